@@ -0,0 +1,260 @@
+// Compares the crawl-path HTTP transports against a local TLS server.
+//
+//   http_transport_bench [requests] [concurrency] [server_delay_ms]
+//
+// The server (self-signed EC certificate, one thread per connection)
+// answers every GET with a small JSON body after server_delay_ms, which
+// stands in for the upstream's response time. The blocking transport gets
+// one thread per concurrent request; the epoll transport keeps the same
+// number in flight from a single submitting thread.
+#include "http_transport.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const std::string kBody = R"({"ok":1,"data":{"user":{"id":1,"screen_name":"bench"}}})";
+
+class TlsServer {
+public:
+  explicit TlsServer(int delay_ms) : m_delay_ms(delay_ms) {
+    m_ctx = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *subject = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, subject);
+    X509_sign(cert, key, EVP_sha256());
+    if (!key || SSL_CTX_use_certificate(m_ctx, cert) != 1 ||
+        SSL_CTX_use_PrivateKey(m_ctx, key) != 1) {
+      std::fprintf(stderr, "failed to set up the server certificate\n");
+      std::exit(1);
+    }
+    X509_free(cert);
+    EVP_PKEY_free(key);
+
+    m_listen = socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(m_listen, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    listen(m_listen, 1024);
+    socklen_t len = sizeof(addr);
+    getsockname(m_listen, reinterpret_cast<sockaddr *>(&addr), &len);
+    m_port = ntohs(addr.sin_port);
+    std::thread([this] { accept_loop(); }).detach();
+  }
+
+  std::string url() const { return "https://127.0.0.1:" + std::to_string(m_port); }
+  int connections() const { return m_connections; }
+
+private:
+  void accept_loop() {
+    for (;;) {
+      const int fd = accept(m_listen, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      m_connections++;
+      std::thread([this, fd] { serve(fd); }).detach();
+    }
+  }
+
+  void serve(int fd) {
+    SSL *ssl = SSL_new(m_ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) == 1) {
+      const std::string response =
+          "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+          std::to_string(kBody.size()) + "\r\n\r\n" + kBody;
+      std::string buf;
+      char chunk[4096];
+      for (;;) {
+        size_t end;
+        bool open = true;
+        while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+          const int n = SSL_read(ssl, chunk, sizeof(chunk));
+          if (n <= 0) {
+            open = false;
+            break;
+          }
+          buf.append(chunk, static_cast<size_t>(n));
+        }
+        if (!open) {
+          break;
+        }
+        buf.erase(0, end + 4);
+        if (m_delay_ms > 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(m_delay_ms));
+        }
+        if (SSL_write(ssl, response.data(), static_cast<int>(response.size())) <= 0) {
+          break;
+        }
+      }
+    }
+    SSL_free(ssl);
+    close(fd);
+  }
+
+  SSL_CTX *m_ctx = nullptr;
+  int m_listen = -1;
+  int m_port = 0;
+  int m_delay_ms = 0;
+  std::atomic<int> m_connections{0};
+};
+
+void report(const HttpTransport &transport,
+            int threads,
+            int connections,
+            Clock::duration elapsed,
+            std::vector<double> latencies_ms,
+            int failed) {
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  auto percentile = [&](double p) {
+    if (latencies_ms.empty()) {
+      return 0.0;
+    }
+    return latencies_ms[static_cast<size_t>(p * static_cast<double>(latencies_ms.size() - 1))];
+  };
+  const double seconds = std::chrono::duration<double>(elapsed).count();
+  const HttpTransportStats stats = transport.stats();
+  std::printf("%-9s threads=%-4d conns=%-4d req/s=%-8.0f p50=%.2fms p99=%.2fms failed=%d\n",
+              transport.name(),
+              threads,
+              connections,
+              static_cast<double>(latencies_ms.size()) / seconds,
+              percentile(0.50),
+              percentile(0.99),
+              failed);
+  std::printf("          reused=%llu handshakes=%llu resumed=%llu handshake=%.1fms (%.1f%% of request time)\n",
+              static_cast<unsigned long long>(stats.reused),
+              static_cast<unsigned long long>(stats.handshakes),
+              static_cast<unsigned long long>(stats.resumed_handshakes),
+              stats.handshake_ms,
+              stats.request_ms > 0 ? 100.0 * stats.handshake_ms / stats.request_ms : 0.0);
+}
+
+void run_blocking(const HttpTransportOptions &options, int requests, int concurrency, int delay_ms) {
+  TlsServer server(delay_ms);
+  HttpTransportOptions local = options;
+  local.base_url = server.url();
+  auto transport = make_blocking_transport(local);
+
+  std::mutex mutex;
+  std::vector<double> latencies;
+  latencies.reserve(static_cast<size_t>(requests));
+  std::atomic<int> next{0};
+  std::atomic<int> failed{0};
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < concurrency; ++t) {
+    threads.emplace_back([&] {
+      std::vector<double> mine;
+      while (next++ < requests) {
+        const auto sent = Clock::now();
+        const HttpResponse response = transport->get("/ajax/profile/info?uid=1", {});
+        if (response.status != 200) {
+          failed++;
+          continue;
+        }
+        mine.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      latencies.insert(latencies.end(), mine.begin(), mine.end());
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  report(*transport, concurrency, server.connections(), Clock::now() - start,
+         std::move(latencies), failed);
+}
+
+void run_epoll(const HttpTransportOptions &options, int requests, int concurrency, int delay_ms) {
+  TlsServer server(delay_ms);
+  HttpTransportOptions local = options;
+  local.base_url = server.url();
+  auto transport = make_epoll_transport(local);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<double> latencies;
+  latencies.reserve(static_cast<size_t>(requests));
+  int in_flight = 0;
+  int done = 0;
+  int failed = 0;
+  const auto start = Clock::now();
+  for (int i = 0; i < requests; ++i) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return in_flight < concurrency; });
+      in_flight++;
+    }
+    const auto sent = Clock::now();
+    transport->get_async("/ajax/profile/info?uid=1", {}, [&, sent](HttpResponse response) {
+      const double ms = std::chrono::duration<double, std::milli>(Clock::now() - sent).count();
+      std::lock_guard<std::mutex> lock(mutex);
+      if (response.status == 200) {
+        latencies.push_back(ms);
+      } else {
+        failed++;
+      }
+      in_flight--;
+      done++;
+      cv.notify_all();
+    });
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return done == requests; });
+  }
+  // The submitting thread plus the event loop.
+  report(*transport, 2, server.connections(), Clock::now() - start,
+         std::move(latencies), failed);
+}
+
+}
+
+int main(int argc, char **argv) {
+  const int requests = argc > 1 ? std::atoi(argv[1]) : 5000;
+  const int concurrency = argc > 2 ? std::atoi(argv[2]) : 32;
+  const int delay_ms = argc > 3 ? std::atoi(argv[3]) : 5;
+  if (requests <= 0 || concurrency <= 0 || delay_ms < 0) {
+    std::fprintf(stderr, "usage: %s [requests] [concurrency] [server_delay_ms]\n", argv[0]);
+    return 1;
+  }
+
+  HttpTransportOptions options;
+  options.max_connections = concurrency;
+  options.verify_peer = false;
+  std::printf("requests=%d concurrency=%d server_delay=%dms\n", requests, concurrency, delay_ms);
+  run_blocking(options, requests, concurrency, delay_ms);
+  run_epoll(options, requests, concurrency, delay_ms);
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Compares the visited-set candidates on memory and lookup latency.
+//
+//   uid_set_bench [uid_count]
+//
+// RSS is sampled from /proc/self/statm before and after filling each
+// structure, so run it on an otherwise idle box for stable numbers.
+#include "uid_set.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <set>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+size_t resident_bytes() {
+  std::ifstream statm("/proc/self/statm");
+  size_t pages_total = 0;
+  size_t pages_resident = 0;
+  statm >> pages_total >> pages_resident;
+  return pages_resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+template <typename Set, typename Insert, typename Contains>
+void run_case(const char *name,
+              const std::vector<uint64_t> &uids,
+              const std::vector<uint64_t> &probes,
+              Insert insert,
+              Contains contains) {
+  const size_t rss_before = resident_bytes();
+  Set set;
+  for (const uint64_t uid : uids) {
+    insert(set, uid);
+  }
+  const size_t rss_after = resident_bytes();
+
+  size_t hits = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (const uint64_t uid : probes) {
+    hits += contains(set, uid) ? 1 : 0;
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const double ns_per_lookup =
+      std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(probes.size());
+  const double rss_delta = static_cast<double>(rss_after - rss_before);
+
+  std::printf("%-14s uids=%zu rss=%.1fMB (%.1f B/uid) lookup=%.1fns hits=%zu\n",
+              name,
+              uids.size(),
+              rss_delta / 1048576.0,
+              rss_delta / static_cast<double>(uids.size()),
+              ns_per_lookup,
+              hits);
+}
+
+}
+
+int main(int argc, char **argv) {
+  const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+  // Weibo uids are 10-digit numbers clustered in a few billion-wide band.
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<uint64_t> dist(1000000000ULL, 7999999999ULL);
+  std::vector<uint64_t> uids(count);
+  for (auto &uid : uids) {
+    uid = dist(rng);
+  }
+  // Half hits, half (almost certain) misses, shuffled.
+  std::vector<uint64_t> probes;
+  probes.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    probes.push_back(i % 2 == 0 ? uids[(i * 7919) % count] : dist(rng));
+  }
+
+  run_case<std::set<uint64_t>>(
+      "std::set",
+      uids,
+      probes,
+      [](std::set<uint64_t> &s, uint64_t uid) { s.insert(uid); },
+      [](const std::set<uint64_t> &s, uint64_t uid) { return s.count(uid) != 0; });
+  run_case<UidSet>(
+      "UidSet",
+      uids,
+      probes,
+      [](UidSet &s, uint64_t uid) { s.insert(uid); },
+      [](const UidSet &s, uint64_t uid) { return s.contains(uid); });
+  return 0;
+}
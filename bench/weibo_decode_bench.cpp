@@ -0,0 +1,289 @@
+// Compares DOM parsing (json::parse plus copying the item arrays, as the
+// handlers used to) with the typed decoders on each JSON backend that is
+// built in, per response page.
+//
+//   weibo_decode_bench [iterations] [profile.json friendships.json mymblog.json]
+//
+// With three file arguments the bench parses those recorded response
+// bodies; otherwise it uses synthetic pages shaped like real responses:
+// 20 users or posts with the members the API sends, most of which the
+// spider ignores. Allocations are counted by replacing the global
+// operator new.
+#include "weibo_decode.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<size_t> g_allocations{0};
+std::atomic<size_t> g_allocated_bytes{0};
+
+}
+
+// noinline keeps GCC from pairing the inlined malloc/free with the new
+// and delete expressions and warning about a mismatch.
+__attribute__((noinline)) void *operator new(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+json user_object(uint64_t id) {
+  return {
+      {"id", id},
+      {"idstr", std::to_string(id)},
+      {"screen_name", "user_" + std::to_string(id)},
+      {"name", "user_" + std::to_string(id)},
+      {"location", "Beijing"},
+      {"description", "A description that is long enough not to fit in a small string buffer."},
+      {"profile_image_url", "https://tvax1.sinaimg.cn/crop.0.0.512.512.50/" + std::to_string(id) + ".jpg"},
+      {"avatar_large", "https://tvax1.sinaimg.cn/crop.0.0.512.512.180/" + std::to_string(id) + ".jpg"},
+      {"avatar_hd", "https://tvax1.sinaimg.cn/crop.0.0.512.512.1024/" + std::to_string(id) + ".jpg"},
+      {"gender", "f"},
+      {"followers_count", 1000 + id % 997},
+      {"friends_count", 100 + id % 97},
+      {"statuses_count", 10 + id % 13},
+      {"favourites_count", 3},
+      {"created_at", "Tue Oct 14 10:00:00 +0800 2014"},
+      {"verified", false},
+      {"verified_type", -1},
+      {"follow_me", false},
+      {"following", true},
+      {"mbrank", 4},
+      {"mbtype", 12},
+      {"status_total_counter", {{"total_cnt", "1,024"}, {"repost_cnt", "24"}, {"comment_cnt", "200"}, {"like_cnt", "800"}}},
+  };
+}
+
+std::string profile_page() {
+  return json{{"ok", 1},
+              {"data", {{"user", user_object(6126303533)},
+                        {"tabList", {{{"name", "home"}, {"tabName", "Home"}}, {{"name", "album"}, {"tabName", "Album"}}}},
+                        {"blockText", ""}}}}
+      .dump();
+}
+
+std::string friendships_page() {
+  json users = json::array();
+  for (uint64_t i = 0; i < 20; ++i) {
+    users.push_back(user_object(7000000000 + i));
+  }
+  return json{{"ok", 1}, {"display_total_number", 1200}, {"next_cursor", 20}, {"users", users}}.dump();
+}
+
+std::string timeline_page() {
+  json list = json::array();
+  for (uint64_t i = 0; i < 20; ++i) {
+    json pics = json::object();
+    json pic_ids = json::array();
+    for (int p = 0; p < 4; ++p) {
+      const std::string pid = "006abcd" + std::to_string(i) + "ly1h" + std::to_string(p);
+      pic_ids.push_back(pid);
+      json info;
+      for (const char *size : {"thumbnail", "bmiddle", "large", "original", "largest", "mw2000"}) {
+        info[size] = {{"url", std::string("https://wx1.sinaimg.cn/") + size + "/" + pid + ".jpg"},
+                      {"width", 1080},
+                      {"height", 1440},
+                      {"cut_type", 1}};
+      }
+      info["object_id"] = "1042018:" + pid;
+      info["pic_id"] = pid;
+      info["photo_tag"] = 0;
+      info["type"] = "pic";
+      pics[pid] = info;
+    }
+    json post = {
+        {"id", 5000000000000000 + i},
+        {"idstr", std::to_string(5000000000000000 + i)},
+        {"mblogid", "Nabc" + std::to_string(i)},
+        {"created_at", "Tue Oct 14 10:00:00 +0800 2026"},
+        {"text", "Post text with a link <a href=\"https://weibo.com\">weibo</a> and enough words to matter."},
+        {"text_raw", "Post text with a link weibo and enough words to matter."},
+        {"source", "iPhone 15"},
+        {"user", user_object(6126303533)},
+        {"reposts_count", 3},
+        {"comments_count", 7},
+        {"attitudes_count", 42},
+        {"pic_ids", pic_ids},
+        {"pic_num", 4},
+        {"pic_infos", pics},
+        {"visible", {{"type", 0}, {"list_id", 0}}},
+    };
+    if (i % 5 == 0) {
+      post["page_info"] = {{"type", "video"},
+                           {"page_pic", "https://wx1.sinaimg.cn/orj480/cover.jpg"},
+                           {"media_info", {{"stream_url", "https://f.video.weibocdn.com/v.mp4"},
+                                           {"stream_url_hd", "https://f.video.weibocdn.com/hd.mp4"},
+                                           {"duration", 31.5}}}};
+    }
+    list.push_back(post);
+  }
+  return json{{"ok", 1}, {"data", {{"since_id", "abc"}, {"list", list}, {"total", 1200}}}}.dump();
+}
+
+std::string read_file(const char *path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    std::fprintf(stderr, "cannot read %s\n", path);
+    std::exit(1);
+  }
+  std::ostringstream out;
+  out << in.rdbuf();
+  return out.str();
+}
+
+// The pre-decoder handlers: full DOM, then the array copied out.
+size_t dom_profile(const std::string &body) {
+  auto resp = json::parse(body);
+  auto user = resp["data"]["user"];
+  return user["id"].get<uint64_t>() + user["screen_name"].get<std::string>().size() +
+         user["followers_count"].get<uint64_t>();
+}
+
+size_t dom_friendships(const std::string &body) {
+  auto resp = json::parse(body);
+  const int total = resp["display_total_number"].get<int>();
+  std::vector<json::object_t> users = resp["users"];
+  size_t sink = static_cast<size_t>(total);
+  for (auto &user : users) {
+    sink += user["id"].get<uint64_t>() + user["screen_name"].get<std::string>().size();
+  }
+  return sink;
+}
+
+size_t dom_timeline(const std::string &body) {
+  auto resp = json::parse(body);
+  auto data = resp["data"];
+  std::vector<json::object_t> items = data["list"];
+  size_t sink = 0;
+  for (auto &item : items) {
+    sink += item["id"].get<uint64_t>() + item["text"].get<std::string>().size() +
+            item["created_at"].get<std::string>().size();
+    if (item.count("pic_infos")) {
+      for (auto &[key, value] : item["pic_infos"].items()) {
+        if (value.contains("large")) {
+          sink += value["large"]["url"].get<std::string>().size();
+        }
+      }
+    }
+  }
+  return sink;
+}
+
+size_t sum_profile(const ProfileResponse &response) {
+  return response.user.uid + response.user.screen_name.size() + response.user.followers_count;
+}
+
+size_t sum_friendships(const FriendshipsPage &page) {
+  size_t sink = static_cast<size_t>(page.display_total_number.value_or(0));
+  for (const auto &user : page.users) {
+    sink += user.uid + user.screen_name.size();
+  }
+  return sink;
+}
+
+size_t sum_timeline(const TimelinePage &page) {
+  size_t sink = 0;
+  for (const auto &post : page.posts) {
+    sink += post.id + post.text.size() + post.created_at.size();
+    for (const auto &url : post.pics) {
+      sink += url.size();
+    }
+  }
+  return sink;
+}
+
+template <typename Decode>
+void run_case(const char *name, const std::string &body, int iterations, Decode decode) {
+  size_t sink = decode(body);
+  const size_t allocations_before = g_allocations.load();
+  const size_t bytes_before = g_allocated_bytes.load();
+  const auto start = Clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    sink += decode(body);
+  }
+  const double elapsed_us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  const double allocations = static_cast<double>(g_allocations.load() - allocations_before) / iterations;
+  const double kib = static_cast<double>(g_allocated_bytes.load() - bytes_before) / iterations / 1024.0;
+  const double mb_per_s = static_cast<double>(body.size()) * iterations / elapsed_us;
+  std::printf("%-22s page=%6.1fKB  %8.1fus/page  %7.1fMB/s  %8.0f allocs/page  %8.1fKB allocated/page  (%zu)\n",
+              name,
+              static_cast<double>(body.size()) / 1024.0,
+              elapsed_us / iterations,
+              mb_per_s,
+              allocations,
+              kib,
+              sink % 10);
+}
+
+}
+
+int main(int argc, char **argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+  if (iterations <= 0 || (argc != 1 && argc != 2 && argc != 5)) {
+    std::fprintf(stderr, "usage: %s [iterations] [profile.json friendships.json mymblog.json]\n", argv[0]);
+    return 1;
+  }
+  const bool recorded = argc == 5;
+  const std::string profile = recorded ? read_file(argv[2]) : profile_page();
+  const std::string friendships = recorded ? read_file(argv[3]) : friendships_page();
+  const std::string timeline = recorded ? read_file(argv[4]) : timeline_page();
+  std::printf("%s pages, default backend %s\n", recorded ? "recorded" : "synthetic", json_backend_name());
+
+  run_case("profile dom", profile, iterations, dom_profile);
+  run_case("profile nlohmann", profile, iterations, [](const std::string &body) {
+    return sum_profile(nlohmann_backend::decode_profile(body));
+  });
+#ifdef SPIDER_HAVE_SIMDJSON
+  run_case("profile simdjson", profile, iterations, [](const std::string &body) {
+    return sum_profile(simdjson_backend::decode_profile(body));
+  });
+#endif
+
+  run_case("friendships dom", friendships, iterations, dom_friendships);
+  run_case("friendships nlohmann", friendships, iterations, [](const std::string &body) {
+    return sum_friendships(nlohmann_backend::decode_friendships(body));
+  });
+#ifdef SPIDER_HAVE_SIMDJSON
+  run_case("friendships simdjson", friendships, iterations, [](const std::string &body) {
+    return sum_friendships(simdjson_backend::decode_friendships(body));
+  });
+#endif
+
+  run_case("mymblog dom", timeline, iterations, dom_timeline);
+  run_case("mymblog nlohmann", timeline, iterations, [](const std::string &body) {
+    return sum_timeline(nlohmann_backend::decode_timeline(body));
+  });
+#ifdef SPIDER_HAVE_SIMDJSON
+  run_case("mymblog simdjson", timeline, iterations, [](const std::string &body) {
+    return sum_timeline(simdjson_backend::decode_timeline(body));
+  });
+#endif
+  return 0;
+}
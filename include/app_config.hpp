@@ -3,6 +3,28 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+
+// Cookie and header files of one logged-in account.
+struct SessionCredentials {
+  std::string name;
+  std::string cookie_path;
+  std::string headers_path;
+};
+
+// Pacing policy for one class of API endpoints (URL path prefix).
+struct EndpointLimit {
+  std::string name;
+  std::string prefix;
+  // 0 inherits request_min_interval_ms
+  int min_interval_ms = 0;
+  int burst = 1;
+  // Negative inherits cooldown_429_ms
+  int cooldown_429_ms = -1;
+  // Burst window: rest pause_ms after every pause_every requests (0 = off)
+  int pause_every = 0;
+  int pause_ms = 0;
+};
 
 struct AppConfig {
   // MongoDB
@@ -15,14 +37,81 @@ struct AppConfig {
   std::string headers_path = "headers.json";
   std::string config_path = "config.json";
   std::string crawl_state_path = "crawl_state.json";
+  // Extra accounts crawled in parallel, each with its own rate budget;
+  // empty uses cookie_path/headers_path as the only session. An entry
+  // without headers_path uses headers_path.
+  std::vector<SessionCredentials> sessions;
+  // Consecutive 429s that take a session out of rotation, and for how long
+  int session_quarantine_429s = 3;
+  int session_quarantine_ms = 300000;
 
   // Weibo API
   std::string weibo_host = "https://www.weibo.com";
   std::string image_host = "https://weibo.com";
+  // Crawl-path HTTP client: "blocking" (cpp-httplib, one thread per
+  // in-flight request) or "epoll" (one event-loop thread for all requests)
+  std::string http_transport = "blocking";
+  // Open connections to weibo_host at most, across all sessions
+  int http_max_connections = 64;
+  // Idle keep-alive connections older than this are closed, not reused
+  int http_max_idle_ms = 60000;
 
   // Default target
   uint64_t default_uid = 6126303533;
   int crawl_max_depth = 1;
+  int crawl_workers = 1;
+  // Fetched users buffered for the MongoDB persist stage; crawl workers
+  // block once it is full
+  int persist_queue_capacity = 32;
+  // Where follower/fan names come from: "listing" (friendship pages,
+  // profile request only when a name is missing) or "profile" (always)
+  std::string follower_profile_source = "listing";
+  // Fan listings are written and queued in chunks of this many users as
+  // pages arrive. fan_max_per_user caps the fans taken per user (0: all);
+  // a cap keeps the first pages ("head") or pages spread evenly over the
+  // whole list ("spread")
+  int fan_chunk_users = 200;
+  int fan_max_per_user = 0;
+  std::string fan_sample_mode = "head";
+  // Profiles fetched by earlier runs are reused for this long; an empty
+  // path keeps the cache for the current run only
+  std::string profile_cache_path = "profile_cache.jsonl";
+  int profile_cache_ttl_minutes = 1440;
+  // Per-user posting model, updated on every visit that checks the
+  // timeline; an empty path disables it. With recrawl_mode "scheduled" a
+  // run without saved crawl state revisits the users due within the
+  // window, most expected new posts first, instead of a BFS from the root
+  std::string recrawl_state_path = "recrawl_state.jsonl";
+  std::string recrawl_mode = "off";
+  int recrawl_window_minutes = 1440;
+  int recrawl_max_users = 500;
+  int recrawl_min_interval_minutes = 60;
+  int recrawl_max_interval_days = 30;
+  // Journal records between full crawl state snapshots
+  int crawl_snapshot_records = 100000;
+  // Snapshot format: "json" or "binary" (mmapped on resume); either loads
+  std::string crawl_state_format = "json";
+  // Upper bound on unsynced checkpoint data after a power loss; negative
+  // leaves flushing to the OS, 0 fsyncs every write
+  int checkpoint_fsync_interval_ms = 1000;
+
+  // Visited tracking: "memory" (UidSet) or "tiered" (Bloom filter in
+  // memory, exact uid runs under visited_index_dir on disk)
+  std::string visited_index_mode = "memory";
+  std::string visited_index_dir = "crawl_visited";
+  uint64_t visited_bloom_expected = 100000000;
+  double visited_bloom_fpr = 0.01;
+  int visited_buffer_uids = 1048576;
+
+  // Frontier storage: "memory" (vector) or "disk" (append-only segment
+  // files under frontier_dir, reopened on resume)
+  std::string frontier_mode = "memory";
+  std::string frontier_dir = "crawl_frontier";
+  int frontier_segment_entries = 65536;
+  // Which queued user is crawled next: "fifo" (BFS), "depth", "followers"
+  // (listed follower count) or "degree" (times discovered); all but fifo
+  // need frontier_mode "memory"
+  std::string frontier_order = "fifo";
 
   // Retry strategy
   int retry_max_attempts = 5;
@@ -34,6 +123,22 @@ struct AppConfig {
   int request_min_interval_ms = 800;
   int request_jitter_ms = 400;
   int cooldown_429_ms = 30000;
+  // "static": fixed min interval; "adaptive": AIMD controller starting at
+  // request_min_interval_ms and kept within [floor, ceiling]. Adaptive is
+  // opt-in: every endpoint bucket speeds up on its own, so the combined
+  // rate can go well past a single request_min_interval_ms budget.
+  std::string request_rate_mode = "static";
+  int request_interval_floor_ms = 300;
+  int request_interval_ceiling_ms = 10000;
+  // Slower successful responses stop the rate from growing; 0 disables
+  int request_latency_threshold_ms = 3000;
+  // Separate token buckets per endpoint class; other URLs share a default
+  // bucket paced by request_min_interval_ms
+  std::vector<EndpointLimit> endpoint_limits = {
+      {"profile", "/ajax/profile/", 0, 1, -1, 80, 10000},
+      {"friendships", "/ajax/friendships/", 0, 1, -1, 20, 5000},
+      {"timeline", "/ajax/statuses/", 0, 1, -1, 0, 0},
+  };
   std::string request_profile = "balanced";
 
   // Logging
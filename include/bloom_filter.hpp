@@ -0,0 +1,35 @@
+#ifndef BLOOM_FILTER_HPP
+#define BLOOM_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Standard Bloom filter over 64-bit uids, sized from an expected item count
+// and a target false-positive rate. Uses Kirsch-Mitzenmacher double hashing
+// so each probe costs one 64-bit mix.
+class BloomFilter {
+public:
+  BloomFilter() = default;
+  BloomFilter(uint64_t expected_items, double false_positive_rate);
+
+  void add(uint64_t uid);
+  // false means "definitely never added".
+  bool possibly_contains(uint64_t uid) const;
+  void clear();
+
+  uint64_t bit_count() const { return m_bit_count; }
+  int hash_count() const { return m_hash_count; }
+  uint64_t items_added() const { return m_items; }
+  size_t memory_bytes() const { return m_words.capacity() * sizeof(uint64_t); }
+  // Theoretical false-positive rate for the number of items added so far.
+  double expected_fpr() const;
+
+private:
+  std::vector<uint64_t> m_words;
+  uint64_t m_bit_count = 0;
+  int m_hash_count = 0;
+  uint64_t m_items = 0;
+};
+
+#endif  // BLOOM_FILTER_HPP
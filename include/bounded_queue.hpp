@@ -0,0 +1,108 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Blocking FIFO with a fixed capacity that connects two pipeline stages.
+//
+// push() blocks while the queue is full, which is how a slow consumer
+// throttles its producers; pop() blocks while it is empty. Time spent
+// blocked on either side is accumulated so each stage can report whether
+// it is the bottleneck. close() wakes everyone: pushes fail from then on,
+// pops drain what is left and then fail.
+template <typename T>
+class BoundedQueue {
+public:
+  struct Stats {
+    size_t depth = 0;
+    size_t high_water = 0;
+    uint64_t pushed = 0;
+    // Producers blocked on a full queue.
+    uint64_t push_stall_ms = 0;
+    // Consumers blocked on an empty queue.
+    uint64_t pop_stall_ms = 0;
+  };
+
+  explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  // False if the queue was closed; the item is dropped.
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_items.size() >= m_capacity && !m_closed) {
+      const auto started = std::chrono::steady_clock::now();
+      m_not_full.wait(lock, [this] { return m_items.size() < m_capacity || m_closed; });
+      m_stats.push_stall_ms += elapsed_ms(started);
+    }
+    if (m_closed) {
+      return false;
+    }
+    m_items.push_back(std::move(item));
+    m_stats.pushed++;
+    if (m_items.size() > m_stats.high_water) {
+      m_stats.high_water = m_items.size();
+    }
+    lock.unlock();
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  // False once the queue is closed and drained.
+  bool pop(T *out) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_items.empty() && !m_closed) {
+      const auto started = std::chrono::steady_clock::now();
+      m_not_empty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+      m_stats.pop_stall_ms += elapsed_ms(started);
+    }
+    if (m_items.empty()) {
+      return false;
+    }
+    *out = std::move(m_items.front());
+    m_items.pop_front();
+    lock.unlock();
+    m_not_full.notify_one();
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_not_full.notify_all();
+    m_not_empty.notify_all();
+  }
+
+  size_t capacity() const { return m_capacity; }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.depth = m_items.size();
+    return stats;
+  }
+
+private:
+  static uint64_t elapsed_ms(std::chrono::steady_clock::time_point started) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count());
+  }
+
+  const size_t m_capacity;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_full;
+  std::condition_variable m_not_empty;
+  std::deque<T> m_items;
+  bool m_closed = false;
+  Stats m_stats;
+};
+
+#endif  // BOUNDED_QUEUE_HPP
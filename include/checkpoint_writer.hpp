@@ -0,0 +1,112 @@
+#ifndef CHECKPOINT_WRITER_HPP
+#define CHECKPOINT_WRITER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "crawl_snapshot.hpp"
+#include "segmented_queue.hpp"
+
+// Writes crawl state snapshots and journal records on a background thread.
+//
+// Crawl workers build a snapshot or encode journal records under their own
+// lock and hand them over here; submitting never touches disk. Bursts are
+// coalesced: a newer snapshot replaces a queued one together with any
+// journal bytes queued before it, and queued journal bytes are written
+// with one write(). Snapshots go to a temp file and are renamed into
+// place; the journal is fsynced at most once per fsync_interval_ms, which
+// bounds how much acknowledged progress a power loss can take with it.
+// A process crash only loses what was still queued here.
+class CheckpointWriter {
+public:
+  struct Stats {
+    uint64_t snapshots_written = 0;
+    uint64_t snapshots_superseded = 0;
+    uint64_t journal_writes = 0;
+    uint64_t journal_bytes = 0;
+    uint64_t fsyncs = 0;
+    uint64_t failures = 0;
+  };
+
+  // fsync_interval_ms < 0 leaves flushing to the OS; 0 fsyncs every write.
+  CheckpointWriter(std::string state_path, std::string journal_path, int fsync_interval_ms);
+  // Drains pending work before the thread exits.
+  ~CheckpointWriter();
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+  // The snapshot's info.journal_generation becomes the new journal header.
+  // The frontier commit is applied after the snapshot is in place.
+  // complete, if set, runs on the writer thread just before the snapshot
+  // is written, for parts too costly to build under the caller's lock; if
+  // it throws the snapshot counts as failed. A superseded snapshot's
+  // complete is dropped without running.
+  void submit_snapshot(CrawlSnapshot snapshot,
+                       CrawlSnapshot::Format format,
+                       std::optional<SegmentedQueue::Commit> frontier_commit,
+                       std::function<void(CrawlSnapshot &)> complete = nullptr);
+  // Records encoded after the last submitted snapshot.
+  void submit_journal(std::string records,
+                      std::optional<SegmentedQueue::Commit> frontier_commit);
+  // Blocks until everything submitted so far is written and fsynced.
+  void drain();
+  // Drains, then deletes the state and journal files.
+  void remove_files();
+
+  // True after a failed snapshot write: journal bytes are dropped until
+  // the next snapshot succeeds, so the caller should take one soon.
+  bool needs_snapshot() const;
+  Stats stats() const;
+
+private:
+  struct Batch {
+    std::unique_ptr<CrawlSnapshot> snapshot;
+    std::function<void(CrawlSnapshot &)> complete;
+    CrawlSnapshot::Format format = CrawlSnapshot::Format::Json;
+    std::string journal;
+    std::optional<SegmentedQueue::Commit> frontier_commit;
+    bool sync = false;
+    bool remove = false;
+  };
+
+  bool has_work_locked() const;
+  void merge_commit_locked(std::optional<SegmentedQueue::Commit> commit);
+  void run();
+  void write_batch(Batch *batch);
+  void write_snapshot(const CrawlSnapshot &snapshot, CrawlSnapshot::Format format);
+  void append_journal(const std::string &bytes);
+  void sync_journal();
+  void close_journal();
+
+  const std::string m_state_path;
+  const std::string m_journal_path;
+  const int m_fsync_interval_ms;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_work_cv;
+  std::condition_variable m_done_cv;
+  Batch m_pending;
+  bool m_stop = false;
+  bool m_broken = false;
+  uint64_t m_submitted = 0;
+  uint64_t m_completed = 0;
+  Stats m_stats;
+
+  // Writer thread only.
+  int m_journal_fd = -1;
+  bool m_journal_dirty = false;
+  // Frontier segments pushed to since the last sync.
+  std::vector<std::string> m_dirty_segments;
+  std::chrono::steady_clock::time_point m_last_sync;
+
+  std::thread m_thread;
+};
+
+#endif  // CHECKPOINT_WRITER_HPP
@@ -0,0 +1,143 @@
+#ifndef CRAWL_FRONTIER_HPP
+#define CRAWL_FRONTIER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "indexed_priority_queue.hpp"
+#include "segmented_queue.hpp"
+#include "visited_index.hpp"
+
+// How CrawlFrontier::pop picks the next uid.
+enum class FrontierOrder {
+  Fifo,       // insertion order: plain BFS
+  Depth,      // shallowest first, insertion order within a depth
+  Followers,  // most followers first, per FrontierOrdering::followers_count
+  Degree,     // most often discovered while queued
+  Custom,     // FrontierOrdering::score
+};
+
+// "fifo", "depth", "followers", "degree"; Custom has no name to parse.
+bool parse_frontier_order(const std::string &name, FrontierOrder *order);
+const char *frontier_order_name(FrontierOrder order);
+
+// What an ordering sees of a queued uid.
+struct FrontierCandidate {
+  uint64_t uid = 0;
+  // Smallest depth the uid was pushed at.
+  int depth = 0;
+  // 0 when unknown.
+  uint64_t followers_count = 0;
+  // Pushes while queued, the admitting one included.
+  uint32_t degree = 0;
+};
+
+struct FrontierOrdering {
+  FrontierOrder order = FrontierOrder::Fifo;
+  // Custom only: higher pops first. Called again whenever a rediscovery
+  // changes the candidate.
+  std::function<double(const FrontierCandidate &)> score;
+  // Looked up once when a uid is admitted; optional.
+  std::function<uint64_t(uint64_t uid)> followers_count;
+};
+
+// BFS frontier used by Spider::run.
+//
+// A uid is admitted at most once: push() rejects anything that was ever
+// queued or marked seen (queued ∪ visited), so dense graphs no longer grow
+// the queue once per incoming edge. Each entry is packed into a single
+// 64-bit word (low 56 bits uid, high 8 bits depth).
+//
+// Entries live either in an in-memory vector or, when a queue dir is given,
+// in a SegmentedQueue on disk that survives restarts on its own. Both are
+// FIFO. With an ordering other than Fifo, entries live in an in-memory
+// IndexedPriorityQueue instead, and pushing a uid that is still queued
+// updates its candidate (degree, depth) and priority rather than being
+// ignored.
+class CrawlFrontier {
+public:
+  CrawlFrontier() = default;
+  // The dedup set can be tiered (Bloom filter + disk) for very large crawls.
+  // A non-empty queue_dir keeps queued entries in segment files there.
+  explicit CrawlFrontier(const VisitedIndexOptions &seen_options,
+                         const std::string &queue_dir = std::string(),
+                         size_t segment_entries = 65536);
+
+  static constexpr int kUidBits = 56;
+  static constexpr uint64_t kUidMask = (uint64_t{1} << kUidBits) - 1;
+  static constexpr int kMaxDepth = 255;
+
+  static uint64_t pack(uint64_t uid, int depth);
+  static uint64_t unpack_uid(uint64_t entry) { return entry & kUidMask; }
+  static int unpack_depth(uint64_t entry) { return static_cast<int>(entry >> kUidBits); }
+
+  // Only while nothing is queued. Orderings other than Fifo need the
+  // in-memory queue: false (FIFO kept) for a disk frontier, or for Custom
+  // without a score.
+  bool set_ordering(FrontierOrdering ordering);
+  FrontierOrder order() const { return m_ordering.order; }
+
+  // Returns false when the uid was already seen or does not fit in 56 bits.
+  // reranked, if given, is set when the push instead updated a queued
+  // uid's candidate; such pushes must be journaled like admitting ones.
+  bool push(uint64_t uid, int depth, bool *reranked = nullptr);
+  bool pop(uint64_t *uid, int *depth);
+
+  // Records a uid as seen without queueing it (e.g. visited uids on resume).
+  void mark_seen(uint64_t uid);
+  bool seen(uint64_t uid) const { return m_seen.contains(uid); }
+
+  bool empty() const { return pending() == 0; }
+  size_t pending() const {
+    if (m_queue) {
+      return m_queue->size();
+    }
+    return ordered() ? m_ranked.size() : m_entries.size() - m_head;
+  }
+  size_t seen_size() const { return m_seen.size(); }
+  VisitedIndex::Stats seen_stats() const { return m_seen.stats(); }
+  // See VisitedIndex::seal(); lets the checkpoint thread write and merge
+  // the seen index's runs.
+  std::function<void()> seal_seen() { return m_seen.seal(); }
+  // An ordered frontier lists each uid once per degree, so pushing the
+  // list back in order restores every candidate's degree and depth.
+  std::vector<std::pair<uint64_t, int>> pending_entries() const;
+  // Disk mode also deletes the segment files.
+  void clear();
+  void flush();
+
+  bool disk_backed() const { return m_queue != nullptr; }
+  std::string queue_dir() const { return m_queue ? m_queue->dir() : std::string(); }
+  // Makes the disk queue's consumed position durable; no-op in memory mode.
+  void checkpoint();
+  // Same, split for a background writer; nullopt in memory mode.
+  std::optional<SegmentedQueue::Commit> prepare_checkpoint();
+  // Rebuilds the seen set from the pending entries, e.g. after the disk
+  // queue was reopened with an empty in-memory seen set.
+  void reseed_seen();
+
+  // Approximate heap footprint of queued entries plus the dedup set.
+  size_t memory_bytes() const;
+  // Footprint scaled to one million admitted uids, for capacity planning.
+  double memory_bytes_per_million() const;
+
+private:
+  bool ordered() const { return m_ordering.order != FrontierOrder::Fifo; }
+  double score(const FrontierCandidate &candidate) const;
+  void for_each_pending(const std::function<void(uint64_t)> &fn) const;
+  void compact();
+
+  std::vector<uint64_t> m_entries;
+  size_t m_head = 0;
+  std::unique_ptr<SegmentedQueue> m_queue;
+  FrontierOrdering m_ordering;
+  IndexedPriorityQueue<FrontierCandidate> m_ranked;
+  VisitedIndex m_seen;
+};
+
+#endif  // CRAWL_FRONTIER_HPP
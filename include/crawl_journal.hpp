@@ -0,0 +1,65 @@
+#ifndef CRAWL_JOURNAL_HPP
+#define CRAWL_JOURNAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Append-only log of crawl state deltas written between snapshots.
+//
+// The crawl state file is a full snapshot tagged with a generation number;
+// every change after it is appended here as a small framed record
+// (length + CRC32 + payload) instead of rewriting the snapshot. Writing a
+// new snapshot bumps the generation and truncates the journal. A journal
+// whose header carries a different generation than the snapshot is stale
+// and ignored, so a crash between the two steps is harmless.
+//
+// Replay stops at the first torn or corrupt record: everything before it
+// was written completely, everything after it is lost work that the crawl
+// simply redoes.
+//
+// This class only encodes records into a buffer; CheckpointWriter owns the
+// file and writes the buffered bytes off the crawl thread.
+class CrawlJournal {
+public:
+  enum class Op : uint8_t {
+    Push = 1,   // uid queued at depth
+    Claim = 2,  // uid popped by a worker
+    Done = 3,   // uid crawled and visited
+    Fail = 4,   // uid gave up, not visited
+  };
+
+  struct Record {
+    Op op;
+    uint64_t uid;
+    int depth;
+  };
+
+  // File header for a journal that follows the given snapshot generation.
+  static std::string header(uint64_t generation);
+
+  // Starts counting records for a new generation; drops buffered records.
+  void reset();
+  void append(Op op, uint64_t uid, int depth = 0);
+  // Returns the encoded records buffered since the last call.
+  std::string take();
+
+  // False until the first reset(), i.e. before any snapshot exists.
+  bool active() const { return m_active; }
+  // Records appended since the last reset().
+  size_t records() const { return m_records; }
+
+  // Calls fn for every intact record of a journal written for generation.
+  // Returns the number of records replayed; 0 for a missing or stale file.
+  static size_t replay(const std::string &path,
+                       uint64_t generation,
+                       const std::function<void(const Record &)> &fn);
+
+private:
+  std::string m_buffer;
+  size_t m_records = 0;
+  bool m_active = false;
+};
+
+#endif  // CRAWL_JOURNAL_HPP
@@ -0,0 +1,93 @@
+#ifndef CRAWL_SNAPSHOT_HPP
+#define CRAWL_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Scalar part of a crawl state snapshot.
+struct CrawlSnapshotInfo {
+  uint64_t root_uid = 0;
+  int max_depth = 0;
+  bool crawl_weibo = false;
+  bool crawl_fans = false;
+  bool crawl_followers = false;
+  uint64_t current_uid = 0;
+  uint64_t journal_generation = 0;
+  // The first in_flight_count queue entries were claimed by workers.
+  uint64_t in_flight_count = 0;
+  // Set when the visited set / pending queue live on disk elsewhere.
+  std::string visited_index;
+  std::string frontier_dir;
+
+  uint64_t users_processed = 0;
+  uint64_t users_failed = 0;
+  uint64_t requests_total = 0;
+  uint64_t requests_failed = 0;
+  uint64_t retries_total = 0;
+  uint64_t http_429_count = 0;
+};
+
+// Full crawl state snapshot in one of two on-disk formats.
+//
+// JSON is the original human-readable format. The binary format (v1) is
+// a 128-byte header, the two optional directory strings, the queue as
+// packed CrawlFrontier entries and the visited set as a sorted uint64
+// array. A binary file is memory-mapped and its arrays are used in place,
+// so opening one costs a header check regardless of crawl size. open()
+// detects the format from the first bytes, so either one resumes.
+class CrawlSnapshot {
+public:
+  enum class Format { Json, Binary };
+
+  CrawlSnapshot() = default;
+  ~CrawlSnapshot();
+  CrawlSnapshot(CrawlSnapshot &&other) noexcept;
+  CrawlSnapshot &operator=(CrawlSnapshot &&other) noexcept;
+  CrawlSnapshot(const CrawlSnapshot &) = delete;
+  CrawlSnapshot &operator=(const CrawlSnapshot &) = delete;
+
+  // Throws std::runtime_error for unreadable or corrupt files.
+  static CrawlSnapshot open(const std::string &path);
+  static CrawlSnapshot from_json(const nlohmann::json &j);
+  static Format parse_format(const std::string &name);
+
+  nlohmann::json to_json() const;
+  // Writes through a temporary file and rename(); durable also fsyncs the
+  // file before the rename.
+  void write(const std::string &path, Format format, bool durable = false) const;
+
+  CrawlSnapshotInfo info;
+
+  // Packed queue entries (see CrawlFrontier::pack), in-flight first.
+  const uint64_t *queue() const { return m_map ? m_queue_view : m_queue.data(); }
+  size_t queue_size() const { return m_map ? m_queue_count : m_queue.size(); }
+  // Sorted, duplicate-free visited uids; empty when info.visited_index is set.
+  const uint64_t *visited() const { return m_map ? m_visited_view : m_visited.data(); }
+  size_t visited_size() const { return m_map ? m_visited_count : m_visited.size(); }
+
+  void set_queue(std::vector<uint64_t> entries);
+  // Sorts and deduplicates.
+  void set_visited(std::vector<uint64_t> uids);
+  bool mapped() const { return m_map != nullptr; }
+
+private:
+  void write_binary(const std::string &path) const;
+  // Copies mapped arrays into owned vectors before modification.
+  void materialize();
+  void unmap();
+
+  std::vector<uint64_t> m_queue;
+  std::vector<uint64_t> m_visited;
+  int m_fd = -1;
+  void *m_map = nullptr;
+  size_t m_map_bytes = 0;
+  const uint64_t *m_queue_view = nullptr;
+  size_t m_queue_count = 0;
+  const uint64_t *m_visited_view = nullptr;
+  size_t m_visited_count = 0;
+};
+
+#endif  // CRAWL_SNAPSHOT_HPP
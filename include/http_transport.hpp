@@ -0,0 +1,85 @@
+#ifndef HTTP_TRANSPORT_HPP
+#define HTTP_TRANSPORT_HPP
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <string>
+
+struct HttpResponse {
+  // 0 when the request failed before a status line arrived; error says why.
+  int status = 0;
+  std::string body;
+  // Header names lower-cased.
+  std::map<std::string, std::string> headers;
+  std::string error;
+};
+
+struct HttpTransportOptions {
+  // scheme://host[:port], http or https.
+  std::string base_url;
+  // Open connections at most; further requests queue for a free one.
+  int max_connections = 64;
+  int connect_timeout_ms = 10000;
+  // From the moment the request is written until the full response.
+  int request_timeout_ms = 30000;
+  // Keep-alive connections idle for longer are closed instead of reused;
+  // 0 keeps them until the server closes them.
+  int max_idle_ms = 60000;
+  bool verify_peer = false;
+};
+
+// Cumulative over the transport's lifetime.
+struct HttpTransportStats {
+  uint64_t requests = 0;
+  // Requests sent on a connection that had already served one.
+  uint64_t reused = 0;
+  uint64_t connections_opened = 0;
+  // Idle connections dropped after max_idle_ms, and ones found closed by
+  // the server (health check on checkout, or EOF while idle).
+  uint64_t idle_expired = 0;
+  uint64_t idle_closed = 0;
+  // Connection setup: TCP connect plus TLS handshake. Resumed handshakes
+  // reused a cached TLS session.
+  uint64_t handshakes = 0;
+  uint64_t resumed_handshakes = 0;
+  double handshake_ms = 0.0;
+  // From taking a connection (including opening it) to the full response.
+  double request_ms = 0.0;
+  // Most requests served by one connection.
+  uint64_t max_requests_per_connection = 0;
+  size_t open_connections = 0;
+  size_t idle_connections = 0;
+};
+
+// HTTP/1.1 GETs against one host.
+//
+// get_async() hands the response to done exactly once, either before it
+// returns or later on a transport thread; done must not block. get()
+// waits for the response on the calling thread.
+class HttpTransport {
+public:
+  using Headers = std::multimap<std::string, std::string>;
+  using Callback = std::function<void(HttpResponse)>;
+
+  virtual ~HttpTransport() = default;
+
+  virtual void get_async(const std::string &path, const Headers &headers, Callback done) = 0;
+  virtual HttpResponse get(const std::string &path, const Headers &headers);
+  virtual const char *name() const = 0;
+  virtual HttpTransportStats stats() const = 0;
+};
+
+// cpp-httplib clients checked out per request; every in-flight request
+// holds the calling thread. httplib reconnects inside a client without
+// telling us, so handshake counters stay 0 and TLS sessions are not
+// resumed.
+std::unique_ptr<HttpTransport> make_blocking_transport(const HttpTransportOptions &options);
+
+// One epoll thread multiplexing non-blocking keep-alive connections
+// (OpenSSL for https), so many requests can be in flight without a
+// thread each. Response bodies are not content-decoded.
+std::unique_ptr<HttpTransport> make_epoll_transport(const HttpTransportOptions &options);
+
+#endif  // HTTP_TRANSPORT_HPP
@@ -0,0 +1,168 @@
+#ifndef INDEXED_PRIORITY_QUEUE_HPP
+#define INDEXED_PRIORITY_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Binary max-heap keyed by uid, with a uid -> slot index so the priority of
+// a queued key can be changed in O(log n) instead of re-queueing it.
+//
+// Highest priority pops first; equal priorities pop in push order, so a
+// constant priority degenerates to FIFO. update() keeps a key's original
+// push order. Not thread-safe.
+template <typename T>
+class IndexedPriorityQueue {
+public:
+  // False (and nothing changes) if key is already queued.
+  bool push(uint64_t key, double priority, T value) {
+    if (m_index.count(key)) {
+      return false;
+    }
+    m_nodes.push_back(Node{key, priority, m_next_seq++, std::move(value)});
+    m_index[key] = m_nodes.size() - 1;
+    sift_up(m_nodes.size() - 1);
+    return true;
+  }
+
+  // False if key is not queued.
+  bool update(uint64_t key, double priority) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+      return false;
+    }
+    const size_t slot = it->second;
+    const double old = m_nodes[slot].priority;
+    m_nodes[slot].priority = priority;
+    if (priority > old) {
+      sift_up(slot);
+    } else if (priority < old) {
+      sift_down(slot);
+    }
+    return true;
+  }
+
+  bool pop(uint64_t *key, T *value, double *priority = nullptr) {
+    if (m_nodes.empty()) {
+      return false;
+    }
+    Node &top = m_nodes.front();
+    if (key) {
+      *key = top.key;
+    }
+    if (priority) {
+      *priority = top.priority;
+    }
+    if (value) {
+      *value = std::move(top.value);
+    }
+    m_index.erase(top.key);
+    if (m_nodes.size() > 1) {
+      m_nodes.front() = std::move(m_nodes.back());
+      m_index[m_nodes.front().key] = 0;
+    }
+    m_nodes.pop_back();
+    if (!m_nodes.empty()) {
+      sift_down(0);
+    }
+    return true;
+  }
+
+  // Null if key is not queued. The value may be changed in place; the
+  // priority only through update().
+  T *find(uint64_t key) {
+    auto it = m_index.find(key);
+    return it == m_index.end() ? nullptr : &m_nodes[it->second].value;
+  }
+  const T *find(uint64_t key) const {
+    auto it = m_index.find(key);
+    return it == m_index.end() ? nullptr : &m_nodes[it->second].value;
+  }
+  bool contains(uint64_t key) const { return m_index.count(key) != 0; }
+
+  size_t size() const { return m_nodes.size(); }
+  bool empty() const { return m_nodes.empty(); }
+  void clear() {
+    m_nodes.clear();
+    m_nodes.shrink_to_fit();
+    m_index.clear();
+    m_next_seq = 0;
+  }
+
+  // Heap order, not pop order.
+  template <typename Fn>
+  void for_each(Fn &&fn) const {
+    for (const Node &node : m_nodes) {
+      fn(node.key, node.value, node.priority);
+    }
+  }
+
+  // Approximate heap footprint: node array plus the index's nodes and
+  // buckets.
+  size_t memory_bytes() const {
+    return m_nodes.capacity() * sizeof(Node) +
+           m_index.size() * (sizeof(std::pair<const uint64_t, size_t>) + 2 * sizeof(void *)) +
+           m_index.bucket_count() * sizeof(void *);
+  }
+
+private:
+  struct Node {
+    uint64_t key;
+    double priority;
+    uint64_t seq;
+    T value;
+  };
+
+  static bool before(const Node &a, const Node &b) {
+    if (a.priority != b.priority) {
+      return a.priority > b.priority;
+    }
+    return a.seq < b.seq;
+  }
+
+  void place(size_t slot, Node node) {
+    m_index[node.key] = slot;
+    m_nodes[slot] = std::move(node);
+  }
+
+  void sift_up(size_t slot) {
+    Node node = std::move(m_nodes[slot]);
+    while (slot > 0) {
+      const size_t parent = (slot - 1) / 2;
+      if (!before(node, m_nodes[parent])) {
+        break;
+      }
+      place(slot, std::move(m_nodes[parent]));
+      slot = parent;
+    }
+    place(slot, std::move(node));
+  }
+
+  void sift_down(size_t slot) {
+    Node node = std::move(m_nodes[slot]);
+    const size_t n = m_nodes.size();
+    while (true) {
+      size_t child = 2 * slot + 1;
+      if (child >= n) {
+        break;
+      }
+      if (child + 1 < n && before(m_nodes[child + 1], m_nodes[child])) {
+        child++;
+      }
+      if (!before(m_nodes[child], node)) {
+        break;
+      }
+      place(slot, std::move(m_nodes[child]));
+      slot = child;
+    }
+    place(slot, std::move(node));
+  }
+
+  std::vector<Node> m_nodes;
+  std::unordered_map<uint64_t, size_t> m_index;
+  uint64_t m_next_seq = 0;
+};
+
+#endif  // INDEXED_PRIORITY_QUEUE_HPP
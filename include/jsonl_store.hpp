@@ -0,0 +1,159 @@
+#ifndef JSONL_STORE_HPP
+#define JSONL_STORE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fmt/core.h>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Unix seconds, the timestamp unit of the entries kept in JsonlStores.
+inline int64_t unix_now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// uid -> Entry map persisted as a JSON-lines file, one line per put();
+// later lines for the same uid win. Entry needs a uint64_t uid member.
+//
+// The file is loaded on construction, skipping unreadable lines such as a
+// torn last line from a crash. Lines are buffered and appended in batches,
+// and the file is rewritten without superseded lines once they outnumber
+// the live ones. An empty path keeps the map in memory only. Not
+// thread-safe; owners lock around it.
+template <typename Entry>
+class JsonlStore {
+public:
+  // encode returns one line including its '\n'; decode returns false for a
+  // line it cannot read.
+  using Encode = std::string (*)(const Entry &entry);
+  using Decode = bool (*)(const std::string &line, Entry *entry);
+
+  // what names the file in log messages, e.g. "profile cache".
+  JsonlStore(std::string path, std::string what, Encode encode, Decode decode)
+      : m_path(std::move(path)), m_what(std::move(what)), m_encode(encode), m_decode(decode) {
+    if (!m_path.empty()) {
+      load();
+    }
+  }
+  // Flushes buffered lines.
+  ~JsonlStore() { flush(); }
+  JsonlStore(const JsonlStore &) = delete;
+  JsonlStore &operator=(const JsonlStore &) = delete;
+
+  const Entry *find(uint64_t uid) const {
+    auto it = m_entries.find(uid);
+    return it == m_entries.end() ? nullptr : &it->second;
+  }
+
+  void put(Entry entry) {
+    if (!m_path.empty()) {
+      m_pending += m_encode(entry);
+      m_file_lines++;
+    }
+    const uint64_t uid = entry.uid;
+    m_entries[uid] = std::move(entry);
+    if (m_pending.size() >= kFlushBytes) {
+      flush();
+    }
+  }
+
+  // Appends buffered lines to the file.
+  void flush() {
+    if (m_pending.empty()) {
+      return;
+    }
+    if (needs_compaction() && compact()) {
+      return;
+    }
+    std::ofstream ofs(m_path, std::ios::app | std::ios::binary);
+    if (!ofs.write(m_pending.data(), static_cast<std::streamsize>(m_pending.size()))) {
+      spdlog::warn(fmt::format("{} append failed {}", m_what, m_path));
+    }
+    m_pending.clear();
+  }
+
+  const std::unordered_map<uint64_t, Entry> &entries() const { return m_entries; }
+  size_t size() const { return m_entries.size(); }
+  const std::string &path() const { return m_path; }
+
+private:
+  // Buffered bytes that trigger an append to the file.
+  static constexpr size_t kFlushBytes = 64 * 1024;
+  // Superseded lines tolerated before the file is rewritten.
+  static constexpr size_t kCompactSlack = 1024;
+
+  bool needs_compaction() const { return m_file_lines > 2 * m_entries.size() + kCompactSlack; }
+
+  void load() {
+    std::ifstream ifs(m_path);
+    if (!ifs.is_open()) {
+      return;
+    }
+    std::string line;
+    size_t bad = 0;
+    while (std::getline(ifs, line)) {
+      if (line.empty()) {
+        continue;
+      }
+      Entry entry;
+      if (!m_decode(line, &entry)) {
+        bad++;
+        continue;
+      }
+      const uint64_t uid = entry.uid;
+      m_entries[uid] = std::move(entry);
+      m_file_lines++;
+    }
+    ifs.close();
+    if (bad > 0) {
+      spdlog::warn(fmt::format("{} {}: skipped {} unreadable lines", m_what, m_path, bad));
+    }
+    spdlog::info(fmt::format("{} {}: loaded {} entries", m_what, m_path, m_entries.size()));
+    if (bad > 0 || needs_compaction()) {
+      compact();
+    }
+  }
+
+  // Rewrites the file from memory; false leaves it untouched.
+  bool compact() {
+    const std::string tmp_path = m_path + ".tmp";
+    {
+      std::ofstream ofs(tmp_path, std::ios::trunc | std::ios::binary);
+      for (const auto &[uid, entry] : m_entries) {
+        (void)uid;
+        const std::string line = m_encode(entry);
+        ofs.write(line.data(), static_cast<std::streamsize>(line.size()));
+      }
+      if (!ofs) {
+        spdlog::warn(fmt::format("{} compaction failed {}", m_what, tmp_path));
+        std::remove(tmp_path.c_str());
+        return false;
+      }
+    }
+    if (std::rename(tmp_path.c_str(), m_path.c_str()) != 0) {
+      spdlog::warn(fmt::format("{} rename failed {}", m_what, m_path));
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+    // Everything buffered is now part of the rewritten file.
+    m_pending.clear();
+    m_file_lines = m_entries.size();
+    return true;
+  }
+
+  const std::string m_path;
+  const std::string m_what;
+  const Encode m_encode;
+  const Decode m_decode;
+  std::unordered_map<uint64_t, Entry> m_entries;
+  std::string m_pending;
+  size_t m_file_lines = 0;
+};
+
+#endif  // JSONL_STORE_HPP
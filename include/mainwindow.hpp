@@ -43,6 +43,7 @@
 
 class Spider;
 class User;
+struct UserRelations;
 
 struct Theme {
   QString name;
@@ -191,6 +192,19 @@ private slots:
                          qulonglong queuePending,
                          qulonglong visitedTotal,
                          qulonglong currentUid);
+   void onProfileCacheUpdated(qulonglong hits, qulonglong misses);
+   void onPipelineUpdated(qulonglong persistQueueDepth,
+                          qulonglong fetchStallMs,
+                          qulonglong persistIdleMs);
+   void onRequestRateUpdated(double requestsPerSecond);
+   void onEndpointRatesUpdated(const QString& summary);
+   void onSessionsUpdated(const QString& summary);
+   void onConnectionsUpdated(const QString& summary);
+   void onPacingUpdated(qulonglong spacingMs,
+                        qulonglong jitterMs,
+                        qulonglong cooldownMs,
+                        qulonglong pauseMs,
+                        qulonglong backoffMs);
    void showNodeWeibo(uint64_t uid);
     void updateWeiboStats(int totalWeibo, int totalVideo);
     void showAllPictures(uint64_t uid);
@@ -203,6 +217,7 @@ private:
    void runSpider();
    void loadConfig();
    void addUserNode(uint64_t uid, const QString& name, const QList<uint64_t>& followers, const QList<uint64_t>& fans);
+   void addRestoredUsers(const std::vector<UserRelations>& users);
    QPointF getRandomPosition();
    void saveConfig();
    void applyTheme(int index);
@@ -316,6 +331,8 @@ private:
      QSpinBox* m_requestMinIntervalSpin;
      QSpinBox* m_requestJitterSpin;
      QSpinBox* m_cooldown429Spin;
+     QSpinBox* m_crawlWorkersSpin;
+     QCheckBox* m_adaptiveRateCheck;
      QComboBox* m_requestProfileCombo;
      QComboBox* m_logLevelCombo;
      QLabel* m_cookiePathLabel;
@@ -326,6 +343,13 @@ private:
       QLabel* m_monitor429Label;
       QLabel* m_monitorQueueLabel;
       QLabel* m_monitorCurrentUidLabel;
+      QLabel* m_monitorProfileCacheLabel;
+      QLabel* m_monitorPipelineLabel;
+      QLabel* m_monitorRateLabel;
+      QLabel* m_monitorEndpointsLabel;
+      QLabel* m_monitorPacingLabel;
+      QLabel* m_monitorSessionsLabel;
+      QLabel* m_monitorConnectionsLabel;
       QTableWidget* m_downloadTable;
       QMap<QString, int> m_downloadRowById;
       std::atomic<uint64_t> m_downloadTaskSeq;
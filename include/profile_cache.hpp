@@ -0,0 +1,61 @@
+#ifndef PROFILE_CACHE_HPP
+#define PROFILE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include "jsonl_store.hpp"
+
+struct CachedProfile {
+  uint64_t uid = 0;
+  std::string screen_name;
+  uint64_t followers_count = 0;
+  uint64_t friends_count = 0;
+  uint64_t statuses_count = 0;
+  // Unix seconds of the request that produced this entry.
+  int64_t fetched_at = 0;
+};
+
+// Persistent uid -> profile cache shared by crawl runs.
+//
+// Entries live in memory and are appended to a JSON-lines file, one object
+// per put (see JsonlStore). Entries older than the TTL count as misses but
+// stay until they are overwritten.
+class ProfileCache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t expired = 0;
+    size_t entries = 0;
+  };
+
+  // An empty path keeps the cache in memory only.
+  // Buffered entries are flushed on destruction.
+  ProfileCache(std::string path, int64_t ttl_seconds);
+  ProfileCache(const ProfileCache &) = delete;
+  ProfileCache &operator=(const ProfileCache &) = delete;
+
+  // now defaults to the current time.
+  std::optional<CachedProfile> get(uint64_t uid, int64_t now = 0);
+  // Any entry, expired or not, without touching the hit/miss counters;
+  // for estimates that tolerate stale counts.
+  std::optional<CachedProfile> peek(uint64_t uid) const;
+  void put(CachedProfile profile);
+  // Appends buffered entries to the file.
+  void flush();
+
+  Stats stats() const;
+  const std::string &path() const { return m_store.path(); }
+
+private:
+  const int64_t m_ttl_seconds;
+
+  mutable std::mutex m_mutex;
+  JsonlStore<CachedProfile> m_store;
+  Stats m_stats;
+};
+
+#endif  // PROFILE_CACHE_HPP
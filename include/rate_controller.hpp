@@ -0,0 +1,60 @@
+#ifndef RATE_CONTROLLER_HPP
+#define RATE_CONTROLLER_HPP
+
+#include <chrono>
+#include <mutex>
+
+struct RateControllerOptions {
+  // Shortest and longest gap between request starts; the rate never
+  // leaves [1000 / ceiling, 1000 / floor] requests per second.
+  int floor_interval_ms = 200;
+  int ceiling_interval_ms = 10000;
+  int initial_interval_ms = 800;
+  // Requests per second added for every healthy response.
+  double increase_rps = 0.02;
+  // Rate multiplier applied on a throttling signal.
+  double decrease_factor = 0.5;
+  // Successful responses slower than this hold the rate instead of
+  // raising it; 0 disables the latency signal.
+  int latency_threshold_ms = 3000;
+  // Throttling signals within this long after a decrease are treated as
+  // echoes of the same congestion event (requests already in flight).
+  int decrease_hold_ms = 1000;
+};
+
+// AIMD controller for the shared request rate.
+//
+// Healthy responses raise the rate additively; 429, 5xx and transport
+// errors cut it multiplicatively, at most once per hold window. The
+// result is the gap the pacer keeps between request starts, so the crawl
+// settles just below whatever rate the server tolerates instead of a
+// hand-picked interval.
+class RateController {
+public:
+  enum class Signal { Healthy, Slow, Throttled, Neutral };
+
+  explicit RateController(const RateControllerOptions &options = {});
+
+  // Maps an HTTP status (0 for a transport error) and its latency.
+  Signal classify(int status, std::chrono::milliseconds latency) const;
+  void on_response(int status,
+                   std::chrono::milliseconds latency,
+                   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+
+  double rate_rps() const;
+  std::chrono::milliseconds interval() const;
+  unsigned long long decreases() const;
+
+private:
+  RateControllerOptions m_options;
+  double m_min_rps;
+  double m_max_rps;
+
+  mutable std::mutex m_mutex;
+  double m_rate_rps;
+  unsigned long long m_decreases = 0;
+  bool m_decreased = false;
+  std::chrono::steady_clock::time_point m_last_decrease;
+};
+
+#endif  // RATE_CONTROLLER_HPP
@@ -0,0 +1,131 @@
+#ifndef RATE_LIMITER_HPP
+#define RATE_LIMITER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "rate_controller.hpp"
+
+// Token bucket in virtual-scheduling (GCRA) form: reserve() takes one
+// token and returns when the caller may send. Up to burst requests go out
+// back to back, then one per 1/rate_rps; concurrent callers are spaced out
+// by handing out increasing send times rather than by polling.
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket(double rate_rps, int burst);
+
+  Clock::time_point reserve(Clock::time_point now);
+  // What reserve(now) would return, without taking the token.
+  Clock::time_point peek(Clock::time_point now) const;
+  // Nothing is sent before until, and the bucket starts empty there
+  // (429 cooldown).
+  void hold_until(Clock::time_point until);
+  void set_rate(double rate_rps);
+  double rate() const { return m_rate; }
+
+private:
+  double m_rate;
+  int m_burst;
+  Clock::duration m_interval;
+  // Theoretical arrival time: when the bucket would be full again.
+  Clock::time_point m_tat;
+};
+
+// Request budgets per endpoint class, routed by URL path prefix.
+//
+// Each endpoint has its own bucket, 429 cooldown, burst window and, when
+// adaptive, its own AIMD controller, so a long fan pagination cannot
+// starve profile or timeline requests. URLs matching no prefix use the
+// first endpoint registered with an empty prefix, or the last one.
+//
+// Time handed out by acquire() is attributed to the reason the request
+// had to wait: bucket spacing, 429 cooldown, burst-window pause or jitter.
+// Waits are summed over callers, so with several workers they add up to
+// more than wall-clock time.
+class RateLimitRegistry {
+public:
+  using Clock = TokenBucket::Clock;
+
+  struct EndpointOptions {
+    std::string name;
+    std::string prefix;
+    int min_interval_ms = 800;
+    int burst = 1;
+    int cooldown_429_ms = 30000;
+    // After every pause_every requests the endpoint rests for pause_ms;
+    // 0 disables the burst window.
+    int pause_every = 0;
+    int pause_ms = 0;
+  };
+
+  struct EndpointStats {
+    std::string name;
+    double rate_rps = 0.0;
+    uint64_t requests = 0;
+    uint64_t throttled = 0;
+    uint64_t pauses = 0;
+    // wait_ms is the sum of the four kinds below.
+    uint64_t wait_ms = 0;
+    uint64_t spacing_wait_ms = 0;
+    uint64_t cooldown_wait_ms = 0;
+    uint64_t pause_wait_ms = 0;
+    uint64_t jitter_wait_ms = 0;
+  };
+
+  RateLimitRegistry() = default;
+  RateLimitRegistry(const RateLimitRegistry &) = delete;
+  RateLimitRegistry &operator=(const RateLimitRegistry &) = delete;
+
+  // adaptive: floor/ceiling/latency settings for a per-endpoint AIMD
+  // controller starting at min_interval_ms; nullopt keeps the rate fixed.
+  void add(const EndpointOptions &options,
+           const std::optional<RateControllerOptions> &adaptive = std::nullopt);
+
+  size_t route(const std::string &url) const;
+  const std::string &name(size_t endpoint) const;
+
+  // Reserves a slot; the caller sleeps until the returned time.
+  // extra_delay (jitter) is added to this request only.
+  Clock::time_point acquire(size_t endpoint,
+                            std::chrono::milliseconds extra_delay = std::chrono::milliseconds(0),
+                            Clock::time_point now = Clock::now());
+  // Earliest send time the endpoint could hand out now, jitter and burst
+  // pauses not included.
+  Clock::time_point next_slot(size_t endpoint, Clock::time_point now = Clock::now()) const;
+  // Holds every endpoint until the given time, counted as cooldown.
+  void hold_all(Clock::time_point until);
+  // status 0 is a transport error. A 429 starts the endpoint's cooldown.
+  void on_response(size_t endpoint,
+                   int status,
+                   std::chrono::milliseconds latency,
+                   Clock::time_point now = Clock::now());
+
+  std::vector<EndpointStats> stats() const;
+
+private:
+  enum class HoldReason { None, Cooldown, Pause };
+
+  struct Endpoint {
+    EndpointOptions options;
+    std::unique_ptr<TokenBucket> bucket;
+    std::unique_ptr<RateController> controller;
+    EndpointStats stats;
+    // Latest hold placed on the bucket, for attributing waits.
+    Clock::time_point hold_until;
+    HoldReason hold_reason = HoldReason::None;
+  };
+
+  static void hold(Endpoint &e, Clock::time_point until, HoldReason reason);
+
+  mutable std::mutex m_mutex;
+  std::vector<Endpoint> m_endpoints;
+};
+
+#endif  // RATE_LIMITER_HPP
@@ -0,0 +1,101 @@
+#ifndef RECRAWL_SCHEDULER_HPP
+#define RECRAWL_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "jsonl_store.hpp"
+
+struct RecrawlOptions {
+  // A user is due once the chance of at least one new post since the last
+  // visit reaches this.
+  double due_probability = 0.5;
+  // Bounds on the time between visits, whatever the estimated rate.
+  int64_t min_interval_seconds = 3600;
+  int64_t max_interval_seconds = 30 * 86400;
+  // Observations lose half their weight every half life, so a user who
+  // stops posting drifts back toward the prior.
+  int64_t half_life_seconds = 30 * 86400;
+  // Prior belief, worth prior_seconds of observation: prior_posts posts in
+  // that time (one a week by default).
+  double prior_posts = 1.0;
+  double prior_seconds = 7 * 86400;
+};
+
+// What is known about one user's posting.
+struct RecrawlEntry {
+  uint64_t uid = 0;
+  // Unix seconds of the last visit that checked the timeline.
+  int64_t last_crawl = 0;
+  // Decayed new posts seen over decayed seconds observed, prior excluded.
+  double posts = 0.0;
+  double exposure_seconds = 0.0;
+  uint32_t visits = 0;
+};
+
+struct RecrawlCandidate {
+  uint64_t uid = 0;
+  int64_t last_crawl = 0;
+  // Unix seconds at which the user became or becomes due.
+  int64_t due_at = 0;
+  double posts_per_day = 0.0;
+  // Expected new posts by the end of the planned window.
+  double expected_posts = 0.0;
+};
+
+// Persistent per-user freshness model for revisiting users across runs.
+//
+// Posting is modelled as a Poisson process per user; the rate estimate is
+// the Gamma posterior mean (prior plus exponentially decayed counts), so
+// users with few visits stay near the prior. The first visit of a user
+// only starts the clock: its posts are the whole backlog, not new ones.
+//
+// Entries are kept in memory and persisted as JSON lines, one per visit
+// (see JsonlStore). Thread-safe.
+class RecrawlScheduler {
+public:
+  struct Stats {
+    size_t users = 0;
+    // Users that are due now.
+    size_t due = 0;
+  };
+
+  // An empty path keeps the model in memory only.
+  // Buffered entries are flushed on destruction.
+  explicit RecrawlScheduler(std::string path, RecrawlOptions options = {});
+  RecrawlScheduler(const RecrawlScheduler &) = delete;
+  RecrawlScheduler &operator=(const RecrawlScheduler &) = delete;
+
+  // A visit at now (default: the current time) found new_posts posts that
+  // were not stored before.
+  void record_visit(uint64_t uid, size_t new_posts, int64_t now = 0);
+
+  std::optional<RecrawlEntry> get(uint64_t uid) const;
+  // Posterior mean rate; the prior for unknown users.
+  double posts_per_day(uint64_t uid) const;
+  // When the user's change probability reaches due_probability, clamped to
+  // [min_interval, max_interval] after the last visit.
+  int64_t due_at(const RecrawlEntry &entry) const;
+
+  // Users due before now + window_seconds, most expected new posts by the
+  // end of the window first, at most limit of them (0: no limit).
+  std::vector<RecrawlCandidate> plan(int64_t window_seconds, size_t limit, int64_t now = 0) const;
+
+  Stats stats(int64_t now = 0) const;
+  // Appends buffered entries to the file.
+  void flush();
+  const std::string &path() const { return m_store.path(); }
+
+private:
+  double rate_per_second(const RecrawlEntry &entry) const;
+
+  const RecrawlOptions m_options;
+
+  mutable std::mutex m_mutex;
+  JsonlStore<RecrawlEntry> m_store;
+};
+
+#endif  // RECRAWL_SCHEDULER_HPP
@@ -0,0 +1,106 @@
+#ifndef SEGMENTED_QUEUE_HPP
+#define SEGMENTED_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Disk-backed FIFO of uint64 words, stored as append-only segment files.
+//
+// Each segment holds a fixed number of entries and is memory-mapped only
+// while it is the head (being consumed) or the tail (being appended to);
+// segments in between are plain files. Consumed segments are deleted at
+// the next commit(), so disk use tracks the pending backlog and resident
+// memory stays at two segments however long the crawl runs.
+//
+// The head position is persisted by commit() in a small "head" file that
+// is replaced atomically. Entries popped after the last commit are popped
+// again after a crash; the spider skips those already in its visited set.
+class SegmentedQueue {
+public:
+  // A head position to persist plus the segments it makes obsolete, and
+  // the segments pushed to since the previous commit.
+  struct Commit {
+    std::string head_path;
+    uint64_t seq = 0;
+    uint64_t pos = 0;
+    // false when the head file already holds seq/pos.
+    bool head_changed = false;
+    std::vector<std::string> consumed;
+    std::vector<std::string> dirty;
+
+    // Folds a newer commit into this one.
+    void merge(Commit newer);
+  };
+
+  SegmentedQueue(std::string dir, size_t segment_entries);
+  ~SegmentedQueue();
+  SegmentedQueue(const SegmentedQueue &) = delete;
+  SegmentedQueue &operator=(const SegmentedQueue &) = delete;
+
+  void push(uint64_t value);
+  bool pop(uint64_t *value);
+  bool empty() const { return m_pending == 0; }
+  size_t size() const { return m_pending; }
+
+  // Persists the head position and deletes fully consumed segments.
+  void commit() { apply_commit(prepare_commit()); }
+  // Split form of commit() so the file I/O can run on another thread:
+  // prepare_commit() only captures state, apply_commit() touches no queue
+  // members and may run later, as long as commits are applied in order.
+  Commit prepare_commit();
+  static void apply_commit(const Commit &commit);
+  // fdatasync()s segments listed in Commit::dirty. Goes through the files,
+  // not the mappings, which may be gone by the time a background writer
+  // runs; pages written through a shared mapping are flushed either way.
+  static void sync_segments(const std::vector<std::string> &paths);
+  // msync()s the mapped segments; only needed for power-loss durability.
+  void sync();
+  // Deletes every segment and the head file.
+  void clear();
+
+  // Visits pending entries in FIFO order without consuming them.
+  void for_each(const std::function<void(uint64_t)> &fn) const;
+  size_t segment_count() const { return m_seqs.size(); }
+  size_t mapped_bytes() const;
+  const std::string &dir() const { return m_dir; }
+
+private:
+  struct Segment {
+    std::string path;
+    int fd = -1;
+    char *map = nullptr;
+    size_t map_bytes = 0;
+  };
+
+  std::string segment_path(uint64_t seq) const;
+  std::string head_path() const;
+  void open_existing();
+  Segment &map_segment(uint64_t seq, bool create);
+  void unmap_segment(uint64_t seq);
+  void release_idle_segments();
+  static uint64_t segment_count_field(const Segment &segment);
+  uint64_t read_count(uint64_t seq) const;
+
+  std::string m_dir;
+  size_t m_segment_entries;
+  size_t m_segment_bytes;
+  // Sequence numbers of live segments, head first.
+  std::deque<uint64_t> m_seqs;
+  uint64_t m_next_seq = 1;
+  uint64_t m_head_pos = 0;
+  uint64_t m_committed_seq = 0;
+  uint64_t m_committed_pos = 0;
+  size_t m_pending = 0;
+  std::map<uint64_t, Segment> m_mapped;
+  std::vector<std::string> m_consumed;
+  std::vector<std::string> m_dirty;
+  // Segment last added to m_dirty, 0 for none.
+  uint64_t m_dirty_seq = 0;
+};
+
+#endif  // SEGMENTED_QUEUE_HPP
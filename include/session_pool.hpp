@@ -0,0 +1,90 @@
+#ifndef SESSION_POOL_HPP
+#define SESSION_POOL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "rate_limiter.hpp"
+
+struct SessionPoolOptions {
+  // Consecutive 429s that quarantine a session; 0 never quarantines.
+  int quarantine_after_429s = 3;
+  int quarantine_ms = 300000;
+};
+
+// Scheduling state for several logged-in accounts.
+//
+// Every session has its own endpoint buckets, cooldowns and AIMD
+// controllers. acquire() picks the healthy session that can send soonest
+// (fewest requests in flight on a tie) and reserves its slot; release()
+// feeds the response back. A session that keeps drawing 429s is
+// quarantined: all its endpoints are held and it is skipped until the
+// quarantine ends, unless every session is quarantined.
+//
+// The pool only does the bookkeeping; the caller owns the HTTP clients
+// and indexes them by Lease::session.
+class SessionPool {
+public:
+  using Clock = RateLimitRegistry::Clock;
+
+  struct Lease {
+    size_t session = 0;
+    size_t endpoint = 0;
+    Clock::time_point send_at;
+  };
+
+  struct SessionStats {
+    std::string name;
+    bool quarantined = false;
+    uint64_t requests = 0;
+    uint64_t throttled = 0;
+    uint64_t quarantines = 0;
+    uint64_t in_flight = 0;
+  };
+
+  explicit SessionPool(const SessionPoolOptions &options = {});
+  SessionPool(const SessionPool &) = delete;
+  SessionPool &operator=(const SessionPool &) = delete;
+
+  // All sessions must be given registries with the same endpoints.
+  size_t add(const std::string &name, std::unique_ptr<RateLimitRegistry> limits);
+
+  Lease acquire(const std::string &url,
+                std::chrono::milliseconds extra_delay = std::chrono::milliseconds(0),
+                Clock::time_point now = Clock::now());
+  // Gives back a lease whose request was never sent. Only in_flight is
+  // undone; the reserved bucket slot stays spent, so callers should not
+  // acquire speculatively.
+  void cancel(const Lease &lease);
+  // status 0 is a transport error.
+  void release(const Lease &lease,
+               int status,
+               std::chrono::milliseconds latency,
+               Clock::time_point now = Clock::now());
+
+  size_t size() const;
+  const std::string &name(size_t session) const;
+  const std::string &endpoint_name(size_t endpoint) const;
+  std::vector<SessionStats> stats(Clock::time_point now = Clock::now()) const;
+  // Endpoint counters summed over sessions, in endpoint order.
+  std::vector<RateLimitRegistry::EndpointStats> endpoint_stats() const;
+
+private:
+  struct Session {
+    std::string name;
+    std::unique_ptr<RateLimitRegistry> limits;
+    SessionStats stats;
+    int consecutive_429s = 0;
+    Clock::time_point quarantine_until;
+  };
+
+  SessionPoolOptions m_options;
+  mutable std::mutex m_mutex;
+  std::vector<Session> m_sessions;
+};
+
+#endif  // SESSION_POOL_HPP
@@ -2,17 +2,31 @@
 #define SPIDER
 
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <set>
 #include <string>
 #include <utility>
 #include <vector>
-#include <httplib.h>
 #include "app_config.hpp"
+#include "bounded_queue.hpp"
+#include "checkpoint_writer.hpp"
+#include "crawl_frontier.hpp"
+#include "crawl_journal.hpp"
+#include "crawl_snapshot.hpp"
+#include "http_transport.hpp"
+#include "profile_cache.hpp"
+#include "rate_limiter.hpp"
+#include "recrawl_scheduler.hpp"
+#include "session_pool.hpp"
+#include "visited_index.hpp"
 #include "weibo.hpp"
 
 
@@ -20,85 +34,217 @@ class MongoWriter;
 
 std::vector<Weibo> load_weibos_from_db(const AppConfig &config, uint64_t uid);
 
+struct SpiderMetrics {
+  uint64_t users_processed = 0;
+  uint64_t users_failed = 0;
+  uint64_t requests_total = 0;
+  uint64_t requests_failed = 0;
+  uint64_t retries_total = 0;
+  uint64_t http_429_count = 0;
+  uint64_t queue_pending = 0;
+  uint64_t visited_total = 0;
+  uint64_t current_uid = 0;
+  uint64_t profile_cache_hits = 0;
+  uint64_t profile_cache_misses = 0;
+  // Fetched users waiting for the persist stage, and time each side of
+  // that queue spent blocked.
+  uint64_t persist_queue_depth = 0;
+  uint64_t fetch_stall_ms = 0;
+  uint64_t persist_idle_ms = 0;
+  // Target request rate summed over endpoint buckets, jitter not included.
+  double request_rate_rps = 0.0;
+  // Per-endpoint requests, 429s and time spent waiting, by kind.
+  std::vector<RateLimitRegistry::EndpointStats> endpoints;
+  // Time spent sleeping between retry attempts.
+  uint64_t retry_backoff_ms = 0;
+  std::vector<SessionPool::SessionStats> sessions;
+  // Connection reuse and setup cost of the crawl-path transport.
+  HttpTransportStats http;
+};
+
 class Spider {
 public:
   using UserCallback = std::function<void(uint64_t uid, const std::string& name, 
                                            const std::vector<uint64_t>& followers, 
                                            const std::vector<uint64_t>& fans)>;
+  // Users restored from the database on resume, delivered in batches.
+  using UserBatchCallback = std::function<void(const std::vector<UserRelations>& users)>;
   using WeiboCallback = std::function<void(uint64_t uid, const std::vector<Weibo>& weibos)>;
-  using MetricsCallback = std::function<void(uint64_t users_processed,
-                                             uint64_t users_failed,
-                                             uint64_t requests_total,
-                                             uint64_t requests_failed,
-                                             uint64_t retries_total,
-                                             uint64_t http_429_count,
-                                             uint64_t queue_pending,
-                                             uint64_t visited_total,
-                                             uint64_t current_uid)>;
+  using MetricsCallback = std::function<void(const SpiderMetrics& metrics)>;
+  // Receives fans as they are listed, in chunks of completed users.
+  using FanChunkSink = std::function<void(std::vector<User>& chunk)>;
 
   explicit Spider(uint64_t user_id, const AppConfig &config);
   ~Spider();
   void setUserCallback(UserCallback callback);
+  // Without a batch callback, restored users go through the user callback.
+  void setUserBatchCallback(UserBatchCallback callback);
   void setWeiboCallback(WeiboCallback callback);
   void setCrawlWeibo(bool crawl);
   void setCrawlFans(bool crawl);
   void setCrawlFollowers(bool crawl);
   void setMaxDepth(int max_depth);
+  void setWorkerCount(int workers);
+  // Crawls queued users in descending score order; call before run().
+  // Replaces frontier_order.
+  void setFrontierScore(std::function<double(const FrontierCandidate &)> score);
   void setMetricsCallback(MetricsCallback callback);
 
   void stop();
   bool isRunning() const { return m_running; }
+  // With a fan sink, fans go to it chunk by chunk and are left out of the
+  // returned user and *fan_ids_out.
   User get_user(uint64_t uid,
                 bool get_follower=false,
                 std::vector<uint64_t> *follower_ids_out=nullptr,
-                std::vector<uint64_t> *fan_ids_out=nullptr);
+                std::vector<uint64_t> *fan_ids_out=nullptr,
+                const FanChunkSink &fan_sink=nullptr);
   std::vector<User> get_self_follower(uint64_t uid);
+  // All fans at once, within fan_max_per_user.
   std::vector<User> get_other_follower(uint64_t uid);
   std::vector<Weibo> get_weibo(const User &user);
   void run();
 private:
+  enum class CrawlOutcome { Completed, Failed, Interrupted };
+  // A fetched user on its way from a crawl worker to the persist stage.
+  struct PersistTask {
+    User user;
+    int depth = 0;
+    // Only user.uid and a chunk of user.fans, streamed ahead of the user
+    // itself; the first chunk of a listing replaces the stored fans.
+    bool fan_chunk = false;
+    bool first_chunk = false;
+  };
+  // One logged-in account: its headers (cookie included). Indexed like
+  // the sessions of m_session_pool.
+  struct HttpSession {
+    HttpTransport::Headers headers;
+  };
+
+  void crawl_worker(int worker_id);
+  // Fetches and parses one user; a completed user is left in *fetched for
+  // the persist stage.
+  CrawlOutcome crawl_user(uint64_t uid,
+                          int depth,
+                          User *fetched,
+                          std::vector<uint64_t> *discovered);
+  // Writes fetched users to MongoDB and only then marks them visited.
+  void persist_worker();
+  // Queues a discovered user (or re-ranks it) and journals the push.
+  void queue_child_locked(uint64_t uid, int depth);
+  void update_queue_metrics_locked();
+  void log_frontier_stats_locked(const char *label) const;
   std::vector<User> batch_get_user(const std::vector<uint64_t> &ids);
+  // Keeps users built from friendship listing items and fetches the
+  // profile only for entries without a screen name (or for all of them
+  // when listing harvest is off). Truncated if the spider stops.
+  std::vector<User> complete_listed_users(std::vector<User> listed);
+  // Pages through uid's fans within the per-user cap and hands completed
+  // chunks of fan_chunk_users to sink; returns the fans delivered.
+  size_t stream_fans(uint64_t uid, const FanChunkSink &sink);
+  // Queues a fan chunk at depth + 1 and hands it to the persist stage,
+  // blocking while that is a full queue behind.
+  void ingest_fan_chunk(uint64_t uid, int depth, std::vector<User> &chunk, bool first_chunk);
   void notifyUserFetched(uint64_t uid, const std::string& name, 
                         const std::vector<uint64_t>& followers, 
                         const std::vector<uint64_t>& fans);
-  httplib::Result get_with_retry(const std::string &url,
-                                 const std::string &request_name);
-  bool is_retryable_result(const httplib::Result &result) const;
+  void notifyUsersRestored(const std::vector<UserRelations>& users);
+  // Streams stored relations of every visited uid to the UI callbacks.
+  void restore_visited_users();
+  // In scheduled recrawl mode, queues the users due in the window at the
+  // depth limit, so only their profile and timeline are fetched. False
+  // when the root BFS should run instead.
+  bool seed_recrawl_plan();
+  // A set *cancelled flag abandons the request before it is sent. Empty
+  // when the spider stopped, the request was cancelled or the last attempt
+  // got no response at all; otherwise the last attempt's response.
+  std::optional<HttpResponse> get_with_retry(const std::string &url,
+                                             const std::string &request_name,
+                                             const std::atomic<bool> *cancelled = nullptr);
+  bool is_retryable_result(const HttpResponse &response) const;
   int get_retry_delay_ms(int attempt) const;
-  void wait_for_request_slot() const;
+  // Picks a session for url and sleeps until its endpoint bucket allows
+  // the request. Returns false (lease given back) if the spider was
+  // stopped meanwhile.
+  bool wait_for_request_slot(const std::string &url, SessionPool::Lease *lease);
+  // Sleeps until deadline or stop(), whichever comes first; returns
+  // m_running.
+  bool sleep_until_running(std::chrono::steady_clock::time_point deadline);
   int get_jitter_delay_ms() const;
   void emit_metrics(bool force = false);
-  bool load_crawl_state(std::vector<std::pair<uint64_t, int>> *queue,
-                        size_t *cursor,
-                        std::set<uint64_t> *visited);
-  void save_crawl_state(const std::vector<std::pair<uint64_t, int>> &queue,
-                        size_t cursor,
-                        const std::set<uint64_t> &visited,
-                        uint64_t current_uid);
+  bool load_crawl_state(CrawlFrontier *frontier,
+                        VisitedIndex *visited);
+  // Hands a full snapshot to the checkpoint writer and starts a new journal
+  // generation. Caller holds m_frontier_mutex.
+  void save_crawl_state(uint64_t current_uid);
+  // Hands buffered journal records to the checkpoint writer, or snapshots
+  // once the journal is long enough. Caller holds m_frontier_mutex.
+  void checkpoint_locked(uint64_t current_uid);
+  std::string journal_path() const;
   void clear_crawl_state();
+  // Applies an ordering to m_frontier with follower counts from the
+  // profile cache. Caller holds m_frontier_mutex or runs before run().
+  void apply_frontier_order(FrontierOrder order,
+                            std::function<double(const FrontierCandidate &)> score = {});
 private:
   User m_self;
-  std::unique_ptr<httplib::Client> m_client; 
-  uint64_t m_visit_cnt;
+  std::string m_host;
+  std::vector<HttpSession> m_sessions;
+  // Shared by all sessions and crawl workers; owns the connections.
+  std::unique_ptr<HttpTransport> m_transport;
   std::unique_ptr<MongoWriter> m_writer;
+  std::mutex m_writer_mutex;
+  // Separate connection for the persist stage so its writes do not hold
+  // m_writer_mutex against the crawl workers' reads.
+  std::unique_ptr<MongoWriter> m_persist_writer;
+  size_t m_persist_queue_capacity;
+  std::unique_ptr<BoundedQueue<PersistTask>> m_persist_queue;
   UserCallback m_userCallback;
+  UserBatchCallback m_userBatchCallback;
   WeiboCallback m_weiboCallback;
   MetricsCallback m_metricsCallback;
   bool m_crawlWeibo;
   bool m_crawlFans;
   bool m_crawlFollowers;
   int m_max_depth;
-  bool m_running;
+  int m_workers;
+  bool m_harvest_listing_profiles;
+  size_t m_fan_chunk_users;
+  size_t m_fan_max_per_user;
+  bool m_fan_sample_spread;
+  std::atomic<bool> m_running;
   std::string m_state_path;
-  uint64_t m_users_processed;
-  uint64_t m_users_failed;
-  uint64_t m_requests_total;
-  uint64_t m_requests_failed;
-  uint64_t m_retries_total;
-  uint64_t m_http_429_count;
-  uint64_t m_current_uid;
-  uint64_t m_queue_pending;
-  uint64_t m_visited_total;
+  CrawlSnapshot::Format m_state_format;
+  // Deltas since the last state snapshot; guarded by m_frontier_mutex.
+  CrawlJournal m_journal;
+  uint64_t m_journal_generation = 0;
+  size_t m_snapshot_records;
+  // Owns the state and journal files; null without a state path.
+  std::unique_ptr<CheckpointWriter> m_checkpoint_writer;
+  // Screen names and counts from earlier profile requests, across runs.
+  std::unique_ptr<ProfileCache> m_profile_cache;
+  // Posting model fed by the persist stage; null without a state path.
+  std::unique_ptr<RecrawlScheduler> m_recrawl;
+  bool m_recrawl_scheduled = false;
+  int64_t m_recrawl_window_seconds = 0;
+  size_t m_recrawl_max_users = 0;
+  std::atomic<uint64_t> m_users_processed;
+  std::atomic<uint64_t> m_users_failed;
+  std::atomic<uint64_t> m_requests_total;
+  std::atomic<uint64_t> m_requests_failed;
+  std::atomic<uint64_t> m_retries_total;
+  std::atomic<uint64_t> m_http_429_count;
+  std::atomic<uint64_t> m_retry_backoff_ms;
+  std::atomic<uint64_t> m_current_uid;
+  std::atomic<uint64_t> m_queue_pending;
+  std::atomic<uint64_t> m_visited_total;
+  // Shared BFS frontier. Users popped by a worker but not finished yet stay
+  // in m_in_flight (uid -> depth) so checkpoints can re-queue them.
+  CrawlFrontier m_frontier;
+  VisitedIndex m_visited;
+  std::map<uint64_t, int> m_in_flight;
+  std::mutex m_frontier_mutex;
+  std::condition_variable m_frontier_cv;
   int m_retry_max_attempts;
   int m_retry_base_delay_ms;
   int m_retry_max_delay_ms;
@@ -106,9 +252,15 @@ private:
   int m_request_min_interval_ms;
   int m_request_jitter_ms;
   int m_cooldown_429_ms;
-  mutable std::chrono::steady_clock::time_point m_next_request_time;
+  // Per session: one token bucket (and AIMD controller in adaptive mode)
+  // per endpoint class, plus the default bucket.
+  std::unique_ptr<SessionPool> m_session_pool;
   mutable std::mt19937 m_rng;
+  // Guards m_rng.
   mutable std::mutex m_rate_limit_mutex;
+  // Wakes pacing and backoff sleeps on stop().
+  std::mutex m_stop_mutex;
+  std::condition_variable m_stop_cv;
 
 };
 
@@ -0,0 +1,138 @@
+#ifndef UID_RUN_STORE_HPP
+#define UID_RUN_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "uid_set.hpp"
+
+// Exact on-disk uid set in the style of a tiny LSM tree.
+//
+// New uids collect in an in-memory UidSet; once it reaches buffer_limit the
+// buffer is written out as an immutable run file (sorted uint64 array) and
+// memory-mapped for binary search. Resident memory is the buffer plus
+// whatever pages of the runs the kernel keeps cached.
+//
+// Runs are merged size-tiered: a run of up to buffer_limit * merge_width^t
+// uids is in tier t, and once merge_width runs share a tier they become one
+// run of the next tier. Each uid is rewritten about
+// log_merge_width(size / buffer_limit) times, however large the store gets.
+//
+// seal() splits a flush for a background writer: the buffer is frozen in
+// memory at once and written by a task that may run on another thread.
+// With background_merge the same task also does the pending merge, and
+// the merged run is adopted like a written one; otherwise merges run
+// inline when a run is added.
+//
+// With durable set, a run file is fdatasynced before it is renamed into
+// place and the directory is fsynced after, so a run that counts as
+// written survives a power loss. Reopening sets aside run files that fail
+// validation (renamed to *.corrupt) instead of refusing to open.
+class UidRunStore {
+public:
+  static constexpr size_t kDefaultMergeWidth = 4;
+
+  UidRunStore(std::string dir,
+              size_t buffer_limit,
+              size_t merge_width = kDefaultMergeWidth,
+              bool durable = false,
+              bool background_merge = false);
+  ~UidRunStore();
+  UidRunStore(const UidRunStore &) = delete;
+  UidRunStore &operator=(const UidRunStore &) = delete;
+
+  bool contains(uint64_t uid) const;
+  // Caller guarantees the uid is not already stored.
+  void insert(uint64_t uid);
+  void flush();
+  // Moves the buffer into a frozen set that lookups keep seeing, and
+  // returns a task that writes every frozen set not on disk yet as a run
+  // file (throwing if one fails), then does the pending merge if any. The
+  // task shares only that handoff state with the store, so it can run
+  // later on any thread, even after the store is gone. Runs it wrote or
+  // merged are mapped in by the next insert(), seal() or flush().
+  std::function<void()> seal();
+  // Drops the buffer and deletes every run file.
+  void clear();
+
+  size_t size() const;
+  size_t run_count() const { return m_runs.size(); }
+  size_t memory_bytes() const { return m_buffer.memory_bytes(); }
+  void for_each(const std::function<void(uint64_t)> &fn) const;
+
+private:
+  struct Run {
+    std::string path;
+    int fd = -1;
+    void *map = nullptr;
+    size_t map_bytes = 0;
+    const uint64_t *data = nullptr;
+    size_t count = 0;
+  };
+
+  struct Frozen {
+    std::string path;
+    std::shared_ptr<const UidSet> uids;
+  };
+  struct Merge {
+    std::vector<std::string> inputs;
+    std::string output;
+  };
+  // Handoff between the store and seal() tasks. mutex guards the lists
+  // and is only held briefly; a task holds io_mutex while it writes.
+  struct FrozenRuns {
+    std::mutex mutex;
+    std::mutex io_mutex;
+    std::vector<Frozen> unwritten;
+    std::vector<std::string> written;
+    // Handed out by the store, taken by the next task.
+    std::optional<Merge> planned;
+    // Done by a task, not adopted yet.
+    std::vector<Merge> merged;
+    bool cancelled = false;
+    bool durable = false;
+  };
+
+  void freeze_buffer();
+  // Maps runs written or merged by seal() tasks. blocking waits for a task
+  // that is still writing; otherwise such runs are left for a later call.
+  void adopt_written(bool blocking);
+  void adopt_merge(const Merge &merge);
+  static void write_frozen(const std::shared_ptr<FrozenRuns> &runs);
+  static void run_planned_merge(const std::shared_ptr<FrozenRuns> &runs);
+  // Picks merge_width runs of the lowest full tier, if any.
+  std::optional<Merge> pick_merge();
+  // Inline mode merges until no tier is full; background mode hands one
+  // merge to the next seal() task.
+  void schedule_merges();
+  size_t tier_of(size_t count) const;
+  void open_existing();
+  static Run map_run(const std::string &path);
+  static void unmap_run(Run *run);
+  std::string next_run_path();
+  static void write_run(const std::string &path, const std::vector<uint64_t> &sorted, bool durable);
+  // k-way merge of the input runs into output; returns the uid count.
+  static uint64_t merge_files(const Merge &merge, bool durable);
+
+  std::string m_dir;
+  size_t m_buffer_limit;
+  size_t m_merge_width;
+  bool m_durable;
+  bool m_background_merge;
+  // A merge was handed to the seal() tasks and is not adopted yet.
+  bool m_merge_pending = false;
+  uint64_t m_next_seq = 1;
+  UidSet m_buffer;
+  // Sealed buffers whose runs are not mapped yet, oldest first.
+  std::vector<Frozen> m_frozen;
+  std::shared_ptr<FrozenRuns> m_frozen_runs = std::make_shared<FrozenRuns>();
+  // Oldest first; lookups walk newest first.
+  std::vector<Run> m_runs;
+};
+
+#endif  // UID_RUN_STORE_HPP
@@ -0,0 +1,91 @@
+#ifndef VISITED_INDEX_HPP
+#define VISITED_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "bloom_filter.hpp"
+#include "uid_run_store.hpp"
+#include "uid_set.hpp"
+
+struct VisitedIndexOptions {
+  // false: everything lives in one in-memory UidSet.
+  // true: Bloom filter in memory, exact membership in a UidRunStore on disk.
+  bool tiered = false;
+  std::string dir;
+  uint64_t bloom_expected_items = 100000000;
+  double bloom_fpr = 0.01;
+  size_t buffer_uids = 1 << 20;
+  // Sync run files and their directory before they count as written.
+  bool durable_runs = false;
+  // Leave run merges to seal() tasks instead of doing them in insert().
+  bool background_merge = false;
+};
+
+// Uid membership index for crawl bookkeeping (visited / seen sets).
+//
+// In tiered mode memory is bounded by the Bloom filter size plus the run
+// store's write buffer, however many uids are added. A Bloom miss answers
+// "definitely new" without touching disk; a Bloom hit is resolved against
+// the on-disk runs, and hits the runs reject are counted as false positives
+// so the real rate can be compared with the configured one.
+class VisitedIndex {
+public:
+  struct Stats {
+    uint64_t lookups = 0;
+    uint64_t bloom_negatives = 0;
+    uint64_t disk_probes = 0;
+    uint64_t false_positives = 0;
+    // false_positives / (false_positives + bloom_negatives)
+    double measured_fpr = 0.0;
+    double expected_fpr = 0.0;
+  };
+
+  VisitedIndex() = default;
+  // Tiered mode reopens any runs already in options.dir.
+  explicit VisitedIndex(const VisitedIndexOptions &options);
+
+  // Returns true when the uid was not present before.
+  bool insert(uint64_t uid);
+  bool contains(uint64_t uid) const;
+  size_t count(uint64_t uid) const { return contains(uid) ? 1 : 0; }
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+  // Tiered mode also deletes the on-disk runs.
+  void clear();
+  void reserve(size_t expected);
+  void flush();
+
+  // Checkpoint support: both let the expensive part of persisting the
+  // index run outside the caller's lock.
+  //
+  // Memory mode: the current set, shared copy-on-write; the next insert
+  // copies it while the view is still held.
+  std::shared_ptr<const UidSet> view() const;
+  // Tiered mode: freezes the write buffer and returns a task that writes
+  // it to dir(); see UidRunStore::seal(). Memory mode returns an empty
+  // function.
+  std::function<void()> seal();
+
+  bool tiered() const { return m_store != nullptr; }
+  const std::string &dir() const { return m_options.dir; }
+  size_t memory_bytes() const;
+  Stats stats() const;
+  void for_each(const std::function<void(uint64_t)> &fn) const;
+
+private:
+  UidSet &own_memory();
+
+  VisitedIndexOptions m_options;
+  std::shared_ptr<UidSet> m_memory = std::make_shared<UidSet>();
+  BloomFilter m_bloom;
+  std::unique_ptr<UidRunStore> m_store;
+  mutable uint64_t m_lookups = 0;
+  mutable uint64_t m_bloom_negatives = 0;
+  mutable uint64_t m_disk_probes = 0;
+  mutable uint64_t m_false_positives = 0;
+};
+
+#endif  // VISITED_INDEX_HPP
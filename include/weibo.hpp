@@ -15,6 +15,8 @@ public:
   uint64_t id;
   std::vector<std::string> pics;
   std::string video_url;
+  // Pinned to the top of the author's timeline when it was crawled.
+  bool pinned = false;
 };
 
 class User {
@@ -30,4 +32,36 @@ public:
   std::vector<Weibo> weibo;
 };
 
+// Graph edges of a stored user, without profile details or weibos.
+struct UserRelations {
+  uint64_t uid = 0;
+  std::string username;
+  std::vector<uint64_t> followers;
+  std::vector<uint64_t> fans;
+};
+
+// What is already stored of a user's timeline, kept next to the user
+// documents so an incremental crawl can tell new posts apart without
+// loading the stored ones.
+struct WeiboWatermark {
+  enum class Verdict {
+    New,    // not stored yet
+    Known,  // a stored pinned post; keep walking
+    Stop,   // at or below the newest stored post; the rest is stored
+  };
+
+  // Newest stored post id; 0 when nothing is stored.
+  uint64_t max_id = 0;
+  // Stored posts that were pinned when crawled. Pinned posts sit above
+  // newer ones, so they must not end the walk.
+  std::vector<uint64_t> pinned_ids;
+  // Unix ms of the last write for this user; 0 if unknown.
+  int64_t crawled_at_ms = 0;
+
+  // The timeline is newest-first apart from pinned posts. A pinned post
+  // below max_id that is not in pinned_ids may or may not be stored, so
+  // it counts as new and the writer deduplicates it.
+  Verdict classify(uint64_t id, bool pinned) const;
+};
+
 #endif  // WEIBO
@@ -0,0 +1,81 @@
+#ifndef WEIBO_DECODE_HPP
+#define WEIBO_DECODE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "profile_cache.hpp"
+
+// Typed decoders for the Weibo Ajax responses the spider reads.
+//
+// Each one streams the body and keeps only the fields listed below, so
+// no DOM is built and unused members are skipped as they are tokenized.
+//
+// There are two backends: nlohmann SAX, always built, and simdjson
+// on-demand, built when CMake is configured with SPIDER_USE_SIMDJSON and
+// finds simdjson (which defines SPIDER_HAVE_SIMDJSON). The unqualified
+// decode_* functions use simdjson when it is built in. Both give the
+// same result for any valid body; simdjson does not validate members it
+// skips, so it accepts some broken bodies that nlohmann rejects.
+//
+// A body that is not JSON, or lacks the array the response is about,
+// throws std::runtime_error. Counts that are not non-negative numbers
+// decode as 0; fields of the wrong type are left empty.
+
+// /ajax/profile/info: ok, data.user.{id, screen_name, followers_count,
+// friends_count, statuses_count}.
+struct ProfileResponse {
+  int ok = 0;
+  // uid is 0 if data.user.id is missing; fetched_at is left 0.
+  CachedProfile user;
+};
+
+// /ajax/friendships/friends: display_total_number and users[].{id,
+// screen_name, followers_count, friends_count, statuses_count}. Users
+// without an id are dropped.
+struct FriendshipsPage {
+  std::optional<uint64_t> display_total_number;
+  std::vector<CachedProfile> users;
+};
+
+// One data.list[] item of /ajax/statuses/mymblog. Nested objects such as
+// retweeted_status are not looked into.
+struct TimelinePost {
+  uint64_t id = 0;
+  std::string created_at;
+  std::string text;
+  // pic_infos.*.large.url, in document order.
+  std::vector<std::string> pics;
+  // page_info.media_info.stream_url
+  std::string stream_url;
+  // isTop is a non-zero integer: pinned above newer posts.
+  bool pinned = false;
+};
+
+struct TimelinePage {
+  std::vector<TimelinePost> posts;
+};
+
+ProfileResponse decode_profile(const std::string &body);
+FriendshipsPage decode_friendships(const std::string &body);
+TimelinePage decode_timeline(const std::string &body);
+
+// "simdjson" or "nlohmann": the backend behind the functions above.
+const char *json_backend_name();
+
+namespace nlohmann_backend {
+ProfileResponse decode_profile(const std::string &body);
+FriendshipsPage decode_friendships(const std::string &body);
+TimelinePage decode_timeline(const std::string &body);
+}
+
+#ifdef SPIDER_HAVE_SIMDJSON
+namespace simdjson_backend {
+ProfileResponse decode_profile(const std::string &body);
+FriendshipsPage decode_friendships(const std::string &body);
+TimelinePage decode_timeline(const std::string &body);
+}
+#endif
+
+#endif  // WEIBO_DECODE_HPP
@@ -10,8 +10,8 @@
 #include <mongocxx/uri.hpp>
 #include <mongocxx/instance.hpp>
 #include <spdlog/spdlog.h>
+#include <functional>
 #include <string>
-#include <set>
 #include "weibo.hpp"
 
 class MongoWriter {
@@ -21,21 +21,45 @@ public:
               const std::string &collection_name = "user");
   void write_one(const User &user);
   void write_many(const std::vector<User> &users);
+  // Stores one streamed chunk of a user's fans, creating the document if
+  // needed. The first chunk of a listing replaces the stored fans, later
+  // ones are added to them.
+  void write_fan_chunk(uint64_t uid, const std::vector<User> &fans, bool first_chunk);
 
   // Incremental crawl support
   bool user_exists(uint64_t uid);
+  // Newest stored post id, scanning the user's posts; 0 if none.
   uint64_t get_latest_weibo_id(uint64_t uid);
-  std::set<uint64_t> get_stored_weibo_ids(uint64_t uid);
+  // One small read from the watermark collection. Users stored before it
+  // existed get theirs derived from get_latest_weibo_id and saved, once.
+  WeiboWatermark get_weibo_watermark(uint64_t uid);
   std::vector<Weibo> get_weibos(uint64_t uid);
   bool get_user_relations(uint64_t uid,
                           std::string *username,
                           std::vector<uint64_t> *followers,
                           std::vector<uint64_t> *fans);
+  // Streams username/followers/fans of the given uids in batches of up to
+  // batch_size, using one projected $in cursor per chunk of uids instead of
+  // a find_one per user. Unknown uids are skipped; returns users delivered.
+  size_t for_each_user_relations(
+      const std::vector<uint64_t> &uids,
+      size_t batch_size,
+      const std::function<void(std::vector<UserRelations> &)> &fn);
 
 private:
+  bool weibo_stored(uint64_t uid, uint64_t weibo_id);
+  // Raises max_id, adds pinned_ids and, if crawled, stamps the time.
+  void advance_watermark(uint64_t uid,
+                         uint64_t max_id,
+                         const std::vector<uint64_t> &pinned_ids,
+                         bool crawled);
+
   mongocxx::client m_client;
   mongocxx::database m_db;
   mongocxx::collection m_collection;
+  // <collection>_watermarks: one WeiboWatermark per uid, written after
+  // the user document.
+  mongocxx::collection m_watermarks;
 };
 
 #endif  // MONGOWRITER
@@ -23,10 +23,51 @@ AppConfig AppConfig::load(const std::string &path) {
     if (j.contains("headers_path"))     cfg.headers_path = j["headers_path"].get<std::string>();
     if (j.contains("config_path"))      cfg.config_path = j["config_path"].get<std::string>();
     if (j.contains("crawl_state_path")) cfg.crawl_state_path = j["crawl_state_path"].get<std::string>();
+    if (j.contains("sessions")) {
+      cfg.sessions.clear();
+      for (const auto &item : j["sessions"]) {
+        SessionCredentials session;
+        session.name = item.value("name", "");
+        session.cookie_path = item.value("cookie_path", "");
+        session.headers_path = item.value("headers_path", "");
+        cfg.sessions.push_back(session);
+      }
+    }
+    if (j.contains("session_quarantine_429s")) cfg.session_quarantine_429s = j["session_quarantine_429s"].get<int>();
+    if (j.contains("session_quarantine_ms")) cfg.session_quarantine_ms = j["session_quarantine_ms"].get<int>();
     if (j.contains("weibo_host"))       cfg.weibo_host = j["weibo_host"].get<std::string>();
     if (j.contains("image_host"))       cfg.image_host = j["image_host"].get<std::string>();
+    if (j.contains("http_transport"))   cfg.http_transport = j["http_transport"].get<std::string>();
+    if (j.contains("http_max_connections")) cfg.http_max_connections = j["http_max_connections"].get<int>();
+    if (j.contains("http_max_idle_ms")) cfg.http_max_idle_ms = j["http_max_idle_ms"].get<int>();
     if (j.contains("default_uid"))      cfg.default_uid = j["default_uid"].get<uint64_t>();
     if (j.contains("crawl_max_depth"))  cfg.crawl_max_depth = j["crawl_max_depth"].get<int>();
+    if (j.contains("crawl_workers"))    cfg.crawl_workers = j["crawl_workers"].get<int>();
+    if (j.contains("persist_queue_capacity")) cfg.persist_queue_capacity = j["persist_queue_capacity"].get<int>();
+    if (j.contains("follower_profile_source")) cfg.follower_profile_source = j["follower_profile_source"].get<std::string>();
+    if (j.contains("fan_chunk_users")) cfg.fan_chunk_users = j["fan_chunk_users"].get<int>();
+    if (j.contains("fan_max_per_user")) cfg.fan_max_per_user = j["fan_max_per_user"].get<int>();
+    if (j.contains("fan_sample_mode")) cfg.fan_sample_mode = j["fan_sample_mode"].get<std::string>();
+    if (j.contains("profile_cache_path")) cfg.profile_cache_path = j["profile_cache_path"].get<std::string>();
+    if (j.contains("profile_cache_ttl_minutes")) cfg.profile_cache_ttl_minutes = j["profile_cache_ttl_minutes"].get<int>();
+    if (j.contains("recrawl_state_path")) cfg.recrawl_state_path = j["recrawl_state_path"].get<std::string>();
+    if (j.contains("recrawl_mode")) cfg.recrawl_mode = j["recrawl_mode"].get<std::string>();
+    if (j.contains("recrawl_window_minutes")) cfg.recrawl_window_minutes = j["recrawl_window_minutes"].get<int>();
+    if (j.contains("recrawl_max_users")) cfg.recrawl_max_users = j["recrawl_max_users"].get<int>();
+    if (j.contains("recrawl_min_interval_minutes")) cfg.recrawl_min_interval_minutes = j["recrawl_min_interval_minutes"].get<int>();
+    if (j.contains("recrawl_max_interval_days")) cfg.recrawl_max_interval_days = j["recrawl_max_interval_days"].get<int>();
+    if (j.contains("crawl_snapshot_records")) cfg.crawl_snapshot_records = j["crawl_snapshot_records"].get<int>();
+    if (j.contains("crawl_state_format")) cfg.crawl_state_format = j["crawl_state_format"].get<std::string>();
+    if (j.contains("checkpoint_fsync_interval_ms")) cfg.checkpoint_fsync_interval_ms = j["checkpoint_fsync_interval_ms"].get<int>();
+    if (j.contains("visited_index_mode")) cfg.visited_index_mode = j["visited_index_mode"].get<std::string>();
+    if (j.contains("visited_index_dir")) cfg.visited_index_dir = j["visited_index_dir"].get<std::string>();
+    if (j.contains("visited_bloom_expected")) cfg.visited_bloom_expected = j["visited_bloom_expected"].get<uint64_t>();
+    if (j.contains("visited_bloom_fpr")) cfg.visited_bloom_fpr = j["visited_bloom_fpr"].get<double>();
+    if (j.contains("visited_buffer_uids")) cfg.visited_buffer_uids = j["visited_buffer_uids"].get<int>();
+    if (j.contains("frontier_mode")) cfg.frontier_mode = j["frontier_mode"].get<std::string>();
+    if (j.contains("frontier_dir")) cfg.frontier_dir = j["frontier_dir"].get<std::string>();
+    if (j.contains("frontier_segment_entries")) cfg.frontier_segment_entries = j["frontier_segment_entries"].get<int>();
+    if (j.contains("frontier_order")) cfg.frontier_order = j["frontier_order"].get<std::string>();
     if (j.contains("retry_max_attempts")) cfg.retry_max_attempts = j["retry_max_attempts"].get<int>();
     if (j.contains("retry_base_delay_ms")) cfg.retry_base_delay_ms = j["retry_base_delay_ms"].get<int>();
     if (j.contains("retry_max_delay_ms")) cfg.retry_max_delay_ms = j["retry_max_delay_ms"].get<int>();
@@ -34,6 +75,24 @@ AppConfig AppConfig::load(const std::string &path) {
     if (j.contains("request_min_interval_ms")) cfg.request_min_interval_ms = j["request_min_interval_ms"].get<int>();
     if (j.contains("request_jitter_ms")) cfg.request_jitter_ms = j["request_jitter_ms"].get<int>();
     if (j.contains("cooldown_429_ms")) cfg.cooldown_429_ms = j["cooldown_429_ms"].get<int>();
+    if (j.contains("request_rate_mode")) cfg.request_rate_mode = j["request_rate_mode"].get<std::string>();
+    if (j.contains("request_interval_floor_ms")) cfg.request_interval_floor_ms = j["request_interval_floor_ms"].get<int>();
+    if (j.contains("request_interval_ceiling_ms")) cfg.request_interval_ceiling_ms = j["request_interval_ceiling_ms"].get<int>();
+    if (j.contains("request_latency_threshold_ms")) cfg.request_latency_threshold_ms = j["request_latency_threshold_ms"].get<int>();
+    if (j.contains("endpoint_limits")) {
+      cfg.endpoint_limits.clear();
+      for (const auto &item : j["endpoint_limits"]) {
+        EndpointLimit limit;
+        limit.name = item.value("name", "");
+        limit.prefix = item.value("prefix", "");
+        limit.min_interval_ms = item.value("min_interval_ms", limit.min_interval_ms);
+        limit.burst = item.value("burst", limit.burst);
+        limit.cooldown_429_ms = item.value("cooldown_429_ms", limit.cooldown_429_ms);
+        limit.pause_every = item.value("pause_every", limit.pause_every);
+        limit.pause_ms = item.value("pause_ms", limit.pause_ms);
+        cfg.endpoint_limits.push_back(limit);
+      }
+    }
     if (j.contains("request_profile")) cfg.request_profile = j["request_profile"].get<std::string>();
     if (j.contains("log_level")) cfg.log_level = j["log_level"].get<std::string>();
 
@@ -54,10 +113,49 @@ void AppConfig::save(const std::string &path) const {
     j["headers_path"] = headers_path;
     j["config_path"] = config_path;
     j["crawl_state_path"] = crawl_state_path;
+    j["sessions"] = json::array();
+    for (const auto &session : sessions) {
+      j["sessions"].push_back({
+          {"name", session.name},
+          {"cookie_path", session.cookie_path},
+          {"headers_path", session.headers_path},
+      });
+    }
+    j["session_quarantine_429s"] = session_quarantine_429s;
+    j["session_quarantine_ms"] = session_quarantine_ms;
     j["weibo_host"] = weibo_host;
     j["image_host"] = image_host;
+    j["http_transport"] = http_transport;
+    j["http_max_connections"] = http_max_connections;
+    j["http_max_idle_ms"] = http_max_idle_ms;
     j["default_uid"] = default_uid;
     j["crawl_max_depth"] = crawl_max_depth;
+    j["crawl_workers"] = crawl_workers;
+    j["persist_queue_capacity"] = persist_queue_capacity;
+    j["follower_profile_source"] = follower_profile_source;
+    j["fan_chunk_users"] = fan_chunk_users;
+    j["fan_max_per_user"] = fan_max_per_user;
+    j["fan_sample_mode"] = fan_sample_mode;
+    j["profile_cache_path"] = profile_cache_path;
+    j["profile_cache_ttl_minutes"] = profile_cache_ttl_minutes;
+    j["recrawl_state_path"] = recrawl_state_path;
+    j["recrawl_mode"] = recrawl_mode;
+    j["recrawl_window_minutes"] = recrawl_window_minutes;
+    j["recrawl_max_users"] = recrawl_max_users;
+    j["recrawl_min_interval_minutes"] = recrawl_min_interval_minutes;
+    j["recrawl_max_interval_days"] = recrawl_max_interval_days;
+    j["crawl_snapshot_records"] = crawl_snapshot_records;
+    j["crawl_state_format"] = crawl_state_format;
+    j["checkpoint_fsync_interval_ms"] = checkpoint_fsync_interval_ms;
+    j["visited_index_mode"] = visited_index_mode;
+    j["visited_index_dir"] = visited_index_dir;
+    j["visited_bloom_expected"] = visited_bloom_expected;
+    j["visited_bloom_fpr"] = visited_bloom_fpr;
+    j["visited_buffer_uids"] = visited_buffer_uids;
+    j["frontier_mode"] = frontier_mode;
+    j["frontier_dir"] = frontier_dir;
+    j["frontier_segment_entries"] = frontier_segment_entries;
+    j["frontier_order"] = frontier_order;
     j["retry_max_attempts"] = retry_max_attempts;
     j["retry_base_delay_ms"] = retry_base_delay_ms;
     j["retry_max_delay_ms"] = retry_max_delay_ms;
@@ -65,6 +163,22 @@ void AppConfig::save(const std::string &path) const {
     j["request_min_interval_ms"] = request_min_interval_ms;
     j["request_jitter_ms"] = request_jitter_ms;
     j["cooldown_429_ms"] = cooldown_429_ms;
+    j["request_rate_mode"] = request_rate_mode;
+    j["request_interval_floor_ms"] = request_interval_floor_ms;
+    j["request_interval_ceiling_ms"] = request_interval_ceiling_ms;
+    j["request_latency_threshold_ms"] = request_latency_threshold_ms;
+    j["endpoint_limits"] = json::array();
+    for (const auto &limit : endpoint_limits) {
+      j["endpoint_limits"].push_back({
+          {"name", limit.name},
+          {"prefix", limit.prefix},
+          {"min_interval_ms", limit.min_interval_ms},
+          {"burst", limit.burst},
+          {"cooldown_429_ms", limit.cooldown_429_ms},
+          {"pause_every", limit.pause_every},
+          {"pause_ms", limit.pause_ms},
+      });
+    }
     j["request_profile"] = request_profile;
     j["log_level"] = log_level;
 
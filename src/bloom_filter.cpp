@@ -0,0 +1,66 @@
+#include "bloom_filter.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+uint64_t mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+}
+
+BloomFilter::BloomFilter(uint64_t expected_items, double false_positive_rate) {
+  const double n = static_cast<double>(std::max<uint64_t>(expected_items, 1));
+  const double p = std::clamp(false_positive_rate, 1e-9, 0.5);
+  const double ln2 = std::log(2.0);
+  const double bits = std::ceil(-n * std::log(p) / (ln2 * ln2));
+  m_bit_count = std::max<uint64_t>(64, static_cast<uint64_t>(bits));
+  m_hash_count = std::clamp(static_cast<int>(std::round(bits / n * ln2)), 1, 30);
+  m_words.assign((m_bit_count + 63) / 64, 0);
+}
+
+void BloomFilter::add(uint64_t uid) {
+  if (m_words.empty()) {
+    return;
+  }
+  const uint64_t h1 = mix64(uid);
+  const uint64_t h2 = mix64(h1) | 1;
+  for (int i = 0; i < m_hash_count; ++i) {
+    const uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % m_bit_count;
+    m_words[bit >> 6] |= uint64_t{1} << (bit & 63);
+  }
+  m_items++;
+}
+
+bool BloomFilter::possibly_contains(uint64_t uid) const {
+  if (m_words.empty()) {
+    return false;
+  }
+  const uint64_t h1 = mix64(uid);
+  const uint64_t h2 = mix64(h1) | 1;
+  for (int i = 0; i < m_hash_count; ++i) {
+    const uint64_t bit = (h1 + static_cast<uint64_t>(i) * h2) % m_bit_count;
+    if ((m_words[bit >> 6] & (uint64_t{1} << (bit & 63))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BloomFilter::clear() {
+  std::fill(m_words.begin(), m_words.end(), 0);
+  m_items = 0;
+}
+
+double BloomFilter::expected_fpr() const {
+  if (m_bit_count == 0) {
+    return 0.0;
+  }
+  const double k = m_hash_count;
+  const double fill = 1.0 - std::exp(-k * static_cast<double>(m_items) / static_cast<double>(m_bit_count));
+  return std::pow(fill, k);
+}
@@ -0,0 +1,271 @@
+#include "checkpoint_writer.hpp"
+#include <algorithm>
+#include "crawl_journal.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+bool write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    const ssize_t n = ::write(fd, data, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+}
+
+CheckpointWriter::CheckpointWriter(std::string state_path,
+                                   std::string journal_path,
+                                   int fsync_interval_ms)
+    : m_state_path(std::move(state_path)),
+      m_journal_path(std::move(journal_path)),
+      m_fsync_interval_ms(fsync_interval_ms),
+      m_last_sync(std::chrono::steady_clock::now()),
+      m_thread(&CheckpointWriter::run, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_work_cv.notify_all();
+  m_thread.join();
+}
+
+void CheckpointWriter::submit_snapshot(CrawlSnapshot snapshot,
+                                       CrawlSnapshot::Format format,
+                                       std::optional<SegmentedQueue::Commit> frontier_commit,
+                                       std::function<void(CrawlSnapshot &)> complete) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.snapshot) {
+      m_stats.snapshots_superseded++;
+    }
+    m_pending.snapshot = std::make_unique<CrawlSnapshot>(std::move(snapshot));
+    m_pending.complete = std::move(complete);
+    m_pending.format = format;
+    // Everything journaled so far is part of the new snapshot.
+    m_pending.journal.clear();
+    merge_commit_locked(std::move(frontier_commit));
+    m_submitted++;
+  }
+  m_work_cv.notify_one();
+}
+
+void CheckpointWriter::submit_journal(std::string records,
+                                      std::optional<SegmentedQueue::Commit> frontier_commit) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.journal += records;
+    merge_commit_locked(std::move(frontier_commit));
+    m_submitted++;
+  }
+  m_work_cv.notify_one();
+}
+
+void CheckpointWriter::drain() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_pending.sync = true;
+  const uint64_t target = ++m_submitted;
+  m_work_cv.notify_one();
+  m_done_cv.wait(lock, [this, target] { return m_completed >= target; });
+}
+
+void CheckpointWriter::remove_files() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // Anything still queued would only recreate the files.
+  m_pending.snapshot.reset();
+  m_pending.complete = nullptr;
+  m_pending.journal.clear();
+  m_pending.remove = true;
+  const uint64_t target = ++m_submitted;
+  m_work_cv.notify_one();
+  m_done_cv.wait(lock, [this, target] { return m_completed >= target; });
+}
+
+bool CheckpointWriter::needs_snapshot() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_broken;
+}
+
+CheckpointWriter::Stats CheckpointWriter::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+bool CheckpointWriter::has_work_locked() const {
+  return m_pending.snapshot || !m_pending.journal.empty() || m_pending.frontier_commit ||
+         m_pending.sync || m_pending.remove;
+}
+
+void CheckpointWriter::merge_commit_locked(std::optional<SegmentedQueue::Commit> commit) {
+  if (!commit) {
+    return;
+  }
+  if (m_pending.frontier_commit) {
+    m_pending.frontier_commit->merge(std::move(*commit));
+  } else {
+    m_pending.frontier_commit = std::move(commit);
+  }
+}
+
+void CheckpointWriter::run() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    if (!has_work_locked()) {
+      if (m_stop) {
+        break;
+      }
+      if ((m_journal_dirty || !m_dirty_segments.empty()) && m_fsync_interval_ms > 0) {
+        // Idle with unsynced bytes: sync once the interval is up.
+        const auto deadline = m_last_sync + std::chrono::milliseconds(m_fsync_interval_ms);
+        if (m_work_cv.wait_until(lock, deadline) == std::cv_status::timeout && !has_work_locked()) {
+          lock.unlock();
+          sync_journal();
+          lock.lock();
+        }
+      } else {
+        m_work_cv.wait(lock);
+      }
+      continue;
+    }
+    Batch batch = std::move(m_pending);
+    m_pending = Batch();
+    const uint64_t target = m_submitted;
+    lock.unlock();
+    write_batch(&batch);
+    lock.lock();
+    m_completed = target;
+    m_done_cv.notify_all();
+  }
+  lock.unlock();
+  sync_journal();
+  close_journal();
+}
+
+void CheckpointWriter::write_batch(Batch *batch) {
+  if (batch->snapshot) {
+    try {
+      if (batch->complete) {
+        batch->complete(*batch->snapshot);
+      }
+      write_snapshot(*batch->snapshot, batch->format);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_broken = false;
+    } catch (const std::exception &e) {
+      spdlog::error(fmt::format("checkpoint snapshot failed {}: {}", m_state_path, e.what()));
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stats.failures++;
+      m_broken = true;
+    }
+  }
+  bool broken = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    broken = m_broken;
+  }
+  // After a failed snapshot the on-disk journal still belongs to the
+  // previous one; appending newer records to it would corrupt replay.
+  if (!batch->journal.empty() && !broken) {
+    append_journal(batch->journal);
+  }
+
+  if (batch->frontier_commit) {
+    for (auto &path : batch->frontier_commit->dirty) {
+      if (std::find(m_dirty_segments.begin(), m_dirty_segments.end(), path) == m_dirty_segments.end()) {
+        m_dirty_segments.push_back(std::move(path));
+      }
+    }
+  }
+  const auto now = std::chrono::steady_clock::now();
+  const bool interval_due = m_fsync_interval_ms == 0 ||
+      (m_fsync_interval_ms > 0 && now - m_last_sync >= std::chrono::milliseconds(m_fsync_interval_ms));
+  if ((m_journal_dirty || !m_dirty_segments.empty()) && (batch->sync || interval_due)) {
+    sync_journal();
+  }
+  if (batch->frontier_commit && !broken) {
+    SegmentedQueue::apply_commit(*batch->frontier_commit);
+  }
+  if (batch->remove) {
+    close_journal();
+    std::remove(m_state_path.c_str());
+    std::remove(m_journal_path.c_str());
+  }
+}
+
+void CheckpointWriter::write_snapshot(const CrawlSnapshot &snapshot, CrawlSnapshot::Format format) {
+  snapshot.write(m_state_path, format, m_fsync_interval_ms >= 0);
+  // New generation: the old journal is superseded by the snapshot.
+  close_journal();
+  m_journal_fd = ::open(m_journal_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_journal_fd < 0) {
+    throw std::runtime_error(fmt::format("failed to open crawl journal {}", m_journal_path));
+  }
+  const std::string header = CrawlJournal::header(snapshot.info.journal_generation);
+  if (!write_all(m_journal_fd, header.data(), header.size())) {
+    throw std::runtime_error(fmt::format("failed to write crawl journal {}", m_journal_path));
+  }
+  m_journal_dirty = true;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stats.snapshots_written++;
+}
+
+void CheckpointWriter::append_journal(const std::string &bytes) {
+  if (m_journal_fd < 0) {
+    m_journal_fd = ::open(m_journal_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  }
+  const bool ok = m_journal_fd >= 0 && write_all(m_journal_fd, bytes.data(), bytes.size());
+  if (!ok) {
+    spdlog::error(fmt::format("crawl journal write failed {}", m_journal_path));
+  }
+  m_journal_dirty = m_journal_dirty || ok;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (ok) {
+    m_stats.journal_writes++;
+    m_stats.journal_bytes += bytes.size();
+  } else {
+    m_stats.failures++;
+  }
+}
+
+void CheckpointWriter::sync_journal() {
+  // Frontier entries only live in the segments' mapped pages; they must be
+  // on disk before the journal records that refer to them, and before the
+  // head position is advanced past them.
+  if (!m_dirty_segments.empty()) {
+    if (m_fsync_interval_ms >= 0) {
+      SegmentedQueue::sync_segments(m_dirty_segments);
+    }
+    m_dirty_segments.clear();
+  }
+  if (m_journal_fd < 0 || !m_journal_dirty) {
+    return;
+  }
+  if (m_fsync_interval_ms >= 0) {
+    ::fdatasync(m_journal_fd);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.fsyncs++;
+  }
+  m_journal_dirty = false;
+  m_last_sync = std::chrono::steady_clock::now();
+}
+
+void CheckpointWriter::close_journal() {
+  if (m_journal_fd >= 0) {
+    ::close(m_journal_fd);
+    m_journal_fd = -1;
+  }
+}
@@ -0,0 +1,254 @@
+#include "crawl_frontier.hpp"
+#include <algorithm>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+// Consumed entries are dropped once they make up half of the buffer and the
+// prefix is large enough for the move to pay off.
+constexpr size_t kCompactMinHead = 4096;
+}
+
+bool parse_frontier_order(const std::string &name, FrontierOrder *order) {
+  static const std::pair<const char *, FrontierOrder> kNames[] = {
+      {"fifo", FrontierOrder::Fifo},
+      {"depth", FrontierOrder::Depth},
+      {"followers", FrontierOrder::Followers},
+      {"degree", FrontierOrder::Degree},
+  };
+  for (const auto &[known, value] : kNames) {
+    if (name == known) {
+      *order = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *frontier_order_name(FrontierOrder order) {
+  switch (order) {
+  case FrontierOrder::Fifo:
+    return "fifo";
+  case FrontierOrder::Depth:
+    return "depth";
+  case FrontierOrder::Followers:
+    return "followers";
+  case FrontierOrder::Degree:
+    return "degree";
+  case FrontierOrder::Custom:
+    return "custom";
+  }
+  return "unknown";
+}
+
+CrawlFrontier::CrawlFrontier(const VisitedIndexOptions &seen_options,
+                             const std::string &queue_dir,
+                             size_t segment_entries)
+    : m_seen(seen_options) {
+  if (!queue_dir.empty()) {
+    m_queue = std::make_unique<SegmentedQueue>(queue_dir, segment_entries);
+  }
+}
+
+uint64_t CrawlFrontier::pack(uint64_t uid, int depth) {
+  const uint64_t d = static_cast<uint64_t>(std::clamp(depth, 0, kMaxDepth));
+  return (d << kUidBits) | (uid & kUidMask);
+}
+
+bool CrawlFrontier::set_ordering(FrontierOrdering ordering) {
+  if (!empty()) {
+    spdlog::warn("frontier ordering can only change while the frontier is empty");
+    return false;
+  }
+  if (ordering.order != FrontierOrder::Fifo && m_queue) {
+    spdlog::warn(fmt::format("frontier order {} needs the in-memory frontier; keeping fifo",
+                             frontier_order_name(ordering.order)));
+    return false;
+  }
+  if (ordering.order == FrontierOrder::Custom && !ordering.score) {
+    spdlog::warn("custom frontier order without a score function; keeping fifo");
+    return false;
+  }
+  m_entries.clear();
+  m_head = 0;
+  m_ranked.clear();
+  m_ordering = std::move(ordering);
+  return true;
+}
+
+double CrawlFrontier::score(const FrontierCandidate &candidate) const {
+  switch (m_ordering.order) {
+  case FrontierOrder::Fifo:
+    return 0.0;
+  case FrontierOrder::Depth:
+    return -static_cast<double>(candidate.depth);
+  case FrontierOrder::Followers:
+    return static_cast<double>(candidate.followers_count);
+  case FrontierOrder::Degree:
+    return static_cast<double>(candidate.degree);
+  case FrontierOrder::Custom:
+    return m_ordering.score(candidate);
+  }
+  return 0.0;
+}
+
+bool CrawlFrontier::push(uint64_t uid, int depth, bool *reranked) {
+  if (reranked) {
+    *reranked = false;
+  }
+  if (uid > kUidMask) {
+    spdlog::warn(fmt::format("frontier rejects uid {}: exceeds {} bits", uid, kUidBits));
+    return false;
+  }
+  depth = std::clamp(depth, 0, kMaxDepth);
+  if (!m_seen.insert(uid)) {
+    // Rediscovered while still queued: count the edge and re-rank.
+    FrontierCandidate *queued = ordered() ? m_ranked.find(uid) : nullptr;
+    if (queued) {
+      queued->degree++;
+      queued->depth = std::min(queued->depth, depth);
+      m_ranked.update(uid, score(*queued));
+      if (reranked) {
+        *reranked = true;
+      }
+    }
+    return false;
+  }
+  if (ordered()) {
+    FrontierCandidate candidate;
+    candidate.uid = uid;
+    candidate.depth = depth;
+    candidate.degree = 1;
+    if (m_ordering.followers_count &&
+        (m_ordering.order == FrontierOrder::Followers || m_ordering.order == FrontierOrder::Custom)) {
+      candidate.followers_count = m_ordering.followers_count(uid);
+    }
+    const double priority = score(candidate);
+    m_ranked.push(uid, priority, candidate);
+  } else if (m_queue) {
+    m_queue->push(pack(uid, depth));
+  } else {
+    m_entries.push_back(pack(uid, depth));
+  }
+  return true;
+}
+
+bool CrawlFrontier::pop(uint64_t *uid, int *depth) {
+  uint64_t entry = 0;
+  if (m_queue) {
+    if (!m_queue->pop(&entry)) {
+      return false;
+    }
+  } else if (ordered()) {
+    FrontierCandidate candidate;
+    if (!m_ranked.pop(nullptr, &candidate)) {
+      return false;
+    }
+    entry = pack(candidate.uid, candidate.depth);
+  } else if (empty()) {
+    return false;
+  } else {
+    entry = m_entries[m_head++];
+  }
+  if (uid) {
+    *uid = unpack_uid(entry);
+  }
+  if (depth) {
+    *depth = unpack_depth(entry);
+  }
+  compact();
+  return true;
+}
+
+void CrawlFrontier::mark_seen(uint64_t uid) {
+  m_seen.insert(uid);
+}
+
+std::vector<std::pair<uint64_t, int>> CrawlFrontier::pending_entries() const {
+  std::vector<std::pair<uint64_t, int>> ret;
+  ret.reserve(pending());
+  if (ordered()) {
+    m_ranked.for_each([&ret](uint64_t, const FrontierCandidate &candidate, double) {
+      ret.insert(ret.end(), std::max<uint32_t>(candidate.degree, 1), {candidate.uid, candidate.depth});
+    });
+    return ret;
+  }
+  for_each_pending([&ret](uint64_t entry) { ret.emplace_back(unpack_uid(entry), unpack_depth(entry)); });
+  return ret;
+}
+
+void CrawlFrontier::clear() {
+  m_entries.clear();
+  m_entries.shrink_to_fit();
+  m_head = 0;
+  m_ranked.clear();
+  if (m_queue) {
+    m_queue->clear();
+  }
+  m_seen.clear();
+}
+
+void CrawlFrontier::flush() {
+  m_seen.flush();
+  if (m_queue) {
+    m_queue->sync();
+  }
+}
+
+void CrawlFrontier::checkpoint() {
+  if (m_queue) {
+    m_queue->commit();
+  }
+}
+
+std::optional<SegmentedQueue::Commit> CrawlFrontier::prepare_checkpoint() {
+  if (!m_queue) {
+    return std::nullopt;
+  }
+  return m_queue->prepare_commit();
+}
+
+void CrawlFrontier::reseed_seen() {
+  m_seen.clear();
+  for_each_pending([this](uint64_t entry) { m_seen.insert(unpack_uid(entry)); });
+}
+
+size_t CrawlFrontier::memory_bytes() const {
+  size_t queue_bytes = m_entries.capacity() * sizeof(uint64_t) + m_ranked.memory_bytes();
+  if (m_queue) {
+    queue_bytes = m_queue->mapped_bytes();
+  }
+  return queue_bytes + m_seen.memory_bytes();
+}
+
+double CrawlFrontier::memory_bytes_per_million() const {
+  const size_t n = std::max<size_t>(seen_size(), 1);
+  return static_cast<double>(memory_bytes()) * 1000000.0 / static_cast<double>(n);
+}
+
+void CrawlFrontier::for_each_pending(const std::function<void(uint64_t)> &fn) const {
+  if (m_queue) {
+    m_queue->for_each(fn);
+    return;
+  }
+  if (ordered()) {
+    m_ranked.for_each([&fn](uint64_t, const FrontierCandidate &candidate, double) {
+      fn(pack(candidate.uid, candidate.depth));
+    });
+    return;
+  }
+  std::for_each(m_entries.begin() + static_cast<std::ptrdiff_t>(m_head), m_entries.end(), fn);
+}
+
+void CrawlFrontier::compact() {
+  if (m_head == m_entries.size()) {
+    m_entries.clear();
+    m_head = 0;
+    return;
+  }
+  if (m_head < kCompactMinHead || m_head * 2 < m_entries.size()) {
+    return;
+  }
+  m_entries.erase(m_entries.begin(), m_entries.begin() + static_cast<std::ptrdiff_t>(m_head));
+  m_head = 0;
+}
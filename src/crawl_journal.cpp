@@ -0,0 +1,118 @@
+#include "crawl_journal.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+namespace {
+constexpr char kJournalMagic[4] = {'C', 'J', 'N', 'L'};
+constexpr uint32_t kJournalVersion = 1;
+// op (1) + uid (8) + depth (1)
+constexpr uint32_t kPayloadBytes = 10;
+
+const std::array<uint32_t, 256> &crc_table() {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+  return table;
+}
+
+uint32_t crc32(const char *data, size_t size) {
+  const auto &table = crc_table();
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i) {
+    c = table[(c ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void put(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const char *in) {
+  T value;
+  std::memcpy(&value, in, sizeof(value));
+  return value;
+}
+}
+
+std::string CrawlJournal::header(uint64_t generation) {
+  std::string out(kJournalMagic, sizeof(kJournalMagic));
+  put<uint32_t>(&out, kJournalVersion);
+  put<uint64_t>(&out, generation);
+  return out;
+}
+
+void CrawlJournal::reset() {
+  m_buffer.clear();
+  m_records = 0;
+  m_active = true;
+}
+
+void CrawlJournal::append(Op op, uint64_t uid, int depth) {
+  char payload[kPayloadBytes];
+  payload[0] = static_cast<char>(op);
+  std::memcpy(payload + 1, &uid, sizeof(uid));
+  payload[9] = static_cast<char>(std::clamp(depth, 0, 255));
+  put<uint32_t>(&m_buffer, kPayloadBytes);
+  put<uint32_t>(&m_buffer, crc32(payload, kPayloadBytes));
+  m_buffer.append(payload, kPayloadBytes);
+  m_records++;
+}
+
+std::string CrawlJournal::take() {
+  std::string out;
+  out.swap(m_buffer);
+  return out;
+}
+
+size_t CrawlJournal::replay(const std::string &path,
+                            uint64_t generation,
+                            const std::function<void(const Record &)> &fn) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs.is_open()) {
+    return 0;
+  }
+  char header[16];
+  if (!ifs.read(header, sizeof(header)) ||
+      std::memcmp(header, kJournalMagic, sizeof(kJournalMagic)) != 0 ||
+      get<uint32_t>(header + 4) != kJournalVersion) {
+    spdlog::warn(fmt::format("ignore crawl journal {} with bad header", path));
+    return 0;
+  }
+  if (get<uint64_t>(header + 8) != generation) {
+    spdlog::info(fmt::format("ignore stale crawl journal {}", path));
+    return 0;
+  }
+
+  size_t replayed = 0;
+  char frame[8 + kPayloadBytes];
+  while (ifs.read(frame, sizeof(frame))) {
+    const char *payload = frame + 8;
+    if (get<uint32_t>(frame) != kPayloadBytes ||
+        get<uint32_t>(frame + 4) != crc32(payload, kPayloadBytes)) {
+      spdlog::warn(fmt::format("crawl journal {} corrupt after {} records", path, replayed));
+      break;
+    }
+    Record record;
+    record.op = static_cast<Op>(payload[0]);
+    record.uid = get<uint64_t>(payload + 1);
+    record.depth = static_cast<uint8_t>(payload[9]);
+    fn(record);
+    replayed++;
+  }
+  return replayed;
+}
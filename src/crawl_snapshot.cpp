@@ -0,0 +1,345 @@
+#include "crawl_snapshot.hpp"
+#include "crawl_frontier.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace {
+constexpr char kSnapshotMagic[4] = {'C', 'S', 'N', 'P'};
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr size_t kHeaderBytes = 128;
+
+constexpr uint32_t kFlagCrawlWeibo = 1u << 0;
+constexpr uint32_t kFlagCrawlFans = 1u << 1;
+constexpr uint32_t kFlagCrawlFollowers = 1u << 2;
+
+// Binary header; every field sits at a fixed, naturally aligned offset.
+struct RawHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t root_uid;
+  int32_t max_depth;
+  uint32_t flags;
+  uint64_t current_uid;
+  uint64_t journal_generation;
+  uint64_t in_flight_count;
+  uint64_t queue_count;
+  uint64_t visited_count;
+  uint64_t metrics[6];
+  uint32_t visited_index_len;
+  uint32_t frontier_dir_len;
+  uint64_t reserved;
+};
+static_assert(sizeof(RawHeader) == kHeaderBytes, "snapshot header layout changed");
+
+size_t pad8(size_t n) {
+  return (n + 7) & ~size_t{7};
+}
+}
+
+CrawlSnapshot::~CrawlSnapshot() {
+  unmap();
+}
+
+CrawlSnapshot::CrawlSnapshot(CrawlSnapshot &&other) noexcept {
+  *this = std::move(other);
+}
+
+CrawlSnapshot &CrawlSnapshot::operator=(CrawlSnapshot &&other) noexcept {
+  if (this != &other) {
+    unmap();
+    info = std::move(other.info);
+    m_queue = std::move(other.m_queue);
+    m_visited = std::move(other.m_visited);
+    m_fd = std::exchange(other.m_fd, -1);
+    m_map = std::exchange(other.m_map, nullptr);
+    m_map_bytes = std::exchange(other.m_map_bytes, 0);
+    m_queue_view = std::exchange(other.m_queue_view, nullptr);
+    m_queue_count = std::exchange(other.m_queue_count, 0);
+    m_visited_view = std::exchange(other.m_visited_view, nullptr);
+    m_visited_count = std::exchange(other.m_visited_count, 0);
+  }
+  return *this;
+}
+
+CrawlSnapshot CrawlSnapshot::open(const std::string &path) {
+  CrawlSnapshot snapshot;
+  snapshot.m_fd = ::open(path.c_str(), O_RDONLY);
+  if (snapshot.m_fd < 0) {
+    throw std::runtime_error(fmt::format("failed to open crawl snapshot {}", path));
+  }
+  char magic[sizeof(kSnapshotMagic)] = {};
+  if (::pread(snapshot.m_fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+      std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0) {
+    // Not binary: the original JSON format.
+    ::close(std::exchange(snapshot.m_fd, -1));
+    std::ifstream ifs(path);
+    return from_json(json::parse(ifs));
+  }
+
+  struct stat st {};
+  if (::fstat(snapshot.m_fd, &st) != 0 || static_cast<size_t>(st.st_size) < kHeaderBytes) {
+    throw std::runtime_error(fmt::format("crawl snapshot too short: {}", path));
+  }
+  snapshot.m_map_bytes = static_cast<size_t>(st.st_size);
+  void *map = ::mmap(nullptr, snapshot.m_map_bytes, PROT_READ, MAP_SHARED, snapshot.m_fd, 0);
+  if (map == MAP_FAILED) {
+    throw std::runtime_error(fmt::format("failed to mmap crawl snapshot {}", path));
+  }
+  snapshot.m_map = map;
+  // Resume walks both arrays front to back.
+  ::madvise(map, snapshot.m_map_bytes, MADV_SEQUENTIAL);
+
+  const char *base = static_cast<const char *>(map);
+  RawHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (header.version != kSnapshotVersion) {
+    throw std::runtime_error(fmt::format(
+        "unsupported crawl snapshot version {} in {}", header.version, path));
+  }
+  const size_t strings_bytes = pad8(size_t{header.visited_index_len} + header.frontier_dir_len);
+  const size_t queue_offset = kHeaderBytes + strings_bytes;
+  const size_t visited_offset = queue_offset + header.queue_count * sizeof(uint64_t);
+  if (header.queue_count > snapshot.m_map_bytes / sizeof(uint64_t) ||
+      header.visited_count > snapshot.m_map_bytes / sizeof(uint64_t) ||
+      visited_offset + header.visited_count * sizeof(uint64_t) > snapshot.m_map_bytes) {
+    throw std::runtime_error(fmt::format("corrupt crawl snapshot {}", path));
+  }
+
+  CrawlSnapshotInfo &info = snapshot.info;
+  info.root_uid = header.root_uid;
+  info.max_depth = header.max_depth;
+  info.crawl_weibo = (header.flags & kFlagCrawlWeibo) != 0;
+  info.crawl_fans = (header.flags & kFlagCrawlFans) != 0;
+  info.crawl_followers = (header.flags & kFlagCrawlFollowers) != 0;
+  info.current_uid = header.current_uid;
+  info.journal_generation = header.journal_generation;
+  info.in_flight_count = header.in_flight_count;
+  info.users_processed = header.metrics[0];
+  info.users_failed = header.metrics[1];
+  info.requests_total = header.metrics[2];
+  info.requests_failed = header.metrics[3];
+  info.retries_total = header.metrics[4];
+  info.http_429_count = header.metrics[5];
+  info.visited_index.assign(base + kHeaderBytes, header.visited_index_len);
+  info.frontier_dir.assign(base + kHeaderBytes + header.visited_index_len, header.frontier_dir_len);
+
+  snapshot.m_queue_view = reinterpret_cast<const uint64_t *>(base + queue_offset);
+  snapshot.m_queue_count = static_cast<size_t>(header.queue_count);
+  snapshot.m_visited_view = reinterpret_cast<const uint64_t *>(base + visited_offset);
+  snapshot.m_visited_count = static_cast<size_t>(header.visited_count);
+  return snapshot;
+}
+
+CrawlSnapshot CrawlSnapshot::from_json(const json &j) {
+  CrawlSnapshot snapshot;
+  CrawlSnapshotInfo &info = snapshot.info;
+  info.root_uid = j.at("root_uid").get<uint64_t>();
+  info.max_depth = j.at("max_depth").get<int>();
+  info.crawl_weibo = j.at("crawl_weibo").get<bool>();
+  info.crawl_fans = j.at("crawl_fans").get<bool>();
+  info.crawl_followers = j.at("crawl_followers").get<bool>();
+  info.current_uid = j.value("current_uid", static_cast<uint64_t>(0));
+  info.journal_generation = j.value("journal_generation", static_cast<uint64_t>(0));
+  info.visited_index = j.value("visited_index", std::string());
+  info.frontier_dir = j.value("frontier_dir", std::string());
+
+  // Entries before the cursor were already processed by older state files.
+  const size_t cursor = j.value("cursor", static_cast<size_t>(0));
+  const size_t in_flight_count = j.value("in_flight_count", static_cast<size_t>(0));
+  std::vector<uint64_t> queue;
+  if (j.contains("queue") && j["queue"].is_array()) {
+    const auto &queue_json = j["queue"];
+    queue.reserve(queue_json.size());
+    for (size_t i = std::min(cursor, queue_json.size()); i < queue_json.size(); ++i) {
+      const auto &item = queue_json[i];
+      if (!item.contains("uid") || !item.contains("depth")) {
+        continue;
+      }
+      if (i < in_flight_count) {
+        info.in_flight_count++;
+      }
+      queue.push_back(CrawlFrontier::pack(item["uid"].get<uint64_t>(), item["depth"].get<int>()));
+    }
+  }
+  snapshot.set_queue(std::move(queue));
+
+  std::vector<uint64_t> visited;
+  if (j.contains("visited") && j["visited"].is_array()) {
+    visited.reserve(j["visited"].size());
+    for (const auto &uid_item : j["visited"]) {
+      visited.push_back(uid_item.get<uint64_t>());
+    }
+  }
+  snapshot.set_visited(std::move(visited));
+
+  if (j.contains("metrics") && j["metrics"].is_object()) {
+    const auto &metrics = j["metrics"];
+    info.users_processed = metrics.value("users_processed", static_cast<uint64_t>(0));
+    info.users_failed = metrics.value("users_failed", static_cast<uint64_t>(0));
+    info.requests_total = metrics.value("requests_total", static_cast<uint64_t>(0));
+    info.requests_failed = metrics.value("requests_failed", static_cast<uint64_t>(0));
+    info.retries_total = metrics.value("retries_total", static_cast<uint64_t>(0));
+    info.http_429_count = metrics.value("http_429_count", static_cast<uint64_t>(0));
+  }
+  return snapshot;
+}
+
+CrawlSnapshot::Format CrawlSnapshot::parse_format(const std::string &name) {
+  return name == "binary" ? Format::Binary : Format::Json;
+}
+
+json CrawlSnapshot::to_json() const {
+  json j;
+  j["root_uid"] = info.root_uid;
+  j["max_depth"] = info.max_depth;
+  j["crawl_weibo"] = info.crawl_weibo;
+  j["crawl_fans"] = info.crawl_fans;
+  j["crawl_followers"] = info.crawl_followers;
+  // Only unfinished work is persisted, so the cursor is always 0.
+  j["cursor"] = 0;
+  j["current_uid"] = info.current_uid;
+  j["journal_generation"] = info.journal_generation;
+  j["in_flight_count"] = info.in_flight_count;
+
+  json queue_json = json::array();
+  for (size_t i = 0; i < queue_size(); ++i) {
+    queue_json.push_back({{"uid", CrawlFrontier::unpack_uid(queue()[i])},
+                          {"depth", CrawlFrontier::unpack_depth(queue()[i])}});
+  }
+  j["queue"] = std::move(queue_json);
+  if (!info.frontier_dir.empty()) {
+    j["frontier_dir"] = info.frontier_dir;
+  }
+  if (!info.visited_index.empty()) {
+    j["visited_index"] = info.visited_index;
+  } else {
+    j["visited"] = std::vector<uint64_t>(visited(), visited() + visited_size());
+  }
+
+  j["metrics"] = {
+      {"users_processed", info.users_processed},
+      {"users_failed", info.users_failed},
+      {"requests_total", info.requests_total},
+      {"requests_failed", info.requests_failed},
+      {"retries_total", info.retries_total},
+      {"http_429_count", info.http_429_count},
+  };
+  return j;
+}
+
+void CrawlSnapshot::write(const std::string &path, Format format, bool durable) const {
+  const std::string tmp = path + ".tmp";
+  if (format == Format::Binary) {
+    write_binary(tmp);
+  } else {
+    std::ofstream ofs(tmp, std::ios::trunc);
+    ofs << to_json().dump() << std::endl;
+    if (!ofs) {
+      throw std::runtime_error(fmt::format("failed to write {}", tmp));
+    }
+  }
+  if (durable) {
+    const int fd = ::open(tmp.c_str(), O_RDONLY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error(fmt::format("failed to fsync {}", tmp));
+    }
+    ::close(fd);
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    throw std::runtime_error(fmt::format("failed to replace {}", path));
+  }
+}
+
+void CrawlSnapshot::set_queue(std::vector<uint64_t> entries) {
+  materialize();
+  m_queue = std::move(entries);
+}
+
+void CrawlSnapshot::set_visited(std::vector<uint64_t> uids) {
+  materialize();
+  std::sort(uids.begin(), uids.end());
+  uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
+  m_visited = std::move(uids);
+}
+
+void CrawlSnapshot::write_binary(const std::string &path) const {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open()) {
+    throw std::runtime_error(fmt::format("failed to write {}", path));
+  }
+  RawHeader header {};
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.version = kSnapshotVersion;
+  header.root_uid = info.root_uid;
+  header.max_depth = info.max_depth;
+  header.flags = (info.crawl_weibo ? kFlagCrawlWeibo : 0u) |
+                 (info.crawl_fans ? kFlagCrawlFans : 0u) |
+                 (info.crawl_followers ? kFlagCrawlFollowers : 0u);
+  header.current_uid = info.current_uid;
+  header.journal_generation = info.journal_generation;
+  header.in_flight_count = info.in_flight_count;
+  header.queue_count = queue_size();
+  header.visited_count = visited_size();
+  header.metrics[0] = info.users_processed;
+  header.metrics[1] = info.users_failed;
+  header.metrics[2] = info.requests_total;
+  header.metrics[3] = info.requests_failed;
+  header.metrics[4] = info.retries_total;
+  header.metrics[5] = info.http_429_count;
+  header.visited_index_len = static_cast<uint32_t>(info.visited_index.size());
+  header.frontier_dir_len = static_cast<uint32_t>(info.frontier_dir.size());
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const size_t strings_bytes = info.visited_index.size() + info.frontier_dir.size();
+  ofs.write(info.visited_index.data(), static_cast<std::streamsize>(info.visited_index.size()));
+  ofs.write(info.frontier_dir.data(), static_cast<std::streamsize>(info.frontier_dir.size()));
+  const char zeros[8] = {};
+  ofs.write(zeros, static_cast<std::streamsize>(pad8(strings_bytes) - strings_bytes));
+
+  ofs.write(reinterpret_cast<const char *>(queue()),
+            static_cast<std::streamsize>(queue_size() * sizeof(uint64_t)));
+  ofs.write(reinterpret_cast<const char *>(visited()),
+            static_cast<std::streamsize>(visited_size() * sizeof(uint64_t)));
+  if (!ofs) {
+    throw std::runtime_error(fmt::format("failed to write {}", path));
+  }
+}
+
+void CrawlSnapshot::materialize() {
+  if (!m_map) {
+    return;
+  }
+  m_queue.assign(m_queue_view, m_queue_view + m_queue_count);
+  m_visited.assign(m_visited_view, m_visited_view + m_visited_count);
+  unmap();
+}
+
+void CrawlSnapshot::unmap() {
+  if (m_map) {
+    ::munmap(m_map, m_map_bytes);
+    m_map = nullptr;
+    m_map_bytes = 0;
+    m_queue_view = nullptr;
+    m_visited_view = nullptr;
+    m_queue_count = 0;
+    m_visited_count = 0;
+  }
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+}
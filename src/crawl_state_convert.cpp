@@ -0,0 +1,33 @@
+// Converts a crawl state snapshot between the JSON and binary formats.
+//
+//   crawl_state_convert <input> <output> [--to binary|json]
+//
+// The input format is detected automatically; the default output is binary.
+#include "crawl_snapshot.hpp"
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+  if (argc != 3 && !(argc == 5 && std::strcmp(argv[3], "--to") == 0)) {
+    std::cerr << "usage: " << argv[0] << " <input> <output> [--to binary|json]" << std::endl;
+    return 2;
+  }
+  const std::string format_name = argc == 5 ? argv[4] : "binary";
+  if (format_name != "binary" && format_name != "json") {
+    std::cerr << "unknown format: " << format_name << std::endl;
+    return 2;
+  }
+  try {
+    const CrawlSnapshot snapshot = CrawlSnapshot::open(argv[1]);
+    snapshot.write(argv[2], CrawlSnapshot::parse_format(format_name));
+    std::cout << "converted " << argv[1] << " -> " << argv[2] << " (" << format_name << "): "
+              << snapshot.queue_size() << " queued, " << snapshot.visited_size() << " visited"
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << "conversion failed: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,1045 @@
+#include "http_transport.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <optional>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kMaxHeadBytes = 64 * 1024;
+constexpr size_t kReadChunk = 16 * 1024;
+
+std::string lower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return s;
+}
+
+std::string trim(const std::string &s) {
+  size_t begin = 0;
+  size_t end = s.size();
+  while (begin < end && (s[begin] == ' ' || s[begin] == '\t')) {
+    ++begin;
+  }
+  while (end > begin && (s[end - 1] == ' ' || s[end - 1] == '\t' || s[end - 1] == '\r')) {
+    --end;
+  }
+  return s.substr(begin, end - begin);
+}
+
+std::string ssl_error_string() {
+  const unsigned long code = ERR_get_error();
+  if (code == 0) {
+    return "tls error";
+  }
+  char buf[256];
+  ERR_error_string_n(code, buf, sizeof(buf));
+  ERR_clear_error();
+  return buf;
+}
+
+// Incremental HTTP/1.1 response parser: Content-Length, chunked and
+// close-delimited bodies; 1xx interim responses are skipped.
+class ResponseParser {
+public:
+  enum class Status { NeedMore, Done, Error };
+
+  Status feed(const char *data, size_t size) {
+    m_buf.append(data, size);
+    const Status status = parse();
+    m_buf.erase(0, m_pos);
+    m_pos = 0;
+    return status;
+  }
+
+  // The peer closed the connection.
+  Status finish() {
+    if (m_stage == Stage::UntilClose) {
+      m_stage = Stage::Done;
+      return Status::Done;
+    }
+    m_error = "connection closed before the response was complete";
+    return Status::Error;
+  }
+
+  bool keep_alive() const { return m_keep_alive; }
+  const std::string &error() const { return m_error; }
+  HttpResponse take() { return std::move(m_response); }
+
+private:
+  enum class Stage { Head, Length, ChunkSize, ChunkData, ChunkEnd, Trailer, UntilClose, Done };
+
+  size_t available() const { return m_buf.size() - m_pos; }
+
+  Status fail(std::string error) {
+    m_error = std::move(error);
+    return Status::Error;
+  }
+
+  Status parse() {
+    for (;;) {
+      switch (m_stage) {
+        case Stage::Head: {
+          const size_t end = m_buf.find("\r\n\r\n", m_pos);
+          if (end == std::string::npos) {
+            if (available() > kMaxHeadBytes) {
+              return fail("response head too large");
+            }
+            return Status::NeedMore;
+          }
+          if (!parse_head(m_buf.substr(m_pos, end - m_pos))) {
+            return Status::Error;
+          }
+          m_pos = end + 4;
+          break;
+        }
+        case Stage::Length: {
+          const size_t n = std::min(m_remaining, available());
+          m_response.body.append(m_buf, m_pos, n);
+          m_pos += n;
+          m_remaining -= n;
+          if (m_remaining > 0) {
+            return Status::NeedMore;
+          }
+          m_stage = Stage::Done;
+          break;
+        }
+        case Stage::ChunkSize: {
+          const size_t end = m_buf.find("\r\n", m_pos);
+          if (end == std::string::npos) {
+            return available() > 1024 ? fail("bad chunk size line") : Status::NeedMore;
+          }
+          const std::string line = m_buf.substr(m_pos, end - m_pos);
+          char *parsed_end = nullptr;
+          const unsigned long long size = std::strtoull(line.c_str(), &parsed_end, 16);
+          if (parsed_end == line.c_str()) {
+            return fail("bad chunk size line");
+          }
+          m_pos = end + 2;
+          m_remaining = static_cast<size_t>(size);
+          m_stage = size == 0 ? Stage::Trailer : Stage::ChunkData;
+          break;
+        }
+        case Stage::ChunkData: {
+          const size_t n = std::min(m_remaining, available());
+          m_response.body.append(m_buf, m_pos, n);
+          m_pos += n;
+          m_remaining -= n;
+          if (m_remaining > 0) {
+            return Status::NeedMore;
+          }
+          m_stage = Stage::ChunkEnd;
+          break;
+        }
+        case Stage::ChunkEnd:
+          if (available() < 2) {
+            return Status::NeedMore;
+          }
+          if (m_buf.compare(m_pos, 2, "\r\n") != 0) {
+            return fail("missing chunk terminator");
+          }
+          m_pos += 2;
+          m_stage = Stage::ChunkSize;
+          break;
+        case Stage::Trailer: {
+          const size_t end = m_buf.find("\r\n", m_pos);
+          if (end == std::string::npos) {
+            return Status::NeedMore;
+          }
+          const bool last = end == m_pos;
+          m_pos = end + 2;
+          if (last) {
+            m_stage = Stage::Done;
+          }
+          break;
+        }
+        case Stage::UntilClose:
+          m_response.body.append(m_buf, m_pos, available());
+          m_pos = m_buf.size();
+          return Status::NeedMore;
+        case Stage::Done:
+          return Status::Done;
+      }
+    }
+  }
+
+  bool parse_head(const std::string &head) {
+    HttpResponse response;
+    size_t line_end = head.find("\r\n");
+    const std::string status_line = head.substr(0, line_end);
+    // HTTP/1.x NNN reason
+    if (status_line.size() < 12 || status_line.compare(0, 7, "HTTP/1.") != 0) {
+      m_error = "bad status line";
+      return false;
+    }
+    const bool http10 = status_line[7] == '0';
+    response.status = std::atoi(status_line.c_str() + 9);
+    if (response.status < 100 || response.status > 999) {
+      m_error = "bad status code";
+      return false;
+    }
+    while (line_end != std::string::npos) {
+      const size_t begin = line_end + 2;
+      line_end = head.find("\r\n", begin);
+      const std::string line = head.substr(begin, line_end == std::string::npos ? std::string::npos
+                                                                               : line_end - begin);
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) {
+        continue;
+      }
+      response.headers[lower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+    }
+
+    if (response.status < 200) {
+      // Interim response; the real one follows.
+      return true;
+    }
+    const auto connection = response.headers.find("connection");
+    const std::string connection_value =
+        connection == response.headers.end() ? std::string() : lower(connection->second);
+    m_keep_alive = http10 ? connection_value == "keep-alive" : connection_value != "close";
+
+    const auto encoding = response.headers.find("transfer-encoding");
+    const auto length = response.headers.find("content-length");
+    if (response.status == 204 || response.status == 304) {
+      m_stage = Stage::Done;
+    } else if (encoding != response.headers.end() &&
+               lower(encoding->second).find("chunked") != std::string::npos) {
+      m_stage = Stage::ChunkSize;
+    } else if (length != response.headers.end()) {
+      m_remaining = static_cast<size_t>(std::strtoull(length->second.c_str(), nullptr, 10));
+      m_stage = m_remaining == 0 ? Stage::Done : Stage::Length;
+    } else {
+      m_stage = Stage::UntilClose;
+      m_keep_alive = false;
+    }
+    m_response = std::move(response);
+    return true;
+  }
+
+  std::string m_buf;
+  size_t m_pos = 0;
+  Stage m_stage = Stage::Head;
+  size_t m_remaining = 0;
+  bool m_keep_alive = false;
+  HttpResponse m_response;
+  std::string m_error;
+};
+
+struct Request {
+  std::string path;
+  HttpTransport::Headers headers;
+  HttpTransport::Callback done;
+  // Sent once on a reused connection that turned out to be closed.
+  bool retried = false;
+};
+
+class EpollTransport : public HttpTransport {
+public:
+  explicit EpollTransport(const HttpTransportOptions &options)
+      : m_options(options) {
+    parse_base_url(options.base_url);
+    m_options.max_connections = std::max(1, m_options.max_connections);
+    if (m_tls) {
+      m_ssl_ctx = SSL_CTX_new(TLS_client_method());
+      if (!m_ssl_ctx) {
+        throw std::runtime_error("SSL_CTX_new failed: " + ssl_error_string());
+      }
+      SSL_CTX_set_min_proto_version(m_ssl_ctx, TLS1_2_VERSION);
+      SSL_CTX_set_mode(m_ssl_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+      SSL_CTX_set_options(m_ssl_ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+      // Keep the newest session ticket so reconnects can skip the full
+      // handshake.
+      SSL_CTX_set_session_cache_mode(m_ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_set_app_data(m_ssl_ctx, this);
+      SSL_CTX_sess_set_new_cb(m_ssl_ctx, &EpollTransport::on_new_session);
+      if (m_options.verify_peer) {
+        SSL_CTX_set_default_verify_paths(m_ssl_ctx);
+        SSL_CTX_set_verify(m_ssl_ctx, SSL_VERIFY_PEER, nullptr);
+      } else {
+        SSL_CTX_set_verify(m_ssl_ctx, SSL_VERIFY_NONE, nullptr);
+      }
+    }
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll < 0 || m_wake < 0) {
+      cleanup_fds();
+      throw std::runtime_error(fmt::format("epoll transport setup failed: {}", std::strerror(errno)));
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_wake;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &ev);
+    m_loop = std::thread(&EpollTransport::run, this);
+  }
+
+  ~EpollTransport() override {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    wake();
+    m_loop.join();
+    // The resolver wakes the loop through m_wake when it finishes.
+    if (m_resolver.joinable()) {
+      m_resolver.join();
+    }
+    cleanup_fds();
+    if (m_session) {
+      SSL_SESSION_free(m_session);
+    }
+    if (m_ssl_ctx) {
+      SSL_CTX_free(m_ssl_ctx);
+    }
+  }
+
+  void get_async(const std::string &path, const Headers &headers, Callback done) override {
+    Request request;
+    request.path = path;
+    request.headers = headers;
+    request.done = std::move(done);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_stopping) {
+        m_submitted.push_back(std::move(request));
+        request.done = nullptr;
+      }
+    }
+    if (request.done) {
+      HttpResponse response;
+      response.error = "transport stopped";
+      request.done(std::move(response));
+      return;
+    }
+    wake();
+  }
+
+  const char *name() const override { return "epoll"; }
+
+  HttpTransportStats stats() const override {
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    return m_stats;
+  }
+
+private:
+  enum class State { Connecting, Handshake, Idle, Writing, Reading };
+
+  // getaddrinfo() result handed from the resolver thread to the loop.
+  struct Resolved {
+    sockaddr_storage addr{};
+    socklen_t addr_len = 0;
+    int family = AF_INET;
+    std::string error;
+  };
+
+  struct Connection {
+    int fd = -1;
+    SSL *ssl = nullptr;
+    State state = State::Connecting;
+    uint32_t events = 0;
+    Clock::time_point deadline = Clock::time_point::max();
+    std::string out;
+    size_t out_pos = 0;
+    ResponseParser parser;
+    bool has_request = false;
+    Request request;
+    uint64_t served = 0;
+    bool got_bytes = false;
+    // Handshake done and no fatal TLS error since.
+    bool tls_ok = false;
+    Clock::time_point opened_at;
+    Clock::time_point taken_at;
+  };
+
+  // Called on the loop thread from inside SSL calls; takes the reference.
+  static int on_new_session(SSL *ssl, SSL_SESSION *session) {
+    auto *self = static_cast<EpollTransport *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (self->m_session) {
+      SSL_SESSION_free(self->m_session);
+    }
+    self->m_session = session;
+    return 1;
+  }
+
+  // Applies f to the stats and refreshes the pool gauges.
+  template <typename F>
+  void record(F f) {
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    f(m_stats);
+    m_stats.open_connections = m_connections.size();
+    m_stats.idle_connections = m_idle.size();
+  }
+
+  void parse_base_url(const std::string &url) {
+    std::string rest = url;
+    if (rest.compare(0, 8, "https://") == 0) {
+      m_tls = true;
+      rest = rest.substr(8);
+    } else if (rest.compare(0, 7, "http://") == 0) {
+      rest = rest.substr(7);
+    } else {
+      throw std::invalid_argument("unsupported base url: " + url);
+    }
+    rest = rest.substr(0, rest.find('/'));
+    const size_t colon = rest.rfind(':');
+    if (colon != std::string::npos && rest.find(']') == std::string::npos) {
+      m_host = rest.substr(0, colon);
+      m_port = rest.substr(colon + 1);
+      m_host_header = rest;
+    } else {
+      m_host = rest;
+      m_port = m_tls ? "443" : "80";
+      m_host_header = rest;
+    }
+    if (m_host.empty()) {
+      throw std::invalid_argument("base url has no host: " + url);
+    }
+  }
+
+  void cleanup_fds() {
+    if (m_wake >= 0) {
+      close(m_wake);
+      m_wake = -1;
+    }
+    if (m_epoll >= 0) {
+      close(m_epoll);
+      m_epoll = -1;
+    }
+  }
+
+  void wake() {
+    const uint64_t one = 1;
+    ssize_t ignored = write(m_wake, &one, sizeof(one));
+    (void)ignored;
+  }
+
+  void run() {
+    // SSL writes go through write(2); a peer reset must not kill the process.
+    sigset_t pipe_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, nullptr);
+
+    std::vector<epoll_event> events(256);
+    for (;;) {
+      const int timeout_ms = next_timeout_ms();
+      const int n = epoll_wait(m_epoll, events.data(), static_cast<int>(events.size()), timeout_ms);
+      if (n < 0 && errno != EINTR) {
+        spdlog::error(fmt::format("epoll_wait failed: {}", std::strerror(errno)));
+        break;
+      }
+      bool stopping = false;
+      std::optional<Resolved> resolved;
+      for (int i = 0; i < n; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == m_wake) {
+          uint64_t count = 0;
+          ssize_t ignored = read(m_wake, &count, sizeof(count));
+          (void)ignored;
+          std::lock_guard<std::mutex> lock(m_mutex);
+          stopping = m_stopping;
+          for (auto &request : m_submitted) {
+            m_pending.push_back(std::move(request));
+          }
+          m_submitted.clear();
+          resolved.swap(m_resolved);
+          continue;
+        }
+        auto it = m_connections.find(fd);
+        if (it != m_connections.end()) {
+          drive(*it->second, events[i].events);
+        }
+      }
+      if (stopping) {
+        break;
+      }
+      if (resolved) {
+        on_resolved(std::move(*resolved));
+      }
+      expire(Clock::now());
+      dispatch();
+    }
+    shutdown();
+  }
+
+  int next_timeout_ms() const {
+    Clock::time_point nearest = Clock::time_point::max();
+    for (const auto &entry : m_connections) {
+      nearest = std::min(nearest, entry.second->deadline);
+    }
+    if (nearest == Clock::time_point::max()) {
+      return -1;
+    }
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        nearest - Clock::now()).count();
+    return static_cast<int>(std::clamp<int64_t>(ms + 1, 0, 60000));
+  }
+
+  void expire(Clock::time_point now) {
+    std::vector<int> expired;
+    for (const auto &entry : m_connections) {
+      if (entry.second->deadline <= now) {
+        expired.push_back(entry.first);
+      }
+    }
+    for (const int fd : expired) {
+      auto it = m_connections.find(fd);
+      if (it != m_connections.end()) {
+        Connection &c = *it->second;
+        if (c.state == State::Idle) {
+          close_connection(c);
+          record([](HttpTransportStats &stats) { stats.idle_expired++; });
+          continue;
+        }
+        if (c.state == State::Connecting) {
+          forget_address();
+        }
+        fail(c, c.state == State::Connecting || c.state == State::Handshake ? "connect timeout"
+                                                                            : "request timeout",
+             false);
+      }
+    }
+  }
+
+  void dispatch() {
+    while (!m_pending.empty()) {
+      Connection *c = nullptr;
+      if (!m_idle.empty()) {
+        auto it = m_connections.find(m_idle.back());
+        m_idle.pop_back();
+        if (it == m_connections.end()) {
+          continue;
+        }
+        c = it->second.get();
+        if (!idle_alive(*c)) {
+          close_connection(*c);
+          record([](HttpTransportStats &stats) { stats.idle_closed++; });
+          continue;
+        }
+      } else if (m_connections.size() < static_cast<size_t>(m_options.max_connections)) {
+        if (!resolve()) {
+          // Resumes when the resolver wakes the loop.
+          return;
+        }
+        std::string error;
+        c = open_connection(&error);
+        if (!c) {
+          complete_error(std::move(m_pending.front()), error);
+          m_pending.pop_front();
+          continue;
+        }
+      } else {
+        return;
+      }
+      c->request = std::move(m_pending.front());
+      m_pending.pop_front();
+      c->has_request = true;
+      c->got_bytes = false;
+      c->parser = ResponseParser();
+      c->out = serialize(c->request);
+      c->out_pos = 0;
+      c->taken_at = Clock::now();
+      if (c->state == State::Idle) {
+        c->state = State::Writing;
+        c->deadline = Clock::now() + std::chrono::milliseconds(m_options.request_timeout_ms);
+        drive(*c, EPOLLOUT);
+      }
+    }
+  }
+
+  std::string serialize(const Request &request) const {
+    std::string out;
+    out.reserve(256 + request.path.size());
+    out += "GET ";
+    out += request.path.empty() ? "/" : request.path;
+    out += " HTTP/1.1\r\nHost: ";
+    out += m_host_header;
+    out += "\r\n";
+    bool has_accept = false;
+    for (const auto &header : request.headers) {
+      const std::string name = lower(header.first);
+      if (name == "host" || name == "connection" || name == "content-length") {
+        continue;
+      }
+      has_accept = has_accept || name == "accept";
+      out += header.first;
+      out += ": ";
+      out += header.second;
+      out += "\r\n";
+    }
+    if (!has_accept) {
+      out += "Accept: */*\r\n";
+    }
+    out += "Connection: keep-alive\r\n\r\n";
+    return out;
+  }
+
+  // True once an address is cached. Otherwise starts getaddrinfo() on
+  // the resolver thread, since it blocks for as long as DNS takes, and
+  // the loop picks the result up in on_resolved().
+  bool resolve() {
+    if (m_addr_len > 0) {
+      return true;
+    }
+    if (!m_resolving) {
+      if (m_resolver.joinable()) {
+        m_resolver.join();
+      }
+      m_resolving = true;
+      m_resolver = std::thread([this] { run_resolver(); });
+    }
+    return false;
+  }
+
+  void run_resolver() {
+    Resolved resolved;
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    const int rc = getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &result);
+    if (rc != 0 || !result) {
+      resolved.error = fmt::format("resolve {} failed: {}", m_host, gai_strerror(rc));
+    } else {
+      std::memcpy(&resolved.addr, result->ai_addr, result->ai_addrlen);
+      resolved.addr_len = result->ai_addrlen;
+      resolved.family = result->ai_family;
+    }
+    if (result) {
+      freeaddrinfo(result);
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_resolved = std::move(resolved);
+    }
+    wake();
+  }
+
+  void on_resolved(Resolved resolved) {
+    m_resolving = false;
+    if (!resolved.error.empty()) {
+      // Requests still waiting need a new connection, which cannot open.
+      while (!m_pending.empty()) {
+        complete_error(std::move(m_pending.front()), resolved.error);
+        m_pending.pop_front();
+      }
+      return;
+    }
+    m_addr = resolved.addr;
+    m_addr_len = resolved.addr_len;
+    m_family = resolved.family;
+  }
+
+  // After a failed connect the host may have moved; the next connection
+  // resolves it again.
+  void forget_address() {
+    m_addr_len = 0;
+  }
+
+  Connection *open_connection(std::string *error) {
+    const int fd = socket(m_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      *error = fmt::format("socket failed: {}", std::strerror(errno));
+      return nullptr;
+    }
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&m_addr), m_addr_len) < 0 &&
+        errno != EINPROGRESS) {
+      *error = fmt::format("connect failed: {}", std::strerror(errno));
+      close(fd);
+      forget_address();
+      return nullptr;
+    }
+    auto connection = std::make_unique<Connection>();
+    connection->fd = fd;
+    connection->state = State::Connecting;
+    connection->opened_at = Clock::now();
+    connection->deadline = connection->opened_at + std::chrono::milliseconds(m_options.connect_timeout_ms);
+    connection->events = EPOLLOUT;
+    epoll_event ev{};
+    ev.events = connection->events;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev);
+    Connection *raw = connection.get();
+    m_connections[fd] = std::move(connection);
+    record([](HttpTransportStats &stats) { stats.connections_opened++; });
+    return raw;
+  }
+
+  void watch(Connection &c, uint32_t events) {
+    if (c.events == events) {
+      return;
+    }
+    c.events = events;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = c.fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_MOD, c.fd, &ev);
+  }
+
+  // Maps an SSL call result to "wait for this event" (EPOLLIN/EPOLLOUT),
+  // 0 for end of stream, or -1 for an error.
+  int ssl_wait(Connection &c, int rc) {
+    switch (SSL_get_error(c.ssl, rc)) {
+      case SSL_ERROR_WANT_READ:
+        return EPOLLIN;
+      case SSL_ERROR_WANT_WRITE:
+        return EPOLLOUT;
+      case SSL_ERROR_ZERO_RETURN:
+        return 0;
+      case SSL_ERROR_SYSCALL:
+        c.tls_ok = false;
+        return errno == 0 ? 0 : -1;
+      default:
+        c.tls_ok = false;
+        return -1;
+    }
+  }
+
+  // Advances the connection's state machine as far as the socket allows.
+  void drive(Connection &c, uint32_t ready) {
+    for (;;) {
+      switch (c.state) {
+        case State::Connecting: {
+          int err = 0;
+          socklen_t len = sizeof(err);
+          getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+          if (err == EINPROGRESS || (err == 0 && !(ready & (EPOLLOUT | EPOLLERR | EPOLLHUP)))) {
+            watch(c, EPOLLOUT);
+            return;
+          }
+          if (err != 0) {
+            forget_address();
+            fail(c, fmt::format("connect failed: {}", std::strerror(err)), false);
+            return;
+          }
+          if (m_tls) {
+            c.ssl = SSL_new(m_ssl_ctx);
+            SSL_set_fd(c.ssl, c.fd);
+            SSL_set_tlsext_host_name(c.ssl, m_host.c_str());
+            if (m_options.verify_peer) {
+              SSL_set1_host(c.ssl, m_host.c_str());
+            }
+            if (m_session) {
+              SSL_set_session(c.ssl, m_session);
+            }
+            SSL_set_connect_state(c.ssl);
+            c.state = State::Handshake;
+          } else if (!on_connected(c)) {
+            return;
+          }
+          break;
+        }
+        case State::Handshake: {
+          ERR_clear_error();
+          const int rc = SSL_do_handshake(c.ssl);
+          if (rc == 1) {
+            if (!on_connected(c)) {
+              return;
+            }
+            break;
+          }
+          const int wait = ssl_wait(c, rc);
+          if (wait <= 0) {
+            fail(c, "tls handshake failed: " + ssl_error_string(), false);
+            return;
+          }
+          watch(c, static_cast<uint32_t>(wait));
+          return;
+        }
+        case State::Idle: {
+          if ((ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !idle_alive(c)) {
+            close_connection(c);
+            record([](HttpTransportStats &stats) { stats.idle_closed++; });
+          }
+          return;
+        }
+        case State::Writing: {
+          while (c.out_pos < c.out.size()) {
+            const char *data = c.out.data() + c.out_pos;
+            const size_t size = c.out.size() - c.out_pos;
+            if (c.ssl) {
+              ERR_clear_error();
+              const int rc = SSL_write(c.ssl, data, static_cast<int>(size));
+              if (rc <= 0) {
+                const int wait = ssl_wait(c, rc);
+                if (wait <= 0) {
+                  fail(c, "tls write failed: " + ssl_error_string(), true);
+                  return;
+                }
+                watch(c, static_cast<uint32_t>(wait));
+                return;
+              }
+              c.out_pos += static_cast<size_t>(rc);
+            } else {
+              const ssize_t rc = send(c.fd, data, size, MSG_NOSIGNAL);
+              if (rc < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                  watch(c, EPOLLOUT);
+                  return;
+                }
+                fail(c, fmt::format("write failed: {}", std::strerror(errno)), true);
+                return;
+              }
+              c.out_pos += static_cast<size_t>(rc);
+            }
+          }
+          c.state = State::Reading;
+          break;
+        }
+        case State::Reading: {
+          char buf[kReadChunk];
+          for (;;) {
+            ssize_t rc = 0;
+            if (c.ssl) {
+              ERR_clear_error();
+              const int n = SSL_read(c.ssl, buf, sizeof(buf));
+              if (n <= 0) {
+                const int wait = ssl_wait(c, n);
+                if (wait < 0) {
+                  fail(c, "tls read failed: " + ssl_error_string(), true);
+                  return;
+                }
+                if (wait > 0) {
+                  watch(c, static_cast<uint32_t>(wait));
+                  return;
+                }
+                rc = 0;
+              } else {
+                rc = n;
+              }
+            } else {
+              rc = recv(c.fd, buf, sizeof(buf), 0);
+              if (rc < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                  watch(c, EPOLLIN);
+                  return;
+                }
+                fail(c, fmt::format("read failed: {}", std::strerror(errno)), true);
+                return;
+              }
+            }
+            if (rc == 0) {
+              if (c.parser.finish() == ResponseParser::Status::Done) {
+                complete(c, false);
+              } else {
+                fail(c, c.parser.error(), true);
+              }
+              return;
+            }
+            c.got_bytes = true;
+            const auto status = c.parser.feed(buf, static_cast<size_t>(rc));
+            if (status == ResponseParser::Status::Error) {
+              fail(c, c.parser.error(), false);
+              return;
+            }
+            if (status == ResponseParser::Status::Done) {
+              complete(c, c.parser.keep_alive());
+              return;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Returns false when there is nothing to send yet.
+  bool on_connected(Connection &c) {
+    const double setup_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - c.opened_at).count();
+    const bool resumed = c.ssl && SSL_session_reused(c.ssl);
+    c.tls_ok = c.ssl != nullptr;
+    record([&](HttpTransportStats &stats) {
+      stats.handshakes++;
+      stats.resumed_handshakes += resumed ? 1 : 0;
+      stats.handshake_ms += setup_ms;
+    });
+    if (!c.has_request) {
+      park(c);
+      return false;
+    }
+    c.state = State::Writing;
+    c.deadline = Clock::now() + std::chrono::milliseconds(m_options.request_timeout_ms);
+    return true;
+  }
+
+  void park(Connection &c) {
+    c.state = State::Idle;
+    c.deadline = m_options.max_idle_ms > 0
+                     ? Clock::now() + std::chrono::milliseconds(m_options.max_idle_ms)
+                     : Clock::time_point::max();
+    watch(c, EPOLLIN | EPOLLRDHUP);
+    m_idle.push_back(c.fd);
+  }
+
+  // An idle connection should have nothing to read: EOF or stray bytes
+  // mean it cannot carry another request. TLS records that are not
+  // application data (session tickets, key updates) are consumed here.
+  bool idle_alive(Connection &c) {
+    char byte;
+    if (c.ssl) {
+      ERR_clear_error();
+      const int rc = SSL_read(c.ssl, &byte, 1);
+      return rc <= 0 && ssl_wait(c, rc) > 0;
+    }
+    const ssize_t rc = recv(c.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+
+  void complete(Connection &c, bool keep_alive) {
+    Request request = std::move(c.request);
+    c.has_request = false;
+    HttpResponse response = c.parser.take();
+    c.served++;
+    const double request_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - c.taken_at).count();
+    const uint64_t served = c.served;
+    if (keep_alive) {
+      park(c);
+    } else {
+      close_connection(c);
+    }
+    record([&](HttpTransportStats &stats) {
+      stats.requests++;
+      stats.reused += served > 1 ? 1 : 0;
+      stats.request_ms += request_ms;
+      stats.max_requests_per_connection = std::max(stats.max_requests_per_connection, served);
+    });
+    request.done(std::move(response));
+  }
+
+  // A request that failed on a reused keep-alive connection before any
+  // response byte arrived is sent once more on another connection: the
+  // server may have closed it just as it was picked.
+  void fail(Connection &c, const std::string &error, bool retryable) {
+    if (c.has_request) {
+      Request request = std::move(c.request);
+      c.has_request = false;
+      const bool stale = retryable && c.served > 0 && !c.got_bytes && !request.retried;
+      close_connection(c);
+      if (stale) {
+        request.retried = true;
+        m_pending.push_front(std::move(request));
+        return;
+      }
+      complete_error(std::move(request), error);
+      return;
+    }
+    close_connection(c);
+  }
+
+  void complete_error(Request request, const std::string &error) {
+    record([](HttpTransportStats &stats) { stats.requests++; });
+    HttpResponse response;
+    response.error = error.empty() ? "request failed" : error;
+    request.done(std::move(response));
+  }
+
+  // Invalidates c.
+  void close_connection(Connection &c) {
+    const int fd = c.fd;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    if (c.ssl) {
+      // Without a close_notify OpenSSL marks the session, which m_session
+      // shares, as not resumable.
+      if (c.tls_ok) {
+        ERR_clear_error();
+        SSL_shutdown(c.ssl);
+      }
+      SSL_free(c.ssl);
+    }
+    close(fd);
+    m_idle.erase(std::remove(m_idle.begin(), m_idle.end(), fd), m_idle.end());
+    m_connections.erase(fd);
+    record([](HttpTransportStats &) {});
+  }
+
+  void shutdown() {
+    std::vector<int> fds;
+    for (const auto &entry : m_connections) {
+      fds.push_back(entry.first);
+    }
+    for (const int fd : fds) {
+      auto it = m_connections.find(fd);
+      if (it != m_connections.end()) {
+        fail(*it->second, "transport stopped", false);
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (auto &request : m_submitted) {
+        m_pending.push_back(std::move(request));
+      }
+      m_submitted.clear();
+    }
+    while (!m_pending.empty()) {
+      complete_error(std::move(m_pending.front()), "transport stopped");
+      m_pending.pop_front();
+    }
+  }
+
+  HttpTransportOptions m_options;
+  bool m_tls = false;
+  std::string m_host;
+  std::string m_port;
+  std::string m_host_header;
+  SSL_CTX *m_ssl_ctx = nullptr;
+  int m_epoll = -1;
+  int m_wake = -1;
+  std::thread m_loop;
+
+  std::mutex m_mutex;
+  std::vector<Request> m_submitted;
+  bool m_stopping = false;
+  std::optional<Resolved> m_resolved;
+
+  mutable std::mutex m_stats_mutex;
+  HttpTransportStats m_stats;
+
+  // Loop thread only.
+  std::thread m_resolver;
+  bool m_resolving = false;
+  sockaddr_storage m_addr{};
+  socklen_t m_addr_len = 0;
+  int m_family = AF_INET;
+  std::deque<Request> m_pending;
+  std::unordered_map<int, std::unique_ptr<Connection>> m_connections;
+  std::vector<int> m_idle;
+  SSL_SESSION *m_session = nullptr;
+};
+
+}
+
+std::unique_ptr<HttpTransport> make_epoll_transport(const HttpTransportOptions &options) {
+  return std::make_unique<EpollTransport>(options);
+}
@@ -0,0 +1,147 @@
+#include "http_transport.hpp"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <httplib.h>
+
+namespace {
+
+std::string lower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return s;
+}
+
+using Clock = std::chrono::steady_clock;
+
+class BlockingTransport : public HttpTransport {
+public:
+  explicit BlockingTransport(const HttpTransportOptions &options)
+      : m_options(options) {}
+
+  void get_async(const std::string &path, const Headers &headers, Callback done) override {
+    done(get(path, headers));
+  }
+
+  HttpResponse get(const std::string &path, const Headers &headers) override {
+    const auto started = Clock::now();
+    PooledClient pooled = acquire(started);
+    const httplib::Headers request_headers(headers.begin(), headers.end());
+    auto result = pooled.client->Get(path, request_headers);
+    HttpResponse response;
+    if (result) {
+      response.status = result->status;
+      response.body = std::move(result->body);
+      for (const auto &header : result->headers) {
+        response.headers[lower(header.first)] = header.second;
+      }
+    } else {
+      response.error = httplib::to_string(result.error());
+    }
+    const auto finished = Clock::now();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stats.requests++;
+      m_stats.reused += pooled.requests > 0 ? 1 : 0;
+      m_stats.request_ms += std::chrono::duration<double, std::milli>(finished - started).count();
+      pooled.requests++;
+      m_stats.max_requests_per_connection =
+          std::max(m_stats.max_requests_per_connection, pooled.requests);
+      if (result) {
+        pooled.idle_since = finished;
+        m_idle.push_back(std::move(pooled));
+      } else {
+        // The client's socket state is unknown after a transport error.
+        m_open--;
+      }
+    }
+    m_free_cv.notify_one();
+    return response;
+  }
+
+  const char *name() const override { return "blocking"; }
+
+  HttpTransportStats stats() const override {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    HttpTransportStats stats = m_stats;
+    stats.open_connections = m_open;
+    stats.idle_connections = m_idle.size();
+    return stats;
+  }
+
+private:
+  struct PooledClient {
+    std::unique_ptr<httplib::Client> client;
+    Clock::time_point idle_since;
+    uint64_t requests = 0;
+  };
+
+  // Drops clients idle past max_idle_ms, then hands out the most recently
+  // used one so that spare clients are the ones that age out. With
+  // max_connections clients open and none idle, waits for one to return.
+  PooledClient acquire(Clock::time_point now) {
+    std::vector<PooledClient> expired;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      const size_t limit = static_cast<size_t>(std::max(1, m_options.max_connections));
+      m_free_cv.wait(lock, [this, limit] { return !m_idle.empty() || m_open < limit; });
+      while (m_options.max_idle_ms > 0 && !m_idle.empty() &&
+             now - m_idle.front().idle_since > std::chrono::milliseconds(m_options.max_idle_ms)) {
+        expired.push_back(std::move(m_idle.front()));
+        m_idle.pop_front();
+        m_stats.idle_expired++;
+        m_open--;
+      }
+      if (!m_idle.empty()) {
+        PooledClient pooled = std::move(m_idle.back());
+        m_idle.pop_back();
+        return pooled;
+      }
+      m_stats.connections_opened++;
+      m_open++;
+    }
+    PooledClient pooled;
+    pooled.client = std::make_unique<httplib::Client>(m_options.base_url);
+    auto &client = *pooled.client;
+    client.set_connection_timeout(m_options.connect_timeout_ms / 1000,
+                                  (m_options.connect_timeout_ms % 1000) * 1000);
+    client.set_read_timeout(m_options.request_timeout_ms / 1000,
+                            (m_options.request_timeout_ms % 1000) * 1000);
+    client.set_write_timeout(m_options.request_timeout_ms / 1000,
+                             (m_options.request_timeout_ms % 1000) * 1000);
+    client.enable_server_hostname_verification(m_options.verify_peer);
+    client.enable_server_certificate_verification(m_options.verify_peer);
+    client.set_keep_alive(true);
+    return pooled;
+  }
+
+  HttpTransportOptions m_options;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_free_cv;
+  // Ordered by release time, oldest first.
+  std::deque<PooledClient> m_idle;
+  size_t m_open = 0;
+  HttpTransportStats m_stats;
+};
+
+}
+
+HttpResponse HttpTransport::get(const std::string &path, const Headers &headers) {
+  std::promise<HttpResponse> promise;
+  std::future<HttpResponse> future = promise.get_future();
+  get_async(path, headers, [&promise](HttpResponse response) {
+    promise.set_value(std::move(response));
+  });
+  return future.get();
+}
+
+std::unique_ptr<HttpTransport> make_blocking_transport(const HttpTransportOptions &options) {
+  return std::make_unique<BlockingTransport>(options);
+}
@@ -39,6 +39,8 @@ MainWindow::MainWindow(QWidget* parent)
    , m_requestMinIntervalSpin(nullptr)
    , m_requestJitterSpin(nullptr)
    , m_cooldown429Spin(nullptr)
+   , m_crawlWorkersSpin(nullptr)
+   , m_adaptiveRateCheck(nullptr)
    , m_requestProfileCombo(nullptr)
    , m_logLevelCombo(nullptr)
    , m_cookiePathLabel(nullptr)
@@ -49,6 +51,13 @@ MainWindow::MainWindow(QWidget* parent)
    , m_monitor429Label(nullptr)
    , m_monitorQueueLabel(nullptr)
    , m_monitorCurrentUidLabel(nullptr)
+   , m_monitorProfileCacheLabel(nullptr)
+   , m_monitorPipelineLabel(nullptr)
+   , m_monitorRateLabel(nullptr)
+   , m_monitorEndpointsLabel(nullptr)
+   , m_monitorPacingLabel(nullptr)
+   , m_monitorSessionsLabel(nullptr)
+   , m_monitorConnectionsLabel(nullptr)
    , m_downloadTable(nullptr)
    , m_downloadTaskSeq(0) {
   m_imageClient = std::make_unique<httplib::Client>(m_appConfig.image_host);
@@ -64,6 +64,14 @@ void MainWindow::onUserFetched(uint64_t uid, const QString& name, const QList<ui
   addUserNode(uid, name, followers, fans);
 }
 
+void MainWindow::addRestoredUsers(const std::vector<UserRelations>& users) {
+  for (const auto& user : users) {
+    QList<uint64_t> followersList(user.followers.begin(), user.followers.end());
+    QList<uint64_t> fansList(user.fans.begin(), user.fans.end());
+    addUserNode(user.uid, QString::fromStdString(user.username), followersList, fansList);
+  }
+}
+
 void MainWindow::onWeiboFetched(uint64_t uid, const QString& weiboText) {
   WeiboData data;
   data.text = weiboText;
@@ -109,6 +117,68 @@ void MainWindow::onMetricsUpdated(qulonglong usersProcessed,
   }
 }
 
+void MainWindow::onProfileCacheUpdated(qulonglong hits, qulonglong misses) {
+  if (m_monitorProfileCacheLabel) {
+    m_monitorProfileCacheLabel->setText(
+        QString("Profile cache: hits=%1 misses=%2")
+            .arg(hits)
+            .arg(misses));
+  }
+}
+
+void MainWindow::onPipelineUpdated(qulonglong persistQueueDepth,
+                                   qulonglong fetchStallMs,
+                                   qulonglong persistIdleMs) {
+  if (m_monitorPipelineLabel) {
+    m_monitorPipelineLabel->setText(
+        QString("Pipeline: persist queue=%1 fetch stall=%2ms persist idle=%3ms")
+            .arg(persistQueueDepth)
+            .arg(fetchStallMs)
+            .arg(persistIdleMs));
+  }
+}
+
+void MainWindow::onRequestRateUpdated(double requestsPerSecond) {
+  if (m_monitorRateLabel) {
+    m_monitorRateLabel->setText(
+        QString("Request rate: %1 req/s").arg(requestsPerSecond, 0, 'f', 2));
+  }
+}
+
+void MainWindow::onEndpointRatesUpdated(const QString& summary) {
+  if (m_monitorEndpointsLabel) {
+    m_monitorEndpointsLabel->setText(QString("Endpoints: %1").arg(summary));
+  }
+}
+
+void MainWindow::onSessionsUpdated(const QString& summary) {
+  if (m_monitorSessionsLabel) {
+    m_monitorSessionsLabel->setText(QString("Sessions: %1").arg(summary));
+  }
+}
+
+void MainWindow::onConnectionsUpdated(const QString& summary) {
+  if (m_monitorConnectionsLabel) {
+    m_monitorConnectionsLabel->setText(QString("Connections: %1").arg(summary));
+  }
+}
+
+void MainWindow::onPacingUpdated(qulonglong spacingMs,
+                                 qulonglong jitterMs,
+                                 qulonglong cooldownMs,
+                                 qulonglong pauseMs,
+                                 qulonglong backoffMs) {
+  if (m_monitorPacingLabel) {
+    m_monitorPacingLabel->setText(
+        QString("Waits: spacing=%1s jitter=%2s cooldown=%3s pause=%4s backoff=%5s")
+            .arg(spacingMs / 1000)
+            .arg(jitterMs / 1000)
+            .arg(cooldownMs / 1000)
+            .arg(pauseMs / 1000)
+            .arg(backoffMs / 1000));
+  }
+}
+
 void MainWindow::runSpider() {
   syncSettingsUiToAppConfig();
   m_appConfig.save();
@@ -118,9 +188,10 @@ void MainWindow::runSpider() {
   bool crawlFans = m_crawlFansCheck->isChecked();
   bool crawlFollowers = m_crawlFollowersCheck->isChecked();
   spdlog::info(fmt::format(
-      "run spider with uid={} depth={} retries={} base={}ms max={}ms backoff={} interval={}ms jitter={}ms cooldown429={}ms log_level={}",
+      "run spider with uid={} depth={} workers={} retries={} base={}ms max={}ms backoff={} interval={}ms jitter={}ms cooldown429={}ms log_level={}",
       m_targetUid,
       m_appConfig.crawl_max_depth,
+      m_appConfig.crawl_workers,
       m_appConfig.retry_max_attempts,
       m_appConfig.retry_base_delay_ms,
       m_appConfig.retry_max_delay_ms,
@@ -143,6 +214,7 @@ void MainWindow::runSpider() {
       m_spider->setCrawlFans(crawlFans);
       m_spider->setCrawlFollowers(crawlFollowers);
       m_spider->setMaxDepth(m_appConfig.crawl_max_depth);
+      m_spider->setWorkerCount(m_appConfig.crawl_workers);
       m_spider->setUserCallback([this](uint64_t uid, const std::string& name,
                                        const std::vector<uint64_t>& followers,
                                        const std::vector<uint64_t>& fans) {
@@ -156,26 +228,76 @@ void MainWindow::runSpider() {
                                   Q_ARG(QList<uint64_t>, followersList),
                                   Q_ARG(QList<uint64_t>, fansList));
       });
+      // Resume restores thousands of users; hop to the UI thread once per batch.
+      m_spider->setUserBatchCallback([this](const std::vector<UserRelations>& users) {
+        QMetaObject::invokeMethod(this, [this, &users]() { addRestoredUsers(users); },
+                                  Qt::BlockingQueuedConnection);
+      });
 
-      m_spider->setMetricsCallback([this](uint64_t usersProcessed,
-                                          uint64_t usersFailed,
-                                          uint64_t requestsTotal,
-                                          uint64_t requestsFailed,
-                                          uint64_t retriesTotal,
-                                          uint64_t http429Count,
-                                          uint64_t queuePending,
-                                          uint64_t visitedTotal,
-                                          uint64_t currentUid) {
+      m_spider->setMetricsCallback([this](const SpiderMetrics& metrics) {
         QMetaObject::invokeMethod(this, "onMetricsUpdated", Qt::QueuedConnection,
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(usersProcessed)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(usersFailed)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(requestsTotal)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(requestsFailed)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(retriesTotal)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(http429Count)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(queuePending)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(visitedTotal)),
-                                  Q_ARG(qulonglong, static_cast<qulonglong>(currentUid)));
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.users_processed)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.users_failed)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.requests_total)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.requests_failed)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.retries_total)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.http_429_count)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.queue_pending)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.visited_total)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.current_uid)));
+        QMetaObject::invokeMethod(this, "onProfileCacheUpdated", Qt::QueuedConnection,
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.profile_cache_hits)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.profile_cache_misses)));
+        QMetaObject::invokeMethod(this, "onPipelineUpdated", Qt::QueuedConnection,
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.persist_queue_depth)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.fetch_stall_ms)),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.persist_idle_ms)));
+        QMetaObject::invokeMethod(this, "onRequestRateUpdated", Qt::QueuedConnection,
+                                  Q_ARG(double, metrics.request_rate_rps));
+        QStringList endpoints;
+        qulonglong spacingMs = 0, jitterMs = 0, cooldownMs = 0, pauseMs = 0;
+        for (const auto& endpoint : metrics.endpoints) {
+          spacingMs += endpoint.spacing_wait_ms;
+          jitterMs += endpoint.jitter_wait_ms;
+          cooldownMs += endpoint.cooldown_wait_ms;
+          pauseMs += endpoint.pause_wait_ms;
+          endpoints << QString("%1 %2/s wait=%3ms 429=%4")
+                           .arg(QString::fromStdString(endpoint.name))
+                           .arg(endpoint.rate_rps, 0, 'f', 2)
+                           .arg(static_cast<qulonglong>(endpoint.wait_ms))
+                           .arg(static_cast<qulonglong>(endpoint.throttled));
+        }
+        QMetaObject::invokeMethod(this, "onEndpointRatesUpdated", Qt::QueuedConnection,
+                                  Q_ARG(QString, endpoints.join("; ")));
+        QMetaObject::invokeMethod(this, "onPacingUpdated", Qt::QueuedConnection,
+                                  Q_ARG(qulonglong, spacingMs),
+                                  Q_ARG(qulonglong, jitterMs),
+                                  Q_ARG(qulonglong, cooldownMs),
+                                  Q_ARG(qulonglong, pauseMs),
+                                  Q_ARG(qulonglong, static_cast<qulonglong>(metrics.retry_backoff_ms)));
+        QStringList sessions;
+        for (const auto& session : metrics.sessions) {
+          sessions << QString("%1 %2 req=%3 429=%4")
+                          .arg(QString::fromStdString(session.name))
+                          .arg(session.quarantined ? "quarantined" : "ok")
+                          .arg(static_cast<qulonglong>(session.requests))
+                          .arg(static_cast<qulonglong>(session.throttled));
+        }
+        QMetaObject::invokeMethod(this, "onSessionsUpdated", Qt::QueuedConnection,
+                                  Q_ARG(QString, sessions.join("; ")));
+        const HttpTransportStats& http = metrics.http;
+        const QString connections =
+            QString("open=%1 idle=%2 reused=%3/%4 handshakes=%5 (%6 resumed) %7ms, %8% of request time")
+                .arg(static_cast<qulonglong>(http.open_connections))
+                .arg(static_cast<qulonglong>(http.idle_connections))
+                .arg(static_cast<qulonglong>(http.reused))
+                .arg(static_cast<qulonglong>(http.requests))
+                .arg(static_cast<qulonglong>(http.handshakes))
+                .arg(static_cast<qulonglong>(http.resumed_handshakes))
+                .arg(http.handshake_ms, 0, 'f', 0)
+                .arg(http.request_ms > 0 ? 100.0 * http.handshake_ms / http.request_ms : 0.0, 0, 'f', 1);
+        QMetaObject::invokeMethod(this, "onConnectionsUpdated", Qt::QueuedConnection,
+                                  Q_ARG(QString, connections));
       });
 
       m_spider->setWeiboCallback([this](uint64_t uid, const std::vector<Weibo>& weibos) {
@@ -242,6 +364,12 @@ void MainWindow::syncSettingsUiToAppConfig() {
   if (m_depthSpin) {
     m_appConfig.crawl_max_depth = m_depthSpin->value();
   }
+  if (m_crawlWorkersSpin) {
+    m_appConfig.crawl_workers = m_crawlWorkersSpin->value();
+  }
+  if (m_adaptiveRateCheck) {
+    m_appConfig.request_rate_mode = m_adaptiveRateCheck->isChecked() ? "adaptive" : "static";
+  }
 
   m_appConfig.retry_max_attempts = m_retryAttemptsSpin->value();
   m_appConfig.retry_base_delay_ms = m_retryBaseDelaySpin->value();
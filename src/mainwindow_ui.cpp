@@ -479,6 +479,20 @@ void MainWindow::setupUi() {
   monitorLayout->addWidget(m_monitorQueueLabel);
   m_monitorCurrentUidLabel = createMonitorLabel("Current UID: -");
   monitorLayout->addWidget(m_monitorCurrentUidLabel);
+  m_monitorProfileCacheLabel = createMonitorLabel("Profile cache: hits=0 misses=0");
+  monitorLayout->addWidget(m_monitorProfileCacheLabel);
+  m_monitorPipelineLabel = createMonitorLabel("Pipeline: persist queue=0 fetch stall=0ms persist idle=0ms");
+  monitorLayout->addWidget(m_monitorPipelineLabel);
+  m_monitorRateLabel = createMonitorLabel("Request rate: - req/s");
+  monitorLayout->addWidget(m_monitorRateLabel);
+  m_monitorEndpointsLabel = createMonitorLabel("Endpoints: -");
+  monitorLayout->addWidget(m_monitorEndpointsLabel);
+  m_monitorPacingLabel = createMonitorLabel("Waits: spacing=0s jitter=0s cooldown=0s pause=0s backoff=0s");
+  monitorLayout->addWidget(m_monitorPacingLabel);
+  m_monitorSessionsLabel = createMonitorLabel("Sessions: -");
+  monitorLayout->addWidget(m_monitorSessionsLabel);
+  m_monitorConnectionsLabel = createMonitorLabel("Connections: -");
+  monitorLayout->addWidget(m_monitorConnectionsLabel);
   monitorLayout->addStretch();
 
   m_tabWidget->addTab(monitorTabContent, "📈 Monitor");
@@ -579,6 +593,17 @@ void MainWindow::setupUi() {
   m_cooldown429Spin->setValue(m_appConfig.cooldown_429_ms);
   antiCrawlForm->addRow("429 Cooldown", m_cooldown429Spin);
 
+  m_crawlWorkersSpin = new QSpinBox(antiCrawlGroup);
+  m_crawlWorkersSpin->setRange(1, 16);
+  m_crawlWorkersSpin->setValue(std::max(1, m_appConfig.crawl_workers));
+  m_crawlWorkersSpin->setToolTip("Parallel crawl workers sharing the per-endpoint request budgets");
+  antiCrawlForm->addRow("Crawl Workers", m_crawlWorkersSpin);
+
+  m_adaptiveRateCheck = new QCheckBox("Adapt to 429/5xx responses", antiCrawlGroup);
+  m_adaptiveRateCheck->setChecked(m_appConfig.request_rate_mode == "adaptive");
+  m_adaptiveRateCheck->setToolTip("Start at Min Interval, speed up while responses are healthy and halve the rate on 429/5xx");
+  antiCrawlForm->addRow("Adaptive Rate", m_adaptiveRateCheck);
+
   auto markProfileCustom = [this]() {
     if (!m_requestProfileCombo) {
       return;
@@ -0,0 +1,83 @@
+#include "profile_cache.hpp"
+#include <nlohmann/json.hpp>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace {
+std::string encode(const CachedProfile &profile) {
+  json j;
+  j["uid"] = profile.uid;
+  j["name"] = profile.screen_name;
+  j["followers"] = profile.followers_count;
+  j["friends"] = profile.friends_count;
+  j["statuses"] = profile.statuses_count;
+  j["t"] = profile.fetched_at;
+  return j.dump() + "\n";
+}
+
+bool decode(const std::string &line, CachedProfile *profile) {
+  const json j = json::parse(line, nullptr, false);
+  if (j.is_discarded() || !j.is_object() || !j.contains("uid") || !j["uid"].is_number_unsigned()) {
+    return false;
+  }
+  profile->uid = j["uid"].get<uint64_t>();
+  profile->screen_name = j.value("name", "");
+  profile->followers_count = j.value("followers", uint64_t{0});
+  profile->friends_count = j.value("friends", uint64_t{0});
+  profile->statuses_count = j.value("statuses", uint64_t{0});
+  profile->fetched_at = j.value("t", int64_t{0});
+  return true;
+}
+}
+
+ProfileCache::ProfileCache(std::string path, int64_t ttl_seconds)
+    : m_ttl_seconds(ttl_seconds), m_store(std::move(path), "profile cache", encode, decode) {}
+
+std::optional<CachedProfile> ProfileCache::get(uint64_t uid, int64_t now) {
+  if (now == 0) {
+    now = unix_now();
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const CachedProfile *profile = m_store.find(uid);
+  if (!profile) {
+    m_stats.misses++;
+    return std::nullopt;
+  }
+  if (now - profile->fetched_at >= m_ttl_seconds) {
+    m_stats.misses++;
+    m_stats.expired++;
+    return std::nullopt;
+  }
+  m_stats.hits++;
+  return *profile;
+}
+
+std::optional<CachedProfile> ProfileCache::peek(uint64_t uid) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const CachedProfile *profile = m_store.find(uid);
+  if (!profile) {
+    return std::nullopt;
+  }
+  return *profile;
+}
+
+void ProfileCache::put(CachedProfile profile) {
+  if (profile.fetched_at == 0) {
+    profile.fetched_at = unix_now();
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_store.put(std::move(profile));
+}
+
+void ProfileCache::flush() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_store.flush();
+}
+
+ProfileCache::Stats ProfileCache::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats = m_stats;
+  stats.entries = m_store.size();
+  return stats;
+}
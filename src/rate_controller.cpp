@@ -0,0 +1,67 @@
+#include "rate_controller.hpp"
+#include <algorithm>
+#include <cmath>
+
+RateController::RateController(const RateControllerOptions &options)
+    : m_options(options) {
+  m_options.floor_interval_ms = std::max(1, m_options.floor_interval_ms);
+  m_options.ceiling_interval_ms = std::max(m_options.floor_interval_ms, m_options.ceiling_interval_ms);
+  m_options.decrease_factor = std::clamp(m_options.decrease_factor, 0.05, 1.0);
+  m_options.increase_rps = std::max(0.0, m_options.increase_rps);
+  m_min_rps = 1000.0 / m_options.ceiling_interval_ms;
+  m_max_rps = 1000.0 / m_options.floor_interval_ms;
+  const int initial = std::max(1, m_options.initial_interval_ms);
+  m_rate_rps = std::clamp(1000.0 / initial, m_min_rps, m_max_rps);
+}
+
+RateController::Signal RateController::classify(int status, std::chrono::milliseconds latency) const {
+  if (status == 0 || status == 429 || status >= 500) {
+    return Signal::Throttled;
+  }
+  if (status < 200 || status >= 300) {
+    return Signal::Neutral;
+  }
+  if (m_options.latency_threshold_ms > 0 && latency.count() > m_options.latency_threshold_ms) {
+    return Signal::Slow;
+  }
+  return Signal::Healthy;
+}
+
+void RateController::on_response(int status,
+                                 std::chrono::milliseconds latency,
+                                 std::chrono::steady_clock::time_point now) {
+  const Signal signal = classify(status, latency);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  switch (signal) {
+    case Signal::Healthy:
+      m_rate_rps = std::min(m_max_rps, m_rate_rps + m_options.increase_rps);
+      break;
+    case Signal::Throttled:
+      if (m_decreased && now - m_last_decrease < std::chrono::milliseconds(m_options.decrease_hold_ms)) {
+        break;
+      }
+      m_rate_rps = std::max(m_min_rps, m_rate_rps * m_options.decrease_factor);
+      m_decreased = true;
+      m_last_decrease = now;
+      m_decreases++;
+      break;
+    case Signal::Slow:
+    case Signal::Neutral:
+      break;
+  }
+}
+
+double RateController::rate_rps() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_rate_rps;
+}
+
+std::chrono::milliseconds RateController::interval() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return std::chrono::milliseconds(static_cast<long long>(std::lround(1000.0 / m_rate_rps)));
+}
+
+unsigned long long RateController::decreases() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_decreases;
+}
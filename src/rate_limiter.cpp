@@ -0,0 +1,180 @@
+#include "rate_limiter.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+double interval_to_rps(int interval_ms) {
+  return 1000.0 / std::max(1, interval_ms);
+}
+
+uint64_t to_ms(RateLimitRegistry::Clock::duration d) {
+  return static_cast<uint64_t>(std::max<int64_t>(
+      0, std::chrono::duration_cast<std::chrono::milliseconds>(d).count()));
+}
+}
+
+TokenBucket::TokenBucket(double rate_rps, int burst)
+    : m_burst(std::max(1, burst)), m_tat(Clock::time_point::min()) {
+  set_rate(rate_rps);
+}
+
+TokenBucket::Clock::time_point TokenBucket::reserve(Clock::time_point now) {
+  const Clock::time_point send_at = peek(now);
+  m_tat = std::max(m_tat, send_at) + m_interval;
+  return send_at;
+}
+
+TokenBucket::Clock::time_point TokenBucket::peek(Clock::time_point now) const {
+  const Clock::duration tolerance = m_interval * (m_burst - 1);
+  if (m_tat != Clock::time_point::min() && m_tat - tolerance > now) {
+    return m_tat - tolerance;
+  }
+  return now;
+}
+
+void TokenBucket::hold_until(Clock::time_point until) {
+  // The first request after the hold goes out at until, later ones are
+  // spaced by the interval without a burst.
+  const Clock::duration tolerance = m_interval * (m_burst - 1);
+  m_tat = std::max(m_tat, until + tolerance);
+}
+
+void TokenBucket::set_rate(double rate_rps) {
+  m_rate = std::max(1e-3, rate_rps);
+  m_interval = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / m_rate));
+}
+
+void RateLimitRegistry::add(const EndpointOptions &options,
+                            const std::optional<RateControllerOptions> &adaptive) {
+  Endpoint endpoint;
+  endpoint.options = options;
+  endpoint.bucket = std::make_unique<TokenBucket>(interval_to_rps(options.min_interval_ms),
+                                                  options.burst);
+  if (adaptive) {
+    RateControllerOptions controller_options = *adaptive;
+    controller_options.initial_interval_ms = std::max(1, options.min_interval_ms);
+    endpoint.controller = std::make_unique<RateController>(controller_options);
+    endpoint.bucket->set_rate(endpoint.controller->rate_rps());
+  }
+  endpoint.stats.name = options.name;
+  endpoint.stats.rate_rps = endpoint.bucket->rate();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_endpoints.push_back(std::move(endpoint));
+}
+
+size_t RateLimitRegistry::route(const std::string &url) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_endpoints.empty()) {
+    throw std::logic_error("rate limit registry has no endpoints");
+  }
+  size_t best = m_endpoints.size();
+  size_t best_length = 0;
+  size_t fallback = m_endpoints.size() - 1;
+  bool has_fallback = false;
+  for (size_t i = 0; i < m_endpoints.size(); ++i) {
+    const std::string &prefix = m_endpoints[i].options.prefix;
+    if (prefix.empty()) {
+      if (!has_fallback) {
+        fallback = i;
+        has_fallback = true;
+      }
+      continue;
+    }
+    if (prefix.size() > best_length && url.compare(0, prefix.size(), prefix) == 0) {
+      best = i;
+      best_length = prefix.size();
+    }
+  }
+  return best < m_endpoints.size() ? best : fallback;
+}
+
+const std::string &RateLimitRegistry::name(size_t endpoint) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_endpoints.at(endpoint).options.name;
+}
+
+RateLimitRegistry::Clock::time_point RateLimitRegistry::acquire(size_t endpoint,
+                                                                std::chrono::milliseconds extra_delay,
+                                                                Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Endpoint &e = m_endpoints.at(endpoint);
+  const EndpointOptions &options = e.options;
+  if (options.pause_every > 0 && options.pause_ms > 0 && e.stats.requests > 0 &&
+      e.stats.requests % static_cast<uint64_t>(options.pause_every) == 0) {
+    e.stats.pauses++;
+    hold(e, now + std::chrono::milliseconds(options.pause_ms), HoldReason::Pause);
+  }
+  const Clock::time_point slot = e.bucket->reserve(now);
+  const Clock::time_point send_at = slot + extra_delay;
+
+  // The part of the wait inside the current hold is charged to the hold,
+  // the rest to bucket spacing.
+  Clock::duration held{0};
+  if (e.hold_reason != HoldReason::None && e.hold_until > now) {
+    held = std::min(slot, e.hold_until) - now;
+  }
+  const uint64_t held_ms = to_ms(held);
+  const uint64_t spacing_ms = to_ms(slot - now) - std::min(to_ms(slot - now), held_ms);
+  const uint64_t jitter_ms = to_ms(extra_delay);
+  if (e.hold_reason == HoldReason::Cooldown) {
+    e.stats.cooldown_wait_ms += held_ms;
+  } else if (e.hold_reason == HoldReason::Pause) {
+    e.stats.pause_wait_ms += held_ms;
+  }
+  e.stats.spacing_wait_ms += spacing_ms;
+  e.stats.jitter_wait_ms += jitter_ms;
+  e.stats.wait_ms += held_ms + spacing_ms + jitter_ms;
+  e.stats.requests++;
+  return send_at;
+}
+
+RateLimitRegistry::Clock::time_point RateLimitRegistry::next_slot(size_t endpoint,
+                                                                  Clock::time_point now) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_endpoints.at(endpoint).bucket->peek(now);
+}
+
+void RateLimitRegistry::hold_all(Clock::time_point until) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &e : m_endpoints) {
+    hold(e, until, HoldReason::Cooldown);
+  }
+}
+
+void RateLimitRegistry::hold(Endpoint &e, Clock::time_point until, HoldReason reason) {
+  e.bucket->hold_until(until);
+  if (e.hold_reason == HoldReason::None || until >= e.hold_until) {
+    e.hold_until = until;
+    e.hold_reason = reason;
+  }
+}
+
+void RateLimitRegistry::on_response(size_t endpoint,
+                                    int status,
+                                    std::chrono::milliseconds latency,
+                                    Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Endpoint &e = m_endpoints.at(endpoint);
+  if (status == 429) {
+    e.stats.throttled++;
+    if (e.options.cooldown_429_ms > 0) {
+      hold(e, now + std::chrono::milliseconds(e.options.cooldown_429_ms), HoldReason::Cooldown);
+    }
+  }
+  if (e.controller) {
+    e.controller->on_response(status, latency, now);
+    e.bucket->set_rate(e.controller->rate_rps());
+  }
+  e.stats.rate_rps = e.bucket->rate();
+}
+
+std::vector<RateLimitRegistry::EndpointStats> RateLimitRegistry::stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<EndpointStats> out;
+  out.reserve(m_endpoints.size());
+  for (const auto &e : m_endpoints) {
+    out.push_back(e.stats);
+  }
+  return out;
+}
@@ -0,0 +1,153 @@
+#include "recrawl_scheduler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <nlohmann/json.hpp>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace {
+constexpr double kSecondsPerDay = 86400.0;
+
+std::string encode(const RecrawlEntry &entry) {
+  json j;
+  j["uid"] = entry.uid;
+  j["t"] = entry.last_crawl;
+  j["posts"] = entry.posts;
+  j["exposure"] = entry.exposure_seconds;
+  j["visits"] = entry.visits;
+  return j.dump() + "\n";
+}
+
+bool decode(const std::string &line, RecrawlEntry *entry) {
+  const json j = json::parse(line, nullptr, false);
+  if (j.is_discarded() || !j.is_object() || !j.contains("uid") || !j["uid"].is_number_unsigned()) {
+    return false;
+  }
+  entry->uid = j["uid"].get<uint64_t>();
+  entry->last_crawl = j.value("t", int64_t{0});
+  entry->posts = std::max(0.0, j.value("posts", 0.0));
+  entry->exposure_seconds = std::max(0.0, j.value("exposure", 0.0));
+  entry->visits = j.value("visits", uint32_t{0});
+  return true;
+}
+}
+
+RecrawlScheduler::RecrawlScheduler(std::string path, RecrawlOptions options)
+    : m_options(options), m_store(std::move(path), "recrawl state", encode, decode) {}
+
+void RecrawlScheduler::record_visit(uint64_t uid, size_t new_posts, int64_t now) {
+  if (now == 0) {
+    now = unix_now();
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  RecrawlEntry entry;
+  entry.uid = uid;
+  if (const RecrawlEntry *known = m_store.find(uid)) {
+    entry = *known;
+    const double elapsed = static_cast<double>(std::max<int64_t>(0, now - entry.last_crawl));
+    const double decay = m_options.half_life_seconds > 0
+                             ? std::exp2(-elapsed / static_cast<double>(m_options.half_life_seconds))
+                             : 1.0;
+    entry.posts = entry.posts * decay + static_cast<double>(new_posts);
+    entry.exposure_seconds = entry.exposure_seconds * decay + elapsed;
+  }
+  entry.last_crawl = std::max(entry.last_crawl, now);
+  entry.visits++;
+  m_store.put(entry);
+}
+
+std::optional<RecrawlEntry> RecrawlScheduler::get(uint64_t uid) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const RecrawlEntry *entry = m_store.find(uid);
+  if (!entry) {
+    return std::nullopt;
+  }
+  return *entry;
+}
+
+double RecrawlScheduler::posts_per_day(uint64_t uid) const {
+  RecrawlEntry entry;
+  if (auto found = get(uid)) {
+    entry = *found;
+  }
+  return rate_per_second(entry) * kSecondsPerDay;
+}
+
+double RecrawlScheduler::rate_per_second(const RecrawlEntry &entry) const {
+  const double exposure = std::max(1.0, m_options.prior_seconds + entry.exposure_seconds);
+  return std::max(0.0, m_options.prior_posts + entry.posts) / exposure;
+}
+
+int64_t RecrawlScheduler::due_at(const RecrawlEntry &entry) const {
+  const int64_t min_interval = std::max<int64_t>(0, m_options.min_interval_seconds);
+  const int64_t max_interval = std::max(min_interval, m_options.max_interval_seconds);
+  const double p = std::clamp(m_options.due_probability, 1e-6, 1.0 - 1e-6);
+  const double rate = rate_per_second(entry);
+  // 1 - exp(-rate * t) = p
+  const double interval = rate > 0.0 ? -std::log1p(-p) / rate : static_cast<double>(max_interval);
+  const int64_t clamped = interval >= static_cast<double>(max_interval)
+                              ? max_interval
+                              : std::max(min_interval, static_cast<int64_t>(interval));
+  return entry.last_crawl + clamped;
+}
+
+std::vector<RecrawlCandidate> RecrawlScheduler::plan(int64_t window_seconds, size_t limit, int64_t now) const {
+  if (now == 0) {
+    now = unix_now();
+  }
+  const int64_t horizon = now + std::max<int64_t>(0, window_seconds);
+  std::vector<RecrawlCandidate> candidates;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &[uid, entry] : m_store.entries()) {
+      const int64_t due = due_at(entry);
+      if (due > horizon) {
+        continue;
+      }
+      const double rate = rate_per_second(entry);
+      RecrawlCandidate candidate;
+      candidate.uid = uid;
+      candidate.last_crawl = entry.last_crawl;
+      candidate.due_at = due;
+      candidate.posts_per_day = rate * kSecondsPerDay;
+      candidate.expected_posts = rate * static_cast<double>(std::max<int64_t>(0, horizon - entry.last_crawl));
+      candidates.push_back(candidate);
+    }
+  }
+  auto before = [](const RecrawlCandidate &a, const RecrawlCandidate &b) {
+    if (a.expected_posts != b.expected_posts) {
+      return a.expected_posts > b.expected_posts;
+    }
+    return a.uid < b.uid;
+  };
+  if (limit > 0 && candidates.size() > limit) {
+    std::partial_sort(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(limit),
+                      candidates.end(), before);
+    candidates.resize(limit);
+  } else {
+    std::sort(candidates.begin(), candidates.end(), before);
+  }
+  return candidates;
+}
+
+RecrawlScheduler::Stats RecrawlScheduler::stats(int64_t now) const {
+  if (now == 0) {
+    now = unix_now();
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats;
+  stats.users = m_store.size();
+  for (const auto &[uid, entry] : m_store.entries()) {
+    (void)uid;
+    if (due_at(entry) <= now) {
+      stats.due++;
+    }
+  }
+  return stats;
+}
+
+void RecrawlScheduler::flush() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_store.flush();
+}
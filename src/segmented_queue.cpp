@@ -0,0 +1,375 @@
+#include "segmented_queue.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kSegmentMagic[4] = {'S', 'E', 'G', 'Q'};
+constexpr uint32_t kSegmentVersion = 1;
+// magic, version, u64 count, u64 capacity, u64 reserved.
+constexpr size_t kHeaderBytes = 32;
+constexpr size_t kCountOffset = 8;
+constexpr size_t kCapacityOffset = 16;
+constexpr const char *kSegmentPrefix = "seg-";
+constexpr const char *kSegmentSuffix = ".q";
+constexpr size_t kReadChunkEntries = 8192;
+
+uint64_t *count_ptr(char *map) {
+  return reinterpret_cast<uint64_t *>(map + kCountOffset);
+}
+
+uint64_t *data_ptr(char *map) {
+  return reinterpret_cast<uint64_t *>(map + kHeaderBytes);
+}
+}
+
+SegmentedQueue::SegmentedQueue(std::string dir, size_t segment_entries)
+    : m_dir(std::move(dir)),
+      m_segment_entries(std::max<size_t>(segment_entries, 16)),
+      m_segment_bytes(kHeaderBytes + m_segment_entries * sizeof(uint64_t)) {
+  std::error_code ec;
+  fs::create_directories(m_dir, ec);
+  if (ec) {
+    throw std::runtime_error(fmt::format("failed to create frontier dir {}: {}", m_dir, ec.message()));
+  }
+  open_existing();
+}
+
+SegmentedQueue::~SegmentedQueue() {
+  for (auto &entry : m_mapped) {
+    ::munmap(entry.second.map, entry.second.map_bytes);
+    ::close(entry.second.fd);
+  }
+}
+
+void SegmentedQueue::push(uint64_t value) {
+  if (m_seqs.empty()) {
+    map_segment(m_next_seq, true);
+    m_seqs.push_back(m_next_seq++);
+  }
+  Segment *tail = &map_segment(m_seqs.back(), false);
+  const uint64_t capacity = (tail->map_bytes - kHeaderBytes) / sizeof(uint64_t);
+  if (*count_ptr(tail->map) >= capacity) {
+    tail = &map_segment(m_next_seq, true);
+    m_seqs.push_back(m_next_seq++);
+  }
+  uint64_t *count = count_ptr(tail->map);
+  data_ptr(tail->map)[*count] = value;
+  // Publish the entry only after it is written.
+  *count += 1;
+  m_pending++;
+  if (m_dirty_seq != m_seqs.back()) {
+    m_dirty_seq = m_seqs.back();
+    m_dirty.push_back(tail->path);
+  }
+  release_idle_segments();
+}
+
+bool SegmentedQueue::pop(uint64_t *value) {
+  while (!m_seqs.empty()) {
+    const uint64_t seq = m_seqs.front();
+    Segment &head = map_segment(seq, false);
+    if (m_head_pos < *count_ptr(head.map)) {
+      const uint64_t entry = data_ptr(head.map)[m_head_pos++];
+      if (value) {
+        *value = entry;
+      }
+      m_pending--;
+      return true;
+    }
+    if (m_seqs.size() == 1) {
+      return false;
+    }
+    // Only the tail can be partially filled, so this head is exhausted.
+    m_consumed.push_back(head.path);
+    unmap_segment(seq);
+    m_seqs.pop_front();
+    m_head_pos = 0;
+  }
+  return false;
+}
+
+void SegmentedQueue::Commit::merge(Commit newer) {
+  head_path = std::move(newer.head_path);
+  seq = newer.seq;
+  pos = newer.pos;
+  head_changed = head_changed || newer.head_changed;
+  consumed.insert(consumed.end(),
+                  std::make_move_iterator(newer.consumed.begin()),
+                  std::make_move_iterator(newer.consumed.end()));
+  for (auto &path : newer.dirty) {
+    if (std::find(dirty.begin(), dirty.end(), path) == dirty.end()) {
+      dirty.push_back(std::move(path));
+    }
+  }
+}
+
+SegmentedQueue::Commit SegmentedQueue::prepare_commit() {
+  Commit commit;
+  commit.head_path = head_path();
+  commit.seq = m_seqs.empty() ? m_next_seq : m_seqs.front();
+  commit.pos = m_head_pos;
+  commit.head_changed = commit.seq != m_committed_seq || commit.pos != m_committed_pos;
+  commit.consumed.swap(m_consumed);
+  commit.dirty.swap(m_dirty);
+  m_dirty_seq = 0;
+  m_committed_seq = commit.seq;
+  m_committed_pos = commit.pos;
+  return commit;
+}
+
+void SegmentedQueue::apply_commit(const Commit &commit) {
+  if (commit.head_changed) {
+    const std::string tmp = commit.head_path + ".tmp";
+    {
+      std::ofstream ofs(tmp, std::ios::trunc);
+      ofs << commit.seq << " " << commit.pos << "\n";
+      if (!ofs) {
+        spdlog::warn(fmt::format("failed to write frontier head {}", tmp));
+        return;
+      }
+    }
+    std::error_code ec;
+    fs::rename(tmp, commit.head_path, ec);
+    if (ec) {
+      spdlog::warn(fmt::format("failed to commit frontier head {}: {}", commit.head_path, ec.message()));
+      return;
+    }
+  }
+  // Safe to delete only once the head file no longer points at them.
+  for (const auto &path : commit.consumed) {
+    std::remove(path.c_str());
+  }
+}
+
+void SegmentedQueue::sync_segments(const std::vector<std::string> &paths) {
+  for (const auto &path : paths) {
+    const int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+      // Already consumed and deleted.
+      continue;
+    }
+    if (::fdatasync(fd) != 0) {
+      spdlog::warn(fmt::format("failed to sync frontier segment {}", path));
+    }
+    ::close(fd);
+  }
+}
+
+void SegmentedQueue::sync() {
+  for (auto &entry : m_mapped) {
+    ::msync(entry.second.map, entry.second.map_bytes, MS_SYNC);
+  }
+}
+
+void SegmentedQueue::clear() {
+  for (auto &entry : m_mapped) {
+    ::munmap(entry.second.map, entry.second.map_bytes);
+    ::close(entry.second.fd);
+  }
+  m_mapped.clear();
+  for (const uint64_t seq : m_seqs) {
+    std::remove(segment_path(seq).c_str());
+  }
+  for (const auto &path : m_consumed) {
+    std::remove(path.c_str());
+  }
+  std::remove(head_path().c_str());
+  m_seqs.clear();
+  m_consumed.clear();
+  m_dirty.clear();
+  m_dirty_seq = 0;
+  m_next_seq = 1;
+  m_head_pos = 0;
+  m_committed_seq = 0;
+  m_committed_pos = 0;
+  m_pending = 0;
+}
+
+void SegmentedQueue::for_each(const std::function<void(uint64_t)> &fn) const {
+  std::vector<uint64_t> buffer(kReadChunkEntries);
+  for (const uint64_t seq : m_seqs) {
+    const uint64_t count = read_count(seq);
+    uint64_t pos = seq == m_seqs.front() ? m_head_pos : 0;
+    const int fd = ::open(segment_path(seq).c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(fmt::format("failed to open frontier segment {}", segment_path(seq)));
+    }
+    while (pos < count) {
+      const size_t n = static_cast<size_t>(std::min<uint64_t>(count - pos, buffer.size()));
+      const ssize_t got = ::pread(fd,
+                                  buffer.data(),
+                                  n * sizeof(uint64_t),
+                                  static_cast<off_t>(kHeaderBytes + pos * sizeof(uint64_t)));
+      if (got != static_cast<ssize_t>(n * sizeof(uint64_t))) {
+        ::close(fd);
+        throw std::runtime_error(fmt::format("short read on frontier segment {}", segment_path(seq)));
+      }
+      std::for_each(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(n), fn);
+      pos += n;
+    }
+    ::close(fd);
+  }
+}
+
+size_t SegmentedQueue::mapped_bytes() const {
+  size_t total = 0;
+  for (const auto &entry : m_mapped) {
+    total += entry.second.map_bytes;
+  }
+  return total;
+}
+
+std::string SegmentedQueue::segment_path(uint64_t seq) const {
+  return (fs::path(m_dir) / fmt::format("{}{:010}{}", kSegmentPrefix, seq, kSegmentSuffix)).string();
+}
+
+std::string SegmentedQueue::head_path() const {
+  return (fs::path(m_dir) / "head").string();
+}
+
+void SegmentedQueue::open_existing() {
+  std::vector<uint64_t> found;
+  for (const auto &entry : fs::directory_iterator(m_dir)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind(kSegmentPrefix, 0) != 0 || entry.path().extension() != kSegmentSuffix) {
+      continue;
+    }
+    try {
+      found.push_back(std::stoull(name.substr(std::strlen(kSegmentPrefix))));
+    } catch (const std::exception &) {
+      spdlog::warn(fmt::format("ignore unexpected file in frontier dir: {}", name));
+    }
+  }
+  std::sort(found.begin(), found.end());
+
+  uint64_t head_seq = found.empty() ? 1 : found.front();
+  uint64_t head_pos = 0;
+  std::ifstream head(head_path());
+  if (head >> head_seq >> head_pos) {
+    m_committed_seq = head_seq;
+    m_committed_pos = head_pos;
+  }
+
+  uint64_t total = 0;
+  for (const uint64_t seq : found) {
+    if (seq < head_seq) {
+      // Consumed before the last commit but not yet deleted.
+      std::remove(segment_path(seq).c_str());
+      continue;
+    }
+    m_seqs.push_back(seq);
+    total += read_count(seq);
+  }
+  m_next_seq = std::max(head_seq, found.empty() ? uint64_t{1} : found.back() + 1);
+  m_head_pos = (!m_seqs.empty() && m_seqs.front() == head_seq) ? head_pos : 0;
+  m_pending = static_cast<size_t>(total - std::min(total, m_head_pos));
+  if (!m_seqs.empty()) {
+    spdlog::info(fmt::format(
+        "frontier segments reopened from {}: {} segments, {} pending",
+        m_dir,
+        m_seqs.size(),
+        m_pending));
+  }
+}
+
+SegmentedQueue::Segment &SegmentedQueue::map_segment(uint64_t seq, bool create) {
+  auto it = m_mapped.find(seq);
+  if (it != m_mapped.end()) {
+    return it->second;
+  }
+  Segment segment;
+  segment.path = segment_path(seq);
+  segment.fd = ::open(segment.path.c_str(), O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0644);
+  if (segment.fd < 0) {
+    throw std::runtime_error(fmt::format("failed to open frontier segment {}", segment.path));
+  }
+  uint64_t capacity = m_segment_entries;
+  if (create) {
+    if (::ftruncate(segment.fd, static_cast<off_t>(m_segment_bytes)) != 0) {
+      ::close(segment.fd);
+      throw std::runtime_error(fmt::format("failed to size frontier segment {}", segment.path));
+    }
+  } else if (::pread(segment.fd, &capacity, sizeof(capacity), kCapacityOffset) != sizeof(capacity)) {
+    ::close(segment.fd);
+    throw std::runtime_error(fmt::format("corrupt frontier segment {}", segment.path));
+  }
+  segment.map_bytes = kHeaderBytes + static_cast<size_t>(capacity) * sizeof(uint64_t);
+  void *map = ::mmap(nullptr, segment.map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, segment.fd, 0);
+  if (map == MAP_FAILED) {
+    ::close(segment.fd);
+    throw std::runtime_error(fmt::format("failed to mmap frontier segment {}", segment.path));
+  }
+  segment.map = static_cast<char *>(map);
+  if (create) {
+    std::memcpy(segment.map, kSegmentMagic, sizeof(kSegmentMagic));
+    std::memcpy(segment.map + 4, &kSegmentVersion, sizeof(kSegmentVersion));
+    *count_ptr(segment.map) = 0;
+    std::memcpy(segment.map + kCapacityOffset, &capacity, sizeof(capacity));
+  } else if (std::memcmp(segment.map, kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+    ::munmap(segment.map, segment.map_bytes);
+    ::close(segment.fd);
+    throw std::runtime_error(fmt::format("corrupt frontier segment {}", segment.path));
+  }
+  return m_mapped.emplace(seq, std::move(segment)).first->second;
+}
+
+void SegmentedQueue::unmap_segment(uint64_t seq) {
+  auto it = m_mapped.find(seq);
+  if (it == m_mapped.end()) {
+    return;
+  }
+  ::munmap(it->second.map, it->second.map_bytes);
+  ::close(it->second.fd);
+  m_mapped.erase(it);
+}
+
+void SegmentedQueue::release_idle_segments() {
+  if (m_mapped.size() <= 2) {
+    return;
+  }
+  for (auto it = m_mapped.begin(); it != m_mapped.end();) {
+    if (it->first != m_seqs.front() && it->first != m_seqs.back()) {
+      ::munmap(it->second.map, it->second.map_bytes);
+      ::close(it->second.fd);
+      it = m_mapped.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+uint64_t SegmentedQueue::segment_count_field(const Segment &segment) {
+  uint64_t count = 0;
+  std::memcpy(&count, segment.map + kCountOffset, sizeof(count));
+  return count;
+}
+
+uint64_t SegmentedQueue::read_count(uint64_t seq) const {
+  auto it = m_mapped.find(seq);
+  if (it != m_mapped.end()) {
+    return segment_count_field(it->second);
+  }
+  const int fd = ::open(segment_path(seq).c_str(), O_RDONLY);
+  uint64_t count = 0;
+  if (fd < 0 || ::pread(fd, &count, sizeof(count), kCountOffset) != sizeof(count)) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::runtime_error(fmt::format("corrupt frontier segment {}", segment_path(seq)));
+  }
+  ::close(fd);
+  return count;
+}
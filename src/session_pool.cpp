@@ -0,0 +1,151 @@
+#include "session_pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+SessionPool::SessionPool(const SessionPoolOptions &options)
+    : m_options(options) {
+  m_options.quarantine_after_429s = std::max(0, m_options.quarantine_after_429s);
+  m_options.quarantine_ms = std::max(0, m_options.quarantine_ms);
+}
+
+size_t SessionPool::add(const std::string &name, std::unique_ptr<RateLimitRegistry> limits) {
+  if (!limits) {
+    throw std::invalid_argument("session needs a rate limit registry");
+  }
+  Session session;
+  session.name = name;
+  session.limits = std::move(limits);
+  session.stats.name = name;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_sessions.push_back(std::move(session));
+  return m_sessions.size() - 1;
+}
+
+SessionPool::Lease SessionPool::acquire(const std::string &url,
+                                        std::chrono::milliseconds extra_delay,
+                                        Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_sessions.empty()) {
+    throw std::logic_error("session pool is empty");
+  }
+  const size_t endpoint = m_sessions.front().limits->route(url);
+
+  size_t best = m_sessions.size();
+  Clock::time_point best_slot;
+  bool best_healthy = false;
+  for (size_t i = 0; i < m_sessions.size(); ++i) {
+    const Session &s = m_sessions[i];
+    const bool healthy = s.quarantine_until <= now;
+    const Clock::time_point slot = s.limits->next_slot(endpoint, now);
+    bool better = false;
+    if (best == m_sessions.size()) {
+      better = true;
+    } else if (healthy != best_healthy) {
+      better = healthy;
+    } else if (slot != best_slot) {
+      better = slot < best_slot;
+    } else {
+      better = s.stats.in_flight < m_sessions[best].stats.in_flight;
+    }
+    if (better) {
+      best = i;
+      best_slot = slot;
+      best_healthy = healthy;
+    }
+  }
+
+  Session &s = m_sessions[best];
+  Lease lease;
+  lease.session = best;
+  lease.endpoint = endpoint;
+  lease.send_at = s.limits->acquire(endpoint, extra_delay, now);
+  s.stats.requests++;
+  s.stats.in_flight++;
+  return lease;
+}
+
+void SessionPool::cancel(const Lease &lease) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Session &s = m_sessions.at(lease.session);
+  if (s.stats.in_flight > 0) {
+    s.stats.in_flight--;
+  }
+}
+
+void SessionPool::release(const Lease &lease,
+                          int status,
+                          std::chrono::milliseconds latency,
+                          Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Session &s = m_sessions.at(lease.session);
+  if (s.stats.in_flight > 0) {
+    s.stats.in_flight--;
+  }
+  s.limits->on_response(lease.endpoint, status, latency, now);
+  if (status == 429) {
+    s.stats.throttled++;
+    s.consecutive_429s++;
+    if (m_options.quarantine_after_429s > 0 &&
+        s.consecutive_429s >= m_options.quarantine_after_429s &&
+        s.quarantine_until <= now) {
+      s.quarantine_until = now + std::chrono::milliseconds(m_options.quarantine_ms);
+      s.limits->hold_all(s.quarantine_until);
+      s.stats.quarantines++;
+      s.consecutive_429s = 0;
+    }
+  } else if (status >= 200 && status < 300) {
+    s.consecutive_429s = 0;
+  }
+}
+
+size_t SessionPool::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_sessions.size();
+}
+
+const std::string &SessionPool::name(size_t session) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_sessions.at(session).name;
+}
+
+const std::string &SessionPool::endpoint_name(size_t endpoint) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_sessions.at(0).limits->name(endpoint);
+}
+
+std::vector<SessionPool::SessionStats> SessionPool::stats(Clock::time_point now) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<SessionStats> out;
+  out.reserve(m_sessions.size());
+  for (const auto &s : m_sessions) {
+    SessionStats stats = s.stats;
+    stats.quarantined = s.quarantine_until > now;
+    out.push_back(stats);
+  }
+  return out;
+}
+
+std::vector<RateLimitRegistry::EndpointStats> SessionPool::endpoint_stats() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<RateLimitRegistry::EndpointStats> total;
+  for (const auto &s : m_sessions) {
+    const auto session_stats = s.limits->stats();
+    if (total.empty()) {
+      total = session_stats;
+      continue;
+    }
+    for (size_t i = 0; i < total.size() && i < session_stats.size(); ++i) {
+      const auto &e = session_stats[i];
+      total[i].rate_rps += e.rate_rps;
+      total[i].requests += e.requests;
+      total[i].throttled += e.throttled;
+      total[i].pauses += e.pauses;
+      total[i].wait_ms += e.wait_ms;
+      total[i].spacing_wait_ms += e.spacing_wait_ms;
+      total[i].cooldown_wait_ms += e.cooldown_wait_ms;
+      total[i].pause_wait_ms += e.pause_wait_ms;
+      total[i].jitter_wait_ms += e.jitter_wait_ms;
+    }
+  }
+  return total;
+}
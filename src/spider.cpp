@@ -1,22 +1,25 @@
 #include "spider.hpp"
+#include "weibo_decode.hpp"
 #include "writer.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstdint>
+#include <deque>
 #include <iterator>
 #include <fmt/core.h>
 #include <fstream>
-#include <httplib.h>
+#include <future>
 #include <memory>
+#include <optional>
 #include <mongocxx/instance.hpp>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <string>
-#include <set>
 #include <sys/types.h>
 #include <thread>
+#include <unordered_set>
 #include <utility>
 
 using json = nlohmann::json;
@@ -24,6 +27,10 @@ using json = nlohmann::json;
 namespace {
 mongocxx::instance mongo_instance{};
 
+// Resume restore: visited uids per $in query, and users per UI callback.
+constexpr size_t kRestoreChunkUids = 10000;
+constexpr size_t kRestoreBatchUsers = 500;
+
 json load_json_from_file(const std::string &path, const std::string &name) {
   spdlog::debug(fmt::format("loading {} from {}", name, path));
 
@@ -59,6 +66,45 @@ json load_json_from_file(const std::string &path, const std::string &name) {
     throw;
   }
 }
+
+// Cookie jar and extra headers of one account, sent with every request.
+HttpTransport::Headers load_session_headers(const std::string &cookie_path,
+                                            const std::string &headers_path) {
+  HttpTransport::Headers header;
+  json json_cookie = load_json_from_file(cookie_path, "cookie");
+  std::string cookie;
+  for (json::iterator it = json_cookie.begin(); it != json_cookie.end();
+       ++it) {
+    if (!cookie.empty()) {
+      cookie += "; ";
+    }
+    cookie += it.key() + "=" + it.value().get<std::string>();
+  }
+  header.insert(std::make_pair("Cookie", cookie));
+  spdlog::debug(fmt::format("cookie header length: {}", cookie.size()));
+
+  json json_headers = load_json_from_file(headers_path, "headers");
+  int header_count = 0;
+  for (json::iterator it = json_headers.begin(); it != json_headers.end();
+       ++it) {
+    header.insert(std::make_pair<std::string, std::string>(
+        std::string(it.key()), it.value().get<std::string>()));
+    header_count++;
+  }
+  spdlog::debug(fmt::format("default headers loaded: {}", header_count));
+  return header;
+}
+
+// Friendship listing users decode to the same fields as a profile; the
+// screen name is all a User needs besides the uid. Named users also
+// refresh the profile cache when one is given.
+User user_from_listing(CachedProfile profile, ProfileCache *cache) {
+  User user(profile.uid, profile.screen_name, {});
+  if (cache && !profile.screen_name.empty()) {
+    cache->put(std::move(profile));
+  }
+  return user;
+}
 }
 
 std::vector<Weibo> load_weibos_from_db(const AppConfig &config, uint64_t uid) {
@@ -68,19 +114,52 @@ std::vector<Weibo> load_weibos_from_db(const AppConfig &config, uint64_t uid) {
 
 Spider::Spider(uint64_t uid, const AppConfig &config) {
   m_writer = std::make_unique<MongoWriter>(config.mongo_url, config.mongo_db, config.mongo_collection);
-  m_visit_cnt = 0;
+  m_persist_writer = std::make_unique<MongoWriter>(config.mongo_url, config.mongo_db, config.mongo_collection);
+  m_persist_queue_capacity = static_cast<size_t>(std::max(1, config.persist_queue_capacity));
   m_crawlWeibo = true;
   m_crawlFans = true;
   m_crawlFollowers = true;
   m_max_depth = std::max(0, config.crawl_max_depth);
+  m_workers = std::max(1, config.crawl_workers);
   m_running = false;
   m_state_path = config.crawl_state_path;
+  m_state_format = CrawlSnapshot::parse_format(config.crawl_state_format);
+  m_snapshot_records = static_cast<size_t>(std::max(1, config.crawl_snapshot_records));
+  m_harvest_listing_profiles = config.follower_profile_source != "profile";
+  m_fan_chunk_users = static_cast<size_t>(std::max(1, config.fan_chunk_users));
+  m_fan_max_per_user = static_cast<size_t>(std::max(0, config.fan_max_per_user));
+  m_fan_sample_spread = config.fan_sample_mode == "spread";
+  if (!m_fan_sample_spread && config.fan_sample_mode != "head") {
+    spdlog::warn(fmt::format("unknown fan_sample_mode '{}', using head", config.fan_sample_mode));
+  }
+  m_profile_cache = std::make_unique<ProfileCache>(
+      config.profile_cache_path,
+      static_cast<int64_t>(config.profile_cache_ttl_minutes) * 60);
+  if (!config.recrawl_state_path.empty()) {
+    RecrawlOptions recrawl_options;
+    recrawl_options.min_interval_seconds = static_cast<int64_t>(std::max(0, config.recrawl_min_interval_minutes)) * 60;
+    recrawl_options.max_interval_seconds = static_cast<int64_t>(std::max(1, config.recrawl_max_interval_days)) * 86400;
+    m_recrawl = std::make_unique<RecrawlScheduler>(config.recrawl_state_path, recrawl_options);
+  }
+  m_recrawl_scheduled = config.recrawl_mode == "scheduled";
+  if (m_recrawl_scheduled && !m_recrawl) {
+    spdlog::warn("recrawl_mode is scheduled but recrawl_state_path is empty; crawling from the root");
+  } else if (!m_recrawl_scheduled && config.recrawl_mode != "off") {
+    spdlog::warn(fmt::format("unknown recrawl_mode '{}', using off", config.recrawl_mode));
+  }
+  m_recrawl_window_seconds = static_cast<int64_t>(std::max(0, config.recrawl_window_minutes)) * 60;
+  m_recrawl_max_users = static_cast<size_t>(std::max(0, config.recrawl_max_users));
+  if (!m_state_path.empty()) {
+    m_checkpoint_writer = std::make_unique<CheckpointWriter>(
+        m_state_path, journal_path(), config.checkpoint_fsync_interval_ms);
+  }
   m_users_processed = 0;
   m_users_failed = 0;
   m_requests_total = 0;
   m_requests_failed = 0;
   m_retries_total = 0;
   m_http_429_count = 0;
+  m_retry_backoff_ms = 0;
   m_current_uid = uid;
   m_queue_pending = 0;
   m_visited_total = 0;
@@ -91,11 +170,64 @@ Spider::Spider(uint64_t uid, const AppConfig &config) {
   m_request_min_interval_ms = std::max(0, config.request_min_interval_ms);
   m_request_jitter_ms = std::max(0, config.request_jitter_ms);
   m_cooldown_429_ms = std::max(0, config.cooldown_429_ms);
-  m_next_request_time = std::chrono::steady_clock::now();
+  std::optional<RateControllerOptions> adaptive;
+  if (config.request_rate_mode == "adaptive") {
+    RateControllerOptions rate_options;
+    rate_options.floor_interval_ms = std::max(1, config.request_interval_floor_ms);
+    rate_options.ceiling_interval_ms = std::max(rate_options.floor_interval_ms,
+                                                config.request_interval_ceiling_ms);
+    rate_options.latency_threshold_ms = std::max(0, config.request_latency_threshold_ms);
+    adaptive = rate_options;
+  }
+  std::vector<RateLimitRegistry::EndpointOptions> endpoint_options;
+  for (const EndpointLimit &limit : config.endpoint_limits) {
+    if (limit.prefix.empty()) {
+      spdlog::warn(fmt::format("endpoint limit '{}' has no prefix, ignored", limit.name));
+      continue;
+    }
+    RateLimitRegistry::EndpointOptions options;
+    options.name = limit.name.empty() ? limit.prefix : limit.name;
+    options.prefix = limit.prefix;
+    options.min_interval_ms = limit.min_interval_ms > 0 ? limit.min_interval_ms : m_request_min_interval_ms;
+    options.burst = std::max(1, limit.burst);
+    options.cooldown_429_ms = limit.cooldown_429_ms >= 0 ? limit.cooldown_429_ms : m_cooldown_429_ms;
+    options.pause_every = std::max(0, limit.pause_every);
+    options.pause_ms = std::max(0, limit.pause_ms);
+    endpoint_options.push_back(options);
+  }
+  RateLimitRegistry::EndpointOptions default_options;
+  default_options.name = "default";
+  default_options.min_interval_ms = m_request_min_interval_ms;
+  default_options.cooldown_429_ms = m_cooldown_429_ms;
+  endpoint_options.push_back(default_options);
   m_rng = std::mt19937(std::random_device{}());
   m_self = User(uid, "", std::vector<User>());
-  m_client = std::make_unique<httplib::Client>(config.weibo_host);
-  httplib::Headers header;
+  m_host = config.weibo_host;
+
+  VisitedIndexOptions index_options;
+  index_options.tiered = config.visited_index_mode == "tiered";
+  index_options.bloom_expected_items = config.visited_bloom_expected;
+  index_options.bloom_fpr = config.visited_bloom_fpr;
+  index_options.buffer_uids = static_cast<size_t>(std::max(1, config.visited_buffer_uids));
+  index_options.durable_runs = config.checkpoint_fsync_interval_ms >= 0;
+  // Snapshots seal both indexes on the checkpoint thread, which then also
+  // merges their runs; without a state file nothing would.
+  index_options.background_merge = m_checkpoint_writer != nullptr;
+  index_options.dir = config.visited_index_dir + "/visited";
+  m_visited = VisitedIndex(index_options);
+  index_options.dir = config.visited_index_dir + "/seen";
+  if (config.frontier_mode == "disk") {
+    m_frontier = CrawlFrontier(index_options,
+                               config.frontier_dir,
+                               static_cast<size_t>(std::max(16, config.frontier_segment_entries)));
+  } else {
+    m_frontier = CrawlFrontier(index_options);
+  }
+  FrontierOrder frontier_order = FrontierOrder::Fifo;
+  if (!parse_frontier_order(config.frontier_order, &frontier_order)) {
+    spdlog::warn(fmt::format("unknown frontier_order '{}', using fifo", config.frontier_order));
+  }
+  apply_frontier_order(frontier_order);
 
   spdlog::info(fmt::format(
       "spider init: uid={}, weibo_host={}, cookie_path={}, headers_path={}",
@@ -103,34 +235,48 @@ Spider::Spider(uint64_t uid, const AppConfig &config) {
       config.weibo_host,
       config.cookie_path,
       config.headers_path));
-  json json_cookie = load_json_from_file(config.cookie_path, "cookie");
-  std::string cookie;
-  for (json::iterator it = json_cookie.begin(); it != json_cookie.end();
-       ++it) {
-    if (!cookie.empty()) {
-      cookie += "; ";
+  std::vector<SessionCredentials> credentials = config.sessions;
+  if (credentials.empty()) {
+    credentials.push_back({"main", config.cookie_path, config.headers_path});
+  }
+  SessionPoolOptions pool_options;
+  pool_options.quarantine_after_429s = config.session_quarantine_429s;
+  pool_options.quarantine_ms = config.session_quarantine_ms;
+  m_session_pool = std::make_unique<SessionPool>(pool_options);
+  for (size_t i = 0; i < credentials.size(); ++i) {
+    const SessionCredentials &c = credentials[i];
+    const std::string name = c.name.empty() ? fmt::format("session{}", i + 1) : c.name;
+    const std::string &headers_path = c.headers_path.empty() ? config.headers_path : c.headers_path;
+    spdlog::info(fmt::format("session {}: cookie_path={}, headers_path={}", name, c.cookie_path, headers_path));
+    HttpSession session;
+    session.headers = load_session_headers(c.cookie_path, headers_path);
+    m_sessions.push_back(std::move(session));
+    auto limits = std::make_unique<RateLimitRegistry>();
+    for (const auto &options : endpoint_options) {
+      limits->add(options, adaptive);
     }
-    cookie += it.key() + "=" + it.value().get<std::string>();
+    m_session_pool->add(name, std::move(limits));
   }
-  header.insert(std::make_pair("Cookie", cookie));
-  spdlog::debug(fmt::format("cookie header length: {}", cookie.size()));
-
-  json json_headers = load_json_from_file(config.headers_path, "headers");
-  int header_count = 0;
-  for (json::iterator it = json_headers.begin(); it != json_headers.end();
-       ++it) {
-    header.insert(std::make_pair<std::string, std::string>(
-        std::string(it.key()), it.value().get<std::string>()));
-    header_count++;
+  HttpTransportOptions transport_options;
+  transport_options.base_url = m_host;
+  transport_options.max_connections = std::max(1, config.http_max_connections);
+  transport_options.connect_timeout_ms = 10000;
+  transport_options.request_timeout_ms = 30000;
+  transport_options.max_idle_ms = std::max(0, config.http_max_idle_ms);
+  transport_options.verify_peer = false;
+  if (config.http_transport == "epoll") {
+    m_transport = make_epoll_transport(transport_options);
+  } else {
+    if (config.http_transport != "blocking") {
+      spdlog::warn(fmt::format("unknown http_transport '{}', using blocking", config.http_transport));
+    }
+    m_transport = make_blocking_transport(transport_options);
   }
-  spdlog::debug(fmt::format("default headers loaded: {}", header_count));
-
-  m_client->set_default_headers(header);
-  m_client->set_read_timeout(30, 0);
-  m_client->set_write_timeout(30, 0);
-  m_client->enable_server_hostname_verification(false);
-  m_client->enable_server_certificate_verification(false);
-  m_client->set_keep_alive(true);
+  spdlog::info(fmt::format("http transport: {}, max_connections={}, max_idle={}ms",
+                           m_transport->name(),
+                           transport_options.max_connections,
+                           transport_options.max_idle_ms));
+  spdlog::info(fmt::format("response decoding: {}", json_backend_name()));
   spdlog::info(fmt::format(
       "retry strategy: attempts={}, base={}ms, max={}ms, factor={}",
       m_retry_max_attempts,
@@ -142,6 +288,18 @@ Spider::Spider(uint64_t uid, const AppConfig &config) {
       m_request_min_interval_ms,
       m_request_jitter_ms,
       m_cooldown_429_ms));
+  for (const auto &endpoint : m_session_pool->endpoint_stats()) {
+    spdlog::info(fmt::format(
+        "rate limit {}: start {:.2f} req/s over {} sessions ({})",
+        endpoint.name,
+        endpoint.rate_rps,
+        m_session_pool->size(),
+        adaptive ? fmt::format("adaptive {}-{}ms",
+                               config.request_interval_floor_ms,
+                               config.request_interval_ceiling_ms)
+                 : std::string("static")));
+  }
+  spdlog::info(fmt::format("crawl workers: {}", m_workers));
 }
 
 Spider::~Spider() = default;
@@ -150,6 +308,10 @@ void Spider::setUserCallback(UserCallback callback) {
   m_userCallback = std::move(callback);
 }
 
+void Spider::setUserBatchCallback(UserBatchCallback callback) {
+  m_userBatchCallback = std::move(callback);
+}
+
 void Spider::setCrawlWeibo(bool crawl) {
   m_crawlWeibo = crawl;
 }
@@ -170,6 +332,31 @@ void Spider::setMaxDepth(int max_depth) {
   m_max_depth = std::max(0, max_depth);
 }
 
+void Spider::setWorkerCount(int workers) {
+  m_workers = std::max(1, workers);
+}
+
+void Spider::setFrontierScore(std::function<double(const FrontierCandidate &)> score) {
+  std::lock_guard<std::mutex> lock(m_frontier_mutex);
+  apply_frontier_order(FrontierOrder::Custom, std::move(score));
+}
+
+void Spider::apply_frontier_order(FrontierOrder order,
+                                  std::function<double(const FrontierCandidate &)> score) {
+  FrontierOrdering ordering;
+  ordering.order = order;
+  ordering.score = std::move(score);
+  // Listing harvest and profile requests fill the cache before the
+  // discovered uids are pushed.
+  ordering.followers_count = [this](uint64_t uid) -> uint64_t {
+    const std::optional<CachedProfile> cached = m_profile_cache->peek(uid);
+    return cached ? cached->followers_count : 0;
+  };
+  if (m_frontier.set_ordering(std::move(ordering))) {
+    spdlog::info(fmt::format("frontier order: {}", frontier_order_name(order)));
+  }
+}
+
 void Spider::setMetricsCallback(MetricsCallback callback) {
   m_metricsCallback = std::move(callback);
 }
@@ -177,16 +364,32 @@ void Spider::setMetricsCallback(MetricsCallback callback) {
 
 void Spider::stop() {
   m_running = false;
+  {
+    // Take the frontier lock so a worker between its predicate check and
+    // wait() cannot miss the wakeup.
+    std::lock_guard<std::mutex> lock(m_frontier_mutex);
+  }
+  m_frontier_cv.notify_all();
+  {
+    std::lock_guard<std::mutex> lock(m_stop_mutex);
+  }
+  m_stop_cv.notify_all();
 }
 
-bool Spider::is_retryable_result(const httplib::Result &result) const {
-  if (!result) {
+bool Spider::sleep_until_running(std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(m_stop_mutex);
+  m_stop_cv.wait_until(lock, deadline, [this] { return !m_running; });
+  return m_running;
+}
+
+bool Spider::is_retryable_result(const HttpResponse &response) const {
+  if (response.status == 0) {
     return true;
   }
-  if (result->status == 429) {
+  if (response.status == 429) {
     return true;
   }
-  return result->status >= 500;
+  return response.status >= 500;
 }
 
 int Spider::get_retry_delay_ms(int attempt) const {
@@ -208,24 +411,29 @@ int Spider::get_jitter_delay_ms() const {
   return jitter_dist(m_rng);
 }
 
-void Spider::wait_for_request_slot() const {
-  const int jitter_ms = get_jitter_delay_ms();
-  const auto gap = std::chrono::milliseconds(m_request_min_interval_ms + jitter_ms);
-  const auto now = std::chrono::steady_clock::now();
-  auto wait_until = now;
+bool Spider::wait_for_request_slot(const std::string &url, SessionPool::Lease *lease) {
+  int jitter_ms = 0;
   {
+    // m_rng is shared by all workers.
     std::lock_guard<std::mutex> lock(m_rate_limit_mutex);
-    if (m_next_request_time > now) {
-      wait_until = m_next_request_time;
-    }
-    m_next_request_time = std::max(m_next_request_time, now) + gap;
+    jitter_ms = get_jitter_delay_ms();
   }
-  if (wait_until > now) {
+  const auto now = std::chrono::steady_clock::now();
+  *lease = m_session_pool->acquire(url, std::chrono::milliseconds(jitter_ms), now);
+  if (lease->send_at > now) {
     const auto wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        wait_until - now).count();
-    spdlog::debug(fmt::format("request pacing sleep {}ms", wait_ms));
-    std::this_thread::sleep_until(wait_until);
+        lease->send_at - now).count();
+    spdlog::debug(fmt::format("request pacing sleep {}ms ({}, {})",
+                              wait_ms,
+                              m_session_pool->endpoint_name(lease->endpoint),
+                              m_session_pool->name(lease->session)));
+    sleep_until_running(lease->send_at);
   }
+  if (!m_running) {
+    m_session_pool->cancel(*lease);
+    return false;
+  }
+  return true;
 }
 
 void Spider::emit_metrics(bool force) {
@@ -235,150 +443,279 @@ void Spider::emit_metrics(bool force) {
   if (!force && (m_requests_total % 20 != 0)) {
     return;
   }
-  m_metricsCallback(
-      m_users_processed,
-      m_users_failed,
-      m_requests_total,
-      m_requests_failed,
-      m_retries_total,
-      m_http_429_count,
-      m_queue_pending,
-      m_visited_total,
-      m_current_uid);
-}
-
-bool Spider::load_crawl_state(std::vector<std::pair<uint64_t, int>> *queue,
-                              size_t *cursor,
-                              std::set<uint64_t> *visited) {
-  if (m_state_path.empty() || !queue || !cursor || !visited) {
+  SpiderMetrics metrics;
+  metrics.users_processed = m_users_processed;
+  metrics.users_failed = m_users_failed;
+  metrics.requests_total = m_requests_total;
+  metrics.requests_failed = m_requests_failed;
+  metrics.retries_total = m_retries_total;
+  metrics.http_429_count = m_http_429_count;
+  metrics.queue_pending = m_queue_pending;
+  metrics.visited_total = m_visited_total;
+  metrics.current_uid = m_current_uid;
+  const ProfileCache::Stats cache_stats = m_profile_cache->stats();
+  metrics.profile_cache_hits = cache_stats.hits;
+  metrics.profile_cache_misses = cache_stats.misses;
+  metrics.endpoints = m_session_pool->endpoint_stats();
+  metrics.sessions = m_session_pool->stats();
+  metrics.http = m_transport->stats();
+  metrics.retry_backoff_ms = m_retry_backoff_ms;
+  for (const auto &endpoint : metrics.endpoints) {
+    metrics.request_rate_rps += endpoint.rate_rps;
+  }
+  if (m_persist_queue) {
+    const auto queue_stats = m_persist_queue->stats();
+    metrics.persist_queue_depth = queue_stats.depth;
+    metrics.fetch_stall_ms = queue_stats.push_stall_ms;
+    metrics.persist_idle_ms = queue_stats.pop_stall_ms;
+  }
+  m_metricsCallback(metrics);
+}
+
+bool Spider::load_crawl_state(CrawlFrontier *frontier,
+                              VisitedIndex *visited) {
+  if (m_state_path.empty() || !frontier || !visited) {
     return false;
   }
-  std::ifstream ifs(m_state_path);
-  if (!ifs.is_open()) {
+  if (!std::ifstream(m_state_path).is_open()) {
     return false;
   }
   try {
-    json j = json::parse(ifs);
-    if (!j.contains("root_uid") || j["root_uid"].get<uint64_t>() != m_self.uid) {
-      return false;
-    }
-    if (!j.contains("max_depth") || j["max_depth"].get<int>() != m_max_depth) {
-      return false;
-    }
-    if (!j.contains("crawl_weibo") || j["crawl_weibo"].get<bool>() != m_crawlWeibo) {
-      return false;
-    }
-    if (!j.contains("crawl_fans") || j["crawl_fans"].get<bool>() != m_crawlFans) {
-      return false;
-    }
-    if (!j.contains("crawl_followers") || j["crawl_followers"].get<bool>() != m_crawlFollowers) {
+    const CrawlSnapshot snapshot = CrawlSnapshot::open(m_state_path);
+    const CrawlSnapshotInfo &info = snapshot.info;
+    if (info.root_uid != m_self.uid || info.max_depth != m_max_depth ||
+        info.crawl_weibo != m_crawlWeibo || info.crawl_fans != m_crawlFans ||
+        info.crawl_followers != m_crawlFollowers) {
       return false;
     }
 
-    queue->clear();
-    if (j.contains("queue") && j["queue"].is_array()) {
-      for (const auto &item : j["queue"]) {
-        if (!item.contains("uid") || !item.contains("depth")) {
-          continue;
-        }
-        queue->emplace_back(item["uid"].get<uint64_t>(), item["depth"].get<int>());
+    // A tiered index persists itself on disk; the state file only names it.
+    if (!info.visited_index.empty()) {
+      if (!visited->tiered() || info.visited_index != visited->dir()) {
+        spdlog::warn(fmt::format(
+            "crawl state uses visited index {}, current config differs",
+            info.visited_index));
+        return false;
       }
+    } else {
+      visited->clear();
+      visited->reserve(snapshot.visited_size());
+      std::for_each(snapshot.visited(),
+                    snapshot.visited() + snapshot.visited_size(),
+                    [visited](uint64_t uid) { visited->insert(uid); });
     }
 
-    visited->clear();
-    if (j.contains("visited") && j["visited"].is_array()) {
-      for (const auto &uid_item : j["visited"]) {
-        visited->insert(uid_item.get<uint64_t>());
+    // The seen set is rebuilt from visited + queue rather than trusted from
+    // disk: uids seen after the last checkpoint may never have been queued.
+    // A disk frontier keeps its pending entries; only in-flight users are
+    // listed in the state file.
+    if (!info.frontier_dir.empty()) {
+      if (!frontier->disk_backed() || info.frontier_dir != frontier->queue_dir()) {
+        spdlog::warn(fmt::format(
+            "crawl state uses frontier dir {}, current config differs",
+            info.frontier_dir));
+        return false;
       }
+      frontier->reseed_seen();
+    } else {
+      frontier->clear();
     }
 
-    size_t saved_cursor = 0;
-    if (j.contains("cursor")) {
-      saved_cursor = j["cursor"].get<size_t>();
+    // The first in_flight_count entries were claimed by workers when the
+    // snapshot was taken; the rest are pending in FIFO order.
+    std::map<uint64_t, int> in_flight;
+    std::deque<std::pair<uint64_t, int>> pending;
+    for (size_t i = 0; i < snapshot.queue_size(); ++i) {
+      const uint64_t entry = snapshot.queue()[i];
+      if (i < info.in_flight_count) {
+        in_flight.emplace(CrawlFrontier::unpack_uid(entry), CrawlFrontier::unpack_depth(entry));
+      } else {
+        pending.emplace_back(CrawlFrontier::unpack_uid(entry), CrawlFrontier::unpack_depth(entry));
+      }
     }
-    *cursor = std::min(saved_cursor, queue->size());
 
-    if (j.contains("metrics") && j["metrics"].is_object()) {
-      auto metrics = j["metrics"];
-      m_users_processed = metrics.value("users_processed", static_cast<uint64_t>(0));
-      m_users_failed = metrics.value("users_failed", static_cast<uint64_t>(0));
-      m_requests_total = metrics.value("requests_total", static_cast<uint64_t>(0));
-      m_requests_failed = metrics.value("requests_failed", static_cast<uint64_t>(0));
-      m_retries_total = metrics.value("retries_total", static_cast<uint64_t>(0));
-      m_http_429_count = metrics.value("http_429_count", static_cast<uint64_t>(0));
+    m_users_processed = info.users_processed;
+    m_users_failed = info.users_failed;
+    m_requests_total = info.requests_total;
+    m_requests_failed = info.requests_failed;
+    m_retries_total = info.retries_total;
+    m_http_429_count = info.http_429_count;
+
+    // Apply the deltas journaled after the snapshot. Under FIFO order a
+    // claim matches the pending head unless the pending entries live in a
+    // disk frontier; an ordered frontier claims from anywhere, and lists a
+    // uid once per rediscovery, so every pending entry of a claimed uid is
+    // dropped afterwards. A uid is admitted at most once, so a claim
+    // always retires it.
+    std::unordered_set<uint64_t> claimed;
+    m_journal_generation = info.journal_generation;
+    const size_t replayed = CrawlJournal::replay(
+        journal_path(),
+        m_journal_generation,
+        [&](const CrawlJournal::Record &record) {
+          switch (record.op) {
+          case CrawlJournal::Op::Push:
+            pending.emplace_back(record.uid, record.depth);
+            break;
+          case CrawlJournal::Op::Claim:
+            if (!pending.empty() && pending.front().first == record.uid) {
+              pending.pop_front();
+            }
+            claimed.insert(record.uid);
+            in_flight[record.uid] = record.depth;
+            break;
+          case CrawlJournal::Op::Done:
+            in_flight.erase(record.uid);
+            visited->insert(record.uid);
+            m_users_processed++;
+            break;
+          case CrawlJournal::Op::Fail:
+            in_flight.erase(record.uid);
+            m_users_failed++;
+            break;
+          }
+        });
+
+    visited->for_each([frontier](uint64_t uid) { frontier->mark_seen(uid); });
+
+    // Re-queue in-flight users, then pending ones; repeats and visited uids
+    // are dropped by the frontier itself.
+    for (const auto &[uid, depth] : in_flight) {
+      frontier->push(uid, depth);
+    }
+    for (const auto &[uid, depth] : pending) {
+      if (!claimed.count(uid)) {
+        frontier->push(uid, depth);
+      }
     }
     spdlog::info(fmt::format(
-        "resume crawl from state: root_uid={}, cursor={}, queue={}, visited={}",
+        "resume crawl from state: root_uid={}, pending={}, visited={}, journal records={}",
         m_self.uid,
-        *cursor,
-        queue->size(),
-        visited->size()));
-    return !queue->empty();
+        frontier->pending(),
+        visited->size(),
+        replayed));
+    return !frontier->empty();
   } catch (const std::exception &e) {
     spdlog::warn(fmt::format("ignore invalid crawl state {}: {}", m_state_path, e.what()));
     return false;
   }
 }
 
-void Spider::save_crawl_state(const std::vector<std::pair<uint64_t, int>> &queue,
-                              size_t cursor,
-                              const std::set<uint64_t> &visited,
-                              uint64_t current_uid) {
+void Spider::save_crawl_state(uint64_t current_uid) {
   if (m_state_path.empty()) {
     return;
   }
   try {
-    json j;
-    j["root_uid"] = m_self.uid;
-    j["max_depth"] = m_max_depth;
-    j["crawl_weibo"] = m_crawlWeibo;
-    j["crawl_fans"] = m_crawlFans;
-    j["crawl_followers"] = m_crawlFollowers;
-    j["cursor"] = cursor;
-    j["current_uid"] = current_uid;
-
-    json queue_json = json::array();
-    for (const auto &item : queue) {
-      queue_json.push_back({{"uid", item.first}, {"depth", item.second}});
-    }
-    j["queue"] = std::move(queue_json);
-
-    json visited_json = json::array();
-    for (const auto uid : visited) {
-      visited_json.push_back(uid);
-    }
-    j["visited"] = std::move(visited_json);
-
-    j["metrics"] = {
-        {"users_processed", m_users_processed},
-        {"users_failed", m_users_failed},
-        {"requests_total", m_requests_total},
-        {"requests_failed", m_requests_failed},
-        {"retries_total", m_retries_total},
-        {"http_429_count", m_http_429_count},
-    };
-
-    std::ofstream ofs(m_state_path);
-    ofs << j.dump(2) << std::endl;
+    CrawlSnapshot snapshot;
+    CrawlSnapshotInfo &info = snapshot.info;
+    info.root_uid = m_self.uid;
+    info.max_depth = m_max_depth;
+    info.crawl_weibo = m_crawlWeibo;
+    info.crawl_fans = m_crawlFans;
+    info.crawl_followers = m_crawlFollowers;
+    info.current_uid = current_uid;
+    info.journal_generation = m_journal_generation + 1;
+
+    std::vector<uint64_t> queue;
+    for (const auto &[uid, depth] : m_in_flight) {
+      queue.push_back(CrawlFrontier::pack(uid, depth));
+    }
+    info.in_flight_count = m_in_flight.size();
+    if (m_frontier.disk_backed()) {
+      info.frontier_dir = m_frontier.queue_dir();
+    } else {
+      for (const auto &[uid, depth] : m_frontier.pending_entries()) {
+        queue.push_back(CrawlFrontier::pack(uid, depth));
+      }
+    }
+    snapshot.set_queue(std::move(queue));
+
+    // The visited set is written on the checkpoint thread, not under the
+    // frontier lock. The tiered index directory may by then also hold uids
+    // finished after this snapshot; their Done records replay as no-ops.
+    std::function<void(CrawlSnapshot &)> complete;
+    if (m_visited.tiered()) {
+      // The journal is truncated once the snapshot is written, so the
+      // buffered uids must reach disk first.
+      info.visited_index = m_visited.dir();
+      complete = [write_runs = m_visited.seal(), seal_seen = m_frontier.seal_seen()](CrawlSnapshot &) {
+        write_runs();
+        if (seal_seen) {
+          seal_seen();
+        }
+      };
+    } else {
+      complete = [view = m_visited.view()](CrawlSnapshot &snapshot) {
+        snapshot.set_visited(view->sorted());
+      };
+    }
+
+    info.users_processed = m_users_processed;
+    info.users_failed = m_users_failed;
+    info.requests_total = m_requests_total;
+    info.requests_failed = m_requests_failed;
+    info.retries_total = m_retries_total;
+    info.http_429_count = m_http_429_count;
+
+    // Records buffered so far are covered by the snapshot. The frontier
+    // commit is applied after the state file is written: a crash in
+    // between replays the in-flight users twice instead of losing them.
+    m_journal_generation++;
+    m_journal.reset();
+    m_checkpoint_writer->submit_snapshot(std::move(snapshot),
+                                         m_state_format,
+                                         m_frontier.prepare_checkpoint(),
+                                         std::move(complete));
   } catch (const std::exception &e) {
     spdlog::warn(fmt::format("save crawl state failed {}: {}", m_state_path, e.what()));
   }
 }
 
+void Spider::checkpoint_locked(uint64_t current_uid) {
+  if (m_state_path.empty()) {
+    return;
+  }
+  if (!m_journal.active() || m_journal.records() >= m_snapshot_records ||
+      m_checkpoint_writer->needs_snapshot()) {
+    save_crawl_state(current_uid);
+    return;
+  }
+  m_checkpoint_writer->submit_journal(m_journal.take(), m_frontier.prepare_checkpoint());
+}
+
+std::string Spider::journal_path() const {
+  return m_state_path + ".journal";
+}
+
 void Spider::clear_crawl_state() {
   if (m_state_path.empty()) {
     return;
   }
-  std::remove(m_state_path.c_str());
+  m_checkpoint_writer->remove_files();
 }
 
-httplib::Result Spider::get_with_retry(const std::string &url,
-                                       const std::string &request_name) {
+std::optional<HttpResponse> Spider::get_with_retry(const std::string &url,
+                                                   const std::string &request_name,
+                                                   const std::atomic<bool> *cancelled) {
   for (int attempt = 1; attempt <= m_retry_max_attempts && m_running; ++attempt) {
+    SessionPool::Lease lease;
+    if (!wait_for_request_slot(url, &lease)) {
+      return std::nullopt;
+    }
+    if (cancelled && cancelled->load()) {
+      m_session_pool->cancel(lease);
+      spdlog::debug(fmt::format("{} cancelled", request_name));
+      return std::nullopt;
+    }
     m_requests_total++;
-    wait_for_request_slot();
-    auto result = m_client->Get(url);
-    if (result && result->status >= 200 && result->status < 300) {
+    const auto sent_at = std::chrono::steady_clock::now();
+    HttpResponse result = m_transport->get(url, m_sessions.at(lease.session).headers);
+    m_session_pool->release(
+        lease,
+        result.status,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - sent_at));
+    if (result.status >= 200 && result.status < 300) {
       if (attempt > 1) {
         m_retries_total += static_cast<uint64_t>(attempt - 1);
         spdlog::info(fmt::format(
@@ -395,8 +732,8 @@ httplib::Result Spider::get_with_retry(const std::string &url,
       if (attempt > 1) {
         m_retries_total += static_cast<uint64_t>(attempt - 1);
       }
-      if (result) {
-        if (result->status == 429) {
+      if (result.status != 0) {
+        if (result.status == 429) {
           m_http_429_count++;
         }
         spdlog::error(fmt::format(
@@ -404,40 +741,39 @@ httplib::Result Spider::get_with_retry(const std::string &url,
             request_name,
             attempt,
             m_retry_max_attempts,
-            result->status));
+            result.status));
       } else {
         spdlog::error(fmt::format(
             "{} failed after {}/{} attempts, error={}",
             request_name,
             attempt,
             m_retry_max_attempts,
-            static_cast<int>(result.error())));
+            result.error));
+        emit_metrics(false);
+        return std::nullopt;
       }
       emit_metrics(false);
       return result;
     }
 
     const int delay_ms = get_retry_delay_ms(attempt);
-    if (result) {
-      if (result->status == 429 && m_cooldown_429_ms > 0) {
+    if (result.status != 0) {
+      if (result.status == 429) {
+        // The endpoint's bucket is already held for its cooldown; the
+        // retry may go out on another session.
         m_http_429_count++;
-        const auto cooldown_until = std::chrono::steady_clock::now() +
-            std::chrono::milliseconds(m_cooldown_429_ms);
-        {
-          std::lock_guard<std::mutex> lock(m_rate_limit_mutex);
-          m_next_request_time = std::max(m_next_request_time, cooldown_until);
-        }
         spdlog::warn(fmt::format(
-            "{} got 429, applying cooldown {}ms",
+            "{} got 429, cooling down {} requests of session {}",
             request_name,
-            m_cooldown_429_ms));
+            m_session_pool->endpoint_name(lease.endpoint),
+            m_session_pool->name(lease.session)));
       }
       spdlog::warn(fmt::format(
           "{} attempt {}/{} failed, status={}, retry in {}ms",
           request_name,
           attempt,
           m_retry_max_attempts,
-          result->status,
+          result.status,
           delay_ms));
     } else {
       spdlog::warn(fmt::format(
@@ -445,14 +781,15 @@ httplib::Result Spider::get_with_retry(const std::string &url,
           request_name,
           attempt,
           m_retry_max_attempts,
-          static_cast<int>(result.error()),
+          result.error,
           delay_ms));
     }
     m_retries_total++;
+    m_retry_backoff_ms += static_cast<uint64_t>(delay_ms);
     emit_metrics(false);
-    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    sleep_until_running(std::chrono::steady_clock::now() + std::chrono::milliseconds(delay_ms));
   }
-  return {};
+  return std::nullopt;
 }
 
 void Spider::notifyUserFetched(uint64_t uid, const std::string& name,
@@ -463,42 +800,88 @@ void Spider::notifyUserFetched(uint64_t uid, const std::string& name,
   }
 }
 
+void Spider::notifyUsersRestored(const std::vector<UserRelations>& users) {
+  if (m_userBatchCallback) {
+    m_userBatchCallback(users);
+    return;
+  }
+  for (const auto &user : users) {
+    notifyUserFetched(user.uid, user.username, user.followers, user.fans);
+  }
+}
+
+void Spider::restore_visited_users() {
+  if (!m_userBatchCallback && !m_userCallback) {
+    return;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  size_t restored = 0;
+  std::vector<uint64_t> chunk;
+  chunk.reserve(kRestoreChunkUids);
+  auto flush_chunk = [this, &chunk, &restored] {
+    if (chunk.empty()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_writer_mutex);
+    restored += m_writer->for_each_user_relations(
+        chunk,
+        kRestoreBatchUsers,
+        [this](std::vector<UserRelations> &batch) { notifyUsersRestored(batch); });
+    chunk.clear();
+  };
+  m_visited.for_each([&chunk, &flush_chunk](uint64_t restored_uid) {
+    chunk.push_back(restored_uid);
+    if (chunk.size() >= kRestoreChunkUids) {
+      flush_chunk();
+    }
+  });
+  flush_chunk();
+  const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - started).count();
+  spdlog::info(fmt::format("restored {} of {} visited nodes into UI in {}ms",
+                           restored,
+                           m_visited.size(),
+                           elapsed_ms));
+}
+
 User Spider::get_user(uint64_t uid,
                       bool get_follower,
                       std::vector<uint64_t> *follower_ids_out,
-                      std::vector<uint64_t> *fan_ids_out) {
-  if (!m_running) {
-    return User(uid, "", {});
-  }
-  m_visit_cnt++;
-  if (m_visit_cnt % 80 == 0) {
-    std::this_thread::sleep_for(std::chrono::seconds(10));
-  }
+                      std::vector<uint64_t> *fan_ids_out,
+                      const FanChunkSink &fan_sink) {
   if (!m_running) {
     return User(uid, "", {});
   }
-  const std::string url = fmt::format("/ajax/profile/info?uid={}", uid);
-  spdlog::info(url);
+  std::optional<CachedProfile> cached = m_profile_cache->get(uid);
   try {
-    httplib::Result resp = get_with_retry(url, fmt::format("get_user uid={}", uid));
-    if (!resp) {
-      return User(uid, "", {});
-    }
-    auto json_resp = json::parse(resp->body);
-    if (spdlog::default_logger_raw() && spdlog::default_logger()->should_log(spdlog::level::debug)) {
-      std::string payload = json_resp.dump();
-      if (payload.size() > 400) {
-        payload = payload.substr(0, 400) + "...";
+    std::string name;
+    if (cached) {
+      name = cached->screen_name;
+      spdlog::debug(fmt::format("profile cache hit uid={}, user name {}", uid, name));
+    } else {
+      const std::string url = fmt::format("/ajax/profile/info?uid={}", uid);
+      spdlog::info(url);
+      std::optional<HttpResponse> resp = get_with_retry(url, fmt::format("get_user uid={}", uid));
+      if (!resp) {
+        return User(uid, "", {});
       }
-      spdlog::debug(fmt::format("profile payload uid={} {}", uid, payload));
-    }
-    if (!json_resp.contains("ok") || json_resp["ok"].get<int>() != 1) {
-      return User(uid, "", {});
+      if (spdlog::default_logger_raw() && spdlog::default_logger()->should_log(spdlog::level::debug)) {
+        std::string payload = resp->body.substr(0, 400);
+        if (resp->body.size() > 400) {
+          payload += "...";
+        }
+        spdlog::debug(fmt::format("profile payload uid={} {}", uid, payload));
+      }
+      ProfileResponse profile = decode_profile(resp->body);
+      if (profile.ok != 1 || profile.user.screen_name.empty()) {
+        return User(uid, "", {});
+      }
+      name = profile.user.screen_name;
+      spdlog::info(fmt::format("screen name:{}", name));
+      spdlog::info(fmt::format("uid: {}, user name {}", uid, name));
+      profile.user.uid = uid;
+      m_profile_cache->put(std::move(profile.user));
     }
-    auto user = json_resp["data"]["user"];
-    auto name = user["screen_name"].get<std::string>();
-    spdlog::info(fmt::format("screen name:{}", name));
-    spdlog::info(fmt::format("uid: {}, user name {}", uid, name));
 
     std::vector<uint64_t> follower_ids;
     std::vector<uint64_t> fan_ids;
@@ -510,18 +893,40 @@ User Spider::get_user(uint64_t uid,
           follower_ids.push_back(f.uid);
         }
       }
-      if (m_crawlFans) {
+      if (m_crawlFans && fan_sink) {
+        // Only the uids are kept, and only for the UI callback.
+        size_t delivered_chunks = 0;
+        try {
+          stream_fans(uid, [this, &fan_ids, &fan_sink, &delivered_chunks](std::vector<User> &chunk) {
+            if (m_userCallback) {
+              for (const auto &f : chunk) {
+                fan_ids.push_back(f.uid);
+              }
+            }
+            fan_sink(chunk);
+            delivered_chunks++;
+          });
+        } catch (const std::exception &e) {
+          if (delivered_chunks == 0) {
+            throw;
+          }
+          // Delivered chunks are already queued and stored, so the user
+          // completes with them, as when a page request gives up.
+          spdlog::warn(fmt::format("fan listing of uid {} stopped after {} chunks: {}",
+                                   uid, delivered_chunks, e.what()));
+        }
+      } else if (m_crawlFans) {
         user.fans = get_other_follower(uid);
         for (const auto& f : user.fans) {
           fan_ids.push_back(f.uid);
         }
+        if (fan_ids_out) {
+          *fan_ids_out = fan_ids;
+        }
       }
       if (follower_ids_out) {
         *follower_ids_out = follower_ids;
       }
-      if (fan_ids_out) {
-        *fan_ids_out = fan_ids;
-      }
       notifyUserFetched(uid, name, follower_ids, fan_ids);
       return user;
     } else {
@@ -545,20 +950,52 @@ std::vector<User> Spider::get_self_follower(uint64_t uid) {
     spdlog::error("HTTP request failed for self follower");
     return {};
   }
-  auto resp = json::parse(result->body);
-  std::vector<json::basic_json::object_t> users = resp["users"];
-  spdlog::info(fmt::format("self follower size:{}", users.size()));
-  for (auto &item : users) {
-    ids.push_back(item["id"].get<uint64_t>());
+  FriendshipsPage page = decode_friendships(result->body);
+  spdlog::info(fmt::format("self follower size:{}", page.users.size()));
+  ProfileCache *listing_cache = m_harvest_listing_profiles ? m_profile_cache.get() : nullptr;
+  std::vector<User> listed;
+  for (auto &item : page.users) {
+    listed.push_back(user_from_listing(std::move(item), listing_cache));
   }
-  auto ret = batch_get_user(ids);
-  return ret;
+  return complete_listed_users(std::move(listed));
 }
 
 std::vector<User> Spider::get_other_follower(uint64_t uid) {
+  std::vector<User> fans;
+  stream_fans(uid, [&fans](std::vector<User> &chunk) {
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(fans));
+  });
+  for (const auto &fan : fans) {
+    spdlog::info(
+        fmt::format("get follower id {}, username: {}", fan.uid, fan.username));
+  }
+  return fans;
+}
+
+size_t Spider::stream_fans(uint64_t uid, const FanChunkSink &sink) {
   spdlog::info(fmt::format("start to get other follower, uid: {}", uid));
+  ProfileCache *listing_cache = m_harvest_listing_profiles ? m_profile_cache.get() : nullptr;
+  std::vector<User> chunk;
+  size_t listed = 0;
+  size_t delivered = 0;
+  size_t chunks = 0;
+  auto flush_chunk = [this, &chunk, &delivered, &chunks, &sink] {
+    if (chunk.empty()) {
+      return;
+    }
+    std::vector<User> users = complete_listed_users(std::move(chunk));
+    chunk.clear();
+    delivered += users.size();
+    chunks++;
+    sink(users);
+  };
+
+  // Pages are fetched one after another; in spread mode the step between
+  // them is fixed once the first page shows the total.
   int page_cnt = 1;
-  std::vector<uint64_t> ids;
+  int page_step = 1;
+  uint64_t page_size = 0;
+  uint64_t total_cnt = 0;
   while (m_running) {
     const std::string url = fmt::format(
         "/ajax/friendships/"
@@ -571,153 +1008,430 @@ std::vector<User> Spider::get_other_follower(uint64_t uid) {
       spdlog::error("HTTP request failed for other follower");
       break;
     }
-    auto resp = json::parse(result->body);
-    int total_cnt = resp["display_total_number"].get<uint>();
-    std::vector<json::basic_json::object_t> users = resp["users"];
-    for (auto &user : users) {
-      ids.push_back(user["id"].get<uint64_t>());
+    FriendshipsPage page = decode_friendships(result->body);
+    if (!page.display_total_number) {
+      throw std::runtime_error(fmt::format("fan page {} of uid {} has no display_total_number", page_cnt, uid));
     }
-    if (ids.size() >= total_cnt || users.empty()) {
-      break;
-    } else {
-      page_cnt += 1;
+    total_cnt = *page.display_total_number;
+    const bool last_page = page.users.empty();
+    if (page_cnt == 1 && m_fan_sample_spread && m_fan_max_per_user > 0 && !last_page) {
+      page_size = page.users.size();
+      const uint64_t total_pages = (total_cnt + page_size - 1) / page_size;
+      const uint64_t wanted_pages = (m_fan_max_per_user + page_size - 1) / page_size;
+      page_step = static_cast<int>(std::max<uint64_t>(1, total_pages / std::max<uint64_t>(1, wanted_pages)));
     }
-    if (page_cnt % 20 == 0) {
-      std::this_thread::sleep_for(std::chrono::seconds(5));
+    for (auto &user : page.users) {
+      if (m_fan_max_per_user > 0 && listed >= m_fan_max_per_user) {
+        break;
+      }
+      chunk.push_back(user_from_listing(std::move(user), listing_cache));
+      listed++;
+    }
+    if (chunk.size() >= m_fan_chunk_users) {
+      flush_chunk();
+    }
+    const bool capped = m_fan_max_per_user > 0 && listed >= m_fan_max_per_user;
+    const bool past_end = page_step > 1
+                              ? static_cast<uint64_t>(page_cnt + page_step - 1) * page_size >= total_cnt
+                              : listed >= total_cnt;
+    if (capped || past_end || last_page) {
+      break;
     }
+    page_cnt += page_step;
     spdlog::info(
-        fmt::format("total {} followers, current {}", total_cnt, ids.size()));
+        fmt::format("total {} followers, current {}", total_cnt, listed));
   }
-  spdlog::info(fmt::format("success to get {} followers", ids.size()));
-  auto fans = batch_get_user(ids);
-  for (const auto &fan : fans) {
-    spdlog::info(
-        fmt::format("get follower id {}, username: {}", fan.uid, fan.username));
+  flush_chunk();
+  spdlog::info(fmt::format("success to get {} of {} followers in {} chunks", delivered, total_cnt, chunks));
+  return delivered;
+}
+
+void Spider::queue_child_locked(uint64_t uid, int depth) {
+  // A disk frontier persists its own entries. A re-rank is journaled as a
+  // repeated Push, which replays as the same rediscovery.
+  bool reranked = false;
+  if ((m_frontier.push(uid, depth, &reranked) || reranked) && !m_frontier.disk_backed()) {
+    m_journal.append(CrawlJournal::Op::Push, uid, depth);
   }
-  return fans;
 }
 
-void Spider::run() {
-  m_running = true;
+void Spider::update_queue_metrics_locked() {
+  m_queue_pending = m_frontier.pending();
+  m_visited_total = m_visited.size();
+}
+
+void Spider::log_frontier_stats_locked(const char *label) const {
   spdlog::info(fmt::format(
-      "spider run started, root uid={}, max_depth={}",
-      m_self.uid,
-      m_max_depth));
+      "{}: pending={}, seen={}, memory={:.1f}MB ({:.1f}MB per 1M uids)",
+      label,
+      m_frontier.pending(),
+      m_frontier.seen_size(),
+      m_frontier.memory_bytes() / 1048576.0,
+      m_frontier.memory_bytes_per_million() / 1048576.0));
+  if (m_visited.tiered()) {
+    const auto seen = m_frontier.seen_stats();
+    const auto visited = m_visited.stats();
+    spdlog::info(fmt::format(
+        "{}: bloom fpr seen={:.4f} (expected {:.4f}, {} disk probes), "
+        "visited={:.4f} (expected {:.4f}, {} disk probes), index memory={:.1f}MB",
+        label,
+        seen.measured_fpr,
+        seen.expected_fpr,
+        seen.disk_probes,
+        visited.measured_fpr,
+        visited.expected_fpr,
+        visited.disk_probes,
+        (m_frontier.memory_bytes() + m_visited.memory_bytes()) / 1048576.0));
+  }
+}
 
-  std::set<uint64_t> visited;
-  std::vector<std::pair<uint64_t, int>> queue;
-  size_t cursor = 0;
+Spider::CrawlOutcome Spider::crawl_user(uint64_t uid,
+                                        int depth,
+                                        User *fetched,
+                                        std::vector<uint64_t> *discovered) {
+  m_current_uid = uid;
 
-  if (!load_crawl_state(&queue, &cursor, &visited)) {
-    queue.clear();
-    queue.emplace_back(m_self.uid, 0);
-    cursor = 0;
-  } else {
-    // Restore already-visited nodes in GUI so resume keeps previous graph visible.
-    for (const auto restored_uid : visited) {
-      std::string restored_name;
-      std::vector<uint64_t> restored_followers;
-      std::vector<uint64_t> restored_fans;
-      if (m_writer->get_user_relations(restored_uid,
-                                       &restored_name,
-                                       &restored_followers,
-                                       &restored_fans)) {
-        notifyUserFetched(restored_uid,
-                          restored_name,
-                          restored_followers,
-                          restored_fans);
-      }
-    }
-    spdlog::info(fmt::format("restored {} visited nodes into UI", visited.size()));
+  const bool need_relations =
+      depth < m_max_depth && (m_crawlFollowers || m_crawlFans);
+  std::vector<uint64_t> follower_ids;
+  std::vector<uint64_t> fan_ids;
+  // Fans are queued and stored chunk by chunk while the listing runs, so a
+  // huge listing neither piles up in memory nor keeps idle workers waiting.
+  bool first_fan_chunk = true;
+  const FanChunkSink fan_sink = [this, uid, depth, &first_fan_chunk](std::vector<User> &chunk) {
+    ingest_fan_chunk(uid, depth, chunk, first_fan_chunk);
+    first_fan_chunk = false;
+  };
+  User user = get_user(uid, need_relations, &follower_ids, &fan_ids, fan_sink);
+
+  if (!m_running) {
+    return CrawlOutcome::Interrupted;
+  }
+  if (user.username.empty()) {
+    return CrawlOutcome::Failed;
   }
 
-  m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-  m_visited_total = visited.size();
-  emit_metrics(true);
-  save_crawl_state(queue, cursor, visited, m_self.uid);
-
-  while (m_running && cursor < queue.size()) {
-    const auto [uid, depth] = queue[cursor];
-    if (visited.count(uid)) {
-      cursor++;
-      m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-      m_visited_total = visited.size();
-      emit_metrics(false);
-      save_crawl_state(queue, cursor, visited, uid);
-      continue;
+  if (m_crawlWeibo) {
+    user.set_weibo(get_weibo(user));
+    if (m_weiboCallback) {
+      m_weiboCallback(user.uid, user.weibo);
     }
+    if (!m_running) {
+      return CrawlOutcome::Interrupted;
+    }
+  }
 
-    m_current_uid = uid;
-
-    const bool need_relations =
-        depth < m_max_depth && (m_crawlFollowers || m_crawlFans);
-    std::vector<uint64_t> follower_ids;
-    std::vector<uint64_t> fan_ids;
-    User user = get_user(uid, need_relations, &follower_ids, &fan_ids);
+  if (need_relations && discovered) {
+    discovered->insert(discovered->end(), follower_ids.begin(), follower_ids.end());
+    discovered->insert(discovered->end(), fan_ids.begin(), fan_ids.end());
+  }
+  if (fetched) {
+    *fetched = std::move(user);
+  }
+  return CrawlOutcome::Completed;
+}
 
-    if (!m_running) {
-      m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-      m_visited_total = visited.size();
-      emit_metrics(true);
-      save_crawl_state(queue, cursor, visited, uid);
-      break;
+void Spider::ingest_fan_chunk(uint64_t uid, int depth, std::vector<User> &chunk, bool first_chunk) {
+  {
+    std::lock_guard<std::mutex> lock(m_frontier_mutex);
+    for (const auto &fan : chunk) {
+      queue_child_locked(fan.uid, depth + 1);
     }
+    update_queue_metrics_locked();
+    checkpoint_locked(uid);
+  }
+  m_frontier_cv.notify_all();
+  PersistTask task;
+  task.user.uid = uid;
+  task.user.fans = std::move(chunk);
+  task.depth = depth;
+  task.fan_chunk = true;
+  task.first_chunk = first_chunk;
+  m_persist_queue->push(std::move(task));
+}
 
-    if (user.username.empty()) {
-      m_users_failed++;
-      cursor++;
-      m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-      m_visited_total = visited.size();
-      emit_metrics(true);
-      save_crawl_state(queue, cursor, visited, uid);
+void Spider::persist_worker() {
+  spdlog::debug("persist worker started");
+  PersistTask task;
+  while (m_persist_queue->pop(&task)) {
+    const uint64_t uid = task.user.uid;
+    if (task.fan_chunk) {
+      // The user itself follows later in the queue; it is not visited yet.
+      try {
+        m_persist_writer->write_fan_chunk(uid, task.user.fans, task.first_chunk);
+      } catch (const std::exception &e) {
+        spdlog::error(fmt::format("write {} fans of uid {} to mongodb failed: {}",
+                                  task.user.fans.size(), uid, e.what()));
+      }
       continue;
     }
-
-    if (m_crawlWeibo) {
-      user.set_weibo(get_weibo(user));
-      if (m_weiboCallback) {
-        m_weiboCallback(user.uid, user.weibo);
+    bool written = true;
+    try {
+      m_persist_writer->write_one(task.user);
+      spdlog::info("write uid: {} to mongodb!", uid);
+    } catch (const std::exception &e) {
+      spdlog::error(fmt::format("write uid {} to mongodb failed: {}", uid, e.what()));
+      written = false;
+    }
+    // Only visits that walked the timeline say anything about posting.
+    if (written && m_crawlWeibo && m_recrawl) {
+      m_recrawl->record_visit(uid, task.user.weibo.size());
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_frontier_mutex);
+      m_in_flight.erase(uid);
+      if (written) {
+        m_users_processed++;
+        m_visited.insert(uid);
+        m_journal.append(CrawlJournal::Op::Done, uid);
+      } else {
+        m_users_failed++;
+        m_journal.append(CrawlJournal::Op::Fail, uid);
+      }
+      update_queue_metrics_locked();
+      checkpoint_locked(uid);
+      if (written && m_users_processed % 1000 == 0) {
+        log_frontier_stats_locked("frontier");
       }
+    }
+    m_frontier_cv.notify_all();
+    emit_metrics(true);
+  }
+  spdlog::debug("persist worker finished");
+}
 
-      if (!m_running) {
-        m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-        m_visited_total = visited.size();
-        emit_metrics(true);
-        save_crawl_state(queue, cursor, visited, uid);
+void Spider::crawl_worker(int worker_id) {
+  spdlog::debug(fmt::format("crawl worker {} started", worker_id));
+  while (true) {
+    uint64_t uid = 0;
+    int depth = 0;
+    {
+      std::unique_lock<std::mutex> lock(m_frontier_mutex);
+      // Idle workers wait while others are still in flight: those may
+      // discover new users at the next depth.
+      m_frontier_cv.wait(lock, [this] {
+        return !m_running || !m_frontier.empty() || m_in_flight.empty();
+      });
+      if (!m_running || !m_frontier.pop(&uid, &depth)) {
         break;
       }
+      if (m_frontier.disk_backed() && m_visited.contains(uid)) {
+        // Popped before a crash and finished, but the queue head was not
+        // committed after; skip instead of crawling it again.
+        update_queue_metrics_locked();
+        continue;
+      }
+      m_in_flight.emplace(uid, depth);
+      m_journal.append(CrawlJournal::Op::Claim, uid, depth);
+      update_queue_metrics_locked();
     }
 
-    m_writer->write_one(user);
-    m_users_processed++;
-    visited.insert(uid);
-    cursor++;
-    spdlog::info("write uid: {} to mongodb!", user.uid);
+    User fetched;
+    std::vector<uint64_t> discovered;
+    const CrawlOutcome outcome = crawl_user(uid, depth, &fetched, &discovered);
 
-    if (need_relations) {
-      for (const auto id : follower_ids) {
-        if (!visited.count(id)) {
-          queue.emplace_back(id, depth + 1);
-        }
+    {
+      std::lock_guard<std::mutex> lock(m_frontier_mutex);
+      if (outcome == CrawlOutcome::Interrupted) {
+        // Keep the entry in flight so the checkpoint re-queues it.
+        checkpoint_locked(uid);
+        break;
       }
-      for (const auto id : fan_ids) {
-        if (!visited.count(id)) {
-          queue.emplace_back(id, depth + 1);
+      if (outcome == CrawlOutcome::Failed) {
+        m_in_flight.erase(uid);
+        m_users_failed++;
+        m_journal.append(CrawlJournal::Op::Fail, uid);
+      } else {
+        // Children are queued right away; the user itself stays in flight
+        // until the persist stage has written it.
+        for (const auto id : discovered) {
+          queue_child_locked(id, depth + 1);
         }
       }
+      update_queue_metrics_locked();
+      checkpoint_locked(uid);
+    }
+    m_frontier_cv.notify_all();
+    if (outcome == CrawlOutcome::Completed) {
+      // Blocks while the persist stage is a full queue behind.
+      m_persist_queue->push(PersistTask{std::move(fetched), depth});
     }
-
-    m_queue_pending = queue.size() > cursor ? queue.size() - cursor : 0;
-    m_visited_total = visited.size();
     emit_metrics(true);
-    save_crawl_state(queue, cursor, visited, uid);
+  }
+  m_frontier_cv.notify_all();
+  spdlog::debug(fmt::format("crawl worker {} finished", worker_id));
+}
+
+bool Spider::seed_recrawl_plan() {
+  if (!m_recrawl_scheduled || !m_recrawl) {
+    return false;
+  }
+  if (m_recrawl->stats().users == 0) {
+    spdlog::info("recrawl model is empty; crawling from the root to build it");
+    return false;
+  }
+  const std::vector<RecrawlCandidate> plan = m_recrawl->plan(m_recrawl_window_seconds, m_recrawl_max_users);
+  double expected_posts = 0.0;
+  for (const RecrawlCandidate &candidate : plan) {
+    m_frontier.push(candidate.uid, m_max_depth);
+    expected_posts += candidate.expected_posts;
+  }
+  spdlog::info(fmt::format(
+      "recrawl plan: {} users due within {}min (limit {}), {:.1f} new posts expected",
+      plan.size(),
+      m_recrawl_window_seconds / 60,
+      m_recrawl_max_users,
+      expected_posts));
+  if (!plan.empty()) {
+    const RecrawlCandidate &top = plan.front();
+    spdlog::debug(fmt::format("recrawl plan head: uid {} at {:.2f} posts/day, {:.1f} expected",
+                              top.uid, top.posts_per_day, top.expected_posts));
+  }
+  return true;
+}
+
+void Spider::run() {
+  m_running = true;
+  spdlog::info(fmt::format(
+      "spider run started, root uid={}, max_depth={}, workers={}",
+      m_self.uid,
+      m_max_depth,
+      m_workers));
+
+  m_in_flight.clear();
+
+  if (!load_crawl_state(&m_frontier, &m_visited)) {
+    m_frontier.clear();
+    m_visited.clear();
+    if (!seed_recrawl_plan()) {
+      m_frontier.push(m_self.uid, 0);
+    }
+  } else {
+    // Restore already-visited nodes in GUI so resume keeps previous graph visible.
+    restore_visited_users();
   }
 
-  if (cursor >= queue.size()) {
-    clear_crawl_state();
+  {
+    std::lock_guard<std::mutex> lock(m_frontier_mutex);
+    update_queue_metrics_locked();
+    save_crawl_state(m_self.uid);
+  }
+  emit_metrics(true);
+
+  // Fetch/parse (crawl workers) -> persist (one thread), so MongoDB writes
+  // overlap with the next user's requests.
+  m_persist_queue = std::make_unique<BoundedQueue<PersistTask>>(m_persist_queue_capacity);
+  std::thread persist_thread(&Spider::persist_worker, this);
+  if (m_workers <= 1) {
+    crawl_worker(0);
+  } else {
+    std::vector<std::thread> workers;
+    workers.reserve(static_cast<size_t>(m_workers));
+    for (int i = 0; i < m_workers; ++i) {
+      workers.emplace_back(&Spider::crawl_worker, this, i);
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+  // Users already fetched are still written after a stop.
+  m_persist_queue->close();
+  persist_thread.join();
+  {
+    const auto queue_stats = m_persist_queue->stats();
+    spdlog::info(fmt::format(
+        "pipeline: {} users persisted, queue high water {}/{}, fetch stalled {}ms on a full queue, persist idle {}ms",
+        queue_stats.pushed,
+        queue_stats.high_water,
+        m_persist_queue->capacity(),
+        queue_stats.push_stall_ms,
+        queue_stats.pop_stall_ms));
+  }
+  for (const auto &session : m_session_pool->stats()) {
+    spdlog::info(fmt::format(
+        "session {}: {} requests, {} throttled, quarantined {} times",
+        session.name,
+        session.requests,
+        session.throttled,
+        session.quarantines));
+  }
+  for (const auto &endpoint : m_session_pool->endpoint_stats()) {
+    spdlog::info(fmt::format(
+        "rate limit {}: {} requests, {} throttled, {} pauses, ending at {:.2f} req/s; "
+        "waited {}ms (spacing {}ms, cooldown {}ms, pause {}ms, jitter {}ms)",
+        endpoint.name,
+        endpoint.requests,
+        endpoint.throttled,
+        endpoint.pauses,
+        endpoint.rate_rps,
+        endpoint.wait_ms,
+        endpoint.spacing_wait_ms,
+        endpoint.cooldown_wait_ms,
+        endpoint.pause_wait_ms,
+        endpoint.jitter_wait_ms));
+  }
+  spdlog::info(fmt::format("retry backoff: {}ms", m_retry_backoff_ms.load()));
+  {
+    const HttpTransportStats http = m_transport->stats();
+    spdlog::info(fmt::format(
+        "connections: {} requests over {} connections ({} reused, at most {} per connection), "
+        "{} idle expired, {} closed by server; {} handshakes ({} resumed) took {:.0f}ms, "
+        "{:.1f}% of {:.0f}ms request time",
+        http.requests,
+        http.connections_opened,
+        http.reused,
+        http.max_requests_per_connection,
+        http.idle_expired,
+        http.idle_closed,
+        http.handshakes,
+        http.resumed_handshakes,
+        http.handshake_ms,
+        http.request_ms > 0 ? 100.0 * http.handshake_ms / http.request_ms : 0.0,
+        http.request_ms));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_frontier_mutex);
+    if (m_frontier.empty() && m_in_flight.empty()) {
+      clear_crawl_state();
+    } else {
+      // Compact the journal so the next resume starts from one snapshot.
+      save_crawl_state(m_current_uid);
+    }
+    m_visited.flush();
+    m_frontier.flush();
+    log_frontier_stats_locked("frontier final");
+    m_in_flight.clear();
+    m_visited_total = m_visited.size();
+  }
+  if (m_recrawl) {
+    m_recrawl->flush();
+    const RecrawlScheduler::Stats recrawl = m_recrawl->stats();
+    spdlog::info(fmt::format("recrawl model: {} users, {} due now", recrawl.users, recrawl.due));
+  }
+  if (m_checkpoint_writer) {
+    m_checkpoint_writer->drain();
+    const auto stats = m_checkpoint_writer->stats();
+    spdlog::info(fmt::format(
+        "checkpoint writer: {} snapshots ({} superseded), {} journal writes ({} bytes), {} fsyncs, {} failures",
+        stats.snapshots_written,
+        stats.snapshots_superseded,
+        stats.journal_writes,
+        stats.journal_bytes,
+        stats.fsyncs,
+        stats.failures));
+  }
+  m_profile_cache->flush();
+  {
+    const auto cache_stats = m_profile_cache->stats();
+    spdlog::info(fmt::format(
+        "profile cache: {} hits, {} misses ({} expired), {} entries",
+        cache_stats.hits,
+        cache_stats.misses,
+        cache_stats.expired,
+        cache_stats.entries));
   }
   m_queue_pending = 0;
-  m_visited_total = visited.size();
   emit_metrics(true);
   spdlog::info(fmt::format("spider run finished, root uid={}", m_self.uid));
 }
@@ -731,67 +1445,109 @@ std::vector<User> Spider::batch_get_user(const std::vector<uint64_t> &ids) {
   return ret;
 }
 
+std::vector<User> Spider::complete_listed_users(std::vector<User> listed) {
+  size_t harvested = 0;
+  size_t fetched = 0;
+  for (size_t i = 0; i < listed.size(); ++i) {
+    if (!m_running) {
+      listed.resize(i);
+      break;
+    }
+    User &user = listed[i];
+    if (m_harvest_listing_profiles && !user.username.empty()) {
+      notifyUserFetched(user.uid, user.username, {}, {});
+      harvested++;
+    } else {
+      user = get_user(user.uid);
+      fetched++;
+    }
+  }
+  spdlog::debug(fmt::format(
+      "listed users: {} from listing, {} from profile requests",
+      harvested,
+      fetched));
+  return listed;
+}
+
 std::vector<Weibo> Spider::get_weibo(const User &user) {
   int page_cnt = 1;
   std::vector<Weibo> weibos;
 
-  // Load existing weibo IDs to skip already-stored posts
-  std::set<uint64_t> existing_ids = m_writer->get_stored_weibo_ids(user.uid);
+  // Where the stored timeline ends; the walk stops there.
+  WeiboWatermark watermark;
+  {
+    std::lock_guard<std::mutex> lock(m_writer_mutex);
+    watermark = m_writer->get_weibo_watermark(user.uid);
+  }
   spdlog::info(fmt::format(
-      "{} existing weibos in db for uid {}",
-      existing_ids.size(), user.uid));
+      "weibo watermark for uid {}: max id {}, {} pinned, last crawled at {}ms",
+      user.uid, watermark.max_id, watermark.pinned_ids.size(), watermark.crawled_at_ms));
+
+  // Page N+1 is requested (through the shared pacing budget) while page N
+  // is turned into posts, but only once page N's verdicts show the walk
+  // goes on: incremental crawls mostly stop on the first page, and a
+  // lookahead started earlier would spend a request slot on every one.
+  std::atomic<bool> cancel_prefetch{false};
+  auto fetch_page = [this, &user, &cancel_prefetch](int page) {
+    return std::async(std::launch::async, [this, uid = user.uid, page, &cancel_prefetch] {
+      return get_with_retry(
+          fmt::format("/ajax/statuses/mymblog?uid={}&page={}&", uid, page),
+          fmt::format("get_weibo uid={} page={}", uid, page),
+          &cancel_prefetch);
+    });
+  };
+  std::future<std::optional<HttpResponse>> next_page = fetch_page(page_cnt);
+  // Cancels and joins the lookahead on every exit path, parse errors included.
+  struct PrefetchGuard {
+    std::atomic<bool> &cancel;
+    std::future<std::optional<HttpResponse>> &page;
+    ~PrefetchGuard() {
+      cancel = true;
+      if (page.valid()) {
+        page.wait();
+      }
+    }
+  } prefetch_guard{cancel_prefetch, next_page};
 
   bool hit_existing = false;
   while (m_running && !hit_existing) {
-    const std::string url = fmt::format(
-        "/ajax/statuses/mymblog?uid={}&page={}&", user.uid, page_cnt);
-    auto result = get_with_retry(
-        url,
-        fmt::format("get_weibo uid={} page={}", user.uid, page_cnt));
+    auto result = next_page.get();
     if (!result) {
       spdlog::error("HTTP request failed for weibo");
       break;
     }
-    auto resp = json::parse(result->body);
-    auto data = resp["data"];
-    std::vector<json::basic_json::object_t> items = data["list"];
-    if (items.empty()) {
+    TimelinePage page = decode_timeline(result->body);
+    if (page.posts.empty()) {
       break;
     }
-    for (auto &item : items) {
-       std::string tm = item["created_at"].get<std::string>();
-       std::string text = item["text"].get<std::string>();
-       uint64_t id = item["id"].get<uint64_t>();
-
-       // Stop when we hit an already-stored weibo
-       if (existing_ids.count(id)) {
-         spdlog::info(fmt::format(
-             "hit existing weibo id , stopping", id));
-         hit_existing = true;
-         break;
+    // Stop when we hit an already-stored weibo
+    size_t page_end = page.posts.size();
+    for (size_t i = 0; i < page.posts.size(); ++i) {
+      if (watermark.classify(page.posts[i].id, page.posts[i].pinned) == WeiboWatermark::Verdict::Stop) {
+        spdlog::info(fmt::format(
+            "hit existing weibo id {}, stopping", page.posts[i].id));
+        hit_existing = true;
+        page_end = i;
+        break;
+      }
+    }
+    if (!hit_existing) {
+      next_page = fetch_page(page_cnt + 1);
+    }
+    for (size_t i = 0; i < page_end; ++i) {
+       auto &post = page.posts[i];
+       const uint64_t id = post.id;
+       if (watermark.classify(id, post.pinned) == WeiboWatermark::Verdict::Known) {
+         continue;
        }
 
-       std::vector<std::string> urls;
-       if (item.count("pic_infos")) {
-         const auto& pic_infos = item["pic_infos"];
-         for (auto& [key, value] : pic_infos.items()) {
-           if (!value.contains("large")) {
-             continue;
-           }
-           std::string url = value["large"]["url"].get<std::string>();
-           urls.push_back(url);
-         }
-       }
-       std::string video_url;
-       if (item.count("page_info") && item["page_info"].count("media_info") && 
-           item["page_info"]["media_info"].count("stream_url")) {
-         video_url = item["page_info"]["media_info"]["stream_url"].get<std::string>();
-         if (video_url.find("http") != 0) {
-           video_url = "";
-         }
+       std::string video_url = std::move(post.stream_url);
+       if (video_url.find("http") != 0) {
+         video_url = "";
        }
-       Weibo weibo(text, tm, id, urls, video_url);
-       weibos.push_back(weibo);
+       weibos.emplace_back(std::move(post.text), std::move(post.created_at), id,
+                           std::move(post.pics), std::move(video_url));
+       weibos.back().pinned = post.pinned;
        spdlog::info(fmt::format(
            "crawling uid {} username {} #{} (id={})",
            user.uid,
@@ -800,7 +1556,6 @@ std::vector<Weibo> Spider::get_weibo(const User &user) {
            id));
      }
     page_cnt += 1;
-    std::this_thread::sleep_for(std::chrono::seconds(2));
   }
   spdlog::info(fmt::format(
       "weibo crawl done: {} new weibos for uid {}",
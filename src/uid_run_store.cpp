@@ -0,0 +1,525 @@
+#include "uid_run_store.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <queue>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kRunMagic[4] = {'U', 'I', 'D', 'R'};
+constexpr uint32_t kRunVersion = 1;
+// magic + version + count; keeps the uint64 payload 8-byte aligned.
+constexpr size_t kRunHeaderBytes = 16;
+constexpr const char *kRunPrefix = "run-";
+constexpr const char *kRunSuffix = ".uids";
+
+constexpr const char *kCorruptSuffix = ".corrupt";
+
+void write_header(std::ofstream &ofs, uint64_t count) {
+  ofs.write(kRunMagic, sizeof(kRunMagic));
+  ofs.write(reinterpret_cast<const char *>(&kRunVersion), sizeof(kRunVersion));
+  ofs.write(reinterpret_cast<const char *>(&count), sizeof(count));
+}
+
+// Renames a finished tmp file into place. durable syncs the data first
+// and the directory entry after, so the run is either fully there or not
+// there at all after a power loss.
+void publish_run(const std::string &tmp, const std::string &path, bool durable) {
+  if (durable) {
+    const int fd = ::open(tmp.c_str(), O_RDONLY);
+    if (fd < 0 || ::fdatasync(fd) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error(fmt::format("failed to sync uid run {}", tmp));
+    }
+    ::close(fd);
+  }
+  fs::rename(tmp, path);
+  if (durable) {
+    const std::string dir = fs::path(path).parent_path().string();
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0 || ::fsync(fd) != 0) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error(fmt::format("failed to sync uid store dir {}", dir));
+    }
+    ::close(fd);
+  }
+}
+}
+
+UidRunStore::UidRunStore(std::string dir,
+                         size_t buffer_limit,
+                         size_t merge_width,
+                         bool durable,
+                         bool background_merge)
+    : m_dir(std::move(dir)),
+      m_buffer_limit(std::max<size_t>(buffer_limit, 1)),
+      m_merge_width(std::max<size_t>(merge_width, 2)),
+      m_durable(durable),
+      m_background_merge(background_merge) {
+  m_frozen_runs->durable = m_durable;
+  std::error_code ec;
+  fs::create_directories(m_dir, ec);
+  if (ec) {
+    throw std::runtime_error(fmt::format("failed to create uid store dir {}: {}", m_dir, ec.message()));
+  }
+  open_existing();
+}
+
+UidRunStore::~UidRunStore() {
+  try {
+    flush();
+  } catch (const std::exception &e) {
+    spdlog::error(fmt::format("uid store flush on close failed {}: {}", m_dir, e.what()));
+  }
+  for (auto &run : m_runs) {
+    unmap_run(&run);
+  }
+}
+
+bool UidRunStore::contains(uint64_t uid) const {
+  if (m_buffer.contains(uid)) {
+    return true;
+  }
+  for (auto it = m_frozen.rbegin(); it != m_frozen.rend(); ++it) {
+    if (it->uids->contains(uid)) {
+      return true;
+    }
+  }
+  for (auto it = m_runs.rbegin(); it != m_runs.rend(); ++it) {
+    if (std::binary_search(it->data, it->data + it->count, uid)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void UidRunStore::insert(uint64_t uid) {
+  if (!m_frozen.empty() || m_merge_pending) {
+    adopt_written(false);
+  }
+  m_buffer.insert(uid);
+  if (m_buffer.size() >= m_buffer_limit) {
+    flush();
+  }
+}
+
+void UidRunStore::flush() {
+  if (m_buffer.empty() && m_frozen.empty()) {
+    return;
+  }
+  if (!m_buffer.empty()) {
+    freeze_buffer();
+  }
+  write_frozen(m_frozen_runs);
+  adopt_written(true);
+}
+
+std::function<void()> UidRunStore::seal() {
+  if (!m_buffer.empty()) {
+    freeze_buffer();
+  }
+  adopt_written(false);
+  return [runs = m_frozen_runs] {
+    write_frozen(runs);
+    run_planned_merge(runs);
+  };
+}
+
+void UidRunStore::freeze_buffer() {
+  Frozen frozen;
+  frozen.path = next_run_path();
+  frozen.uids = std::make_shared<const UidSet>(std::move(m_buffer));
+  m_buffer = UidSet();
+  m_frozen.push_back(frozen);
+  std::lock_guard<std::mutex> lock(m_frozen_runs->mutex);
+  m_frozen_runs->unwritten.push_back(std::move(frozen));
+}
+
+void UidRunStore::adopt_written(bool blocking) {
+  std::unique_lock<std::mutex> io_lock(m_frozen_runs->io_mutex, std::defer_lock);
+  if (blocking) {
+    io_lock.lock();
+  }
+  std::vector<std::string> written;
+  std::vector<Merge> merged;
+  {
+    std::lock_guard<std::mutex> lock(m_frozen_runs->mutex);
+    written.swap(m_frozen_runs->written);
+    merged.swap(m_frozen_runs->merged);
+  }
+  for (const std::string &path : written) {
+    auto it = std::find_if(m_frozen.begin(), m_frozen.end(),
+                           [&path](const Frozen &frozen) { return frozen.path == path; });
+    if (it == m_frozen.end()) {
+      continue;
+    }
+    m_runs.push_back(map_run(path));
+    m_frozen.erase(it);
+  }
+  for (const Merge &merge : merged) {
+    adopt_merge(merge);
+    m_merge_pending = false;
+  }
+  if (!written.empty() || !merged.empty()) {
+    schedule_merges();
+  }
+}
+
+void UidRunStore::adopt_merge(const Merge &merge) {
+  m_runs.push_back(map_run(merge.output));
+  for (const std::string &input : merge.inputs) {
+    auto it = std::find_if(m_runs.begin(), m_runs.end(),
+                           [&input](const Run &run) { return run.path == input; });
+    if (it != m_runs.end()) {
+      unmap_run(&*it);
+      m_runs.erase(it);
+    }
+  }
+}
+
+size_t UidRunStore::tier_of(size_t count) const {
+  size_t tier = 0;
+  for (size_t limit = m_buffer_limit; count > limit; limit *= m_merge_width) {
+    tier++;
+  }
+  return tier;
+}
+
+std::optional<UidRunStore::Merge> UidRunStore::pick_merge() {
+  std::vector<std::vector<const Run *>> tiers;
+  for (const Run &run : m_runs) {
+    const size_t tier = tier_of(run.count);
+    if (tier >= tiers.size()) {
+      tiers.resize(tier + 1);
+    }
+    tiers[tier].push_back(&run);
+  }
+  for (const auto &tier : tiers) {
+    if (tier.size() < m_merge_width) {
+      continue;
+    }
+    Merge merge;
+    for (size_t i = 0; i < m_merge_width; ++i) {
+      merge.inputs.push_back(tier[i]->path);
+    }
+    merge.output = next_run_path();
+    return merge;
+  }
+  return std::nullopt;
+}
+
+void UidRunStore::schedule_merges() {
+  if (m_background_merge) {
+    if (m_merge_pending) {
+      return;
+    }
+    auto merge = pick_merge();
+    if (!merge) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(m_frozen_runs->mutex);
+    m_frozen_runs->planned = std::move(*merge);
+    m_merge_pending = true;
+    return;
+  }
+  while (auto merge = pick_merge()) {
+    merge_files(*merge, m_durable);
+    for (const std::string &input : merge->inputs) {
+      std::remove(input.c_str());
+    }
+    adopt_merge(*merge);
+  }
+}
+
+void UidRunStore::write_frozen(const std::shared_ptr<FrozenRuns> &runs) {
+  std::lock_guard<std::mutex> io_lock(runs->io_mutex);
+  std::vector<Frozen> todo;
+  {
+    std::lock_guard<std::mutex> lock(runs->mutex);
+    if (runs->cancelled) {
+      return;
+    }
+    todo = runs->unwritten;
+  }
+  size_t failed = 0;
+  for (const Frozen &frozen : todo) {
+    try {
+      write_run(frozen.path, frozen.uids->sorted(), runs->durable);
+    } catch (const std::exception &e) {
+      spdlog::error(e.what());
+      failed++;
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(runs->mutex);
+    if (runs->cancelled) {
+      // clear() ran meanwhile; do not resurrect its runs.
+      std::remove(frozen.path.c_str());
+      return;
+    }
+    auto &unwritten = runs->unwritten;
+    unwritten.erase(std::find_if(unwritten.begin(), unwritten.end(),
+                                 [&frozen](const Frozen &f) { return f.path == frozen.path; }));
+    runs->written.push_back(frozen.path);
+  }
+  if (failed > 0) {
+    throw std::runtime_error(fmt::format("{} uid runs could not be written", failed));
+  }
+}
+
+void UidRunStore::run_planned_merge(const std::shared_ptr<FrozenRuns> &runs) {
+  std::lock_guard<std::mutex> io_lock(runs->io_mutex);
+  Merge merge;
+  {
+    std::lock_guard<std::mutex> lock(runs->mutex);
+    if (runs->cancelled || !runs->planned) {
+      return;
+    }
+    merge = std::move(*runs->planned);
+    runs->planned.reset();
+  }
+  try {
+    merge_files(merge, runs->durable);
+  } catch (const std::exception &e) {
+    // The snapshot does not depend on the merge; retry on the next task.
+    spdlog::error(e.what());
+    std::remove((merge.output + ".tmp").c_str());
+    std::lock_guard<std::mutex> lock(runs->mutex);
+    runs->planned = std::move(merge);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(runs->mutex);
+  if (runs->cancelled) {
+    std::remove(merge.output.c_str());
+    return;
+  }
+  // The store keeps its inputs mapped until it adopts the merge. A crash
+  // before these removals leaves uids in two runs; the next merge of
+  // them drops the duplicates.
+  for (const std::string &input : merge.inputs) {
+    std::remove(input.c_str());
+  }
+  runs->merged.push_back(std::move(merge));
+}
+
+void UidRunStore::clear() {
+  {
+    std::lock_guard<std::mutex> lock(m_frozen_runs->mutex);
+    m_frozen_runs->cancelled = true;
+  }
+  m_frozen_runs = std::make_shared<FrozenRuns>();
+  m_frozen_runs->durable = m_durable;
+  m_merge_pending = false;
+  m_frozen.clear();
+  m_buffer.clear();
+  for (auto &run : m_runs) {
+    unmap_run(&run);
+    std::remove(run.path.c_str());
+  }
+  m_runs.clear();
+}
+
+size_t UidRunStore::size() const {
+  size_t total = m_buffer.size();
+  for (const auto &frozen : m_frozen) {
+    total += frozen.uids->size();
+  }
+  for (const auto &run : m_runs) {
+    total += run.count;
+  }
+  return total;
+}
+
+void UidRunStore::for_each(const std::function<void(uint64_t)> &fn) const {
+  for (const auto &run : m_runs) {
+    std::for_each(run.data, run.data + run.count, fn);
+  }
+  for (const auto &frozen : m_frozen) {
+    frozen.uids->for_each(fn);
+  }
+  m_buffer.for_each(fn);
+}
+
+void UidRunStore::open_existing() {
+  std::vector<std::pair<uint64_t, std::string>> found;
+  for (const auto &entry : fs::directory_iterator(m_dir)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind(kRunPrefix, 0) != 0 || entry.path().extension() != kRunSuffix) {
+      continue;
+    }
+    try {
+      const uint64_t seq = std::stoull(name.substr(std::strlen(kRunPrefix)));
+      found.emplace_back(seq, entry.path().string());
+    } catch (const std::exception &) {
+      spdlog::warn(fmt::format("ignore unexpected file in uid store: {}", name));
+    }
+  }
+  std::sort(found.begin(), found.end());
+  for (const auto &[seq, path] : found) {
+    m_next_seq = std::max(m_next_seq, seq + 1);
+    try {
+      m_runs.push_back(map_run(path));
+    } catch (const std::exception &e) {
+      // A torn run from before a crash must not make the store unusable;
+      // keep it aside for inspection.
+      spdlog::warn(fmt::format("set aside unreadable uid run: {}", e.what()));
+      std::error_code ec;
+      fs::rename(path, path + kCorruptSuffix, ec);
+    }
+  }
+  if (!m_runs.empty()) {
+    spdlog::info(fmt::format("uid store {} reopened: {} runs, {} uids", m_dir, m_runs.size(), size()));
+  }
+  schedule_merges();
+}
+
+UidRunStore::Run UidRunStore::map_run(const std::string &path) {
+  Run run;
+  run.path = path;
+  run.fd = ::open(path.c_str(), O_RDONLY);
+  if (run.fd < 0) {
+    throw std::runtime_error(fmt::format("failed to open uid run {}", path));
+  }
+  struct stat st {};
+  if (::fstat(run.fd, &st) != 0 || static_cast<size_t>(st.st_size) < kRunHeaderBytes) {
+    ::close(run.fd);
+    throw std::runtime_error(fmt::format("uid run too short: {}", path));
+  }
+  run.map_bytes = static_cast<size_t>(st.st_size);
+  run.map = ::mmap(nullptr, run.map_bytes, PROT_READ, MAP_SHARED, run.fd, 0);
+  if (run.map == MAP_FAILED) {
+    ::close(run.fd);
+    throw std::runtime_error(fmt::format("failed to mmap uid run {}", path));
+  }
+  // Lookups are binary searches: tell the kernel not to read ahead.
+  ::madvise(run.map, run.map_bytes, MADV_RANDOM);
+
+  const char *base = static_cast<const char *>(run.map);
+  uint64_t count = 0;
+  std::memcpy(&count, base + 8, sizeof(count));
+  if (std::memcmp(base, kRunMagic, sizeof(kRunMagic)) != 0 ||
+      kRunHeaderBytes + count * sizeof(uint64_t) > run.map_bytes) {
+    unmap_run(&run);
+    throw std::runtime_error(fmt::format("corrupt uid run {}", path));
+  }
+  run.data = reinterpret_cast<const uint64_t *>(base + kRunHeaderBytes);
+  run.count = static_cast<size_t>(count);
+  return run;
+}
+
+void UidRunStore::unmap_run(Run *run) {
+  if (run->map && run->map != MAP_FAILED) {
+    ::munmap(run->map, run->map_bytes);
+  }
+  if (run->fd >= 0) {
+    ::close(run->fd);
+  }
+  run->map = nullptr;
+  run->fd = -1;
+  run->data = nullptr;
+}
+
+std::string UidRunStore::next_run_path() {
+  return (fs::path(m_dir) / fmt::format("{}{:010}{}", kRunPrefix, m_next_seq++, kRunSuffix)).string();
+}
+
+void UidRunStore::write_run(const std::string &path, const std::vector<uint64_t> &sorted, bool durable) {
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+      throw std::runtime_error(fmt::format("failed to write uid run {}", tmp));
+    }
+    write_header(ofs, sorted.size());
+    ofs.write(reinterpret_cast<const char *>(sorted.data()),
+              static_cast<std::streamsize>(sorted.size() * sizeof(uint64_t)));
+    if (!ofs) {
+      throw std::runtime_error(fmt::format("failed to write uid run {}", tmp));
+    }
+  }
+  publish_run(tmp, path, durable);
+}
+
+uint64_t UidRunStore::merge_files(const Merge &merge, bool durable) {
+  std::vector<Run> inputs;
+  struct Unmap {
+    std::vector<Run> *runs;
+    ~Unmap() {
+      for (auto &run : *runs) {
+        unmap_run(&run);
+      }
+    }
+  } unmap{&inputs};
+  for (const std::string &path : merge.inputs) {
+    inputs.push_back(map_run(path));
+  }
+
+  const std::string tmp = merge.output + ".tmp";
+  uint64_t total = 0;
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+      throw std::runtime_error(fmt::format("failed to write uid run {}", tmp));
+    }
+    write_header(ofs, 0);
+
+    // k-way merge over the mapped runs. Runs do not overlap unless a crash
+    // interrupted an earlier merge, so equal uids are dropped.
+    using Cursor = std::pair<uint64_t, size_t>;  // (uid, run index)
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    std::vector<size_t> pos(inputs.size(), 0);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      if (inputs[i].count > 0) {
+        heap.emplace(inputs[i].data[0], i);
+      }
+    }
+    std::vector<uint64_t> out;
+    out.reserve(1 << 16);
+    bool any = false;
+    uint64_t last = 0;
+    while (!heap.empty()) {
+      const auto [uid, i] = heap.top();
+      heap.pop();
+      if (!any || uid != last) {
+        out.push_back(uid);
+        any = true;
+        last = uid;
+      }
+      if (out.size() == out.capacity()) {
+        ofs.write(reinterpret_cast<const char *>(out.data()),
+                  static_cast<std::streamsize>(out.size() * sizeof(uint64_t)));
+        total += out.size();
+        out.clear();
+      }
+      if (++pos[i] < inputs[i].count) {
+        heap.emplace(inputs[i].data[pos[i]], i);
+      }
+    }
+    ofs.write(reinterpret_cast<const char *>(out.data()),
+              static_cast<std::streamsize>(out.size() * sizeof(uint64_t)));
+    total += out.size();
+
+    ofs.seekp(8);
+    ofs.write(reinterpret_cast<const char *>(&total), sizeof(total));
+    if (!ofs) {
+      throw std::runtime_error(fmt::format("failed to write uid run {}", tmp));
+    }
+  }
+  publish_run(tmp, merge.output, durable);
+  spdlog::info(fmt::format("merged {} uid runs into {} ({} uids)", merge.inputs.size(), merge.output, total));
+  return total;
+}
@@ -0,0 +1,105 @@
+#include "uid_set.hpp"
+#include <algorithm>
+
+namespace {
+constexpr size_t kMinSlots = 16;
+// Grow when m_size / slots would exceed 7/10.
+constexpr size_t kLoadNum = 7;
+constexpr size_t kLoadDen = 10;
+
+size_t slots_for(size_t expected) {
+  size_t slots = kMinSlots;
+  while (slots * kLoadNum / kLoadDen < expected) {
+    slots <<= 1;
+  }
+  return slots;
+}
+}
+
+uint64_t UidSet::hash(uint64_t uid) {
+  // splitmix64 finalizer: uids are clustered, so mix all bits before masking.
+  uid ^= uid >> 30;
+  uid *= 0xbf58476d1ce4e5b9ULL;
+  uid ^= uid >> 27;
+  uid *= 0x94d049bb133111ebULL;
+  uid ^= uid >> 31;
+  return uid;
+}
+
+bool UidSet::insert(uint64_t uid) {
+  if (uid == 0) {
+    const bool inserted = !m_has_zero;
+    m_has_zero = true;
+    return inserted;
+  }
+  if (contains(uid)) {
+    return false;
+  }
+  if (m_slots.empty() || (m_size + 1) * kLoadDen > m_slots.size() * kLoadNum) {
+    rehash(std::max(kMinSlots, m_slots.size() * 2));
+  }
+  insert_slot(uid);
+  m_size++;
+  return true;
+}
+
+bool UidSet::contains(uint64_t uid) const {
+  if (uid == 0) {
+    return m_has_zero;
+  }
+  if (m_slots.empty()) {
+    return false;
+  }
+  const size_t mask = m_slots.size() - 1;
+  for (size_t i = hash(uid) & mask;; i = (i + 1) & mask) {
+    const uint64_t slot = m_slots[i];
+    if (slot == uid) {
+      return true;
+    }
+    if (slot == 0) {
+      return false;
+    }
+  }
+}
+
+void UidSet::clear() {
+  m_slots.clear();
+  m_slots.shrink_to_fit();
+  m_size = 0;
+  m_has_zero = false;
+}
+
+void UidSet::reserve(size_t expected) {
+  const size_t slots = slots_for(expected);
+  if (slots > m_slots.size()) {
+    rehash(slots);
+  }
+}
+
+std::vector<uint64_t> UidSet::sorted() const {
+  std::vector<uint64_t> ret;
+  ret.reserve(size());
+  for_each([&ret](uint64_t uid) { ret.push_back(uid); });
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+void UidSet::rehash(size_t slot_count) {
+  std::vector<uint64_t> old;
+  old.swap(m_slots);
+  m_slots.assign(slot_count, 0);
+  for (const uint64_t uid : old) {
+    if (uid != 0) {
+      insert_slot(uid);
+    }
+  }
+}
+
+void UidSet::insert_slot(uint64_t uid) {
+  const size_t mask = m_slots.size() - 1;
+  size_t i = hash(uid) & mask;
+  while (m_slots[i] != 0) {
+    i = (i + 1) & mask;
+  }
+  m_slots[i] = uid;
+}
@@ -0,0 +1,125 @@
+#include "visited_index.hpp"
+#include <atomic>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+VisitedIndex::VisitedIndex(const VisitedIndexOptions &options)
+    : m_options(options) {
+  if (!m_options.tiered) {
+    return;
+  }
+  m_bloom = BloomFilter(m_options.bloom_expected_items, m_options.bloom_fpr);
+  m_store = std::make_unique<UidRunStore>(m_options.dir,
+                                          m_options.buffer_uids,
+                                          UidRunStore::kDefaultMergeWidth,
+                                          m_options.durable_runs,
+                                          m_options.background_merge);
+  m_store->for_each([this](uint64_t uid) { m_bloom.add(uid); });
+  spdlog::info(fmt::format(
+      "visited index {}: tiered, bloom={}MB k={} target_fpr={}, {} uids on disk",
+      m_options.dir,
+      m_bloom.memory_bytes() / 1048576,
+      m_bloom.hash_count(),
+      m_options.bloom_fpr,
+      m_store->size()));
+}
+
+bool VisitedIndex::insert(uint64_t uid) {
+  if (!m_store) {
+    return own_memory().insert(uid);
+  }
+  if (contains(uid)) {
+    return false;
+  }
+  m_bloom.add(uid);
+  m_store->insert(uid);
+  return true;
+}
+
+bool VisitedIndex::contains(uint64_t uid) const {
+  if (!m_store) {
+    return m_memory->contains(uid);
+  }
+  m_lookups++;
+  if (!m_bloom.possibly_contains(uid)) {
+    m_bloom_negatives++;
+    return false;
+  }
+  m_disk_probes++;
+  if (m_store->contains(uid)) {
+    return true;
+  }
+  m_false_positives++;
+  return false;
+}
+
+size_t VisitedIndex::size() const {
+  return m_store ? m_store->size() : m_memory->size();
+}
+
+void VisitedIndex::clear() {
+  m_memory = std::make_shared<UidSet>();
+  if (m_store) {
+    m_store->clear();
+    m_bloom.clear();
+  }
+}
+
+void VisitedIndex::reserve(size_t expected) {
+  if (!m_store) {
+    own_memory().reserve(expected);
+  }
+}
+
+void VisitedIndex::flush() {
+  if (m_store) {
+    m_store->flush();
+  }
+}
+
+std::shared_ptr<const UidSet> VisitedIndex::view() const {
+  return m_memory;
+}
+
+std::function<void()> VisitedIndex::seal() {
+  return m_store ? m_store->seal() : std::function<void()>();
+}
+
+UidSet &VisitedIndex::own_memory() {
+  if (m_memory.use_count() > 1) {
+    m_memory = std::make_shared<UidSet>(*m_memory);
+  } else {
+    // Pairs with the release in the last view's destructor, which may run
+    // on another thread, before the set is written again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *m_memory;
+}
+
+size_t VisitedIndex::memory_bytes() const {
+  if (!m_store) {
+    return m_memory->memory_bytes();
+  }
+  return m_bloom.memory_bytes() + m_store->memory_bytes();
+}
+
+VisitedIndex::Stats VisitedIndex::stats() const {
+  Stats stats;
+  stats.lookups = m_lookups;
+  stats.bloom_negatives = m_bloom_negatives;
+  stats.disk_probes = m_disk_probes;
+  stats.false_positives = m_false_positives;
+  const uint64_t negatives = m_false_positives + m_bloom_negatives;
+  stats.measured_fpr = negatives == 0 ? 0.0
+      : static_cast<double>(m_false_positives) / static_cast<double>(negatives);
+  stats.expected_fpr = m_store ? m_bloom.expected_fpr() : 0.0;
+  return stats;
+}
+
+void VisitedIndex::for_each(const std::function<void(uint64_t)> &fn) const {
+  if (m_store) {
+    m_store->for_each(fn);
+  } else {
+    m_memory->for_each(fn);
+  }
+}
@@ -1,7 +1,20 @@
 #include "weibo.hpp"
+#include <algorithm>
 #include <fmt/format.h>
 
 std::string Weibo::dump()
 {
   return fmt::format("id: {}, text: {}, timestamp: {}", id, text, timestamp);
 }
+
+WeiboWatermark::Verdict WeiboWatermark::classify(uint64_t id, bool pinned) const
+{
+  if (id > max_id) {
+    return Verdict::New;
+  }
+  if (!pinned) {
+    return Verdict::Stop;
+  }
+  return std::find(pinned_ids.begin(), pinned_ids.end(), id) != pinned_ids.end() ? Verdict::Known
+                                                                                   : Verdict::New;
+}
@@ -0,0 +1,297 @@
+#include "weibo_decode.hpp"
+#include <cstring>
+#include <fmt/core.h>
+#include <initializer_list>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Tracks where in the document the parser is, as the member names from
+// the root down ("[]" for array elements), and hands leaf values and
+// container boundaries to the response-specific subclass.
+class PathHandler : public nlohmann::json_sax<json> {
+public:
+  bool null() override {
+    skip();
+    return true;
+  }
+  bool boolean(bool) override {
+    skip();
+    return true;
+  }
+  bool number_integer(number_integer_t value) override {
+    begin_value();
+    on_count(value < 0 ? 0 : static_cast<uint64_t>(value));
+    end_value();
+    return true;
+  }
+  bool number_unsigned(number_unsigned_t value) override {
+    begin_value();
+    on_count(value);
+    end_value();
+    return true;
+  }
+  bool number_float(number_float_t, const string_t &) override {
+    skip();
+    return true;
+  }
+  bool string(string_t &value) override {
+    begin_value();
+    on_string(value);
+    end_value();
+    return true;
+  }
+  bool binary(binary_t &) override {
+    skip();
+    return true;
+  }
+  bool start_object(std::size_t) override {
+    begin_value();
+    m_in_array.push_back(false);
+    on_start_object();
+    return true;
+  }
+  bool key(string_t &name) override {
+    m_path.push_back(std::move(name));
+    return true;
+  }
+  bool end_object() override {
+    on_end_object();
+    m_in_array.pop_back();
+    end_value();
+    return true;
+  }
+  bool start_array(std::size_t) override {
+    begin_value();
+    m_in_array.push_back(true);
+    on_start_array();
+    return true;
+  }
+  bool end_array() override {
+    m_in_array.pop_back();
+    end_value();
+    return true;
+  }
+  bool parse_error(std::size_t position,
+                   const std::string &,
+                   const nlohmann::detail::exception &ex) override {
+    m_error = fmt::format("{} (byte {})", ex.what(), position);
+    return false;
+  }
+
+  const std::string &error() const { return m_error; }
+
+protected:
+  // Integers only; negative values arrive as 0.
+  virtual void on_count(uint64_t) {}
+  virtual void on_string(std::string &) {}
+  virtual void on_start_object() {}
+  virtual void on_end_object() {}
+  virtual void on_start_array() {}
+
+  // Exact match against the current path; "*" matches any member name
+  // but not an array element.
+  bool at(std::initializer_list<const char *> pattern) const {
+    if (pattern.size() != m_path.size()) {
+      return false;
+    }
+    size_t i = 0;
+    for (const char *segment : pattern) {
+      const bool match = std::strcmp(segment, "*") == 0 ? m_path[i] != "[]" : m_path[i] == segment;
+      if (!match) {
+        return false;
+      }
+      ++i;
+    }
+    return true;
+  }
+
+  // Name of the current value: its member name, or "[]".
+  const std::string &name() const { return m_path.back(); }
+
+private:
+  void begin_value() {
+    if (!m_in_array.empty() && m_in_array.back()) {
+      m_path.emplace_back("[]");
+    }
+  }
+  // Drops the value's name, pushed by key() or begin_value(); the root
+  // has none.
+  void end_value() {
+    if (!m_in_array.empty()) {
+      m_path.pop_back();
+    }
+  }
+  void skip() {
+    begin_value();
+    end_value();
+  }
+
+  std::vector<std::string> m_path;
+  std::vector<bool> m_in_array;
+  std::string m_error;
+};
+
+void set_user_count(CachedProfile *user, const std::string &field, uint64_t value) {
+  if (field == "id") {
+    user->uid = value;
+  } else if (field == "followers_count") {
+    user->followers_count = value;
+  } else if (field == "friends_count") {
+    user->friends_count = value;
+  } else if (field == "statuses_count") {
+    user->statuses_count = value;
+  }
+}
+
+class ProfileHandler : public PathHandler {
+public:
+  ProfileResponse response;
+
+protected:
+  void on_count(uint64_t value) override {
+    if (at({"ok"})) {
+      response.ok = static_cast<int>(value);
+    } else if (at({"data", "user", "*"})) {
+      set_user_count(&response.user, name(), value);
+    }
+  }
+  void on_string(std::string &value) override {
+    if (at({"data", "user", "screen_name"})) {
+      response.user.screen_name = std::move(value);
+    }
+  }
+};
+
+class FriendshipsHandler : public PathHandler {
+public:
+  FriendshipsPage page;
+  bool saw_users = false;
+
+protected:
+  void on_count(uint64_t value) override {
+    if (at({"display_total_number"})) {
+      page.display_total_number = value;
+    } else if (at({"users", "[]", "*"})) {
+      set_user_count(&page.users.back(), name(), value);
+    }
+  }
+  void on_string(std::string &value) override {
+    if (at({"users", "[]", "screen_name"})) {
+      page.users.back().screen_name = std::move(value);
+    }
+  }
+  void on_start_object() override {
+    if (at({"users", "[]"})) {
+      page.users.emplace_back();
+    }
+  }
+  void on_end_object() override {
+    if (at({"users", "[]"}) && page.users.back().uid == 0) {
+      page.users.pop_back();
+    }
+  }
+  void on_start_array() override {
+    saw_users = saw_users || at({"users"});
+  }
+};
+
+class TimelineHandler : public PathHandler {
+public:
+  TimelinePage page;
+  bool saw_list = false;
+
+protected:
+  void on_count(uint64_t value) override {
+    if (at({"data", "list", "[]", "id"})) {
+      page.posts.back().id = value;
+    } else if (at({"data", "list", "[]", "isTop"})) {
+      page.posts.back().pinned = value != 0;
+    }
+  }
+  void on_string(std::string &value) override {
+    if (at({"data", "list", "[]", "created_at"})) {
+      page.posts.back().created_at = std::move(value);
+    } else if (at({"data", "list", "[]", "text"})) {
+      page.posts.back().text = std::move(value);
+    } else if (at({"data", "list", "[]", "pic_infos", "*", "large", "url"})) {
+      page.posts.back().pics.push_back(std::move(value));
+    } else if (at({"data", "list", "[]", "page_info", "media_info", "stream_url"})) {
+      page.posts.back().stream_url = std::move(value);
+    }
+  }
+  void on_start_object() override {
+    if (at({"data", "list", "[]"})) {
+      page.posts.emplace_back();
+    }
+  }
+  void on_start_array() override {
+    saw_list = saw_list || at({"data", "list"});
+  }
+};
+
+void run(const std::string &body, PathHandler *handler, const char *what) {
+  if (!json::sax_parse(body, handler)) {
+    throw std::runtime_error(fmt::format("failed to decode {} response: {}", what, handler->error()));
+  }
+}
+
+}
+
+namespace nlohmann_backend {
+
+ProfileResponse decode_profile(const std::string &body) {
+  ProfileHandler handler;
+  run(body, &handler, "profile");
+  return std::move(handler.response);
+}
+
+FriendshipsPage decode_friendships(const std::string &body) {
+  FriendshipsHandler handler;
+  run(body, &handler, "friendships");
+  if (!handler.saw_users) {
+    throw std::runtime_error("friendships response has no users array");
+  }
+  return std::move(handler.page);
+}
+
+TimelinePage decode_timeline(const std::string &body) {
+  TimelineHandler handler;
+  run(body, &handler, "mymblog");
+  if (!handler.saw_list) {
+    throw std::runtime_error("mymblog response has no data.list array");
+  }
+  return std::move(handler.page);
+}
+
+}
+
+#ifdef SPIDER_HAVE_SIMDJSON
+namespace active = simdjson_backend;
+#else
+namespace active = nlohmann_backend;
+#endif
+
+ProfileResponse decode_profile(const std::string &body) {
+  return active::decode_profile(body);
+}
+
+FriendshipsPage decode_friendships(const std::string &body) {
+  return active::decode_friendships(body);
+}
+
+TimelinePage decode_timeline(const std::string &body) {
+  return active::decode_timeline(body);
+}
+
+const char *json_backend_name() {
+#ifdef SPIDER_HAVE_SIMDJSON
+  return "simdjson";
+#else
+  return "nlohmann";
+#endif
+}
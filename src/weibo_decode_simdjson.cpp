@@ -0,0 +1,248 @@
+#include "weibo_decode.hpp"
+#include <algorithm>
+#include <fmt/core.h>
+#include <simdjson.h>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+// simdjson on-demand versions of the nlohmann SAX decoders in
+// weibo_decode.cpp. Members are visited in document order and anything
+// the response type does not need is skipped without being parsed, which
+// also means skipped values are not validated: a malformed number inside
+// an ignored member is an error for the SAX path but not here.
+
+namespace {
+
+namespace od = simdjson::ondemand;
+
+// One parser per thread keeps its buffers across pages.
+od::parser &thread_parser() {
+  thread_local od::parser parser;
+  return parser;
+}
+
+// A wrong type or a missing member means the field is absent, as in the
+// SAX path. Any other error leaves the iterator unusable, so it ends the
+// decode.
+bool usable(simdjson::error_code error) {
+  if (error == simdjson::SUCCESS) {
+    return true;
+  }
+  if (error == simdjson::INCORRECT_TYPE || error == simdjson::NO_SUCH_FIELD) {
+    return false;
+  }
+  throw simdjson::simdjson_error(error);
+}
+
+void check(simdjson::error_code error) {
+  if (error) {
+    throw simdjson::simdjson_error(error);
+  }
+}
+
+// Integers only; negative values read as 0.
+std::optional<uint64_t> count(od::value value) {
+  // get_number() reports a string as a malformed number, not as the
+  // wrong type, so look at the type first.
+  od::json_type type;
+  check(value.type().get(type));
+  if (type != od::json_type::number) {
+    return std::nullopt;
+  }
+  od::number number;
+  const auto error = value.get_number().get(number);
+  if (error == simdjson::BIGINT_ERROR) {
+    // Out of 64-bit range; nlohmann reads these as floats.
+    return std::nullopt;
+  }
+  check(error);
+  if (number.is_uint64()) {
+    return number.get_uint64();
+  }
+  if (number.is_int64()) {
+    return static_cast<uint64_t>(std::max<int64_t>(0, number.get_int64()));
+  }
+  return std::nullopt;
+}
+
+void assign_count(od::value value, uint64_t *out) {
+  if (auto n = count(value)) {
+    *out = *n;
+  }
+}
+
+void assign_string(od::value value, std::string *out) {
+  std::string_view s;
+  if (usable(value.get_string().get(s))) {
+    out->assign(s.data(), s.size());
+  }
+}
+
+// Calls on_field(key, value) for each member of object, in order.
+template <typename OnField>
+void for_each_field(od::object object, OnField on_field) {
+  for (auto field_result : object) {
+    od::field field;
+    check(std::move(field_result).get(field));
+    std::string_view key;
+    check(field.unescaped_key().get(key));
+    on_field(key, field.value());
+  }
+}
+
+void read_user(od::value value, CachedProfile *user) {
+  od::object object;
+  if (!usable(value.get_object().get(object))) {
+    return;
+  }
+  for_each_field(object, [&](std::string_view key, od::value field) {
+    if (key == "id") {
+      assign_count(field, &user->uid);
+    } else if (key == "screen_name") {
+      assign_string(field, &user->screen_name);
+    } else if (key == "followers_count") {
+      assign_count(field, &user->followers_count);
+    } else if (key == "friends_count") {
+      assign_count(field, &user->friends_count);
+    } else if (key == "statuses_count") {
+      assign_count(field, &user->statuses_count);
+    }
+  });
+}
+
+void read_pics(od::value value, std::vector<std::string> *pics) {
+  od::object object;
+  if (!usable(value.get_object().get(object))) {
+    return;
+  }
+  for_each_field(object, [&](std::string_view, od::value pic) {
+    std::string_view url;
+    if (usable(pic.find_field_unordered("large").find_field_unordered("url").get_string().get(url))) {
+      pics->emplace_back(url);
+    }
+  });
+}
+
+void read_post(od::object object, TimelinePost *post) {
+  for_each_field(object, [&](std::string_view key, od::value field) {
+    if (key == "id") {
+      assign_count(field, &post->id);
+    } else if (key == "isTop") {
+      if (auto top = count(field)) {
+        post->pinned = *top != 0;
+      }
+    } else if (key == "created_at") {
+      assign_string(field, &post->created_at);
+    } else if (key == "text") {
+      assign_string(field, &post->text);
+    } else if (key == "pic_infos") {
+      read_pics(field, &post->pics);
+    } else if (key == "page_info") {
+      auto stream_url = field.find_field_unordered("media_info").find_field_unordered("stream_url");
+      std::string_view url;
+      if (usable(stream_url.get_string().get(url))) {
+        post->stream_url.assign(url.data(), url.size());
+      }
+    }
+  });
+}
+
+// Runs on_member over the top-level members of body and turns simdjson
+// errors into the decoders' runtime_error.
+template <typename OnMember>
+void decode(const std::string &body, const char *what, OnMember on_member) {
+  try {
+    // On-demand parsing reads past the end of the input, so it needs a
+    // padded copy.
+    const simdjson::padded_string padded(body);
+    od::document doc;
+    check(thread_parser().iterate(padded).get(doc));
+    od::object object;
+    check(doc.get_object().get(object));
+    for_each_field(object, on_member);
+    if (!doc.at_end()) {
+      throw simdjson::simdjson_error(simdjson::TRAILING_CONTENT);
+    }
+  } catch (const simdjson::simdjson_error &ex) {
+    throw std::runtime_error(fmt::format("failed to decode {} response: {}", what, ex.what()));
+  }
+}
+
+}
+
+namespace simdjson_backend {
+
+ProfileResponse decode_profile(const std::string &body) {
+  ProfileResponse response;
+  decode(body, "profile", [&](std::string_view key, od::value value) {
+    if (key == "ok") {
+      if (auto ok = count(value)) {
+        response.ok = static_cast<int>(*ok);
+      }
+    } else if (key == "data") {
+      od::value user;
+      if (usable(value.find_field_unordered("user").get(user))) {
+        read_user(user, &response.user);
+      }
+    }
+  });
+  return response;
+}
+
+FriendshipsPage decode_friendships(const std::string &body) {
+  FriendshipsPage page;
+  bool saw_users = false;
+  decode(body, "friendships", [&](std::string_view key, od::value value) {
+    if (key == "display_total_number") {
+      if (auto total = count(value)) {
+        page.display_total_number = total;
+      }
+      return;
+    }
+    od::array users;
+    if (key != "users" || !usable(value.get_array().get(users))) {
+      return;
+    }
+    saw_users = true;
+    for (auto item_result : users) {
+      od::value item;
+      check(std::move(item_result).get(item));
+      CachedProfile user;
+      read_user(item, &user);
+      if (user.uid != 0) {
+        page.users.push_back(std::move(user));
+      }
+    }
+  });
+  if (!saw_users) {
+    throw std::runtime_error("friendships response has no users array");
+  }
+  return page;
+}
+
+TimelinePage decode_timeline(const std::string &body) {
+  TimelinePage page;
+  bool saw_list = false;
+  decode(body, "mymblog", [&](std::string_view key, od::value value) {
+    od::array list;
+    if (key != "data" || !usable(value.find_field_unordered("list").get_array().get(list))) {
+      return;
+    }
+    saw_list = true;
+    for (auto item_result : list) {
+      od::value item;
+      check(std::move(item_result).get(item));
+      od::object object;
+      if (usable(item.get_object().get(object))) {
+        read_post(object, &page.posts.emplace_back());
+      }
+    }
+  });
+  if (!saw_list) {
+    throw std::runtime_error("mymblog response has no data.list array");
+  }
+  return page;
+}
+
+}
@@ -7,7 +7,75 @@
 #include <mongocxx/options/update.hpp>
 #include <mongocxx/options/index.hpp>
 #include <fmt/core.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <set>
 #include <string>
+#include <unordered_set>
+
+namespace {
+// Upper bound on uids per $in filter; keeps the query document far below
+// the 16MB BSON limit.
+constexpr size_t kMaxInUids = 10000;
+
+uint64_t parse_uid(const bsoncxx::document::element &elem) {
+  try {
+    if (elem.type() == bsoncxx::type::k_string) {
+      return std::stoull(std::string(elem.get_string().value));
+    } else if (elem.type() == bsoncxx::type::k_int64) {
+      return static_cast<uint64_t>(elem.get_int64().value);
+    } else if (elem.type() == bsoncxx::type::k_int32) {
+      return static_cast<uint64_t>(elem.get_int32().value);
+    }
+  } catch (const std::exception &) {
+  }
+  return 0;
+}
+
+void parse_uid_array(const bsoncxx::document::view &d,
+                     const char *field,
+                     std::vector<uint64_t> *out) {
+  if (!out) {
+    return;
+  }
+  out->clear();
+  if (!d[field] || d[field].type() != bsoncxx::type::k_array) {
+    return;
+  }
+  for (const auto &elem : d[field].get_array().value) {
+    try {
+      if (elem.type() == bsoncxx::type::k_string) {
+        out->push_back(std::stoull(std::string(elem.get_string().value)));
+      } else if (elem.type() == bsoncxx::type::k_int64) {
+        out->push_back(static_cast<uint64_t>(elem.get_int64().value));
+      } else if (elem.type() == bsoncxx::type::k_int32) {
+        out->push_back(static_cast<uint64_t>(elem.get_int32().value));
+      }
+    } catch (const std::exception &) {
+    }
+  }
+}
+
+WeiboWatermark parse_watermark(const bsoncxx::document::view &d) {
+  WeiboWatermark watermark;
+  if (d["max_id"]) {
+    watermark.max_id = parse_uid(d["max_id"]);
+  }
+  parse_uid_array(d, "pinned_ids", &watermark.pinned_ids);
+  if (d["crawled_at_ms"] && d["crawled_at_ms"].type() == bsoncxx::type::k_int64) {
+    watermark.crawled_at_ms = d["crawled_at_ms"].get_int64().value;
+  }
+  return watermark;
+}
+
+int64_t now_ms() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+}
+
 MongoWriter::MongoWriter(const std::string &uri,
                          const std::string &db_name,
                          const std::string &collection_name)
@@ -39,20 +107,35 @@ MongoWriter::MongoWriter(const std::string &uri,
   } catch (const std::exception &e) {
     spdlog::warn(fmt::format("uid index creation: {}", e.what()));
   }
+
+  m_watermarks = m_db[collection_name + "_watermarks"];
+  try {
+    m_watermarks.create_index(index_key.view(), index_opts);
+  } catch (const std::exception &e) {
+    spdlog::warn(fmt::format("watermark uid index creation: {}", e.what()));
+  }
 }
 
 void MongoWriter::write_one(const User &user)
 {
   using bsoncxx::builder::basic::kvp;
 
-  // Get existing weibo IDs to deduplicate
-  auto existing_ids = get_stored_weibo_ids(user.uid);
+  // Posts above the watermark are new without looking. At or below it the
+  // crawl only passes pinned posts, and the ones the watermark does not
+  // list are looked up individually, so this costs O(posts written).
+  const WeiboWatermark watermark = get_weibo_watermark(user.uid);
 
   // Build only new weibos
   bsoncxx::builder::basic::array new_weibos;
   int new_count = 0;
+  uint64_t max_id = 0;
+  std::vector<uint64_t> pinned_ids;
   for (const auto &weibo : user.weibo) {
-    if (existing_ids.count(weibo.id)) continue;
+    if (weibo.pinned) {
+      pinned_ids.push_back(weibo.id);
+    }
+    if (watermark.classify(weibo.id, weibo.pinned) != WeiboWatermark::Verdict::New) continue;
+    if (weibo.id <= watermark.max_id && weibo_stored(user.uid, weibo.id)) continue;
     bsoncxx::builder::basic::document wb;
     bsoncxx::builder::basic::array pics;
     for (const auto &pic : weibo.pics) {
@@ -65,6 +148,7 @@ void MongoWriter::write_one(const User &user)
     wb.append(kvp("video_url", weibo.video_url));
     new_weibos.append(wb.extract());
     new_count++;
+    max_id = std::max(max_id, weibo.id);
   }
 
   // Build followers array
@@ -82,45 +166,56 @@ void MongoWriter::write_one(const User &user)
   bsoncxx::builder::basic::document filter;
   filter.append(kvp("uid", std::to_string(user.uid)));
 
-  if (!user_exists(user.uid)) {
-    // First time: insert new document
-    bsoncxx::builder::basic::document doc;
-    doc.append(kvp("uid", std::to_string(user.uid)));
-    doc.append(kvp("username", user.username));
-    doc.append(kvp("followers", followers.extract()));
-    doc.append(kvp("fans", fans.extract()));
-    doc.append(kvp("weibos", new_weibos.extract()));
-    m_collection.insert_one(doc.view());
+  // One upsert instead of an existence check plus insert or update. Empty
+  // relation lists only land on insert, so a partial crawl does not wipe
+  // stored ones.
+  bsoncxx::builder::basic::document set_doc;
+  bsoncxx::builder::basic::document set_on_insert;
+  set_doc.append(kvp("username", user.username));
+  if (!user.followers.empty()) {
+    set_doc.append(kvp("followers", followers.extract()));
+  } else {
+    set_on_insert.append(kvp("followers", followers.extract()));
+  }
+  if (!user.fans.empty()) {
+    set_doc.append(kvp("fans", fans.extract()));
+  } else {
+    set_on_insert.append(kvp("fans", fans.extract()));
+  }
+
+  bsoncxx::builder::basic::document update;
+  if (new_count > 0) {
+    bsoncxx::builder::basic::document each_doc;
+    each_doc.append(kvp("$each", new_weibos.extract()));
+    bsoncxx::builder::basic::document push_doc;
+    push_doc.append(kvp("weibos", each_doc.extract()));
+    update.append(kvp("$push", push_doc.extract()));
+  } else {
+    set_on_insert.append(kvp("weibos", new_weibos.extract()));
+  }
+  update.append(kvp("$set", set_doc.extract()));
+  // Servers before 5.0 reject an empty operator document.
+  if (!set_on_insert.view().empty()) {
+    update.append(kvp("$setOnInsert", set_on_insert.extract()));
+  }
+
+  mongocxx::options::update upsert;
+  upsert.upsert(true);
+  auto result = m_collection.update_one(filter.view(), update.view(), upsert);
+  if (result && result->upserted_id()) {
     spdlog::info(fmt::format(
         "inserted new user uid:{} with {} weibos",
         user.uid, new_count));
   } else {
-    // User exists: update info + append new weibos only
-    bsoncxx::builder::basic::document set_doc;
-    set_doc.append(kvp("username", user.username));
-    if (!user.followers.empty()) {
-      set_doc.append(kvp("followers", followers.extract()));
-    }
-    if (!user.fans.empty()) {
-      set_doc.append(kvp("fans", fans.extract()));
-    }
-
-    bsoncxx::builder::basic::document update;
-    update.append(kvp("$set", set_doc.extract()));
-
-    if (new_count > 0) {
-      bsoncxx::builder::basic::document each_doc;
-      each_doc.append(kvp("$each", new_weibos.extract()));
-      bsoncxx::builder::basic::document push_doc;
-      push_doc.append(kvp("weibos", each_doc.extract()));
-      update.append(kvp("$push", push_doc.extract()));
-    }
-
-    m_collection.update_one(filter.view(), update.view());
     spdlog::info(fmt::format(
         "updated user uid:{}, {} new weibos appended",
         user.uid, new_count));
   }
+
+  // After the posts: if this write is lost the watermark lags, and the
+  // next crawl re-appends a few posts that get_weibos deduplicates,
+  // rather than skipping posts that were never stored.
+  advance_watermark(user.uid, max_id, pinned_ids, true);
 }
 
 void MongoWriter::write_many(const std::vector<User> &users)
@@ -130,48 +225,56 @@ void MongoWriter::write_many(const std::vector<User> &users)
   }
 }
 
-bool MongoWriter::user_exists(uint64_t uid) {
+void MongoWriter::write_fan_chunk(uint64_t uid, const std::vector<User> &fans, bool first_chunk)
+{
   using bsoncxx::builder::basic::kvp;
   bsoncxx::builder::basic::document filter;
   filter.append(kvp("uid", std::to_string(uid)));
-  auto result = m_collection.find_one(filter.view());
-  return result.has_value();
+
+  bsoncxx::builder::basic::array ids;
+  for (const auto &fan : fans) {
+    ids.append(std::to_string(fan.uid));
+  }
+  bsoncxx::builder::basic::document update;
+  if (first_chunk) {
+    bsoncxx::builder::basic::document set_doc;
+    set_doc.append(kvp("fans", ids.extract()));
+    update.append(kvp("$set", set_doc.extract()));
+  } else {
+    bsoncxx::builder::basic::document each_doc;
+    each_doc.append(kvp("$each", ids.extract()));
+    bsoncxx::builder::basic::document add_doc;
+    add_doc.append(kvp("fans", each_doc.extract()));
+    update.append(kvp("$addToSet", add_doc.extract()));
+  }
+
+  mongocxx::options::update upsert;
+  upsert.upsert(true);
+  m_collection.update_one(filter.view(), update.view(), upsert);
 }
 
-uint64_t MongoWriter::get_latest_weibo_id(uint64_t uid) {
+bool MongoWriter::user_exists(uint64_t uid) {
   using bsoncxx::builder::basic::kvp;
   bsoncxx::builder::basic::document filter;
   filter.append(kvp("uid", std::to_string(uid)));
-
   auto result = m_collection.find_one(filter.view());
-  if (!result) return 0;
-
-  auto doc = result->view();
-  if (!doc["weibos"] || doc["weibos"].type() != bsoncxx::type::k_array) {
-    return 0;
-  }
-
-  uint64_t max_id = 0;
-  for (const auto &elem : doc["weibos"].get_array().value) {
-    if (elem.type() != bsoncxx::type::k_document) continue;
-    auto wb = elem.get_document().value;
-    if (wb["id"]) {
-      uint64_t id = std::stoull(std::string(wb["id"].get_string().value));
-      if (id > max_id) max_id = id;
-    }
-  }
-  return max_id;
+  return result.has_value();
 }
 
-std::set<uint64_t> MongoWriter::get_stored_weibo_ids(uint64_t uid) {
+uint64_t MongoWriter::get_latest_weibo_id(uint64_t uid) {
   using bsoncxx::builder::basic::kvp;
-  std::set<uint64_t> ids;
   bsoncxx::builder::basic::document filter;
   filter.append(kvp("uid", std::to_string(uid)));
-
-  // Use find (not find_one) to scan ALL documents with this uid
-  // This handles legacy duplicate documents from old insert_one behavior
-  auto cursor = m_collection.find(filter.view());
+  bsoncxx::builder::basic::document projection;
+  projection.append(kvp("_id", 0));
+  projection.append(kvp("weibos.id", 1));
+  mongocxx::options::find opts;
+  opts.projection(projection.view());
+
+  // Every document with this uid: legacy duplicates from the old
+  // insert_one behavior hold posts too.
+  uint64_t max_id = 0;
+  auto cursor = m_collection.find(filter.view(), opts);
   for (const auto &doc : cursor) {
     if (!doc["weibos"] || doc["weibos"].type() != bsoncxx::type::k_array) {
       continue;
@@ -180,13 +283,76 @@ std::set<uint64_t> MongoWriter::get_stored_weibo_ids(uint64_t uid) {
       if (elem.type() != bsoncxx::type::k_document) continue;
       auto wb = elem.get_document().value;
       if (wb["id"]) {
-        uint64_t id = std::stoull(
-            std::string(wb["id"].get_string().value));
-        ids.insert(id);
+        max_id = std::max(max_id, parse_uid(wb["id"]));
       }
     }
   }
-  return ids;
+  return max_id;
+}
+
+WeiboWatermark MongoWriter::get_weibo_watermark(uint64_t uid) {
+  using bsoncxx::builder::basic::kvp;
+  bsoncxx::builder::basic::document filter;
+  filter.append(kvp("uid", std::to_string(uid)));
+
+  auto result = m_watermarks.find_one(filter.view());
+  if (result) {
+    return parse_watermark(result->view());
+  }
+
+  WeiboWatermark watermark;
+  watermark.max_id = get_latest_weibo_id(uid);
+  if (watermark.max_id != 0) {
+    advance_watermark(uid, watermark.max_id, {}, false);
+    spdlog::info(fmt::format("backfilled weibo watermark for uid {}: max id {}", uid, watermark.max_id));
+  }
+  return watermark;
+}
+
+bool MongoWriter::weibo_stored(uint64_t uid, uint64_t weibo_id) {
+  using bsoncxx::builder::basic::kvp;
+  bsoncxx::builder::basic::document filter;
+  filter.append(kvp("uid", std::to_string(uid)));
+  filter.append(kvp("weibos.id", std::to_string(weibo_id)));
+  bsoncxx::builder::basic::document projection;
+  projection.append(kvp("_id", 1));
+  mongocxx::options::find opts;
+  opts.projection(projection.view());
+  return m_collection.find_one(filter.view(), opts).has_value();
+}
+
+void MongoWriter::advance_watermark(uint64_t uid,
+                                    uint64_t max_id,
+                                    const std::vector<uint64_t> &pinned_ids,
+                                    bool crawled) {
+  using bsoncxx::builder::basic::kvp;
+  bsoncxx::builder::basic::document filter;
+  filter.append(kvp("uid", std::to_string(uid)));
+
+  bsoncxx::builder::basic::document max_doc;
+  max_doc.append(kvp("max_id", static_cast<int64_t>(max_id)));
+  bsoncxx::builder::basic::document update;
+  update.append(kvp("$max", max_doc.extract()));
+  if (!pinned_ids.empty()) {
+    bsoncxx::builder::basic::array pinned;
+    for (uint64_t id : pinned_ids) {
+      pinned.append(static_cast<int64_t>(id));
+    }
+    bsoncxx::builder::basic::document each_doc;
+    each_doc.append(kvp("$each", pinned.extract()));
+    bsoncxx::builder::basic::document add_doc;
+    add_doc.append(kvp("pinned_ids", each_doc.extract()));
+    update.append(kvp("$addToSet", add_doc.extract()));
+  }
+  if (crawled) {
+    bsoncxx::builder::basic::document set_doc;
+    set_doc.append(kvp("crawled_at_ms", now_ms()));
+    update.append(kvp("$set", set_doc.extract()));
+  }
+
+  mongocxx::options::update upsert;
+  upsert.upsert(true);
+  m_watermarks.update_one(filter.view(), update.view(), upsert);
 }
 
 std::vector<Weibo> MongoWriter::get_weibos(uint64_t uid) {
@@ -278,31 +444,71 @@ bool MongoWriter::get_user_relations(uint64_t uid,
     }
   }
 
-  auto parse_uid_array = [](const bsoncxx::document::view &d,
-                            const char *field,
-                            std::vector<uint64_t> *out) {
-    if (!out) {
-      return;
-    }
-    out->clear();
-    if (!d[field] || d[field].type() != bsoncxx::type::k_array) {
-      return;
-    }
-    for (const auto &elem : d[field].get_array().value) {
-      try {
-        if (elem.type() == bsoncxx::type::k_string) {
-          out->push_back(std::stoull(std::string(elem.get_string().value)));
-        } else if (elem.type() == bsoncxx::type::k_int64) {
-          out->push_back(static_cast<uint64_t>(elem.get_int64().value));
-        } else if (elem.type() == bsoncxx::type::k_int32) {
-          out->push_back(static_cast<uint64_t>(elem.get_int32().value));
-        }
-      } catch (const std::exception &) {
-      }
-    }
-  };
-
   parse_uid_array(doc, "followers", followers);
   parse_uid_array(doc, "fans", fans);
   return true;
 }
+
+size_t MongoWriter::for_each_user_relations(
+    const std::vector<uint64_t> &uids,
+    size_t batch_size,
+    const std::function<void(std::vector<UserRelations> &)> &fn) {
+  using bsoncxx::builder::basic::kvp;
+  batch_size = std::max<size_t>(1, batch_size);
+
+  bsoncxx::builder::basic::document projection;
+  projection.append(kvp("_id", 0));
+  projection.append(kvp("uid", 1));
+  projection.append(kvp("username", 1));
+  projection.append(kvp("followers", 1));
+  projection.append(kvp("fans", 1));
+  mongocxx::options::find opts;
+  opts.projection(projection.view());
+  opts.batch_size(static_cast<int32_t>(std::min<size_t>(batch_size, INT32_MAX)));
+
+  size_t delivered = 0;
+  std::vector<UserRelations> batch;
+  batch.reserve(batch_size);
+  for (size_t begin = 0; begin < uids.size(); begin += kMaxInUids) {
+    const size_t end = std::min(uids.size(), begin + kMaxInUids);
+    bsoncxx::builder::basic::array in;
+    for (size_t i = begin; i < end; ++i) {
+      in.append(std::to_string(uids[i]));
+    }
+    bsoncxx::builder::basic::document in_doc;
+    in_doc.append(kvp("$in", in.extract()));
+    bsoncxx::builder::basic::document filter;
+    filter.append(kvp("uid", in_doc.extract()));
+
+    // Legacy duplicate documents: keep the first one per uid, like find_one.
+    std::unordered_set<uint64_t> seen;
+    auto cursor = m_collection.find(filter.view(), opts);
+    for (const auto &doc : cursor) {
+      if (!doc["uid"]) {
+        continue;
+      }
+      const uint64_t uid = parse_uid(doc["uid"]);
+      if (uid == 0 || !seen.insert(uid).second) {
+        continue;
+      }
+      UserRelations rel;
+      rel.uid = uid;
+      if (doc["username"] && doc["username"].type() == bsoncxx::type::k_string) {
+        rel.username = std::string(doc["username"].get_string().value);
+      }
+      parse_uid_array(doc, "followers", &rel.followers);
+      parse_uid_array(doc, "fans", &rel.fans);
+      batch.push_back(std::move(rel));
+      if (batch.size() >= batch_size) {
+        delivered += batch.size();
+        fn(batch);
+        batch.clear();
+      }
+    }
+  }
+  if (!batch.empty()) {
+    delivered += batch.size();
+    fn(batch);
+  }
+  return delivered;
+}
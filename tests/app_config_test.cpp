@@ -1,25 +1,14 @@
 #include "app_config.hpp"
+#include "test_util.hpp"
 
 #include <gtest/gtest.h>
 
-#include <chrono>
 #include <filesystem>
 #include <fstream>
 
-namespace {
-
-std::filesystem::path unique_temp_path(const std::string &suffix) {
-  const auto base = std::filesystem::temp_directory_path();
-  const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
-  const auto unique = std::filesystem::path("cpp_spider_test_" + std::to_string(stamp) + "_" + suffix);
-  return base / unique;
-}
-
-}
-
 TEST(AppConfigTest, LoadMissingFileReturnsDefaults) {
-  const auto missing = unique_temp_path("missing_config.json");
-  std::filesystem::remove(missing);
+  const TempDir tmp("missing_config");
+  const auto missing = tmp.file("missing_config.json");
 
   const AppConfig cfg = AppConfig::load(missing.string());
 
@@ -28,11 +17,15 @@ TEST(AppConfigTest, LoadMissingFileReturnsDefaults) {
   EXPECT_EQ(cfg.mongo_collection, "user");
   EXPECT_EQ(cfg.retry_max_attempts, 5);
   EXPECT_EQ(cfg.request_min_interval_ms, 800);
+  // Existing configs must not get a faster crawl from an upgrade.
+  EXPECT_EQ(cfg.request_rate_mode, "static");
+  EXPECT_EQ(cfg.crawl_workers, 1);
   EXPECT_EQ(cfg.log_level, "info");
 }
 
 TEST(AppConfigTest, SaveAndLoadRoundTripPersistsFields) {
-  const auto path = unique_temp_path("roundtrip_config.json");
+  const TempDir tmp("roundtrip_config");
+  const auto path = tmp.file("roundtrip_config.json");
 
   AppConfig original;
   original.mongo_url = "mongodb://127.0.0.1:27017";
@@ -42,10 +35,43 @@ TEST(AppConfigTest, SaveAndLoadRoundTripPersistsFields) {
   original.headers_path = "headers_test.json";
   original.config_path = "config_test.json";
   original.crawl_state_path = "crawl_state_test.json";
+  original.sessions = {{"main", "cookie_a.json", "headers_a.json"},
+                       {"backup", "cookie_b.json", ""}};
+  original.session_quarantine_429s = 5;
+  original.session_quarantine_ms = 120000;
   original.weibo_host = "https://example.com";
   original.image_host = "https://img.example.com";
+  original.http_transport = "epoll";
+  original.http_max_connections = 16;
+  original.http_max_idle_ms = 15000;
   original.default_uid = 123456789;
   original.crawl_max_depth = 3;
+  original.crawl_workers = 4;
+  original.persist_queue_capacity = 8;
+  original.follower_profile_source = "profile";
+  original.fan_chunk_users = 50;
+  original.fan_max_per_user = 5000;
+  original.fan_sample_mode = "spread";
+  original.profile_cache_path = "/tmp/profiles.jsonl";
+  original.profile_cache_ttl_minutes = 90;
+  original.recrawl_state_path = "/tmp/recrawl.jsonl";
+  original.recrawl_mode = "scheduled";
+  original.recrawl_window_minutes = 720;
+  original.recrawl_max_users = 42;
+  original.recrawl_min_interval_minutes = 15;
+  original.recrawl_max_interval_days = 7;
+  original.crawl_snapshot_records = 500;
+  original.crawl_state_format = "binary";
+  original.checkpoint_fsync_interval_ms = 250;
+  original.visited_index_mode = "tiered";
+  original.visited_index_dir = "visited_test";
+  original.visited_bloom_expected = 5000000;
+  original.visited_bloom_fpr = 0.001;
+  original.visited_buffer_uids = 4096;
+  original.frontier_mode = "disk";
+  original.frontier_dir = "frontier_test";
+  original.frontier_segment_entries = 1024;
+  original.frontier_order = "degree";
   original.retry_max_attempts = 9;
   original.retry_base_delay_ms = 1500;
   original.retry_max_delay_ms = 12000;
@@ -53,6 +79,12 @@ TEST(AppConfigTest, SaveAndLoadRoundTripPersistsFields) {
   original.request_min_interval_ms = 700;
   original.request_jitter_ms = 350;
   original.cooldown_429_ms = 45000;
+  original.request_rate_mode = "adaptive";
+  original.request_interval_floor_ms = 150;
+  original.request_interval_ceiling_ms = 20000;
+  original.request_latency_threshold_ms = 0;
+  original.endpoint_limits = {{"profile", "/ajax/profile/", 1200, 2, 60000, 50, 7000},
+                              {"timeline", "/ajax/statuses/", 0, 1, -1, 0, 0}};
   original.request_profile = "aggressive";
   original.log_level = "debug";
 
@@ -66,10 +98,47 @@ TEST(AppConfigTest, SaveAndLoadRoundTripPersistsFields) {
   EXPECT_EQ(loaded.headers_path, original.headers_path);
   EXPECT_EQ(loaded.config_path, original.config_path);
   EXPECT_EQ(loaded.crawl_state_path, original.crawl_state_path);
+  ASSERT_EQ(loaded.sessions.size(), original.sessions.size());
+  for (size_t i = 0; i < original.sessions.size(); ++i) {
+    EXPECT_EQ(loaded.sessions[i].name, original.sessions[i].name);
+    EXPECT_EQ(loaded.sessions[i].cookie_path, original.sessions[i].cookie_path);
+    EXPECT_EQ(loaded.sessions[i].headers_path, original.sessions[i].headers_path);
+  }
+  EXPECT_EQ(loaded.session_quarantine_429s, original.session_quarantine_429s);
+  EXPECT_EQ(loaded.session_quarantine_ms, original.session_quarantine_ms);
   EXPECT_EQ(loaded.weibo_host, original.weibo_host);
   EXPECT_EQ(loaded.image_host, original.image_host);
+  EXPECT_EQ(loaded.http_transport, original.http_transport);
+  EXPECT_EQ(loaded.http_max_connections, original.http_max_connections);
+  EXPECT_EQ(loaded.http_max_idle_ms, original.http_max_idle_ms);
   EXPECT_EQ(loaded.default_uid, original.default_uid);
   EXPECT_EQ(loaded.crawl_max_depth, original.crawl_max_depth);
+  EXPECT_EQ(loaded.crawl_workers, original.crawl_workers);
+  EXPECT_EQ(loaded.persist_queue_capacity, original.persist_queue_capacity);
+  EXPECT_EQ(loaded.follower_profile_source, original.follower_profile_source);
+  EXPECT_EQ(loaded.fan_chunk_users, original.fan_chunk_users);
+  EXPECT_EQ(loaded.fan_max_per_user, original.fan_max_per_user);
+  EXPECT_EQ(loaded.fan_sample_mode, original.fan_sample_mode);
+  EXPECT_EQ(loaded.profile_cache_path, original.profile_cache_path);
+  EXPECT_EQ(loaded.profile_cache_ttl_minutes, original.profile_cache_ttl_minutes);
+  EXPECT_EQ(loaded.recrawl_state_path, original.recrawl_state_path);
+  EXPECT_EQ(loaded.recrawl_mode, original.recrawl_mode);
+  EXPECT_EQ(loaded.recrawl_window_minutes, original.recrawl_window_minutes);
+  EXPECT_EQ(loaded.recrawl_max_users, original.recrawl_max_users);
+  EXPECT_EQ(loaded.recrawl_min_interval_minutes, original.recrawl_min_interval_minutes);
+  EXPECT_EQ(loaded.recrawl_max_interval_days, original.recrawl_max_interval_days);
+  EXPECT_EQ(loaded.crawl_snapshot_records, original.crawl_snapshot_records);
+  EXPECT_EQ(loaded.crawl_state_format, original.crawl_state_format);
+  EXPECT_EQ(loaded.checkpoint_fsync_interval_ms, original.checkpoint_fsync_interval_ms);
+  EXPECT_EQ(loaded.visited_index_mode, original.visited_index_mode);
+  EXPECT_EQ(loaded.visited_index_dir, original.visited_index_dir);
+  EXPECT_EQ(loaded.visited_bloom_expected, original.visited_bloom_expected);
+  EXPECT_DOUBLE_EQ(loaded.visited_bloom_fpr, original.visited_bloom_fpr);
+  EXPECT_EQ(loaded.visited_buffer_uids, original.visited_buffer_uids);
+  EXPECT_EQ(loaded.frontier_mode, original.frontier_mode);
+  EXPECT_EQ(loaded.frontier_dir, original.frontier_dir);
+  EXPECT_EQ(loaded.frontier_segment_entries, original.frontier_segment_entries);
+  EXPECT_EQ(loaded.frontier_order, original.frontier_order);
   EXPECT_EQ(loaded.retry_max_attempts, original.retry_max_attempts);
   EXPECT_EQ(loaded.retry_base_delay_ms, original.retry_base_delay_ms);
   EXPECT_EQ(loaded.retry_max_delay_ms, original.retry_max_delay_ms);
@@ -77,14 +146,27 @@ TEST(AppConfigTest, SaveAndLoadRoundTripPersistsFields) {
   EXPECT_EQ(loaded.request_min_interval_ms, original.request_min_interval_ms);
   EXPECT_EQ(loaded.request_jitter_ms, original.request_jitter_ms);
   EXPECT_EQ(loaded.cooldown_429_ms, original.cooldown_429_ms);
+  EXPECT_EQ(loaded.request_rate_mode, original.request_rate_mode);
+  EXPECT_EQ(loaded.request_interval_floor_ms, original.request_interval_floor_ms);
+  EXPECT_EQ(loaded.request_interval_ceiling_ms, original.request_interval_ceiling_ms);
+  EXPECT_EQ(loaded.request_latency_threshold_ms, original.request_latency_threshold_ms);
+  ASSERT_EQ(loaded.endpoint_limits.size(), original.endpoint_limits.size());
+  for (size_t i = 0; i < original.endpoint_limits.size(); ++i) {
+    EXPECT_EQ(loaded.endpoint_limits[i].name, original.endpoint_limits[i].name);
+    EXPECT_EQ(loaded.endpoint_limits[i].prefix, original.endpoint_limits[i].prefix);
+    EXPECT_EQ(loaded.endpoint_limits[i].min_interval_ms, original.endpoint_limits[i].min_interval_ms);
+    EXPECT_EQ(loaded.endpoint_limits[i].burst, original.endpoint_limits[i].burst);
+    EXPECT_EQ(loaded.endpoint_limits[i].cooldown_429_ms, original.endpoint_limits[i].cooldown_429_ms);
+    EXPECT_EQ(loaded.endpoint_limits[i].pause_every, original.endpoint_limits[i].pause_every);
+    EXPECT_EQ(loaded.endpoint_limits[i].pause_ms, original.endpoint_limits[i].pause_ms);
+  }
   EXPECT_EQ(loaded.request_profile, original.request_profile);
   EXPECT_EQ(loaded.log_level, original.log_level);
-
-  std::filesystem::remove(path);
 }
 
 TEST(AppConfigTest, LoadInvalidJsonFallsBackToDefaults) {
-  const auto path = unique_temp_path("invalid_config.json");
+  const TempDir tmp("invalid_config");
+  const auto path = tmp.file("invalid_config.json");
   {
     std::ofstream ofs(path);
     ofs << "{ invalid json";
@@ -95,12 +177,11 @@ TEST(AppConfigTest, LoadInvalidJsonFallsBackToDefaults) {
   EXPECT_EQ(cfg.mongo_db, "weibo");
   EXPECT_EQ(cfg.retry_max_attempts, 5);
   EXPECT_EQ(cfg.request_profile, "balanced");
-
-  std::filesystem::remove(path);
 }
 
 TEST(AppConfigTest, PartialConfigOnlyOverridesSpecifiedFields) {
-  const auto path = unique_temp_path("partial_config.json");
+  const TempDir tmp("partial_config");
+  const auto path = tmp.file("partial_config.json");
   {
     std::ofstream ofs(path);
     ofs << R"({
@@ -117,6 +198,4 @@ TEST(AppConfigTest, PartialConfigOnlyOverridesSpecifiedFields) {
   EXPECT_EQ(cfg.log_level, "warn");
   EXPECT_EQ(cfg.mongo_collection, "user");
   EXPECT_EQ(cfg.request_profile, "balanced");
-
-  std::filesystem::remove(path);
 }
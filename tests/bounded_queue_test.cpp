@@ -0,0 +1,70 @@
+#include "bounded_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(BoundedQueueTest, PopsInFifoOrder) {
+  BoundedQueue<int> queue(4);
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_TRUE(queue.push(2));
+  EXPECT_TRUE(queue.push(3));
+
+  int value = 0;
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 1);
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 2);
+
+  const auto stats = queue.stats();
+  EXPECT_EQ(stats.depth, 1U);
+  EXPECT_EQ(stats.high_water, 3U);
+  EXPECT_EQ(stats.pushed, 3U);
+}
+
+TEST(BoundedQueueTest, FullQueueBlocksProducerUntilConsumerPops) {
+  BoundedQueue<int> queue(1);
+  ASSERT_TRUE(queue.push(1));
+
+  std::thread producer([&queue] { queue.push(2); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(queue.stats().depth, 1U);
+
+  int value = 0;
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 1);
+  producer.join();
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_GE(queue.stats().push_stall_ms, 40U);
+}
+
+TEST(BoundedQueueTest, CloseDrainsThenStopsConsumers) {
+  BoundedQueue<int> queue(8);
+  ASSERT_TRUE(queue.push(7));
+  queue.close();
+  EXPECT_FALSE(queue.push(8));
+
+  int value = 0;
+  ASSERT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 7);
+  EXPECT_FALSE(queue.pop(&value));
+}
+
+TEST(BoundedQueueTest, CloseWakesBlockedConsumer) {
+  BoundedQueue<int> queue(2);
+  std::vector<int> received;
+  std::thread consumer([&queue, &received] {
+    int value = 0;
+    while (queue.pop(&value)) {
+      received.push_back(value);
+    }
+  });
+  ASSERT_TRUE(queue.push(1));
+  ASSERT_TRUE(queue.push(2));
+  queue.close();
+  consumer.join();
+  EXPECT_EQ(received, (std::vector<int>{1, 2}));
+}
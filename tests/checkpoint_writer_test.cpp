@@ -0,0 +1,138 @@
+#include "checkpoint_writer.hpp"
+#include "crawl_journal.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+CrawlSnapshot make_snapshot(uint64_t generation, uint64_t visited_uid) {
+  CrawlSnapshot snapshot;
+  snapshot.info.root_uid = 1;
+  snapshot.info.journal_generation = generation;
+  snapshot.set_visited({visited_uid});
+  return snapshot;
+}
+
+std::vector<uint64_t> replay_uids(const std::filesystem::path &path, uint64_t generation) {
+  std::vector<uint64_t> uids;
+  CrawlJournal::replay(path.string(), generation, [&uids](const CrawlJournal::Record &record) {
+    uids.push_back(record.uid);
+  });
+  return uids;
+}
+
+}
+
+TEST(CheckpointWriterTest, WritesSnapshotThenJournal) {
+  const TempDir tmp("ckpt_basic");
+  const auto &dir = tmp.path();
+  const auto state = dir / "state.bin";
+  const auto journal_path = dir / "state.bin.journal";
+  {
+    CheckpointWriter writer(state.string(), journal_path.string(), 0);
+    writer.submit_snapshot(make_snapshot(1, 10), CrawlSnapshot::Format::Binary, std::nullopt);
+    CrawlJournal journal;
+    journal.append(CrawlJournal::Op::Done, 11);
+    writer.submit_journal(journal.take(), std::nullopt);
+    journal.append(CrawlJournal::Op::Done, 12);
+    writer.submit_journal(journal.take(), std::nullopt);
+    writer.drain();
+
+    const auto stats = writer.stats();
+    EXPECT_EQ(stats.snapshots_written + stats.snapshots_superseded, 1u);
+    EXPECT_GE(stats.fsyncs, 1u);
+    EXPECT_EQ(stats.failures, 0u);
+  }
+  const CrawlSnapshot loaded = CrawlSnapshot::open(state.string());
+  EXPECT_EQ(loaded.info.journal_generation, 1u);
+  ASSERT_EQ(loaded.visited_size(), 1u);
+  EXPECT_EQ(loaded.visited()[0], 10u);
+  EXPECT_EQ(replay_uids(journal_path, 1), (std::vector<uint64_t>{11, 12}));
+}
+
+TEST(CheckpointWriterTest, NewerSnapshotSupersedesQueuedJournal) {
+  const TempDir tmp("ckpt_coalesce");
+  const auto &dir = tmp.path();
+  const auto state = dir / "state.json";
+  const auto journal_path = dir / "state.json.journal";
+  {
+    CheckpointWriter writer(state.string(), journal_path.string(), 1000);
+    CrawlJournal journal;
+    for (uint64_t generation = 1; generation <= 50; ++generation) {
+      writer.submit_snapshot(make_snapshot(generation, generation), CrawlSnapshot::Format::Json, std::nullopt);
+      journal.append(CrawlJournal::Op::Done, 1000 + generation);
+      writer.submit_journal(journal.take(), std::nullopt);
+    }
+    writer.drain();
+    const auto stats = writer.stats();
+    EXPECT_EQ(stats.snapshots_written + stats.snapshots_superseded, 50u);
+  }
+  const CrawlSnapshot loaded = CrawlSnapshot::open(state.string());
+  EXPECT_EQ(loaded.info.journal_generation, 50u);
+  EXPECT_EQ(replay_uids(journal_path, 50), (std::vector<uint64_t>{1050}));
+}
+
+TEST(CheckpointWriterTest, CompletesSnapshotOnWriterThread) {
+  const TempDir tmp("ckpt_complete");
+  const auto &dir = tmp.path();
+  const auto state = dir / "state.bin";
+  const auto journal_path = dir / "state.bin.journal";
+  {
+    CheckpointWriter writer(state.string(), journal_path.string(), 0);
+    const auto caller = std::this_thread::get_id();
+    bool on_writer_thread = false;
+    writer.submit_snapshot(make_snapshot(1, 10), CrawlSnapshot::Format::Binary, std::nullopt,
+                           [&](CrawlSnapshot &snapshot) {
+                             on_writer_thread = std::this_thread::get_id() != caller;
+                             snapshot.set_visited({20, 30});
+                           });
+    writer.drain();
+    EXPECT_TRUE(on_writer_thread);
+
+    // A throwing completion fails the snapshot like a failed write.
+    writer.submit_snapshot(make_snapshot(2, 10), CrawlSnapshot::Format::Binary, std::nullopt,
+                           [](CrawlSnapshot &) { throw std::runtime_error("runs not written"); });
+    writer.drain();
+    EXPECT_EQ(writer.stats().failures, 1u);
+    EXPECT_TRUE(writer.needs_snapshot());
+  }
+  const CrawlSnapshot loaded = CrawlSnapshot::open(state.string());
+  EXPECT_EQ(loaded.info.journal_generation, 1u);
+  ASSERT_EQ(loaded.visited_size(), 2u);
+  EXPECT_EQ(loaded.visited()[0], 20u);
+  EXPECT_EQ(loaded.visited()[1], 30u);
+}
+
+TEST(CheckpointWriterTest, FailedSnapshotStopsJournalUntilNextSnapshot) {
+  const TempDir tmp("ckpt_failure");
+  const auto &dir = tmp.path();
+  const auto state = dir / "missing" / "state.json";
+  const auto journal_path = dir / "state.json.journal";
+  CheckpointWriter writer(state.string(), journal_path.string(), -1);
+  writer.submit_snapshot(make_snapshot(1, 1), CrawlSnapshot::Format::Json, std::nullopt);
+  writer.drain();
+  EXPECT_TRUE(writer.needs_snapshot());
+  EXPECT_EQ(writer.stats().failures, 1u);
+
+  CrawlJournal journal;
+  journal.append(CrawlJournal::Op::Done, 2);
+  writer.submit_journal(journal.take(), std::nullopt);
+  writer.drain();
+  EXPECT_FALSE(std::filesystem::exists(journal_path));
+
+  std::filesystem::create_directories(state.parent_path());
+  writer.submit_snapshot(make_snapshot(2, 1), CrawlSnapshot::Format::Json, std::nullopt);
+  writer.drain();
+  EXPECT_FALSE(writer.needs_snapshot());
+  EXPECT_TRUE(std::filesystem::exists(journal_path));
+
+  writer.remove_files();
+  EXPECT_FALSE(std::filesystem::exists(state));
+  EXPECT_FALSE(std::filesystem::exists(journal_path));
+}
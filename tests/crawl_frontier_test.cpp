@@ -0,0 +1,223 @@
+#include "crawl_frontier.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(CrawlFrontierTest, PackRoundTripsUidAndDepth) {
+  const uint64_t uid = 6126303533ULL;
+  const uint64_t entry = CrawlFrontier::pack(uid, 3);
+
+  EXPECT_EQ(CrawlFrontier::unpack_uid(entry), uid);
+  EXPECT_EQ(CrawlFrontier::unpack_depth(entry), 3);
+  EXPECT_EQ(CrawlFrontier::unpack_depth(CrawlFrontier::pack(uid, 1000)), CrawlFrontier::kMaxDepth);
+}
+
+TEST(CrawlFrontierTest, PushDeduplicatesOnEnqueue) {
+  CrawlFrontier frontier;
+
+  EXPECT_TRUE(frontier.push(1, 0));
+  EXPECT_TRUE(frontier.push(2, 1));
+  EXPECT_FALSE(frontier.push(1, 1));
+  EXPECT_EQ(frontier.pending(), 2U);
+
+  uint64_t uid = 0;
+  int depth = -1;
+  ASSERT_TRUE(frontier.pop(&uid, &depth));
+  EXPECT_EQ(uid, 1U);
+  EXPECT_EQ(depth, 0);
+
+  // Popped uids stay seen, so rediscovery does not re-queue them.
+  EXPECT_FALSE(frontier.push(1, 2));
+  EXPECT_EQ(frontier.pending(), 1U);
+}
+
+TEST(CrawlFrontierTest, MarkSeenBlocksFuturePushes) {
+  CrawlFrontier frontier;
+  frontier.mark_seen(42);
+
+  EXPECT_TRUE(frontier.seen(42));
+  EXPECT_FALSE(frontier.push(42, 0));
+  EXPECT_TRUE(frontier.empty());
+}
+
+TEST(CrawlFrontierTest, RejectsUidWiderThanPackedField) {
+  CrawlFrontier frontier;
+
+  EXPECT_FALSE(frontier.push(CrawlFrontier::kUidMask + 1, 0));
+  EXPECT_TRUE(frontier.empty());
+}
+
+TEST(CrawlFrontierTest, KeepsFifoOrderAcrossCompaction) {
+  CrawlFrontier frontier;
+  const uint64_t total = 20000;
+  for (uint64_t uid = 1; uid <= total; ++uid) {
+    ASSERT_TRUE(frontier.push(uid, static_cast<int>(uid % 4)));
+  }
+
+  for (uint64_t expected = 1; expected <= total; ++expected) {
+    uint64_t uid = 0;
+    int depth = 0;
+    ASSERT_TRUE(frontier.pop(&uid, &depth));
+    ASSERT_EQ(uid, expected);
+    ASSERT_EQ(depth, static_cast<int>(expected % 4));
+    if (expected == total / 2) {
+      frontier.push(total + 1, 0);
+    }
+  }
+
+  uint64_t uid = 0;
+  ASSERT_TRUE(frontier.pop(&uid, nullptr));
+  EXPECT_EQ(uid, total + 1);
+  EXPECT_TRUE(frontier.empty());
+}
+
+TEST(CrawlFrontierTest, PendingEntriesListsUnconsumedWork) {
+  CrawlFrontier frontier;
+  frontier.push(10, 0);
+  frontier.push(11, 1);
+  frontier.push(12, 1);
+  frontier.pop(nullptr, nullptr);
+
+  const auto pending = frontier.pending_entries();
+  ASSERT_EQ(pending.size(), 2U);
+  EXPECT_EQ(pending[0].first, 11U);
+  EXPECT_EQ(pending[0].second, 1);
+  EXPECT_EQ(pending[1].first, 12U);
+  EXPECT_EQ(pending[1].second, 1);
+}
+
+TEST(CrawlFrontierTest, ReportsMemoryPerMillionEntries) {
+  CrawlFrontier frontier;
+  for (uint64_t uid = 1; uid <= 100000; ++uid) {
+    frontier.push(uid, 1);
+  }
+
+  EXPECT_GE(frontier.memory_bytes(), 100000 * sizeof(uint64_t));
+  // Packed entry (8 bytes) plus an open-addressing slot share per uid.
+  EXPECT_GT(frontier.memory_bytes_per_million(), 8.0 * 1000000.0);
+  EXPECT_LT(frontier.memory_bytes_per_million(), 40.0 * 1000000.0);
+}
+
+TEST(CrawlFrontierTest, ParsesOrderNames) {
+  FrontierOrder order = FrontierOrder::Fifo;
+  EXPECT_TRUE(parse_frontier_order("degree", &order));
+  EXPECT_EQ(order, FrontierOrder::Degree);
+  EXPECT_STREQ(frontier_order_name(order), "degree");
+  EXPECT_FALSE(parse_frontier_order("custom", &order));
+  EXPECT_EQ(order, FrontierOrder::Degree);
+}
+
+TEST(CrawlFrontierTest, FollowersOrderUsesLookup) {
+  CrawlFrontier frontier;
+  FrontierOrdering ordering;
+  ordering.order = FrontierOrder::Followers;
+  ordering.followers_count = [](uint64_t uid) { return uid == 2 ? 1000 : uid; };
+  ASSERT_TRUE(frontier.set_ordering(ordering));
+
+  for (uint64_t uid = 1; uid <= 4; ++uid) {
+    EXPECT_TRUE(frontier.push(uid, 1));
+  }
+  std::vector<uint64_t> order;
+  uint64_t uid = 0;
+  while (frontier.pop(&uid, nullptr)) {
+    order.push_back(uid);
+  }
+  EXPECT_EQ(order, (std::vector<uint64_t>{2, 4, 3, 1}));
+}
+
+TEST(CrawlFrontierTest, RediscoveryRaisesDegreeAndLowersDepth) {
+  CrawlFrontier frontier;
+  FrontierOrdering ordering;
+  ordering.order = FrontierOrder::Degree;
+  ASSERT_TRUE(frontier.set_ordering(ordering));
+
+  EXPECT_TRUE(frontier.push(1, 2));
+  EXPECT_TRUE(frontier.push(2, 2));
+  EXPECT_TRUE(frontier.push(3, 2));
+  // Still rejected as new entries, but they re-rank the queued ones.
+  EXPECT_FALSE(frontier.push(3, 1));
+  EXPECT_FALSE(frontier.push(3, 2));
+  EXPECT_FALSE(frontier.push(2, 3));
+  EXPECT_EQ(frontier.pending(), 3U);
+
+  uint64_t uid = 0;
+  int depth = 0;
+  ASSERT_TRUE(frontier.pop(&uid, &depth));
+  EXPECT_EQ(uid, 3U);
+  EXPECT_EQ(depth, 1);
+  ASSERT_TRUE(frontier.pop(&uid, &depth));
+  EXPECT_EQ(uid, 2U);
+  EXPECT_EQ(depth, 2);
+  // Popped uids stay seen and are not re-ranked.
+  EXPECT_FALSE(frontier.push(3, 0));
+  ASSERT_TRUE(frontier.pop(&uid, &depth));
+  EXPECT_EQ(uid, 1U);
+  EXPECT_TRUE(frontier.empty());
+}
+
+TEST(CrawlFrontierTest, PendingEntriesRestoreRankedCandidates) {
+  FrontierOrdering ordering;
+  ordering.order = FrontierOrder::Degree;
+  CrawlFrontier frontier;
+  ASSERT_TRUE(frontier.set_ordering(ordering));
+
+  bool reranked = true;
+  EXPECT_TRUE(frontier.push(1, 2, &reranked));
+  EXPECT_FALSE(reranked);
+  frontier.push(2, 3);
+  EXPECT_FALSE(frontier.push(2, 1, &reranked));
+  EXPECT_TRUE(reranked);
+  frontier.push(2, 2);
+
+  // What a resume does with a snapshot plus the journaled repeats.
+  CrawlFrontier resumed;
+  ASSERT_TRUE(resumed.set_ordering(ordering));
+  for (const auto &[uid, depth] : frontier.pending_entries()) {
+    resumed.push(uid, depth);
+  }
+  EXPECT_EQ(resumed.pending(), 2U);
+
+  uint64_t uid = 0;
+  int depth = 0;
+  ASSERT_TRUE(resumed.pop(&uid, &depth));
+  EXPECT_EQ(uid, 2U);
+  EXPECT_EQ(depth, 1);
+  // Once popped, a uid is no longer re-ranked.
+  EXPECT_FALSE(resumed.push(2, 0, &reranked));
+  EXPECT_FALSE(reranked);
+  ASSERT_TRUE(resumed.pop(&uid, &depth));
+  EXPECT_EQ(uid, 1U);
+  EXPECT_EQ(depth, 2);
+}
+
+TEST(CrawlFrontierTest, CustomOrderScoresCandidates) {
+  CrawlFrontier frontier;
+  FrontierOrdering ordering;
+  ordering.order = FrontierOrder::Custom;
+  EXPECT_FALSE(frontier.set_ordering(ordering));
+  EXPECT_EQ(frontier.order(), FrontierOrder::Fifo);
+
+  ordering.score = [](const FrontierCandidate &candidate) {
+    return candidate.uid % 2 == 0 ? 1.0 : 0.0;
+  };
+  ASSERT_TRUE(frontier.set_ordering(ordering));
+  for (uint64_t uid = 1; uid <= 6; ++uid) {
+    frontier.push(uid, 0);
+  }
+  EXPECT_EQ(frontier.pending_entries().size(), 6U);
+
+  std::vector<uint64_t> order;
+  uint64_t uid = 0;
+  while (frontier.pop(&uid, nullptr)) {
+    order.push_back(uid);
+  }
+  EXPECT_EQ(order, (std::vector<uint64_t>{2, 4, 6, 1, 3, 5}));
+}
+
+TEST(CrawlFrontierTest, OrderingNeedsEmptyFrontier) {
+  CrawlFrontier frontier;
+  frontier.push(1, 0);
+  FrontierOrdering ordering;
+  ordering.order = FrontierOrder::Depth;
+  EXPECT_FALSE(frontier.set_ordering(ordering));
+  EXPECT_EQ(frontier.order(), FrontierOrder::Fifo);
+}
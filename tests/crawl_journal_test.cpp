@@ -0,0 +1,91 @@
+#include "crawl_journal.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+void write_journal(const std::filesystem::path &path, uint64_t generation, CrawlJournal *journal) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs << CrawlJournal::header(generation) << journal->take();
+}
+
+std::vector<CrawlJournal::Record> replay_all(const std::filesystem::path &path, uint64_t generation) {
+  std::vector<CrawlJournal::Record> records;
+  CrawlJournal::replay(path.string(), generation, [&records](const CrawlJournal::Record &record) {
+    records.push_back(record);
+  });
+  return records;
+}
+
+}
+
+TEST(CrawlJournalTest, ReplaysRecordsInOrder) {
+  const TempDir tmp("journal_order");
+  const auto path = tmp.file("journal_order");
+  {
+    CrawlJournal journal;
+    EXPECT_FALSE(journal.active());
+    journal.reset();
+    EXPECT_TRUE(journal.active());
+    journal.append(CrawlJournal::Op::Claim, 100, 1);
+    journal.append(CrawlJournal::Op::Push, 200, 2);
+    journal.append(CrawlJournal::Op::Done, 100);
+    journal.append(CrawlJournal::Op::Fail, 300);
+    EXPECT_EQ(journal.records(), 4u);
+    write_journal(path, 3, &journal);
+    EXPECT_TRUE(journal.take().empty());
+  }
+  const auto records = replay_all(path, 3);
+  ASSERT_EQ(records.size(), 4u);
+  EXPECT_EQ(records[0].op, CrawlJournal::Op::Claim);
+  EXPECT_EQ(records[0].uid, 100u);
+  EXPECT_EQ(records[0].depth, 1);
+  EXPECT_EQ(records[1].op, CrawlJournal::Op::Push);
+  EXPECT_EQ(records[1].uid, 200u);
+  EXPECT_EQ(records[1].depth, 2);
+  EXPECT_EQ(records[2].op, CrawlJournal::Op::Done);
+  EXPECT_EQ(records[3].op, CrawlJournal::Op::Fail);
+  EXPECT_EQ(records[3].uid, 300u);
+}
+
+TEST(CrawlJournalTest, IgnoresJournalFromOtherGeneration) {
+  const TempDir tmp("journal_generation");
+  const auto path = tmp.file("journal_generation");
+  {
+    CrawlJournal journal;
+    journal.append(CrawlJournal::Op::Done, 1);
+    write_journal(path, 7, &journal);
+  }
+  EXPECT_TRUE(replay_all(path, 8).empty());
+  EXPECT_EQ(replay_all(path, 7).size(), 1u);
+  EXPECT_TRUE(replay_all(tmp.file("journal_missing"), 7).empty());
+}
+
+TEST(CrawlJournalTest, StopsAtTornOrCorruptRecord) {
+  const TempDir tmp("journal_torn");
+  const auto path = tmp.file("journal_torn");
+  {
+    CrawlJournal journal;
+    for (uint64_t uid = 1; uid <= 10; ++uid) {
+      journal.append(CrawlJournal::Op::Done, uid);
+    }
+    write_journal(path, 1, &journal);
+  }
+  // Cut the last record in half, as a crash mid-write would.
+  const auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - 5);
+  EXPECT_EQ(replay_all(path, 1).size(), 9u);
+
+  // Flip a payload byte of the fourth record.
+  {
+    std::fstream fs(path, std::ios::in | std::ios::out | std::ios::binary);
+    fs.seekp(16 + 3 * 18 + 12);
+    fs.put('\x7f');
+  }
+  EXPECT_EQ(replay_all(path, 1).size(), 3u);
+}
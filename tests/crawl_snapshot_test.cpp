@@ -0,0 +1,95 @@
+#include "crawl_frontier.hpp"
+#include "crawl_snapshot.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+CrawlSnapshot make_snapshot() {
+  CrawlSnapshot snapshot;
+  snapshot.info.root_uid = 6126303533;
+  snapshot.info.max_depth = 2;
+  snapshot.info.crawl_fans = true;
+  snapshot.info.current_uid = 42;
+  snapshot.info.journal_generation = 9;
+  snapshot.info.in_flight_count = 1;
+  snapshot.info.frontier_dir = "frontier";
+  snapshot.info.users_processed = 10;
+  snapshot.info.http_429_count = 3;
+  snapshot.set_queue({CrawlFrontier::pack(5, 1), CrawlFrontier::pack(7, 2)});
+  snapshot.set_visited({30, 10, 20, 10});
+  return snapshot;
+}
+
+void expect_matches_sample(const CrawlSnapshot &snapshot) {
+  EXPECT_EQ(snapshot.info.root_uid, 6126303533u);
+  EXPECT_EQ(snapshot.info.max_depth, 2);
+  EXPECT_FALSE(snapshot.info.crawl_weibo);
+  EXPECT_TRUE(snapshot.info.crawl_fans);
+  EXPECT_FALSE(snapshot.info.crawl_followers);
+  EXPECT_EQ(snapshot.info.current_uid, 42u);
+  EXPECT_EQ(snapshot.info.journal_generation, 9u);
+  EXPECT_EQ(snapshot.info.in_flight_count, 1u);
+  EXPECT_EQ(snapshot.info.frontier_dir, "frontier");
+  EXPECT_TRUE(snapshot.info.visited_index.empty());
+  EXPECT_EQ(snapshot.info.users_processed, 10u);
+  EXPECT_EQ(snapshot.info.http_429_count, 3u);
+  ASSERT_EQ(snapshot.queue_size(), 2u);
+  EXPECT_EQ(CrawlFrontier::unpack_uid(snapshot.queue()[1]), 7u);
+  EXPECT_EQ(CrawlFrontier::unpack_depth(snapshot.queue()[1]), 2);
+  ASSERT_EQ(snapshot.visited_size(), 3u);
+  EXPECT_EQ(snapshot.visited()[0], 10u);
+  EXPECT_EQ(snapshot.visited()[2], 30u);
+}
+
+}
+
+TEST(CrawlSnapshotTest, BinaryRoundTripIsMapped) {
+  const TempDir tmp("snapshot");
+  const auto path = tmp.file("snapshot.bin");
+  make_snapshot().write(path.string(), CrawlSnapshot::Format::Binary);
+  const CrawlSnapshot loaded = CrawlSnapshot::open(path.string());
+  EXPECT_TRUE(loaded.mapped());
+  expect_matches_sample(loaded);
+}
+
+TEST(CrawlSnapshotTest, JsonRoundTripAndConversion) {
+  const TempDir tmp("snapshot");
+  const auto json_path = tmp.file("snapshot.json");
+  const auto bin_path = tmp.file("snapshot_converted.bin");
+  make_snapshot().write(json_path.string(), CrawlSnapshot::Format::Json);
+
+  const CrawlSnapshot from_json = CrawlSnapshot::open(json_path.string());
+  EXPECT_FALSE(from_json.mapped());
+  expect_matches_sample(from_json);
+
+  from_json.write(bin_path.string(), CrawlSnapshot::Format::Binary);
+  expect_matches_sample(CrawlSnapshot::open(bin_path.string()));
+}
+
+TEST(CrawlSnapshotTest, ReadsLegacyJsonWithCursor) {
+  const auto json = nlohmann::json::parse(R"({
+    "root_uid": 1, "max_depth": 1, "crawl_weibo": true, "crawl_fans": false,
+    "crawl_followers": true, "cursor": 1,
+    "queue": [{"uid": 1, "depth": 0}, {"uid": 2, "depth": 1}],
+    "visited": [1]
+  })");
+  const CrawlSnapshot snapshot = CrawlSnapshot::from_json(json);
+  EXPECT_EQ(snapshot.info.in_flight_count, 0u);
+  EXPECT_EQ(snapshot.info.journal_generation, 0u);
+  ASSERT_EQ(snapshot.queue_size(), 1u);
+  EXPECT_EQ(CrawlFrontier::unpack_uid(snapshot.queue()[0]), 2u);
+  ASSERT_EQ(snapshot.visited_size(), 1u);
+}
+
+TEST(CrawlSnapshotTest, RejectsTruncatedBinary) {
+  const TempDir tmp("snapshot_truncated");
+  const auto path = tmp.file("snapshot_truncated.bin");
+  make_snapshot().write(path.string(), CrawlSnapshot::Format::Binary);
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 8);
+  EXPECT_THROW(CrawlSnapshot::open(path.string()), std::runtime_error);
+}
@@ -0,0 +1,349 @@
+#include "http_transport.hpp"
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <netinet/in.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Self-signed certificate for 127.0.0.1, generated in memory.
+SSL_CTX *make_server_ctx() {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  EVP_PKEY *key = EVP_EC_gen("P-256");
+  X509 *cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME *subject = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char *>("127.0.0.1"), -1, -1, 0);
+  X509_set_issuer_name(cert, subject);
+  X509_sign(cert, key, EVP_sha256());
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ctx;
+}
+
+// HTTP (or HTTPS) server on 127.0.0.1 with one thread per connection.
+//   /len      Content-Length body "hello"
+//   /chunked  chunked body "hello"
+//   /close    close-delimited body "bye"
+//   /drop     Content-Length body "hello", connection closed 50ms later
+//   /missing  404
+//   /slow     "ok" after 200ms
+//   /hang     never answers
+class LocalServer {
+public:
+  explicit LocalServer(bool tls = false) : m_ctx(tls ? make_server_ctx() : nullptr) {
+    m_listen = socket(AF_INET, SOCK_STREAM, 0);
+    const int one = 1;
+    setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(m_listen, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    listen(m_listen, 128);
+    socklen_t len = sizeof(addr);
+    getsockname(m_listen, reinterpret_cast<sockaddr *>(&addr), &len);
+    m_port = ntohs(addr.sin_port);
+    m_accept = std::thread([this] { accept_loop(); });
+  }
+
+  ~LocalServer() {
+    m_stopping = true;
+    shutdown(m_listen, SHUT_RDWR);
+    close(m_listen);
+    m_accept.join();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      for (const int fd : m_clients) {
+        shutdown(fd, SHUT_RDWR);
+      }
+    }
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+    if (m_ctx) {
+      SSL_CTX_free(m_ctx);
+    }
+  }
+
+  std::string url() const {
+    return (m_ctx ? "https://127.0.0.1:" : "http://127.0.0.1:") + std::to_string(m_port);
+  }
+  int accepted() const { return m_accepted; }
+
+private:
+  void accept_loop() {
+    while (!m_stopping) {
+      const int fd = accept(m_listen, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      m_accepted++;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_clients.push_back(fd);
+      m_workers.emplace_back([this, fd] { serve(fd); });
+    }
+  }
+
+  void serve(int fd) {
+    SSL *ssl = nullptr;
+    if (m_ctx) {
+      ssl = SSL_new(m_ctx);
+      SSL_set_fd(ssl, fd);
+      if (SSL_accept(ssl) != 1) {
+        SSL_free(ssl);
+        close(fd);
+        return;
+      }
+    }
+    serve_requests(fd, ssl);
+    if (ssl) {
+      SSL_free(ssl);
+    }
+    close(fd);
+  }
+
+  void serve_requests(int fd, SSL *ssl) {
+    std::string buf;
+    char chunk[4096];
+    for (;;) {
+      size_t end;
+      while ((end = buf.find("\r\n\r\n")) == std::string::npos) {
+        const ssize_t n = ssl ? SSL_read(ssl, chunk, sizeof(chunk)) : recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+          return;
+        }
+        buf.append(chunk, static_cast<size_t>(n));
+      }
+      const std::string head = buf.substr(0, end);
+      buf.erase(0, end + 4);
+      const std::string path = head.substr(4, head.find(' ', 4) - 4);
+      std::string response;
+      bool close_after = false;
+      int close_delay_ms = 0;
+      if (path == "/len") {
+        response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+      } else if (path == "/chunked") {
+        response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nhel\r\n2\r\nlo\r\n0\r\n\r\n";
+      } else if (path == "/close") {
+        response = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nbye";
+        close_after = true;
+      } else if (path == "/drop") {
+        response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+        close_after = true;
+        close_delay_ms = 50;
+      } else if (path == "/slow") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+      } else if (path == "/hang") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        return;
+      } else {
+        response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      }
+      if (ssl) {
+        SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+      } else {
+        send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+      }
+      if (close_after) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(close_delay_ms));
+        if (ssl) {
+          SSL_shutdown(ssl);
+        }
+        return;
+      }
+    }
+  }
+
+  SSL_CTX *m_ctx = nullptr;
+  int m_listen = -1;
+  int m_port = 0;
+  std::atomic<bool> m_stopping{false};
+  std::atomic<int> m_accepted{0};
+  std::thread m_accept;
+  std::mutex m_mutex;
+  std::vector<int> m_clients;
+  std::vector<std::thread> m_workers;
+};
+
+HttpTransportOptions options_for(const LocalServer &server) {
+  HttpTransportOptions options;
+  options.base_url = server.url();
+  options.max_connections = 64;
+  options.connect_timeout_ms = 2000;
+  options.request_timeout_ms = 2000;
+  return options;
+}
+
+}
+
+TEST(EpollTransportTest, ParsesBodiesAndStatuses) {
+  LocalServer server;
+  auto transport = make_epoll_transport(options_for(server));
+
+  HttpResponse length = transport->get("/len", {{"X-Test", "1"}});
+  EXPECT_EQ(length.status, 200);
+  EXPECT_EQ(length.body, "hello");
+  EXPECT_EQ(length.headers["content-length"], "5");
+
+  HttpResponse chunked = transport->get("/chunked", {});
+  EXPECT_EQ(chunked.status, 200);
+  EXPECT_EQ(chunked.body, "hello");
+
+  HttpResponse closed = transport->get("/close", {});
+  EXPECT_EQ(closed.status, 200);
+  EXPECT_EQ(closed.body, "bye");
+
+  HttpResponse missing = transport->get("/missing", {});
+  EXPECT_EQ(missing.status, 404);
+  EXPECT_TRUE(missing.body.empty());
+}
+
+TEST(EpollTransportTest, ReusesKeepAliveConnection) {
+  LocalServer server;
+  auto transport = make_epoll_transport(options_for(server));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(transport->get("/len", {}).status, 200);
+  }
+  EXPECT_EQ(server.accepted(), 1);
+
+  // A server-closed connection is replaced transparently.
+  EXPECT_EQ(transport->get("/close", {}).status, 200);
+  EXPECT_EQ(transport->get("/len", {}).status, 200);
+  EXPECT_EQ(server.accepted(), 2);
+}
+
+TEST(EpollTransportTest, KeepsManyRequestsInFlightOnOneThread) {
+  LocalServer server;
+  auto transport = make_epoll_transport(options_for(server));
+  constexpr int kRequests = 40;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int done = 0;
+  int ok = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRequests; ++i) {
+    transport->get_async("/slow", {}, [&](HttpResponse response) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ok += response.status == 200 ? 1 : 0;
+      done++;
+      cv.notify_all();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(5), [&] { return done == kRequests; }));
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_EQ(ok, kRequests);
+  // Sequentially this takes 8s; concurrently about one server delay.
+  EXPECT_LT(elapsed, std::chrono::milliseconds(2000));
+}
+
+TEST(EpollTransportTest, ReportsTransportErrors) {
+  LocalServer server;
+  HttpTransportOptions options = options_for(server);
+  options.request_timeout_ms = 200;
+  auto transport = make_epoll_transport(options);
+  const HttpResponse timed_out = transport->get("/hang", {});
+  EXPECT_EQ(timed_out.status, 0);
+  EXPECT_EQ(timed_out.error, "request timeout");
+
+  // Nothing listens on the port once the server is gone.
+  {
+    LocalServer closed;
+    options.base_url = closed.url();
+  }
+  auto refused = make_epoll_transport(options);
+  const HttpResponse response = refused->get("/len", {});
+  EXPECT_EQ(response.status, 0);
+  EXPECT_FALSE(response.error.empty());
+}
+
+TEST(EpollTransportTest, CountsReuseAndExpiresIdleConnections) {
+  LocalServer server;
+  HttpTransportOptions options = options_for(server);
+  options.max_idle_ms = 100;
+  auto transport = make_epoll_transport(options);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(transport->get("/len", {}).status, 200);
+  }
+  HttpTransportStats stats = transport->stats();
+  EXPECT_EQ(stats.requests, 3U);
+  EXPECT_EQ(stats.reused, 2U);
+  EXPECT_EQ(stats.connections_opened, 1U);
+  EXPECT_EQ(stats.handshakes, 1U);
+  EXPECT_EQ(stats.max_requests_per_connection, 3U);
+  EXPECT_EQ(stats.idle_connections, 1U);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  stats = transport->stats();
+  EXPECT_EQ(stats.idle_expired, 1U);
+  EXPECT_EQ(stats.open_connections, 0U);
+
+  // A connection the server closed while idle is not reused.
+  EXPECT_EQ(transport->get("/drop", {}).status, 200);
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  EXPECT_EQ(transport->get("/len", {}).status, 200);
+  stats = transport->stats();
+  EXPECT_EQ(stats.idle_closed, 1U);
+  EXPECT_EQ(stats.connections_opened, 3U);
+  EXPECT_EQ(server.accepted(), 3);
+}
+
+TEST(EpollTransportTest, ResumesTlsSessionOnReconnect) {
+  LocalServer server(true);
+  auto transport = make_epoll_transport(options_for(server));
+  const HttpResponse first = transport->get("/drop", {});
+  EXPECT_EQ(first.status, 200);
+  EXPECT_EQ(first.body, "hello");
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  EXPECT_EQ(transport->get("/len", {}).status, 200);
+
+  const HttpTransportStats stats = transport->stats();
+  EXPECT_EQ(stats.handshakes, 2U);
+  EXPECT_EQ(stats.resumed_handshakes, 1U);
+  EXPECT_GT(stats.handshake_ms, 0.0);
+  EXPECT_GE(stats.request_ms, stats.handshake_ms);
+}
+
+TEST(BlockingTransportTest, QueuesRequestsBeyondMaxConnections) {
+  LocalServer server;
+  HttpTransportOptions options = options_for(server);
+  options.max_connections = 1;
+  auto transport = make_blocking_transport(options);
+
+  std::vector<std::thread> callers;
+  std::atomic<int> ok{0};
+  for (int i = 0; i < 4; ++i) {
+    callers.emplace_back([&] { ok += transport->get("/slow", {}).status == 200 ? 1 : 0; });
+  }
+  for (auto &caller : callers) {
+    caller.join();
+  }
+  EXPECT_EQ(ok, 4);
+  // All four took turns on the one client instead of opening more.
+  const HttpTransportStats stats = transport->stats();
+  EXPECT_EQ(stats.connections_opened, 1U);
+  EXPECT_EQ(stats.reused, 3U);
+  EXPECT_EQ(server.accepted(), 1);
+}
@@ -0,0 +1,79 @@
+#include "indexed_priority_queue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST(IndexedPriorityQueueTest, PopsHighestPriorityFirstFifoOnTies) {
+  IndexedPriorityQueue<int> queue;
+  EXPECT_TRUE(queue.push(1, 1.0, 10));
+  EXPECT_TRUE(queue.push(2, 5.0, 20));
+  EXPECT_TRUE(queue.push(3, 1.0, 30));
+  EXPECT_TRUE(queue.push(4, 5.0, 40));
+  EXPECT_FALSE(queue.push(2, 9.0, 99));
+  EXPECT_EQ(queue.size(), 4U);
+
+  std::vector<uint64_t> order;
+  uint64_t key = 0;
+  int value = 0;
+  while (queue.pop(&key, &value)) {
+    EXPECT_EQ(value, static_cast<int>(key) * 10);
+    order.push_back(key);
+  }
+  EXPECT_EQ(order, (std::vector<uint64_t>{2, 4, 1, 3}));
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(IndexedPriorityQueueTest, UpdateRepositionsQueuedKey) {
+  IndexedPriorityQueue<int> queue;
+  for (uint64_t key = 1; key <= 5; ++key) {
+    queue.push(key, static_cast<double>(key), 0);
+  }
+  EXPECT_TRUE(queue.update(1, 10.0));
+  EXPECT_TRUE(queue.update(5, 0.0));
+  EXPECT_FALSE(queue.update(6, 1.0));
+
+  *queue.find(3) = 7;
+  EXPECT_EQ(queue.find(6), nullptr);
+
+  std::vector<uint64_t> order;
+  uint64_t key = 0;
+  int value = 0;
+  double priority = 0;
+  while (queue.pop(&key, &value, &priority)) {
+    order.push_back(key);
+    if (key == 3) {
+      EXPECT_EQ(value, 7);
+      EXPECT_DOUBLE_EQ(priority, 3.0);
+    }
+  }
+  EXPECT_EQ(order, (std::vector<uint64_t>{1, 4, 3, 2, 5}));
+}
+
+TEST(IndexedPriorityQueueTest, MatchesSortedOrderUnderRandomUpdates) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> dist(0.0, 100.0);
+  IndexedPriorityQueue<int> queue;
+  std::vector<double> expected(2000);
+  for (uint64_t key = 0; key < expected.size(); ++key) {
+    expected[key] = dist(rng);
+    queue.push(key, expected[key], 0);
+  }
+  for (int i = 0; i < 5000; ++i) {
+    const uint64_t key = rng() % expected.size();
+    expected[key] = dist(rng);
+    ASSERT_TRUE(queue.update(key, expected[key]));
+  }
+
+  std::vector<double> popped;
+  double priority = 0;
+  uint64_t key = 0;
+  while (queue.pop(&key, nullptr, &priority)) {
+    ASSERT_DOUBLE_EQ(priority, expected[key]);
+    popped.push_back(priority);
+  }
+  ASSERT_EQ(popped.size(), expected.size());
+  EXPECT_TRUE(std::is_sorted(popped.begin(), popped.end(), [](double a, double b) { return a > b; }));
+}
@@ -0,0 +1,97 @@
+#include "profile_cache.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+CachedProfile make_profile(uint64_t uid, const std::string &name, int64_t fetched_at) {
+  CachedProfile profile;
+  profile.uid = uid;
+  profile.screen_name = name;
+  profile.followers_count = uid * 10;
+  profile.fetched_at = fetched_at;
+  return profile;
+}
+
+}
+
+TEST(ProfileCacheTest, HitsWithinTtlAndMissesAfter) {
+  ProfileCache cache("", 100);
+  cache.put(make_profile(7, "alice", 1000));
+
+  auto hit = cache.get(7, 1099);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->screen_name, "alice");
+  EXPECT_EQ(hit->followers_count, 70U);
+
+  EXPECT_FALSE(cache.get(7, 1100).has_value());
+  EXPECT_FALSE(cache.get(8, 1000).has_value());
+
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 2U);
+  EXPECT_EQ(stats.expired, 1U);
+  EXPECT_EQ(stats.entries, 1U);
+}
+
+TEST(ProfileCacheTest, PeekIgnoresTtlAndStats) {
+  ProfileCache cache("", 100);
+  cache.put(make_profile(7, "alice", 1000));
+
+  auto peeked = cache.peek(7);
+  ASSERT_TRUE(peeked.has_value());
+  EXPECT_EQ(peeked->followers_count, 70U);
+  EXPECT_FALSE(cache.peek(8).has_value());
+
+  const auto stats = cache.stats();
+  EXPECT_EQ(stats.hits, 0U);
+  EXPECT_EQ(stats.misses, 0U);
+}
+
+TEST(ProfileCacheTest, PersistsAcrossInstancesLatestEntryWins) {
+  const TempDir tmp("profile_cache_persist");
+  const auto &dir = tmp.path();
+  const auto path = (dir / "profiles.jsonl").string();
+  {
+    ProfileCache cache(path, 100);
+    cache.put(make_profile(1, "old", 1000));
+    cache.put(make_profile(2, "bob", 1000));
+    cache.put(make_profile(1, "new", 1050));
+  }
+  ProfileCache reopened(path, 100);
+  EXPECT_EQ(reopened.stats().entries, 2U);
+  auto first = reopened.get(1, 1060);
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->screen_name, "new");
+  EXPECT_EQ(first->fetched_at, 1050);
+  ASSERT_TRUE(reopened.get(2, 1060).has_value());
+
+}
+
+TEST(ProfileCacheTest, SkipsTornLastLine) {
+  const TempDir tmp("profile_cache_torn");
+  const auto &dir = tmp.path();
+  const auto path = (dir / "profiles.jsonl").string();
+  {
+    ProfileCache cache(path, 100);
+    cache.put(make_profile(3, "carol", 1000));
+  }
+  {
+    std::ofstream ofs(path, std::ios::app);
+    ofs << "{\"uid\":4,\"name\":\"da";
+  }
+  {
+    ProfileCache reopened(path, 100);
+    EXPECT_EQ(reopened.stats().entries, 1U);
+    reopened.put(make_profile(5, "eve", 1000));
+  }
+  // The torn line was dropped on load, so the next append stays readable.
+  ProfileCache again(path, 100);
+  EXPECT_EQ(again.stats().entries, 2U);
+  EXPECT_TRUE(again.get(5, 1000).has_value());
+
+}
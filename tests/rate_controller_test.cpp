@@ -0,0 +1,64 @@
+#include "rate_controller.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+RateControllerOptions make_options() {
+  RateControllerOptions options;
+  options.floor_interval_ms = 250;     // 4 rps
+  options.ceiling_interval_ms = 2000;  // 0.5 rps
+  options.initial_interval_ms = 1000;  // 1 rps
+  options.increase_rps = 0.5;
+  options.decrease_factor = 0.5;
+  options.latency_threshold_ms = 1000;
+  options.decrease_hold_ms = 1000;
+  return options;
+}
+
+const std::chrono::milliseconds kFast(100);
+
+}
+
+TEST(RateControllerTest, HealthyResponsesIncreaseUpToFloorInterval) {
+  RateController controller(make_options());
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 1.0);
+
+  controller.on_response(200, kFast);
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 1.5);
+  for (int i = 0; i < 20; ++i) {
+    controller.on_response(200, kFast);
+  }
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 4.0);
+  EXPECT_EQ(controller.interval().count(), 250);
+}
+
+TEST(RateControllerTest, ThrottlingHalvesRateOncePerHoldWindow) {
+  RateController controller(make_options());
+  const auto t0 = std::chrono::steady_clock::now();
+
+  controller.on_response(429, kFast, t0);
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 0.5);
+  // Echo of the same burst: ignored.
+  controller.on_response(503, kFast, t0 + std::chrono::milliseconds(200));
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 0.5);
+  EXPECT_EQ(controller.decreases(), 1U);
+
+  controller.on_response(200, kFast, t0 + std::chrono::milliseconds(300));
+  controller.on_response(0, kFast, t0 + std::chrono::milliseconds(1500));
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 0.5);  // 1.0 halved, clamped at ceiling
+  EXPECT_EQ(controller.decreases(), 2U);
+  EXPECT_EQ(controller.interval().count(), 2000);
+}
+
+TEST(RateControllerTest, SlowAndClientErrorsHoldRate) {
+  RateController controller(make_options());
+  controller.on_response(200, std::chrono::milliseconds(1500));
+  controller.on_response(404, kFast);
+  EXPECT_DOUBLE_EQ(controller.rate_rps(), 1.0);
+
+  EXPECT_EQ(controller.classify(200, std::chrono::milliseconds(1500)), RateController::Signal::Slow);
+  EXPECT_EQ(controller.classify(403, kFast), RateController::Signal::Neutral);
+  EXPECT_EQ(controller.classify(502, kFast), RateController::Signal::Throttled);
+  EXPECT_EQ(controller.classify(204, kFast), RateController::Signal::Healthy);
+}
@@ -0,0 +1,143 @@
+#include "rate_limiter.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+RateLimitRegistry::EndpointOptions endpoint(const std::string &name,
+                                            const std::string &prefix,
+                                            int min_interval_ms,
+                                            int burst = 1,
+                                            int cooldown_429_ms = 5000) {
+  RateLimitRegistry::EndpointOptions options;
+  options.name = name;
+  options.prefix = prefix;
+  options.min_interval_ms = min_interval_ms;
+  options.burst = burst;
+  options.cooldown_429_ms = cooldown_429_ms;
+  return options;
+}
+
+}
+
+TEST(TokenBucketTest, SpacesRequestsAfterBurst) {
+  TokenBucket bucket(1.0, 3);
+  const auto t0 = Clock::now();
+
+  EXPECT_EQ(bucket.reserve(t0), t0);
+  EXPECT_EQ(bucket.reserve(t0), t0);
+  EXPECT_EQ(bucket.reserve(t0), t0);
+  EXPECT_EQ(bucket.reserve(t0), t0 + milliseconds(1000));
+  EXPECT_EQ(bucket.reserve(t0), t0 + milliseconds(2000));
+
+  // Idle time refills the burst, but not beyond it.
+  const auto t1 = t0 + milliseconds(10000);
+  EXPECT_EQ(bucket.reserve(t1), t1);
+  EXPECT_EQ(bucket.reserve(t1), t1);
+  EXPECT_EQ(bucket.reserve(t1), t1);
+  EXPECT_EQ(bucket.reserve(t1), t1 + milliseconds(1000));
+}
+
+TEST(TokenBucketTest, HoldDelaysAndDrainsBurst) {
+  TokenBucket bucket(2.0, 2);
+  const auto t0 = Clock::now();
+  bucket.hold_until(t0 + milliseconds(3000));
+
+  EXPECT_EQ(bucket.reserve(t0), t0 + milliseconds(3000));
+  EXPECT_EQ(bucket.reserve(t0), t0 + milliseconds(3500));
+}
+
+TEST(RateLimitRegistryTest, RoutesByLongestPrefix) {
+  RateLimitRegistry registry;
+  registry.add(endpoint("friendships", "/ajax/friendships/", 1000));
+  registry.add(endpoint("default", "", 1000));
+  registry.add(endpoint("fans", "/ajax/friendships/friends", 1000));
+
+  EXPECT_EQ(registry.name(registry.route("/ajax/friendships/friends?uid=1")), "fans");
+  EXPECT_EQ(registry.name(registry.route("/ajax/friendships/other")), "friendships");
+  EXPECT_EQ(registry.name(registry.route("/ajax/profile/info?uid=1")), "default");
+
+  RateLimitRegistry empty;
+  EXPECT_THROW(empty.route("/"), std::logic_error);
+}
+
+TEST(RateLimitRegistryTest, EndpointsKeepSeparateBudgetsAndCooldowns) {
+  RateLimitRegistry registry;
+  registry.add(endpoint("profile", "/ajax/profile/", 1000));
+  registry.add(endpoint("timeline", "/ajax/statuses/", 500));
+  const auto t0 = Clock::now();
+
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0);
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0 + milliseconds(1000));
+  // The profile backlog does not delay timeline requests.
+  EXPECT_EQ(registry.acquire(1, milliseconds(0), t0), t0);
+  EXPECT_EQ(registry.acquire(1, milliseconds(50), t0), t0 + milliseconds(550));
+
+  registry.on_response(1, 429, milliseconds(10), t0);
+  EXPECT_GE(registry.acquire(1, milliseconds(0), t0), t0 + milliseconds(5000));
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0 + milliseconds(2000));
+
+  const auto stats = registry.stats();
+  ASSERT_EQ(stats.size(), 2U);
+  EXPECT_EQ(stats[0].name, "profile");
+  EXPECT_EQ(stats[0].requests, 3U);
+  EXPECT_EQ(stats[0].throttled, 0U);
+  EXPECT_EQ(stats[0].wait_ms, 3000U);
+  EXPECT_EQ(stats[1].requests, 3U);
+  EXPECT_EQ(stats[1].throttled, 1U);
+  EXPECT_GE(stats[1].wait_ms, 5550U);
+}
+
+TEST(RateLimitRegistryTest, AdaptiveEndpointsAdjustIndependently) {
+  RateControllerOptions adaptive;
+  adaptive.floor_interval_ms = 100;
+  adaptive.ceiling_interval_ms = 4000;
+  adaptive.increase_rps = 0.5;
+  RateLimitRegistry registry;
+  registry.add(endpoint("profile", "/ajax/profile/", 1000), adaptive);
+  registry.add(endpoint("fixed", "", 1000));
+
+  registry.on_response(0, 200, milliseconds(10));
+  registry.on_response(1, 200, milliseconds(10));
+  auto stats = registry.stats();
+  EXPECT_DOUBLE_EQ(stats[0].rate_rps, 1.5);
+  EXPECT_DOUBLE_EQ(stats[1].rate_rps, 1.0);
+
+  registry.on_response(0, 503, milliseconds(10));
+  stats = registry.stats();
+  EXPECT_DOUBLE_EQ(stats[0].rate_rps, 0.75);
+  EXPECT_EQ(stats[0].throttled, 0U);
+}
+
+TEST(RateLimitRegistryTest, BurstWindowPausesAndAttributesWaits) {
+  RateLimitRegistry registry;
+  auto options = endpoint("friendships", "/ajax/friendships/", 100);
+  options.pause_every = 3;
+  options.pause_ms = 2000;
+  registry.add(options);
+  const auto t0 = Clock::now();
+
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0);
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0 + milliseconds(100));
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0 + milliseconds(200));
+  // Fourth request opens a new window after the pause.
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0), t0 + milliseconds(2000));
+  EXPECT_EQ(registry.acquire(0, milliseconds(30), t0), t0 + milliseconds(2130));
+
+  registry.on_response(0, 429, milliseconds(10), t0 + milliseconds(2200));
+  EXPECT_EQ(registry.acquire(0, milliseconds(0), t0 + milliseconds(2200)),
+            t0 + milliseconds(7200));
+
+  const auto stats = registry.stats();
+  EXPECT_EQ(stats[0].pauses, 1U);
+  // Waits are summed over callers: both requests queued behind the pause
+  // count it.
+  EXPECT_EQ(stats[0].pause_wait_ms, 4000U);
+  EXPECT_EQ(stats[0].spacing_wait_ms, 100U + 200U + 100U);
+  EXPECT_EQ(stats[0].jitter_wait_ms, 30U);
+  EXPECT_EQ(stats[0].cooldown_wait_ms, 5000U);
+  EXPECT_EQ(stats[0].wait_ms, 9430U);
+}
@@ -0,0 +1,132 @@
+#include "recrawl_scheduler.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+
+namespace {
+
+constexpr int64_t kDay = 86400;
+
+// No forgetting and a weak prior, so rates are easy to check by hand.
+RecrawlOptions plain_options() {
+  RecrawlOptions options;
+  options.half_life_seconds = 0;
+  options.prior_posts = 0.1;
+  options.prior_seconds = kDay;
+  options.min_interval_seconds = 3600;
+  options.max_interval_seconds = 30 * kDay;
+  return options;
+}
+
+}
+
+TEST(RecrawlSchedulerTest, FirstVisitOnlyStartsTheClock) {
+  RecrawlScheduler scheduler("", plain_options());
+  scheduler.record_visit(1, 500, 1000);
+
+  const auto entry = scheduler.get(1);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->last_crawl, 1000);
+  EXPECT_EQ(entry->visits, 1U);
+  // The backlog of a first visit is not a posting rate.
+  EXPECT_DOUBLE_EQ(entry->posts, 0.0);
+  EXPECT_NEAR(scheduler.posts_per_day(1), 0.1, 1e-9);
+  EXPECT_NEAR(scheduler.posts_per_day(2), 0.1, 1e-9);
+}
+
+TEST(RecrawlSchedulerTest, EstimatesRateFromNewPosts) {
+  RecrawlScheduler scheduler("", plain_options());
+  scheduler.record_visit(1, 0, 1);
+  scheduler.record_visit(1, 10, 1 + kDay);
+  scheduler.record_visit(1, 9, 1 + 2 * kDay);
+
+  // (0.1 + 19) posts over (1 + 2) days.
+  EXPECT_NEAR(scheduler.posts_per_day(1), 19.1 / 3.0, 1e-9);
+
+  const auto entry = scheduler.get(1);
+  ASSERT_TRUE(entry.has_value());
+  // due_probability 0.5: t = ln 2 / rate.
+  const double rate = 19.1 / 3.0 / kDay;
+  EXPECT_NEAR(static_cast<double>(scheduler.due_at(*entry) - entry->last_crawl), std::log(2.0) / rate, 1.0);
+}
+
+TEST(RecrawlSchedulerTest, OldObservationsDecay) {
+  RecrawlOptions options = plain_options();
+  options.half_life_seconds = kDay;
+  RecrawlScheduler scheduler("", options);
+  scheduler.record_visit(1, 0, 1);
+  scheduler.record_visit(1, 40, 1 + kDay);
+  const double busy = scheduler.posts_per_day(1);
+  // Ten quiet days later the burst is mostly forgotten.
+  scheduler.record_visit(1, 0, 1 + 11 * kDay);
+  EXPECT_LT(scheduler.posts_per_day(1), busy / 5);
+}
+
+TEST(RecrawlSchedulerTest, DueTimeIsClampedToIntervalBounds) {
+  RecrawlScheduler scheduler("", plain_options());
+  // Very active: would be due within seconds.
+  scheduler.record_visit(1, 0, 1);
+  scheduler.record_visit(1, 5000, 1 + kDay);
+  // Silent: would be due after months.
+  scheduler.record_visit(2, 0, 1);
+  scheduler.record_visit(2, 0, 1 + 100 * kDay);
+
+  const auto active = scheduler.get(1);
+  const auto silent = scheduler.get(2);
+  ASSERT_TRUE(active && silent);
+  EXPECT_EQ(scheduler.due_at(*active), active->last_crawl + 3600);
+  EXPECT_EQ(scheduler.due_at(*silent), silent->last_crawl + 30 * kDay);
+}
+
+TEST(RecrawlSchedulerTest, PlansDueUsersByExpectedPosts) {
+  RecrawlScheduler scheduler("", plain_options());
+  const int64_t start = 1000;
+  // uid 1: about 2 posts a day, uid 2: about 10, uid 3: about 0.1, all
+  // last seen a day after start.
+  for (uint64_t uid : {1, 2, 3}) {
+    scheduler.record_visit(uid, 0, start);
+  }
+  scheduler.record_visit(1, 2, start + kDay);
+  scheduler.record_visit(2, 10, start + kDay);
+  scheduler.record_visit(3, 0, start + kDay);
+
+  const int64_t now = start + kDay + 12 * 3600;
+  const auto plan = scheduler.plan(12 * 3600, 0, now);
+  // uid 3 is not due for days.
+  ASSERT_EQ(plan.size(), 2U);
+  EXPECT_EQ(plan[0].uid, 2U);
+  EXPECT_EQ(plan[1].uid, 1U);
+  EXPECT_GT(plan[0].expected_posts, plan[1].expected_posts);
+  EXPECT_LE(plan[1].due_at, now + 12 * 3600);
+
+  const auto limited = scheduler.plan(12 * 3600, 1, now);
+  ASSERT_EQ(limited.size(), 1U);
+  EXPECT_EQ(limited[0].uid, 2U);
+
+  const auto wide = scheduler.plan(60 * kDay, 0, now);
+  EXPECT_EQ(wide.size(), 3U);
+  EXPECT_EQ(scheduler.stats(now + 60 * kDay).due, 3U);
+}
+
+TEST(RecrawlSchedulerTest, PersistsAcrossInstances) {
+  const TempDir tmp("recrawl_persist");
+  const auto &dir = tmp.path();
+  const auto path = (dir / "recrawl.jsonl").string();
+  {
+    RecrawlScheduler scheduler(path, plain_options());
+    scheduler.record_visit(1, 0, 1);
+    scheduler.record_visit(1, 6, 1 + kDay);
+    scheduler.record_visit(2, 3, 1);
+  }
+  RecrawlScheduler reopened(path, plain_options());
+  EXPECT_EQ(reopened.stats(1).users, 2U);
+  const auto entry = reopened.get(1);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->last_crawl, 1 + kDay);
+  EXPECT_EQ(entry->visits, 2U);
+  EXPECT_DOUBLE_EQ(entry->posts, 6.0);
+  EXPECT_DOUBLE_EQ(entry->exposure_seconds, static_cast<double>(kDay));
+}
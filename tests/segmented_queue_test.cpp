@@ -0,0 +1,140 @@
+#include "crawl_frontier.hpp"
+#include "segmented_queue.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <vector>
+
+namespace {
+
+size_t count_segment_files(const std::filesystem::path &dir) {
+  size_t n = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    n += entry.path().extension() == ".q" ? 1 : 0;
+  }
+  return n;
+}
+
+}
+
+TEST(SegmentedQueueTest, KeepsFifoOrderAcrossSegments) {
+  const TempDir tmp("segq_fifo");
+  const auto &dir = tmp.path();
+  {
+    SegmentedQueue queue(dir.string(), 16);
+    for (uint64_t v = 1; v <= 100; ++v) {
+      queue.push(v);
+    }
+    EXPECT_EQ(queue.size(), 100u);
+    EXPECT_EQ(queue.segment_count(), 7u);
+    // Only the head and tail segments are mapped.
+    EXPECT_LE(queue.mapped_bytes(), 2 * (32 + 16 * sizeof(uint64_t)));
+
+    uint64_t v = 0;
+    for (uint64_t expected = 1; expected <= 100; ++expected) {
+      ASSERT_TRUE(queue.pop(&v));
+      EXPECT_EQ(v, expected);
+    }
+    EXPECT_FALSE(queue.pop(&v));
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(SegmentedQueueTest, CommitDropsConsumedSegmentsAndReopens) {
+  const TempDir tmp("segq_reopen");
+  const auto &dir = tmp.path();
+  {
+    SegmentedQueue queue(dir.string(), 16);
+    for (uint64_t v = 1; v <= 50; ++v) {
+      queue.push(v);
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < 35; ++i) {
+      ASSERT_TRUE(queue.pop(&v));
+    }
+    queue.commit();
+    EXPECT_EQ(count_segment_files(dir), 2u);
+    // Popped after the commit: replayed on reopen.
+    ASSERT_TRUE(queue.pop(&v));
+    EXPECT_EQ(v, 36u);
+  }
+  {
+    SegmentedQueue queue(dir.string(), 16);
+    EXPECT_EQ(queue.size(), 15u);
+    std::vector<uint64_t> listed;
+    queue.for_each([&listed](uint64_t v) { listed.push_back(v); });
+    ASSERT_EQ(listed.size(), 15u);
+    EXPECT_EQ(listed.front(), 36u);
+    EXPECT_EQ(listed.back(), 50u);
+
+    queue.push(51);
+    uint64_t v = 0;
+    for (uint64_t expected = 36; expected <= 51; ++expected) {
+      ASSERT_TRUE(queue.pop(&v));
+      EXPECT_EQ(v, expected);
+    }
+    queue.clear();
+    EXPECT_EQ(count_segment_files(dir), 0u);
+  }
+}
+
+TEST(SegmentedQueueTest, CommitListsSegmentsPushedToSinceTheLastOne) {
+  const TempDir tmp("segq_dirty");
+  const auto &dir = tmp.path();
+  {
+    SegmentedQueue queue(dir.string(), 16);
+    for (uint64_t v = 1; v <= 20; ++v) {
+      queue.push(v);
+    }
+    auto commit = queue.prepare_commit();
+    ASSERT_EQ(commit.dirty.size(), 2u);
+    SegmentedQueue::sync_segments(commit.dirty);
+    SegmentedQueue::apply_commit(commit);
+
+    EXPECT_TRUE(queue.prepare_commit().dirty.empty());
+    queue.push(21);
+    auto next = queue.prepare_commit();
+    ASSERT_EQ(next.dirty.size(), 1u);
+    EXPECT_EQ(next.dirty[0], commit.dirty[1]);
+
+    // Merging keeps each segment once.
+    commit.merge(std::move(next));
+    EXPECT_EQ(commit.dirty.size(), 2u);
+  }
+}
+
+TEST(SegmentedQueueTest, DiskBackedFrontierResumesPendingEntries) {
+  const TempDir tmp("segq_frontier");
+  const auto &dir = tmp.path();
+  {
+    CrawlFrontier frontier(VisitedIndexOptions{}, dir.string(), 16);
+    EXPECT_TRUE(frontier.disk_backed());
+    for (uint64_t uid = 1; uid <= 40; ++uid) {
+      frontier.push(uid, static_cast<int>(uid % 3));
+    }
+    EXPECT_FALSE(frontier.push(7, 0));
+    uint64_t uid = 0;
+    int depth = 0;
+    ASSERT_TRUE(frontier.pop(&uid, &depth));
+    EXPECT_EQ(uid, 1u);
+    EXPECT_EQ(depth, 1);
+    frontier.checkpoint();
+  }
+  {
+    CrawlFrontier frontier(VisitedIndexOptions{}, dir.string(), 16);
+    EXPECT_EQ(frontier.pending(), 39u);
+    frontier.reseed_seen();
+    EXPECT_TRUE(frontier.seen(40));
+    EXPECT_FALSE(frontier.push(40, 1));
+    EXPECT_TRUE(frontier.push(1, 0));
+
+    const auto entries = frontier.pending_entries();
+    ASSERT_EQ(entries.size(), 40u);
+    EXPECT_EQ(entries.front().first, 2u);
+    EXPECT_EQ(entries.front().second, 2);
+    EXPECT_EQ(entries.back().first, 1u);
+    frontier.clear();
+  }
+}
@@ -0,0 +1,101 @@
+#include "session_pool.hpp"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+std::unique_ptr<RateLimitRegistry> make_limits() {
+  auto limits = std::make_unique<RateLimitRegistry>();
+  RateLimitRegistry::EndpointOptions profile;
+  profile.name = "profile";
+  profile.prefix = "/ajax/profile/";
+  profile.min_interval_ms = 1000;
+  profile.cooldown_429_ms = 0;
+  limits->add(profile);
+  RateLimitRegistry::EndpointOptions fallback;
+  fallback.name = "default";
+  fallback.min_interval_ms = 1000;
+  fallback.cooldown_429_ms = 0;
+  limits->add(fallback);
+  return limits;
+}
+
+SessionPoolOptions make_options() {
+  SessionPoolOptions options;
+  options.quarantine_after_429s = 2;
+  options.quarantine_ms = 60000;
+  return options;
+}
+
+}
+
+TEST(SessionPoolTest, SpreadsRequestsAcrossSessions) {
+  SessionPool pool(make_options());
+  pool.add("a", make_limits());
+  pool.add("b", make_limits());
+  const auto t0 = Clock::now();
+
+  const auto first = pool.acquire("/ajax/profile/info?uid=1", milliseconds(0), t0);
+  const auto second = pool.acquire("/ajax/profile/info?uid=2", milliseconds(0), t0);
+  const auto third = pool.acquire("/ajax/profile/info?uid=3", milliseconds(0), t0);
+
+  // Two accounts send two requests at once; the third waits one interval.
+  EXPECT_NE(first.session, second.session);
+  EXPECT_EQ(first.send_at, t0);
+  EXPECT_EQ(second.send_at, t0);
+  EXPECT_EQ(third.send_at, t0 + milliseconds(1000));
+  EXPECT_EQ(pool.endpoint_name(first.endpoint), "profile");
+
+  const auto other = pool.acquire("/ajax/statuses/mymblog?uid=1", milliseconds(0), t0);
+  EXPECT_EQ(pool.endpoint_name(other.endpoint), "default");
+  EXPECT_EQ(other.send_at, t0);
+
+  const auto stats = pool.stats(t0);
+  EXPECT_EQ(stats[0].requests + stats[1].requests, 4U);
+  EXPECT_EQ(stats[0].in_flight + stats[1].in_flight, 4U);
+  pool.release(first, 200, milliseconds(10), t0);
+  pool.cancel(third);
+  const auto after = pool.stats(t0);
+  EXPECT_EQ(after[0].in_flight + after[1].in_flight, 2U);
+
+  const auto endpoints = pool.endpoint_stats();
+  ASSERT_EQ(endpoints.size(), 2U);
+  EXPECT_EQ(endpoints[0].requests, 3U);
+  EXPECT_DOUBLE_EQ(endpoints[0].rate_rps, 2.0);
+}
+
+TEST(SessionPoolTest, QuarantinesSessionAfterRepeated429s) {
+  SessionPool pool(make_options());
+  pool.add("a", make_limits());
+  pool.add("b", make_limits());
+  const auto t0 = Clock::now();
+  const std::string url = "/ajax/profile/info?uid=1";
+
+  SessionPool::Lease lease = pool.acquire(url, milliseconds(0), t0);
+  const size_t throttled = lease.session;
+  pool.release(lease, 429, milliseconds(10), t0);
+  // A success in between resets the streak.
+  lease.session = throttled;
+  pool.release(lease, 200, milliseconds(10), t0);
+  pool.release(lease, 429, milliseconds(10), t0);
+  EXPECT_FALSE(pool.stats(t0)[throttled].quarantined);
+  pool.release(lease, 429, milliseconds(10), t0);
+
+  auto stats = pool.stats(t0);
+  EXPECT_TRUE(stats[throttled].quarantined);
+  EXPECT_EQ(stats[throttled].quarantines, 1U);
+  EXPECT_EQ(stats[throttled].throttled, 3U);
+
+  // Even once the other session is busy, the quarantined one is skipped.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NE(pool.acquire(url, milliseconds(0), t0).session, throttled);
+  }
+
+  // After the quarantine the session is used again.
+  const auto later = t0 + milliseconds(60000);
+  EXPECT_FALSE(pool.stats(later)[throttled].quarantined);
+  EXPECT_EQ(pool.acquire(url, milliseconds(0), later).session, throttled);
+}
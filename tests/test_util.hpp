@@ -0,0 +1,38 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+
+// A fresh directory under the system temp dir, removed with everything in
+// it when the guard goes out of scope.
+class TempDir {
+public:
+  explicit TempDir(const std::string &suffix) {
+    static std::atomic<unsigned> counter{0};
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    m_path = std::filesystem::temp_directory_path() /
+             ("cpp_spider_test_" + std::to_string(::getpid()) + "_" + std::to_string(stamp) + "_" +
+              std::to_string(counter++) + "_" + suffix);
+    std::filesystem::create_directories(m_path);
+  }
+  ~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(m_path, ec);
+  }
+  TempDir(const TempDir &) = delete;
+  TempDir &operator=(const TempDir &) = delete;
+
+  const std::filesystem::path &path() const { return m_path; }
+  // A path inside the directory; nothing is created there.
+  std::filesystem::path file(const std::string &name) const { return m_path / name; }
+
+private:
+  std::filesystem::path m_path;
+};
+
+#endif  // TEST_UTIL_HPP
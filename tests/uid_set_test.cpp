@@ -0,0 +1,48 @@
+#include "uid_set.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <set>
+
+TEST(UidSetTest, InsertReportsNewMembersOnly) {
+  UidSet set;
+
+  EXPECT_TRUE(set.insert(6126303533ULL));
+  EXPECT_FALSE(set.insert(6126303533ULL));
+  EXPECT_TRUE(set.insert(0));
+  EXPECT_FALSE(set.insert(0));
+  EXPECT_EQ(set.size(), 2U);
+  EXPECT_TRUE(set.contains(0));
+  EXPECT_EQ(set.count(6126303533ULL), 1U);
+  EXPECT_EQ(set.count(42), 0U);
+}
+
+TEST(UidSetTest, MatchesStdSetAcrossGrowth) {
+  UidSet set;
+  std::set<uint64_t> reference;
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<uint64_t> dist(1000000000ULL, 1001000000ULL);
+
+  for (int i = 0; i < 50000; ++i) {
+    const uint64_t uid = dist(rng);
+    EXPECT_EQ(set.insert(uid), reference.insert(uid).second);
+  }
+  ASSERT_EQ(set.size(), reference.size());
+  for (int i = 0; i < 10000; ++i) {
+    const uint64_t uid = dist(rng);
+    ASSERT_EQ(set.contains(uid), reference.count(uid) == 1);
+  }
+
+  const auto sorted = set.sorted();
+  EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), reference.begin(), reference.end()));
+}
+
+TEST(UidSetTest, StaysUnderTwentyFourBytesPerUid) {
+  UidSet set;
+  for (uint64_t uid = 1; uid <= 100000; ++uid) {
+    set.insert(5000000000ULL + uid * 17);
+  }
+
+  EXPECT_LE(set.memory_bytes(), set.size() * 24);
+}
@@ -0,0 +1,232 @@
+#include "bloom_filter.hpp"
+#include "uid_run_store.hpp"
+#include "visited_index.hpp"
+#include "test_util.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <set>
+
+TEST(BloomFilterTest, NeverReportsFalseNegatives) {
+  BloomFilter bloom(10000, 0.01);
+  for (uint64_t uid = 1; uid <= 10000; ++uid) {
+    bloom.add(uid * 7919);
+  }
+  for (uint64_t uid = 1; uid <= 10000; ++uid) {
+    ASSERT_TRUE(bloom.possibly_contains(uid * 7919));
+  }
+}
+
+TEST(BloomFilterTest, FalsePositiveRateNearTarget) {
+  BloomFilter bloom(20000, 0.01);
+  for (uint64_t uid = 1; uid <= 20000; ++uid) {
+    bloom.add(uid);
+  }
+  int false_positives = 0;
+  const int probes = 100000;
+  for (uint64_t uid = 1000000; uid < 1000000 + probes; ++uid) {
+    false_positives += bloom.possibly_contains(uid) ? 1 : 0;
+  }
+
+  const double rate = static_cast<double>(false_positives) / probes;
+  EXPECT_LT(rate, 0.02);
+  EXPECT_NEAR(bloom.expected_fpr(), 0.01, 0.005);
+}
+
+TEST(UidRunStoreTest, FlushesRunsAndReopens) {
+  const TempDir tmp("uid_runs");
+  const auto &dir = tmp.path();
+  {
+    UidRunStore store(dir.string(), 100, 4);
+    for (uint64_t uid = 1; uid <= 1050; ++uid) {
+      store.insert(uid * 3);
+    }
+    // Every 4 runs of 100 became one of 400: 2 of those plus 2 of 100.
+    EXPECT_EQ(store.run_count(), 4U);
+    EXPECT_EQ(store.size(), 1050U);
+    EXPECT_TRUE(store.contains(3));
+    EXPECT_TRUE(store.contains(3150));
+    EXPECT_FALSE(store.contains(4));
+  }
+  {
+    UidRunStore reopened(dir.string(), 100, 4);
+    EXPECT_EQ(reopened.size(), 1050U);
+    EXPECT_TRUE(reopened.contains(1500));
+    EXPECT_FALSE(reopened.contains(1501));
+
+    std::set<uint64_t> all;
+    reopened.for_each([&all](uint64_t uid) { all.insert(uid); });
+    EXPECT_EQ(all.size(), 1050U);
+
+    reopened.clear();
+    EXPECT_EQ(reopened.size(), 0U);
+  }
+}
+
+TEST(UidRunStoreTest, SealedBufferIsVisibleUntilItsRunIsWritten) {
+  const TempDir tmp("uid_runs_seal");
+  const auto &dir = tmp.path();
+  {
+    UidRunStore store(dir.string(), 1000, 4);
+    for (uint64_t uid = 1; uid <= 10; ++uid) {
+      store.insert(uid);
+    }
+    auto write_runs = store.seal();
+    store.insert(11);
+    EXPECT_EQ(store.run_count(), 0U);
+    EXPECT_EQ(store.size(), 11U);
+    EXPECT_TRUE(store.contains(10));
+
+    write_runs();
+    // Nothing is sealed since, so a second run of the task is a no-op.
+    write_runs();
+    store.insert(12);
+    EXPECT_EQ(store.run_count(), 1U);
+    EXPECT_EQ(store.size(), 12U);
+    EXPECT_TRUE(store.contains(10));
+  }
+  UidRunStore reopened(dir.string(), 1000, 4);
+  EXPECT_EQ(reopened.size(), 12U);
+}
+
+TEST(UidRunStoreTest, SealTaskAfterClearWritesNothing) {
+  const TempDir tmp("uid_runs_seal_clear");
+  const auto &dir = tmp.path();
+  {
+    UidRunStore store(dir.string(), 1000, 4);
+    store.insert(1);
+    auto write_runs = store.seal();
+    store.clear();
+    write_runs();
+    EXPECT_EQ(store.size(), 0U);
+  }
+  UidRunStore reopened(dir.string(), 1000, 4);
+  EXPECT_EQ(reopened.size(), 0U);
+}
+
+TEST(UidRunStoreTest, BackgroundMergeRunsInSealTask) {
+  const TempDir tmp("uid_runs_merge");
+  const auto &dir = tmp.path();
+  const auto files = [&dir] {
+    return static_cast<size_t>(std::distance(std::filesystem::directory_iterator(dir),
+                                             std::filesystem::directory_iterator()));
+  };
+  {
+    UidRunStore store(dir.string(), 10, 2, false, true);
+    for (uint64_t uid = 1; uid <= 40; ++uid) {
+      store.insert(uid);
+    }
+    // Insert only writes runs; the merge waits for a seal() task.
+    EXPECT_EQ(store.run_count(), 4U);
+
+    // Each task merges one pair; the next seal() adopts it and plans the
+    // next: 10+10 -> 20, 10+10 -> 20, 20+20 -> 40.
+    auto task = store.seal();
+    task();
+    task = store.seal();
+    EXPECT_EQ(store.run_count(), 3U);
+    EXPECT_EQ(files(), 3U);
+    task();
+    task = store.seal();
+    EXPECT_EQ(store.run_count(), 2U);
+    task();
+    store.insert(41);
+    EXPECT_EQ(store.run_count(), 1U);
+    EXPECT_EQ(files(), 1U);
+    EXPECT_EQ(store.size(), 41U);
+    for (uint64_t uid = 1; uid <= 41; ++uid) {
+      ASSERT_TRUE(store.contains(uid));
+    }
+  }
+  UidRunStore reopened(dir.string(), 10, 2, false, true);
+  EXPECT_EQ(reopened.size(), 41U);
+}
+
+TEST(UidRunStoreTest, TornRunIsSetAsideOnReopen) {
+  const TempDir tmp("uid_runs_torn");
+  const auto &dir = tmp.path();
+  {
+    UidRunStore store(dir.string(), 100, 8, true);
+    for (uint64_t uid = 1; uid <= 250; ++uid) {
+      store.insert(uid);
+    }
+    store.flush();
+    EXPECT_EQ(store.run_count(), 3U);
+  }
+  std::filesystem::path newest;
+  for (const auto &entry : std::filesystem::directory_iterator(dir)) {
+    newest = std::max(newest, entry.path());
+  }
+  std::filesystem::resize_file(newest, 10);
+
+  UidRunStore reopened(dir.string(), 100, 8, true);
+  EXPECT_EQ(reopened.run_count(), 2U);
+  EXPECT_EQ(reopened.size(), 200U);
+  EXPECT_FALSE(reopened.contains(250));
+  EXPECT_TRUE(std::filesystem::exists(newest.string() + ".corrupt"));
+  // The torn run's sequence number is not handed out again.
+  reopened.insert(250);
+  reopened.flush();
+  EXPECT_FALSE(std::filesystem::exists(newest));
+}
+
+TEST(VisitedIndexTest, MemoryModeBehavesLikeASet) {
+  VisitedIndex index;
+
+  EXPECT_FALSE(index.tiered());
+  EXPECT_TRUE(index.insert(5));
+  EXPECT_FALSE(index.insert(5));
+  EXPECT_TRUE(index.contains(5));
+  EXPECT_EQ(index.size(), 1U);
+}
+
+TEST(VisitedIndexTest, MemoryViewIsUnaffectedByLaterInserts) {
+  VisitedIndex index;
+  index.insert(1);
+  index.insert(2);
+  auto view = index.view();
+  index.insert(3);
+  EXPECT_EQ(view->sorted(), (std::vector<uint64_t>{1, 2}));
+  EXPECT_EQ(index.size(), 3U);
+
+  view.reset();
+  index.clear();
+  EXPECT_TRUE(index.empty());
+}
+
+TEST(VisitedIndexTest, TieredModeIsExactAndMeasuresFalsePositives) {
+  const TempDir tmp("visited_index");
+  const auto &dir = tmp.path();
+  VisitedIndexOptions options;
+  options.tiered = true;
+  options.dir = dir.string();
+  options.bloom_expected_items = 5000;
+  options.bloom_fpr = 0.05;
+  options.buffer_uids = 512;
+  {
+    VisitedIndex index(options);
+    for (uint64_t uid = 1; uid <= 5000; ++uid) {
+      ASSERT_TRUE(index.insert(uid * 2));
+    }
+    EXPECT_FALSE(index.insert(2));
+    for (uint64_t uid = 1; uid <= 5000; ++uid) {
+      ASSERT_TRUE(index.contains(uid * 2));
+      ASSERT_FALSE(index.contains(uid * 2 + 1));
+    }
+
+    const auto stats = index.stats();
+    EXPECT_GT(stats.bloom_negatives, 0U);
+    EXPECT_GT(stats.false_positives, 0U);
+    EXPECT_LT(stats.measured_fpr, 0.15);
+    EXPECT_GT(stats.expected_fpr, 0.0);
+    EXPECT_LT(index.memory_bytes(), 5000 * sizeof(uint64_t));
+  }
+  {
+    // Reopening rebuilds the Bloom filter from the runs on disk.
+    VisitedIndex reopened(options);
+    EXPECT_EQ(reopened.size(), 5000U);
+    EXPECT_TRUE(reopened.contains(10000));
+    EXPECT_FALSE(reopened.contains(10001));
+  }
+}
@@ -0,0 +1,178 @@
+#include "weibo_decode.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+struct DecodeBackend {
+  const char *name;
+  ProfileResponse (*decode_profile)(const std::string &);
+  FriendshipsPage (*decode_friendships)(const std::string &);
+  TimelinePage (*decode_timeline)(const std::string &);
+};
+
+namespace {
+
+// Trimmed responses with the shape of the real endpoints; the fields the
+// decoders skip are kept so that skipping is exercised too.
+const char *kProfile = R"({
+  "ok": 1,
+  "data": {
+    "user": {
+      "id": 6126303533,
+      "idstr": "6126303533",
+      "screen_name": "gugugu",
+      "profile_image_url": "https://tvax1.sinaimg.cn/crop.0.0.180.180.50/x.jpg",
+      "verified": false,
+      "followers_count": 1520,
+      "friends_count": 301,
+      "statuses_count": -1,
+      "status_total_counter": {"total_cnt": "1,024", "like_cnt": "800"},
+      "mbrank": 0.5
+    },
+    "tabList": [{"name": "home", "tabName": "Home"}]
+  }
+})";
+
+const char *kFriendships = R"({
+  "ok": 1,
+  "display_total_number": 3,
+  "next_cursor": 20,
+  "users": [
+    {"id": 101, "screen_name": "alice", "followers_count": 10, "friends_count": 2,
+     "statuses_count": 5, "status": {"id": 999, "text": "nested"}},
+    {"id": 102, "screen_name": "bob", "followers_count": "1.2万"},
+    {"screen_name": "no id"},
+    {"id": 103, "screen_name": null}
+  ]
+})";
+
+const char *kTimeline = R"({
+  "ok": 1,
+  "data": {
+    "since_id": "",
+    "list": [
+      {
+        "id": 5001,
+        "isTop": 1,
+        "created_at": "Tue Oct 14 10:00:00 +0800 2026",
+        "text": "two pictures",
+        "pic_ids": ["p2", "p1"],
+        "pic_infos": {
+          "p2": {"thumbnail": {"url": "https://wx1/thumb/p2.jpg"}, "large": {"url": "https://wx1/large/p2.jpg"}},
+          "p1": {"large": {"url": "https://wx1/large/p1.jpg"}, "original": {"url": "https://wx1/orig/p1.jpg"}},
+          "p0": {"thumbnail": {"url": "https://wx1/thumb/p0.jpg"}}
+        },
+        "user": {"id": 6126303533, "screen_name": "gugugu"},
+        "reposts_count": 3
+      },
+      {
+        "id": 5000,
+        "isTop": 0,
+        "created_at": "Mon Oct 13 09:00:00 +0800 2026",
+        "text": "a video",
+        "page_info": {"type": "video", "media_info": {"stream_url": "https://f.video/v.mp4", "duration": 12.5}},
+        "retweeted_status": {
+          "id": 4000,
+          "text": "original",
+          "pic_infos": {"q": {"large": {"url": "https://wx1/large/q.jpg"}}}
+        }
+      }
+    ],
+    "total": 2
+  }
+})";
+
+const DecodeBackend kBackends[] = {
+    {"nlohmann", nlohmann_backend::decode_profile, nlohmann_backend::decode_friendships,
+     nlohmann_backend::decode_timeline},
+#ifdef SPIDER_HAVE_SIMDJSON
+    {"simdjson", simdjson_backend::decode_profile, simdjson_backend::decode_friendships,
+     simdjson_backend::decode_timeline},
+#endif
+};
+
+// Every backend has to decode the fixtures the same way.
+class WeiboDecodeTest : public ::testing::TestWithParam<DecodeBackend> {
+protected:
+  ProfileResponse decode_profile(const std::string &body) const { return GetParam().decode_profile(body); }
+  FriendshipsPage decode_friendships(const std::string &body) const {
+    return GetParam().decode_friendships(body);
+  }
+  TimelinePage decode_timeline(const std::string &body) const { return GetParam().decode_timeline(body); }
+};
+
+}
+
+TEST_P(WeiboDecodeTest, DecodesProfile) {
+  const ProfileResponse response = decode_profile(kProfile);
+  EXPECT_EQ(response.ok, 1);
+  EXPECT_EQ(response.user.uid, 6126303533U);
+  EXPECT_EQ(response.user.screen_name, "gugugu");
+  EXPECT_EQ(response.user.followers_count, 1520U);
+  EXPECT_EQ(response.user.friends_count, 301U);
+  EXPECT_EQ(response.user.statuses_count, 0U);
+
+  const ProfileResponse failed = decode_profile(R"({"ok": 0, "msg": "rate limited"})");
+  EXPECT_EQ(failed.ok, 0);
+  EXPECT_TRUE(failed.user.screen_name.empty());
+}
+
+TEST_P(WeiboDecodeTest, DecodesFriendshipsPage) {
+  const FriendshipsPage page = decode_friendships(kFriendships);
+  ASSERT_TRUE(page.display_total_number.has_value());
+  EXPECT_EQ(*page.display_total_number, 3U);
+  ASSERT_EQ(page.users.size(), 3U);
+  EXPECT_EQ(page.users[0].uid, 101U);
+  EXPECT_EQ(page.users[0].screen_name, "alice");
+  EXPECT_EQ(page.users[0].followers_count, 10U);
+  EXPECT_EQ(page.users[0].statuses_count, 5U);
+  EXPECT_EQ(page.users[1].uid, 102U);
+  EXPECT_EQ(page.users[1].followers_count, 0U);
+  EXPECT_EQ(page.users[2].uid, 103U);
+  EXPECT_TRUE(page.users[2].screen_name.empty());
+
+  const FriendshipsPage empty = decode_friendships(R"({"users": []})");
+  EXPECT_FALSE(empty.display_total_number.has_value());
+  EXPECT_TRUE(empty.users.empty());
+}
+
+TEST_P(WeiboDecodeTest, DecodesTimelinePage) {
+  const TimelinePage page = decode_timeline(kTimeline);
+  ASSERT_EQ(page.posts.size(), 2U);
+
+  const TimelinePost &pictures = page.posts[0];
+  EXPECT_EQ(pictures.id, 5001U);
+  EXPECT_TRUE(pictures.pinned);
+  EXPECT_EQ(pictures.created_at, "Tue Oct 14 10:00:00 +0800 2026");
+  EXPECT_EQ(pictures.text, "two pictures");
+  ASSERT_EQ(pictures.pics.size(), 2U);
+  EXPECT_EQ(pictures.pics[0], "https://wx1/large/p2.jpg");
+  EXPECT_EQ(pictures.pics[1], "https://wx1/large/p1.jpg");
+  EXPECT_TRUE(pictures.stream_url.empty());
+
+  const TimelinePost &video = page.posts[1];
+  EXPECT_EQ(video.id, 5000U);
+  EXPECT_FALSE(video.pinned);
+  EXPECT_EQ(video.text, "a video");
+  EXPECT_EQ(video.stream_url, "https://f.video/v.mp4");
+  // The retweeted post's pictures belong to the other post.
+  EXPECT_TRUE(video.pics.empty());
+}
+
+TEST_P(WeiboDecodeTest, RejectsMalformedBodies) {
+  EXPECT_THROW(decode_profile("<html>login</html>"), std::runtime_error);
+  EXPECT_THROW(decode_friendships(R"({"users": [{"id": 1})"), std::runtime_error);
+  EXPECT_THROW(decode_friendships(R"({"ok": 1, "users": null})"), std::runtime_error);
+  EXPECT_THROW(decode_timeline(R"({"ok": 1, "data": {}})"), std::runtime_error);
+  // Odd shapes inside the arrays are skipped, not misread.
+  EXPECT_TRUE(decode_friendships(R"({"users": [[1, 2], "x", 3]})").users.empty());
+  EXPECT_TRUE(decode_timeline(R"({"data": {"list": [[{"id": 1}]]}})").posts.empty());
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends,
+                         WeiboDecodeTest,
+                         ::testing::ValuesIn(kBackends),
+                         [](const ::testing::TestParamInfo<DecodeBackend> &info) {
+                           return std::string(info.param.name);
+                         });
@@ -27,3 +27,21 @@ TEST(UserTest, SetWeiboReplacesCurrentCollection) {
   EXPECT_EQ(user.weibo[0].id, 2U);
   EXPECT_EQ(user.weibo[1].id, 3U);
 }
+
+TEST(WeiboWatermarkTest, ClassifiesTimelinePosts) {
+  using Verdict = WeiboWatermark::Verdict;
+  WeiboWatermark empty;
+  EXPECT_EQ(empty.classify(1, false), Verdict::New);
+  EXPECT_EQ(empty.classify(1, true), Verdict::New);
+
+  WeiboWatermark watermark;
+  watermark.max_id = 500;
+  watermark.pinned_ids = {120};
+  EXPECT_EQ(watermark.classify(501, false), Verdict::New);
+  EXPECT_EQ(watermark.classify(500, false), Verdict::Stop);
+  EXPECT_EQ(watermark.classify(499, false), Verdict::Stop);
+  // An old pinned post above the new ones does not end the walk.
+  EXPECT_EQ(watermark.classify(120, true), Verdict::Known);
+  EXPECT_EQ(watermark.classify(90, true), Verdict::New);
+  EXPECT_EQ(watermark.classify(600, true), Verdict::New);
+}